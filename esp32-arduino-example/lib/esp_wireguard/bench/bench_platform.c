@@ -0,0 +1,45 @@
+// Host implementation of wireguard-platform.h for the benchmark
+// Mirrors src/wireguard-platform.c but uses the Linux clocks and getrandom() instead of lwIP / mbedTLS
+
+#include "wireguard-platform.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <sys/random.h>
+
+#include "crypto.h"
+
+esp_err_t wireguard_platform_init() {
+	return ESP_OK;
+}
+
+void wireguard_random_bytes(void *bytes, size_t size) {
+	uint8_t *out = (uint8_t *)bytes;
+	ssize_t n;
+	while (size > 0) {
+		n = getrandom(out, size, 0);
+		if (n <= 0) {
+			abort();
+		}
+		out += n;
+		size -= (size_t)n;
+	}
+}
+
+uint32_t wireguard_sys_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+void wireguard_tai64n_now(uint8_t *output) {
+	// See https://cr.yp.to/libtai/tai64.html
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	uint64_t seconds = 0x400000000000000aULL + ts.tv_sec;
+	uint32_t nanos = ts.tv_nsec;
+	U64TO8_BIG(output + 0, seconds);
+	U32TO8_BIG(output + 8, nanos);
+}
+// vim: noexpandtab
@@ -0,0 +1,384 @@
+// Stand-in lwIP runtime for the host checks - see lwip_host.h
+
+#include "lwip_host.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lwip/ip.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "lwip/tcpip.h"
+#include "esp_netif.h"
+
+#define LWIP_HOST_MAX_CALLBACKS	(16)
+#define LWIP_HOST_MAX_TIMEOUTS	(8)
+
+const ip_addr_t ip_addr_any;
+
+struct lwip_host_datagram lwip_host_sent[LWIP_HOST_MAX_DATAGRAMS];
+int lwip_host_sent_count;
+struct lwip_host_datagram lwip_host_input[LWIP_HOST_MAX_DATAGRAMS];
+int lwip_host_input_count;
+err_t lwip_host_send_result = ERR_OK;
+bool lwip_host_mbox_full;
+struct udp_pcb *lwip_host_udp;
+int lwip_host_pbufs;
+
+// The interface WireGuard sends through
+static struct netif lwip_host_uplink = { .name = { 's', 't' }, .mtu = 1500, .flags = NETIF_FLAG_UP | NETIF_FLAG_LINK_UP };
+struct netif *netif_default = &lwip_host_uplink;
+
+struct tcpip_callback_msg {
+	tcpip_callback_fn function;
+	void *ctx;
+	bool owned; // By the caller, so not freed once run
+};
+
+static struct tcpip_callback_msg *callbacks[LWIP_HOST_MAX_CALLBACKS];
+static int callback_count;
+
+struct lwip_host_timeout {
+	sys_timeout_handler handler;
+	void *arg;
+};
+
+static struct lwip_host_timeout timeouts[LWIP_HOST_MAX_TIMEOUTS];
+
+const char *lwip_strerr(err_t err) {
+	(void)err;
+	return "lwIP error";
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+	(void)code;
+	return "ESP error";
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key) {
+	return (strcmp(if_key, "WIFI_STA_DEF") == 0) ? (esp_netif_t *)&lwip_host_uplink : NULL;
+}
+
+esp_err_t esp_netif_get_netif_impl_name(esp_netif_t *esp_netif, char *name) {
+	esp_err_t result = ESP_FAIL;
+	if (esp_netif) {
+		strcpy(name, "st1");
+		result = ESP_OK;
+	}
+	return result;
+}
+
+struct netif *netif_find(const char *name) {
+	return (strcmp(name, "st1") == 0) ? &lwip_host_uplink : NULL;
+}
+
+void netif_set_link_up(struct netif *netif) {
+	netif->flags |= NETIF_FLAG_LINK_UP;
+}
+
+void netif_set_link_down(struct netif *netif) {
+	netif->flags &= (u8_t)~NETIF_FLAG_LINK_UP;
+}
+
+static struct pbuf *pbuf_new(pbuf_layer layer, u16_t length, pbuf_type type) {
+	struct pbuf *p = (struct pbuf *)calloc(1, sizeof(struct pbuf) + LWIP_MEM_ALIGN_SIZE(layer) + length);
+	if (p) {
+		p->payload = (u8_t *)(p + 1) + LWIP_MEM_ALIGN_SIZE(layer);
+		p->tot_len = length;
+		p->len = length;
+		p->type_internal = (u8_t)type;
+		p->ref = 1;
+		lwip_host_pbufs++;
+	}
+	return p;
+}
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+	return pbuf_new(layer, length, type);
+}
+
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len) {
+	struct pbuf *result = NULL;
+	if ((LWIP_MEM_ALIGN_SIZE(l) + length) <= payload_mem_len) {
+		p->pbuf.next = NULL;
+		p->pbuf.payload = (u8_t *)payload_mem + LWIP_MEM_ALIGN_SIZE(l);
+		p->pbuf.tot_len = length;
+		p->pbuf.len = length;
+		p->pbuf.type_internal = (u8_t)type;
+		p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+		p->pbuf.ref = 1;
+		result = &p->pbuf;
+	}
+	return result;
+}
+
+void pbuf_realloc(struct pbuf *p, u16_t size) {
+	struct pbuf *q = p;
+	u16_t shrink = (u16_t)(p->tot_len - size);
+	u16_t rem = size;
+	LWIP_ASSERT("pbuf_realloc only shrinks", size <= p->tot_len);
+	while (rem > q->len) {
+		rem = (u16_t)(rem - q->len);
+		q->tot_len = (u16_t)(q->tot_len - shrink);
+		q = q->next;
+	}
+	q->len = rem;
+	q->tot_len = rem;
+	if (q->next) {
+		pbuf_free(q->next);
+	}
+	q->next = NULL;
+}
+
+u8_t pbuf_remove_header(struct pbuf *p, size_t header_size) {
+	u8_t result = 1;
+	if (header_size <= p->len) {
+		p->payload = (u8_t *)p->payload + header_size;
+		p->len = (u16_t)(p->len - header_size);
+		p->tot_len = (u16_t)(p->tot_len - header_size);
+		result = 0;
+	}
+	return result;
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+	struct pbuf *q;
+	u8_t count = 0;
+	while (p && (--p->ref == 0)) {
+		q = p->next;
+		if (p->flags & PBUF_FLAG_IS_CUSTOM) {
+			((struct pbuf_custom *)p)->custom_free_function(p);
+		} else {
+			free(p);
+			lwip_host_pbufs--;
+		}
+		count++;
+		p = q;
+	}
+	return count;
+}
+
+void pbuf_ref(struct pbuf *p) {
+	p->ref++;
+}
+
+void pbuf_cat(struct pbuf *head, struct pbuf *tail) {
+	struct pbuf *p;
+	for (p = head; p->next; p = p->next) {
+		p->tot_len = (u16_t)(p->tot_len + tail->tot_len);
+	}
+	p->tot_len = (u16_t)(p->tot_len + tail->tot_len);
+	p->next = tail;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset) {
+	u16_t copied = 0;
+	u16_t n;
+	for (; p && (len > 0); p = p->next) {
+		if (offset >= p->len) {
+			offset = (u16_t)(offset - p->len);
+		} else {
+			n = (u16_t)(p->len - offset);
+			n = (n < len) ? n : len;
+			memcpy((u8_t *)dataptr + copied, (const u8_t *)p->payload + offset, n);
+			copied = (u16_t)(copied + n);
+			len = (u16_t)(len - n);
+			offset = 0;
+		}
+	}
+	return copied;
+}
+
+struct pbuf *pbuf_clone(pbuf_layer l, pbuf_type type, struct pbuf *p) {
+	struct pbuf *q = pbuf_new(l, p->tot_len, type);
+	if (q) {
+		pbuf_copy_partial(p, q->payload, p->tot_len, 0);
+	}
+	return q;
+}
+
+struct pbuf *lwip_host_pbuf(pbuf_type type, const void *data, u16_t len) {
+	struct pbuf *p = pbuf_new(PBUF_RAW, len, type);
+	LWIP_ASSERT("out of memory", p != NULL);
+	memcpy(p->payload, data, len);
+	return p;
+}
+
+struct pbuf *lwip_host_chain(const void *data, const u16_t *split) {
+	struct pbuf *head = NULL;
+	struct pbuf *p;
+	const u8_t *src = (const u8_t *)data;
+	for (; *split; split++) {
+		p = lwip_host_pbuf(PBUF_POOL, src, *split);
+		src += *split;
+		if (head) {
+			pbuf_cat(head, p);
+		} else {
+			head = p;
+		}
+	}
+	return head;
+}
+
+static void datagram_keep(struct lwip_host_datagram *datagrams, int *count, struct pbuf *p) {
+	LWIP_ASSERT("too many datagrams", *count < LWIP_HOST_MAX_DATAGRAMS);
+	LWIP_ASSERT("datagram too long", p->tot_len <= LWIP_HOST_MAX_DATAGRAM);
+	datagrams[*count].len = pbuf_copy_partial(p, datagrams[*count].data, p->tot_len, 0);
+	(*count)++;
+}
+
+struct udp_pcb *udp_new(void) {
+	lwip_host_udp = (struct udp_pcb *)calloc(1, sizeof(struct udp_pcb));
+	return lwip_host_udp;
+}
+
+void udp_remove(struct udp_pcb *pcb) {
+	if (pcb == lwip_host_udp) {
+		lwip_host_udp = NULL;
+	}
+	free(pcb);
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+	pcb->local_ip = *ipaddr;
+	pcb->local_port = port;
+	return ERR_OK;
+}
+
+void udp_bind_netif(struct udp_pcb *pcb, const struct netif *netif) {
+	(void)pcb;
+	(void)netif;
+}
+
+void udp_disconnect(struct udp_pcb *pcb) {
+	(void)pcb;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+	pcb->recv = recv;
+	pcb->recv_arg = recv_arg;
+}
+
+err_t udp_sendto_if(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port, struct netif *netif) {
+	(void)pcb;
+	(void)dst_ip;
+	(void)dst_port;
+	LWIP_ASSERT("sent on the underlying interface", netif == &lwip_host_uplink);
+	if (lwip_host_send_result == ERR_OK) {
+		datagram_keep(lwip_host_sent, &lwip_host_sent_count, p);
+	}
+	return lwip_host_send_result;
+}
+
+// As ip4_input and ip6_input, which drop a packet whose header is not all in the first pbuf
+err_t ip_input(struct pbuf *p, struct netif *inp) {
+	u8_t version = (p->len > 0) ? (*(u8_t *)p->payload >> 4) : 0;
+	u16_t header_len = (version == 6) ? IP6_HLEN : (version == 4) ? IPH_HL_BYTES((struct ip_hdr *)p->payload) : 0xFFFF;
+	(void)inp;
+	if ((header_len >= IP_HLEN) && (p->len >= header_len)) {
+		datagram_keep(lwip_host_input, &lwip_host_input_count, p);
+	}
+	pbuf_free(p);
+	return ERR_OK;
+}
+
+u32_t sys_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u32_t)((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg) {
+	int x;
+	(void)msecs;
+	for (x = 0; x < LWIP_HOST_MAX_TIMEOUTS; x++) {
+		if (!timeouts[x].handler) {
+			timeouts[x].handler = handler;
+			timeouts[x].arg = arg;
+			break;
+		}
+	}
+	LWIP_ASSERT("too many timeouts", x < LWIP_HOST_MAX_TIMEOUTS);
+}
+
+void sys_untimeout(sys_timeout_handler handler, void *arg) {
+	int x;
+	for (x = 0; x < LWIP_HOST_MAX_TIMEOUTS; x++) {
+		if ((timeouts[x].handler == handler) && (timeouts[x].arg == arg)) {
+			timeouts[x].handler = NULL;
+		}
+	}
+}
+
+static err_t callback_post(struct tcpip_callback_msg *msg) {
+	err_t result = ERR_MEM;
+	if (!lwip_host_mbox_full && (callback_count < LWIP_HOST_MAX_CALLBACKS)) {
+		callbacks[callback_count++] = msg;
+		result = ERR_OK;
+	}
+	return result;
+}
+
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx) {
+	struct tcpip_callback_msg *msg = tcpip_callbackmsg_new(function, ctx);
+	err_t result = ERR_MEM;
+	if (msg) {
+		msg->owned = false;
+		result = callback_post(msg);
+		if (result != ERR_OK) {
+			free(msg);
+		}
+	}
+	return result;
+}
+
+struct tcpip_callback_msg *tcpip_callbackmsg_new(tcpip_callback_fn function, void *ctx) {
+	struct tcpip_callback_msg *msg = (struct tcpip_callback_msg *)calloc(1, sizeof(struct tcpip_callback_msg));
+	if (msg) {
+		msg->function = function;
+		msg->ctx = ctx;
+		msg->owned = true;
+	}
+	return msg;
+}
+
+void tcpip_callbackmsg_delete(struct tcpip_callback_msg *msg) {
+	int x;
+	for (x = 0; x < callback_count; x++) {
+		LWIP_ASSERT("callback message deleted while posted", callbacks[x] != msg);
+	}
+	free(msg);
+}
+
+err_t tcpip_callbackmsg_trycallback(struct tcpip_callback_msg *msg) {
+	return callback_post(msg);
+}
+
+int lwip_host_pending_callbacks(void) {
+	return callback_count;
+}
+
+int lwip_host_run_callbacks(void) {
+	struct tcpip_callback_msg *msg;
+	bool owned;
+	int count = 0;
+	while (callback_count > 0) {
+		msg = callbacks[0];
+		callback_count--;
+		memmove(callbacks, &callbacks[1], callback_count * sizeof(callbacks[0]));
+		// An owned message may be deleted by its own callback
+		owned = msg->owned;
+		msg->function(msg->ctx);
+		if (!owned) {
+			free(msg);
+		}
+		count++;
+	}
+	return count;
+}
+
+void lwip_host_clear(void) {
+	lwip_host_sent_count = 0;
+	lwip_host_input_count = 0;
+}
@@ -0,0 +1,49 @@
+// Stand-in lwIP runtime for the host checks in wg_ifcheck.c - pbufs on the C heap, one UDP socket, an underlying
+// interface whose sent datagrams are kept, and lwIP callbacks that wait until the check runs them as the lwIP thread
+#ifndef _BENCH_LWIP_HOST_H_
+#define _BENCH_LWIP_HOST_H_
+
+#include <stdbool.h>
+
+#include "lwip/arch.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
+
+#define LWIP_HOST_MAX_DATAGRAMS	(64)
+#define LWIP_HOST_MAX_DATAGRAM	(2048)
+
+struct lwip_host_datagram {
+	u8_t data[LWIP_HOST_MAX_DATAGRAM];
+	u16_t len;
+};
+
+// Datagrams sent on the underlying interface, and the packets handed to ip_input - oldest first
+extern struct lwip_host_datagram lwip_host_sent[LWIP_HOST_MAX_DATAGRAMS];
+extern int lwip_host_sent_count;
+extern struct lwip_host_datagram lwip_host_input[LWIP_HOST_MAX_DATAGRAMS];
+extern int lwip_host_input_count;
+
+// What udp_sendto_if returns - anything but ERR_OK drops the datagram
+extern err_t lwip_host_send_result;
+// When set, tcpip_callbackmsg_trycallback finds the lwIP mailbox full
+extern bool lwip_host_mbox_full;
+
+// The socket the interface under test opened, to deliver datagrams to
+extern struct udp_pcb *lwip_host_udp;
+
+// pbufs allocated and not freed yet
+extern int lwip_host_pbufs;
+
+// A pbuf of the given length with its payload copied in, or a chain of pbufs of the lengths in split (0 ended)
+struct pbuf *lwip_host_pbuf(pbuf_type type, const void *data, u16_t len);
+struct pbuf *lwip_host_chain(const void *data, const u16_t *split);
+
+// Runs the callbacks posted to the lwIP thread, those they post in turn included - the number run
+int lwip_host_run_callbacks(void);
+int lwip_host_pending_callbacks(void);
+
+void lwip_host_clear(void);
+
+#endif /* _BENCH_LWIP_HOST_H_ */
@@ -0,0 +1,14 @@
+// Host stand-in for esp_log.h - logging is compiled out so it does not show up in the timings, but its arguments
+// still count as used
+#ifndef _BENCH_ESP_LOG_H_
+#define _BENCH_ESP_LOG_H_
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, ...) do { (void)(tag); if (0) { printf(__VA_ARGS__); } } while (0)
+#define ESP_LOGW(tag, ...) do { (void)(tag); if (0) { printf(__VA_ARGS__); } } while (0)
+#define ESP_LOGI(tag, ...) do { (void)(tag); if (0) { printf(__VA_ARGS__); } } while (0)
+#define ESP_LOGD(tag, ...) do { (void)(tag); if (0) { printf(__VA_ARGS__); } } while (0)
+#define ESP_LOGV(tag, ...) do { (void)(tag); if (0) { printf(__VA_ARGS__); } } while (0)
+
+#endif /* _BENCH_ESP_LOG_H_ */
@@ -0,0 +1,12 @@
+// Host stand-in for esp_netif.h - a single underlying interface, see lwip_host.c
+#ifndef _BENCH_ESP_NETIF_H_
+#define _BENCH_ESP_NETIF_H_
+
+#include "esp_err.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key);
+esp_err_t esp_netif_get_netif_impl_name(esp_netif_t *esp_netif, char *name);
+
+#endif /* _BENCH_ESP_NETIF_H_ */
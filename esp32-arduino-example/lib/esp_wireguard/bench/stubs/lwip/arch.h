@@ -0,0 +1,48 @@
+// Host stand-in for the lwIP headers needed by wireguard.h and wireguardif.c - only the types and macros they touch
+#ifndef _BENCH_LWIP_ARCH_H_
+#define _BENCH_LWIP_ARCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t u8_t;
+typedef int8_t s8_t;
+typedef uint16_t u16_t;
+typedef int16_t s16_t;
+typedef uint32_t u32_t;
+typedef int32_t s32_t;
+
+typedef s8_t err_t;
+#define ERR_OK		0
+#define ERR_MEM		-1
+#define ERR_BUF		-2
+#define ERR_RTE		-4
+#define ERR_VAL		-6
+#define ERR_USE		-8
+#define ERR_CONN	-11
+#define ERR_IF		-12
+#define ERR_ARG		-16
+
+#define LWIP_UNUSED_ARG(x) (void)(x)
+
+// Asserts stay on, so the checks stop at the first one that fails
+#define LWIP_ASSERT(message, assertion) do { if (!(assertion)) { fprintf(stderr, "assertion \"%s\" failed at %s:%d\n", message, __FILE__, __LINE__); abort(); } } while (0)
+
+#define MEM_ALIGNMENT				4
+#define LWIP_MEM_ALIGN_SIZE(size)	(((size) + MEM_ALIGNMENT - 1U) & ~(MEM_ALIGNMENT - 1U))
+
+#define LWIP_SUPPORT_CUSTOM_PBUF	1
+
+#define PP_HTONS(x)	((u16_t)((((x) & 0x00FFU) << 8) | (((x) & 0xFF00U) >> 8)))
+#define PP_NTOHS(x)	PP_HTONS(x)
+#define PP_HTONL(x)	((((x) & 0x000000FFUL) << 24) | (((x) & 0x0000FF00UL) << 8) | (((x) & 0x00FF0000UL) >> 8) | (((x) & 0xFF000000UL) >> 24))
+#define PP_NTOHL(x)	PP_HTONL(x)
+#define lwip_htons(x)	PP_HTONS(x)
+#define lwip_ntohs(x)	PP_HTONS(x)
+
+const char *lwip_strerr(err_t err);
+
+#endif /* _BENCH_LWIP_ARCH_H_ */
@@ -0,0 +1,42 @@
+// Host stand-in for lwip/ip.h - the IPv4 and IPv6 headers as they sit in a packet
+#ifndef _BENCH_LWIP_IP_H_
+#define _BENCH_LWIP_IP_H_
+
+#include "lwip/arch.h"
+#include "lwip/ip_addr.h"
+#include "lwip/netif.h"
+
+#define IP_HLEN		20
+#define IP6_HLEN	40
+
+struct ip_hdr {
+	u8_t _v_hl;
+	u8_t _tos;
+	u16_t _len;
+	u16_t _id;
+	u16_t _offset;
+	u8_t _ttl;
+	u8_t _proto;
+	u16_t _chksum;
+	ip4_addr_t src;
+	ip4_addr_t dest;
+};
+
+struct ip6_hdr {
+	u32_t _v_tc_fl;
+	u16_t _plen;
+	u8_t _nexth;
+	u8_t _hoplim;
+	ip6_addr_p_t src;
+	ip6_addr_p_t dest;
+};
+
+#define IPH_V(hdr)		((hdr)->_v_hl >> 4)
+#define IPH_HL(hdr)		((hdr)->_v_hl & 0x0F)
+#define IPH_HL_BYTES(hdr)	((u8_t)(IPH_HL(hdr) * 4))
+#define IPH_LEN(hdr)	((hdr)->_len)
+#define IP6H_PLEN(hdr)	(lwip_ntohs((hdr)->_plen))
+
+err_t ip_input(struct pbuf *p, struct netif *inp);
+
+#endif /* _BENCH_LWIP_IP_H_ */
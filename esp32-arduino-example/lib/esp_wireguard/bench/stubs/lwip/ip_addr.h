@@ -0,0 +1,64 @@
+// Host stand-in for lwip/ip_addr.h
+#ifndef _BENCH_LWIP_IP_ADDR_H_
+#define _BENCH_LWIP_IP_ADDR_H_
+
+#include "lwip/arch.h"
+
+#define LWIP_IPV4 1
+#define LWIP_IPV6 1
+
+typedef struct ip4_addr {
+	u32_t addr;
+} ip4_addr_t;
+
+typedef struct ip6_addr {
+	u32_t addr[4];
+	u8_t zone;
+} ip6_addr_t;
+
+enum lwip_ip_addr_type {
+	IPADDR_TYPE_V4 = 0U,
+	IPADDR_TYPE_V6 = 6U,
+	IPADDR_TYPE_ANY = 46U
+};
+
+// As it sits in a packet
+typedef struct ip6_addr_packed {
+	u32_t addr[4];
+} ip6_addr_p_t;
+
+typedef struct ip_addr {
+	union {
+		ip6_addr_t ip6;
+		ip4_addr_t ip4;
+	} u_addr;
+	u8_t type;
+} ip_addr_t;
+
+extern const ip_addr_t ip_addr_any;
+#define IP_ADDR_ANY					(&ip_addr_any)
+
+#define IP_IS_V4(ipaddr)			((ipaddr)->type == IPADDR_TYPE_V4)
+#define IP_IS_V6(ipaddr)			((ipaddr)->type == IPADDR_TYPE_V6)
+#define IP_GET_TYPE(ipaddr)			((ipaddr)->type)
+#define ip_2_ip4(ipaddr)			(&((ipaddr)->u_addr.ip4))
+#define ip_2_ip6(ipaddr)			(&((ipaddr)->u_addr.ip6))
+#define ip4_addr_get_u32(ipaddr)	((ipaddr)->addr)
+#define ip_addr_set_zero(ipaddr)	memset((ipaddr), 0, sizeof(ip_addr_t))
+#define ip_addr_copy(dest, src)		((dest) = (src))
+#define ip_addr_cmp(a, b)			(memcmp((a), (b), sizeof(ip_addr_t)) == 0)
+#define ip_addr_set_any(is_ipv6, ipaddr)	do { ip_addr_set_zero(ipaddr); (ipaddr)->type = (is_ipv6) ? IPADDR_TYPE_V6 : IPADDR_TYPE_V4; } while (0)
+#define ip_addr_isany(ipaddr)		(((ipaddr) == NULL) || ((ipaddr)->u_addr.ip6.addr[0] | (ipaddr)->u_addr.ip6.addr[1] | (ipaddr)->u_addr.ip6.addr[2] | (ipaddr)->u_addr.ip6.addr[3]) == 0)
+#define ip_addr_copy_from_ip4(dest, src)	do { ip_addr_set_zero(&(dest)); (dest).u_addr.ip4 = (src); (dest).type = IPADDR_TYPE_V4; } while (0)
+#define ip_addr_copy_from_ip6(dest, src)	do { (dest).u_addr.ip6 = (src); (dest).type = IPADDR_TYPE_V6; } while (0)
+#define ip_addr_copy_from_ip6_packed(dest, src)	do { memcpy((dest).u_addr.ip6.addr, (src).addr, 16); (dest).u_addr.ip6.zone = 0; (dest).type = IPADDR_TYPE_V6; } while (0)
+#define IP6_ADDR_BLOCK1(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[0] & 0xFFFF)))
+#define IP6_ADDR_BLOCK2(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[0] >> 16)))
+#define IP6_ADDR_BLOCK3(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[1] & 0xFFFF)))
+#define IP6_ADDR_BLOCK4(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[1] >> 16)))
+#define IP6_ADDR_BLOCK5(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[2] & 0xFFFF)))
+#define IP6_ADDR_BLOCK6(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[2] >> 16)))
+#define IP6_ADDR_BLOCK7(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[3] & 0xFFFF)))
+#define IP6_ADDR_BLOCK8(ip6addr)	((u16_t)(PP_NTOHS((ip6addr)->addr[3] >> 16)))
+
+#endif /* _BENCH_LWIP_IP_ADDR_H_ */
@@ -0,0 +1,13 @@
+// Host stand-in for lwip/mem.h - the lwIP heap is the C heap
+#ifndef _BENCH_LWIP_MEM_H_
+#define _BENCH_LWIP_MEM_H_
+
+#include <stdlib.h>
+
+#include "lwip/arch.h"
+
+#define mem_malloc(size)			malloc(size)
+#define mem_calloc(count, size)		calloc((count), (size))
+#define mem_free(mem)				free(mem)
+
+#endif /* _BENCH_LWIP_MEM_H_ */
@@ -0,0 +1,37 @@
+// Host stand-in for lwip/netif.h
+#ifndef _BENCH_LWIP_NETIF_H_
+#define _BENCH_LWIP_NETIF_H_
+
+#include "lwip/arch.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+
+#define NETIF_FLAG_UP		0x01U
+#define NETIF_FLAG_LINK_UP	0x04U
+
+struct netif;
+
+typedef err_t (*netif_input_fn)(struct pbuf *p, struct netif *inp);
+typedef err_t (*netif_output_fn)(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr);
+typedef err_t (*netif_output_ip6_fn)(struct netif *netif, struct pbuf *p, const ip6_addr_t *ipaddr);
+typedef err_t (*netif_linkoutput_fn)(struct netif *netif, struct pbuf *p);
+
+struct netif {
+	void *state;
+	netif_input_fn input;
+	netif_output_fn output;
+	netif_output_ip6_fn output_ip6;
+	netif_linkoutput_fn linkoutput;
+	u16_t mtu;
+	u8_t hwaddr_len;
+	u8_t flags;
+	char name[2];
+};
+
+extern struct netif *netif_default;
+
+struct netif *netif_find(const char *name);
+void netif_set_link_up(struct netif *netif);
+void netif_set_link_down(struct netif *netif);
+
+#endif /* _BENCH_LWIP_NETIF_H_ */
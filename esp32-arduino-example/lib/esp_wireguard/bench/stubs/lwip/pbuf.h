@@ -0,0 +1,55 @@
+// Host stand-in for lwip/pbuf.h - pbufs are allocated from the C heap, chains and reference counts work as in lwIP
+#ifndef _BENCH_LWIP_PBUF_H_
+#define _BENCH_LWIP_PBUF_H_
+
+#include "lwip/arch.h"
+
+// Room each layer leaves in front of the payload for the headers below it
+typedef enum {
+	PBUF_TRANSPORT = 62,
+	PBUF_IP = 54,
+	PBUF_LINK = 14,
+	PBUF_RAW = 0
+} pbuf_layer;
+
+#define PBUF_TYPE_FLAG_DATA_VOLATILE	0x40
+
+typedef enum {
+	PBUF_RAM = 0x80,
+	PBUF_ROM = 0x01,
+	PBUF_REF = (0x01 | PBUF_TYPE_FLAG_DATA_VOLATILE),
+	PBUF_POOL = 0x82
+} pbuf_type;
+
+#define PBUF_FLAG_IS_CUSTOM	0x02U
+
+struct pbuf {
+	struct pbuf *next;
+	void *payload;
+	u16_t tot_len;
+	u16_t len;
+	u8_t type_internal;
+	u8_t flags;
+	u16_t ref;
+};
+
+typedef void (*pbuf_free_custom_fn)(struct pbuf *p);
+
+struct pbuf_custom {
+	struct pbuf pbuf;
+	pbuf_free_custom_fn custom_free_function;
+};
+
+#define PBUF_NEEDS_COPY(p)	((p)->type_internal & PBUF_TYPE_FLAG_DATA_VOLATILE)
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len);
+void pbuf_realloc(struct pbuf *p, u16_t size);
+u8_t pbuf_remove_header(struct pbuf *p, size_t header_size);
+u8_t pbuf_free(struct pbuf *p);
+void pbuf_ref(struct pbuf *p);
+void pbuf_cat(struct pbuf *head, struct pbuf *tail);
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset);
+struct pbuf *pbuf_clone(pbuf_layer l, pbuf_type type, struct pbuf *p);
+
+#endif /* _BENCH_LWIP_PBUF_H_ */
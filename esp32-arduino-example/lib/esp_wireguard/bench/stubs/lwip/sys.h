@@ -0,0 +1,16 @@
+// Host stand-in for lwip/sys.h - built with NO_SYS semantics for threads: the handshake worker is left out
+#ifndef _BENCH_LWIP_SYS_H_
+#define _BENCH_LWIP_SYS_H_
+
+#include "lwip/arch.h"
+
+typedef int sys_prot_t;
+
+// One thread only
+#define SYS_ARCH_DECL_PROTECT(lev)	sys_prot_t lev
+#define SYS_ARCH_PROTECT(lev)		((lev) = 0)
+#define SYS_ARCH_UNPROTECT(lev)		(void)(lev)
+
+u32_t sys_now(void);
+
+#endif /* _BENCH_LWIP_SYS_H_ */
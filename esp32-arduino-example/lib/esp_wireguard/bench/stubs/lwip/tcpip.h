@@ -0,0 +1,20 @@
+// Host stand-in for lwip/tcpip.h - the checks are the lwIP thread: posted callbacks wait until they run them
+#ifndef _BENCH_LWIP_TCPIP_H_
+#define _BENCH_LWIP_TCPIP_H_
+
+#include "lwip/arch.h"
+
+#define LOCK_TCPIP_CORE()
+#define UNLOCK_TCPIP_CORE()
+#define LWIP_ASSERT_CORE_LOCKED()
+
+typedef void (*tcpip_callback_fn)(void *ctx);
+
+struct tcpip_callback_msg;
+
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx);
+struct tcpip_callback_msg *tcpip_callbackmsg_new(tcpip_callback_fn function, void *ctx);
+void tcpip_callbackmsg_delete(struct tcpip_callback_msg *msg);
+err_t tcpip_callbackmsg_trycallback(struct tcpip_callback_msg *msg);
+
+#endif /* _BENCH_LWIP_TCPIP_H_ */
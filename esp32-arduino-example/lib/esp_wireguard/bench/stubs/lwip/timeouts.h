@@ -0,0 +1,12 @@
+// Host stand-in for lwip/timeouts.h - timeouts are only recorded, the checks fire them when they choose to
+#ifndef _BENCH_LWIP_TIMEOUTS_H_
+#define _BENCH_LWIP_TIMEOUTS_H_
+
+#include "lwip/arch.h"
+
+typedef void (*sys_timeout_handler)(void *arg);
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg);
+void sys_untimeout(sys_timeout_handler handler, void *arg);
+
+#endif /* _BENCH_LWIP_TIMEOUTS_H_ */
@@ -0,0 +1,29 @@
+// Host stand-in for lwip/udp.h
+#ifndef _BENCH_LWIP_UDP_H_
+#define _BENCH_LWIP_UDP_H_
+
+#include "lwip/arch.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+
+struct netif;
+struct udp_pcb;
+
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+
+struct udp_pcb {
+	ip_addr_t local_ip;
+	u16_t local_port;
+	udp_recv_fn recv;
+	void *recv_arg;
+};
+
+struct udp_pcb *udp_new(void);
+void udp_remove(struct udp_pcb *pcb);
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+void udp_bind_netif(struct udp_pcb *pcb, const struct netif *netif);
+void udp_disconnect(struct udp_pcb *pcb);
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+err_t udp_sendto_if(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port, struct netif *netif);
+
+#endif /* _BENCH_LWIP_UDP_H_ */
@@ -0,0 +1,1307 @@
+// Host micro-benchmarks for the WireGuard crypto and protocol code
+//
+// Builds the sources in src/crypto/refc and src/wireguard.c against the stub lwIP / ESP headers in stubs/
+// and reports, as JSON on stdout:
+//  - cycles (and ns) per byte for ChaCha20, Poly1305, the AEAD and BLAKE2s at typical packet sizes
+//  - operations per second for X25519 (DH and public key generation) on every backend - libsodium and the refc
+//    ladder / comb on 32-bit and 64-bit limbs - plus creating / processing a handshake initiation and the replay check
+//  - lookups in the peer indices and the allowed IPs trie, and re-arming the peer timers. The trie is checked first
+//    against a linear longest prefix match, the replay window and the timer wheel against plain arrays
+//  - handshake admission under a simulated flood: the cookie exchange end to end, and the CPU time and per-source
+//    handshake rate that spoofed and cookie-holding floods get away with
+//  - the size of the per-peer structures, and how much of struct wireguard_peer the data path reads ("peer_hot")
+// Every result sits on its own line so two runs can be compared with a plain diff.
+//
+// Usage: make run, or ./wg_bench [-q] [-o file]
+//  -q       quick run (fewer, shorter samples) - for smoke testing, not for comparisons
+//  -o file  write the JSON to file instead of stdout
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+#include <sodium.h>
+
+#include "wireguard.h"
+#include "wireguard-ratelimiter.h"
+#include "crypto.h"
+#include "crypto/refc/chacha20.h"
+#include "crypto/refc/chacha20poly1305.h"
+#include "crypto/refc/poly1305-donna.h"
+#include "crypto/refc/blake2s.h"
+
+#define BENCH_MAX_PACKET	(1420)
+
+// Packet sizes measured for the throughput benchmarks - 1420 is the default WireGuard MTU
+static const size_t packet_sizes[] = { 64, 256, 576, BENCH_MAX_PACKET };
+
+// Each measurement is the median of this many samples, each sample running for at least the given time
+static int sample_count = 11;
+static double sample_min_ns = 20e6;
+
+static FILE *out;
+static bool first_result = true;
+
+struct bench_result {
+	double ns_per_op;
+	double cycles_per_op; // 0 when there is no cycle counter
+};
+
+typedef void (*bench_fn)(void *arg, size_t len);
+
+static double bench_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec;
+}
+
+static uint64_t bench_cycles(void) {
+#if defined(BENCH_HAVE_TSC)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static int compare_double(const void *a, const void *b) {
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// Run fn enough times to fill a sample, repeat sample_count times and keep the median time per call
+static struct bench_result bench_measure(bench_fn fn, void *arg, size_t len) {
+	struct bench_result result;
+	double ns[64];
+	double cycles[64];
+	double start_ns;
+	double elapsed;
+	uint64_t start_cycles;
+	size_t iterations = 1;
+	size_t i;
+	int s;
+
+	// Warm up and find an iteration count that fills one sample
+	for (;;) {
+		start_ns = bench_now_ns();
+		for (i = 0; i < iterations; i++) {
+			fn(arg, len);
+		}
+		elapsed = bench_now_ns() - start_ns;
+		if (elapsed >= sample_min_ns) {
+			break;
+		}
+		if (elapsed < (sample_min_ns / 100)) {
+			iterations *= 10;
+		} else {
+			iterations = (size_t)(iterations * (sample_min_ns * 1.2 / elapsed)) + 1;
+		}
+	}
+
+	for (s = 0; s < sample_count; s++) {
+		start_cycles = bench_cycles();
+		start_ns = bench_now_ns();
+		for (i = 0; i < iterations; i++) {
+			fn(arg, len);
+		}
+		ns[s] = (bench_now_ns() - start_ns) / (double)iterations;
+		cycles[s] = (double)(bench_cycles() - start_cycles) / (double)iterations;
+	}
+
+	qsort(ns, sample_count, sizeof(double), compare_double);
+	qsort(cycles, sample_count, sizeof(double), compare_double);
+	result.ns_per_op = ns[sample_count / 2];
+	result.cycles_per_op = cycles[sample_count / 2];
+	return result;
+}
+
+static void emit_prefix(void) {
+	fprintf(out, "%s\n", first_result ? "" : ",");
+	first_result = false;
+}
+
+static void report_throughput(const char *name, size_t len, struct bench_result r) {
+	emit_prefix();
+	fprintf(out, "    {\"name\": \"%s\", \"bytes\": %zu, \"cycles_per_byte\": %.2f, \"ns_per_byte\": %.3f, \"mb_per_s\": %.1f}",
+		name, len, r.cycles_per_op / (double)len, r.ns_per_op / (double)len, ((double)len * 1e3) / r.ns_per_op);
+}
+
+static void report_ops(const char *name, struct bench_result r) {
+	emit_prefix();
+	fprintf(out, "    {\"name\": \"%s\", \"ops_per_sec\": %.1f, \"cycles_per_op\": %.0f, \"ns_per_op\": %.1f}",
+		name, 1e9 / r.ns_per_op, r.cycles_per_op, r.ns_per_op);
+}
+
+static void bench_throughput(const char *name, bench_fn fn, void *arg) {
+	size_t i;
+	for (i = 0; i < sizeof(packet_sizes) / sizeof(packet_sizes[0]); i++) {
+		report_throughput(name, packet_sizes[i], bench_measure(fn, arg, packet_sizes[i]));
+	}
+}
+
+// Symmetric primitives
+
+static uint8_t buffer[BENCH_MAX_PACKET + 64];
+static uint8_t sealed[BENCH_MAX_PACKET + 64];
+static uint8_t key[32];
+
+static void run_chacha20(void *arg, size_t len) {
+	struct chacha20_ctx *ctx = (struct chacha20_ctx *)arg;
+	chacha20(ctx, buffer, buffer, len);
+}
+
+static void run_poly1305(void *arg, size_t len) {
+	poly1305_context ctx;
+	(void)arg;
+	poly1305_init(&ctx, key);
+	poly1305_update(&ctx, buffer, len);
+	poly1305_finish(&ctx, sealed);
+}
+
+static void run_aead_encrypt(void *arg, size_t len) {
+	chacha20poly1305_encrypt_key(sealed, buffer, len, NULL, 0, 0, (const struct chacha20poly1305_key *)arg);
+}
+
+static void run_aead_decrypt(void *arg, size_t len) {
+	// The tag will not match for the shorter sizes, which still costs the full MAC and decrypt pass
+	chacha20poly1305_decrypt_key(buffer, sealed, len + WIREGUARD_AUTHTAG_LEN, NULL, 0, 0, (const struct chacha20poly1305_key *)arg);
+}
+
+// A packet as lwIP chains a TCP segment, the way wireguardif streams it: IP and TCP headers in one pbuf, the data
+// in the next - which leaves the data starting part way into a ChaCha20 block
+#define BENCH_HEADER_SEGMENT_LEN	(40)
+
+static void run_aead_encrypt_segmented(void *arg, size_t len) {
+	struct chacha20poly1305_stream stream;
+	size_t header_len = (len < BENCH_HEADER_SEGMENT_LEN) ? len : BENCH_HEADER_SEGMENT_LEN;
+
+	chacha20poly1305_stream_init(&stream, NULL, 0, 0, (const struct chacha20poly1305_key *)arg);
+	chacha20poly1305_stream_encrypt(&stream, sealed, buffer, header_len);
+	chacha20poly1305_stream_encrypt(&stream, sealed + header_len, buffer + header_len, len - header_len);
+	chacha20poly1305_stream_finish(&stream, sealed + len);
+}
+
+// A batch of same-sized packets as wireguardif sends them, encrypted in place - reported per packet
+#define BENCH_BATCH_PACKETS	(8)
+
+static uint8_t batch_buffer[BENCH_BATCH_PACKETS][BENCH_MAX_PACKET + WIREGUARD_AUTHTAG_LEN];
+
+static void run_aead_encrypt_batch(void *arg, size_t len) {
+	struct chacha20poly1305_message messages[BENCH_BATCH_PACKETS];
+	size_t i;
+
+	for (i = 0; i < BENCH_BATCH_PACKETS; i++) {
+		messages[i].dst = batch_buffer[i];
+		messages[i].src = batch_buffer[i];
+		messages[i].src_len = len;
+		messages[i].len = len;
+		messages[i].nonce = i;
+	}
+	chacha20poly1305_encrypt_batch(messages, BENCH_BATCH_PACKETS, (const struct chacha20poly1305_key *)arg);
+}
+
+static void run_blake2s(void *arg, size_t len) {
+	(void)arg;
+	blake2s(sealed, WIREGUARD_HASH_LEN, NULL, 0, buffer, len);
+}
+
+static void bench_symmetric(void) {
+	struct chacha20poly1305_key aead_key;
+	struct chacha20_ctx chacha20_ctx;
+	const char *selected = chacha20_backend_name();
+	struct bench_result r;
+	char name[64];
+	int backend;
+	size_t i;
+
+	wireguard_random_bytes(key, sizeof(key));
+	wireguard_random_bytes(buffer, sizeof(buffer));
+
+	chacha20_init(&chacha20_ctx, key, 0);
+	for (backend = CHACHA20_BACKEND_PORTABLE; backend <= CHACHA20_BACKEND_AVX2; backend++) {
+		if (chacha20_set_backend((enum chacha20_backend_id)backend)) {
+			snprintf(name, sizeof(name), "chacha20/%s", chacha20_backend_name());
+			bench_throughput(name, run_chacha20, &chacha20_ctx);
+		}
+	}
+	// Everything else runs on the kernel picked by wireguard_crypto_calibrate()
+	for (backend = CHACHA20_BACKEND_PORTABLE; backend <= CHACHA20_BACKEND_AVX2; backend++) {
+		if (chacha20_set_backend((enum chacha20_backend_id)backend) && (strcmp(chacha20_backend_name(), selected) == 0)) {
+			break;
+		}
+	}
+	bench_throughput("chacha20", run_chacha20, &chacha20_ctx);
+
+	bench_throughput("poly1305", run_poly1305, NULL);
+
+	chacha20poly1305_key_init(&aead_key, key);
+	bench_throughput("aead_encrypt", run_aead_encrypt, &aead_key);
+	chacha20poly1305_encrypt_key(sealed, buffer, BENCH_MAX_PACKET, NULL, 0, 0, &aead_key);
+	bench_throughput("aead_decrypt", run_aead_decrypt, &aead_key);
+	bench_throughput("aead_encrypt_segmented", run_aead_encrypt_segmented, &aead_key);
+	for (i = 0; i < sizeof(packet_sizes) / sizeof(packet_sizes[0]); i++) {
+		r = bench_measure(run_aead_encrypt_batch, &aead_key, packet_sizes[i]);
+		r.ns_per_op /= BENCH_BATCH_PACKETS;
+		r.cycles_per_op /= BENCH_BATCH_PACKETS;
+		report_throughput("aead_encrypt_batch", packet_sizes[i], r);
+	}
+
+	bench_throughput("blake2s", run_blake2s, NULL);
+
+	crypto_zero(&aead_key, sizeof(aead_key));
+	crypto_zero(&chacha20_ctx, sizeof(chacha20_ctx));
+}
+
+// Protocol operations
+
+struct handshake_bench {
+	struct wireguard_device initiator;
+	struct wireguard_device responder;
+	struct wireguard_peer *initiator_peer; // The responder, as seen by the initiator
+	struct wireguard_peer *responder_peer; // The initiator, as seen by the responder
+	struct message_handshake_initiation msg;
+	struct wireguard_handshake_dh dh; // The handshake worker's share of processing msg
+	uint32_t receiver; // Index the responder sends transport data to
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+	struct wireguard_pregen_initiation pregen; // Saved copy, restored before each send-time measurement
+#endif
+};
+
+static void run_x25519(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	(void)len;
+	wireguard_x25519(sealed, hb->initiator.private_key, hb->responder.public_key);
+}
+
+// X25519 backends - the refc ones are extra copies of crypto/refc/x25519.c built by x25519_refc32.c / x25519_refc64.c
+
+int bench_x25519_refc32(uint8_t *out, const uint8_t *private_key, const uint8_t *public_key);
+int bench_x25519_base_refc32(uint8_t *public_key, const uint8_t *private_key);
+#if defined(__SIZEOF_INT128__) && defined(__LP64__)
+int bench_x25519_refc64(uint8_t *out, const uint8_t *private_key, const uint8_t *public_key);
+int bench_x25519_base_refc64(uint8_t *public_key, const uint8_t *private_key);
+#endif
+
+static const uint8_t x25519_basepoint[WIREGUARD_PUBLIC_KEY_LEN] = { 9 };
+
+// What wireguard_generate_public_key() used to do - the generic ladder against u=9
+static int sodium_x25519_base_ladder(uint8_t *public_key, const uint8_t *private_key) {
+	return crypto_scalarmult_curve25519(public_key, private_key, x25519_basepoint);
+}
+
+struct x25519_backend {
+	const char *name;
+	int (*scalarmult)(uint8_t *out, const uint8_t *private_key, const uint8_t *public_key);
+	int (*base)(uint8_t *public_key, const uint8_t *private_key);
+};
+
+static const struct x25519_backend x25519_backends[] = {
+	{ "sodium", crypto_scalarmult_curve25519, crypto_scalarmult_curve25519_base },
+	{ "sodium_ladder", NULL, sodium_x25519_base_ladder },
+	{ "refc32", bench_x25519_refc32, bench_x25519_base_refc32 },
+#if defined(__SIZEOF_INT128__) && defined(__LP64__)
+	{ "refc64", bench_x25519_refc64, bench_x25519_base_refc64 },
+#endif
+};
+
+#define X25519_BACKEND_COUNT (sizeof(x25519_backends) / sizeof(x25519_backends[0]))
+
+struct x25519_run {
+	const struct x25519_backend *backend;
+	struct handshake_bench *hb;
+};
+
+static void run_x25519_backend(void *arg, size_t len) {
+	struct x25519_run *run = (struct x25519_run *)arg;
+	(void)len;
+	run->backend->scalarmult(sealed, run->hb->initiator.private_key, run->hb->responder.public_key);
+}
+
+static void run_x25519_base_backend(void *arg, size_t len) {
+	struct x25519_run *run = (struct x25519_run *)arg;
+	(void)len;
+	run->backend->base(sealed, run->hb->initiator.private_key);
+}
+
+static void run_x25519_base(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	(void)len;
+	wireguard_x25519_base(sealed, hb->initiator.private_key);
+}
+
+// Streaming the AEAD over segments must give what the one-shot functions give, wherever the segments split the
+// ChaCha20 blocks and Poly1305 blocks - checked for random splits of every length up to a few blocks and a full packet
+static bool bench_check_aead_stream(void) {
+	static uint8_t plain[BENCH_MAX_PACKET];
+	static uint8_t expected[BENCH_MAX_PACKET + WIREGUARD_AUTHTAG_LEN];
+	static uint8_t actual[BENCH_MAX_PACKET + WIREGUARD_AUTHTAG_LEN];
+	struct chacha20poly1305_key aead_key;
+	struct chacha20poly1305_stream stream;
+	uint8_t k[32];
+	size_t len;
+	size_t offset;
+	size_t segment;
+	uint32_t r;
+	int round;
+	bool result = true;
+
+	wireguard_random_bytes(k, sizeof(k));
+	wireguard_random_bytes(plain, sizeof(plain));
+	chacha20poly1305_key_init(&aead_key, k);
+	for (len = 0; result && (len <= BENCH_MAX_PACKET); len = (len < 300) ? (len + 1) : (len + 97)) {
+		chacha20poly1305_encrypt_key(expected, plain, len, NULL, 0, len, &aead_key);
+		for (round = 0; result && (round < 4); round++) {
+			// Encrypt from segments into actual
+			chacha20poly1305_stream_init(&stream, NULL, 0, len, &aead_key);
+			for (offset = 0; offset < len; offset += segment) {
+				wireguard_random_bytes(&r, sizeof(r));
+				segment = 1 + (r % ((round & 1) ? 7 : 150));
+				if (segment > (len - offset)) {
+					segment = len - offset;
+				}
+				chacha20poly1305_stream_encrypt(&stream, actual + offset, plain + offset, segment);
+			}
+			chacha20poly1305_stream_finish(&stream, actual + len);
+			if (memcmp(actual, expected, len + WIREGUARD_AUTHTAG_LEN) != 0) {
+				fprintf(stderr, "aead stream encrypt mismatch, len %zu\n", len);
+				result = false;
+			}
+			// ...and decrypt it in place from other segments
+			chacha20poly1305_stream_init(&stream, NULL, 0, len, &aead_key);
+			for (offset = 0; offset < len; offset += segment) {
+				wireguard_random_bytes(&r, sizeof(r));
+				segment = 1 + (r % ((round & 2) ? 7 : 150));
+				if (segment > (len - offset)) {
+					segment = len - offset;
+				}
+				chacha20poly1305_stream_decrypt(&stream, actual + offset, actual + offset, segment);
+			}
+			if (!chacha20poly1305_stream_verify(&stream, expected + len) || (memcmp(actual, plain, len) != 0)) {
+				fprintf(stderr, "aead stream decrypt mismatch, len %zu\n", len);
+				result = false;
+			}
+		}
+		// A flipped bit anywhere must fail
+		if (result && (len > 0)) {
+			memcpy(actual, expected, len + WIREGUARD_AUTHTAG_LEN);
+			actual[len / 2] ^= 0x01;
+			chacha20poly1305_stream_init(&stream, NULL, 0, len, &aead_key);
+			chacha20poly1305_stream_decrypt(&stream, actual, actual, len);
+			if (chacha20poly1305_stream_verify(&stream, actual + len)) {
+				fprintf(stderr, "aead stream accepted a corrupt message, len %zu\n", len);
+				result = false;
+			}
+		}
+	}
+	crypto_zero(&aead_key, sizeof(aead_key));
+	return result;
+}
+
+// A batch must come out as the packets encrypted one at a time would, on every ChaCha20 kernel - whatever the mix of
+// lengths, so that blocks of different packets share the kernels' lanes and packets end part way into a block. Some
+// are encrypted in place, the others from a shorter source that is padded with zeros
+static bool bench_check_aead_batch(void) {
+	static uint8_t plain[BENCH_BATCH_PACKETS * 2][BENCH_MAX_PACKET];
+	static uint8_t padded[BENCH_MAX_PACKET];
+	static uint8_t expected[BENCH_BATCH_PACKETS * 2][BENCH_MAX_PACKET + WIREGUARD_AUTHTAG_LEN];
+	static uint8_t actual[BENCH_BATCH_PACKETS * 2][BENCH_MAX_PACKET + WIREGUARD_AUTHTAG_LEN];
+	struct chacha20poly1305_message messages[BENCH_BATCH_PACKETS * 2];
+	struct chacha20poly1305_key aead_key;
+	const char *selected = chacha20_backend_name();
+	uint8_t k[32];
+	uint32_t r;
+	size_t count;
+	size_t i;
+	int backend;
+	int round;
+	bool result = true;
+
+	wireguard_random_bytes(k, sizeof(k));
+	wireguard_random_bytes(plain, sizeof(plain));
+	chacha20poly1305_key_init(&aead_key, k);
+	for (backend = CHACHA20_BACKEND_PORTABLE; result && (backend <= CHACHA20_BACKEND_AVX2); backend++) {
+		if (!chacha20_set_backend((enum chacha20_backend_id)backend)) {
+			continue;
+		}
+		for (round = 0; result && (round < 200); round++) {
+			wireguard_random_bytes(&r, sizeof(r));
+			count = 1 + (r % (BENCH_BATCH_PACKETS * 2));
+			for (i = 0; i < count; i++) {
+				wireguard_random_bytes(&r, sizeof(r));
+				messages[i].dst = actual[i];
+				// Mostly short, now and then a full packet; odd lengths as well as padded ones
+				messages[i].len = ((r & 7) == 0) ? BENCH_MAX_PACKET : ((r >> 4) % 300);
+				if (r & 8) {
+					messages[i].len &= ~(size_t)15;
+				}
+				messages[i].nonce = ((uint64_t)r << 20) + i;
+				if (r & 0x80000000) {
+					messages[i].src = actual[i];
+					messages[i].src_len = messages[i].len;
+					memcpy(actual[i], plain[i], messages[i].len);
+				} else {
+					messages[i].src = plain[i];
+					messages[i].src_len = messages[i].len - (messages[i].len ? ((r >> 12) % 16) % messages[i].len : 0);
+				}
+				memset(padded, 0, sizeof(padded));
+				memcpy(padded, plain[i], messages[i].src_len);
+				chacha20poly1305_encrypt_key(expected[i], padded, messages[i].len, NULL, 0, messages[i].nonce, &aead_key);
+			}
+			chacha20poly1305_encrypt_batch(messages, count, &aead_key);
+			for (i = 0; result && (i < count); i++) {
+				if (memcmp(actual[i], expected[i], messages[i].len + WIREGUARD_AUTHTAG_LEN) != 0) {
+					fprintf(stderr, "aead batch mismatch on %s, packet %zu of %zu, len %zu\n", chacha20_backend_name(), i, count, messages[i].len);
+					result = false;
+				}
+			}
+		}
+	}
+	// Back to the kernel the rest runs on
+	for (backend = CHACHA20_BACKEND_PORTABLE; backend <= CHACHA20_BACKEND_AVX2; backend++) {
+		if (chacha20_set_backend((enum chacha20_backend_id)backend) && (strcmp(chacha20_backend_name(), selected) == 0)) {
+			break;
+		}
+	}
+	crypto_zero(&aead_key, sizeof(aead_key));
+	return result;
+}
+
+// Every backend must agree with libsodium - DH against real public keys and arbitrary u coordinates, and public key
+// generation - including for unclamped private keys
+static bool bench_check_x25519(void) {
+	uint8_t private_key[WIREGUARD_PRIVATE_KEY_LEN];
+	uint8_t public_key[WIREGUARD_PUBLIC_KEY_LEN];
+	uint8_t expected[WIREGUARD_PUBLIC_KEY_LEN];
+	uint8_t actual[WIREGUARD_PUBLIC_KEY_LEN];
+	const struct x25519_backend *backend;
+	bool result = true;
+	size_t b;
+	int i;
+
+	for (i = 0; result && (i < 256); i++) {
+		wireguard_random_bytes(private_key, sizeof(private_key));
+		if (i & 1) {
+			wireguard_random_bytes(public_key, sizeof(public_key));
+		} else {
+			crypto_scalarmult_curve25519_base(public_key, private_key);
+			wireguard_random_bytes(private_key, sizeof(private_key));
+		}
+		for (b = 0; result && (b < X25519_BACKEND_COUNT); b++) {
+			backend = &x25519_backends[b];
+			if (backend->scalarmult && (crypto_scalarmult_curve25519(expected, private_key, public_key) == 0)) {
+				if ((backend->scalarmult(actual, private_key, public_key) != 0) || (memcmp(expected, actual, sizeof(expected)) != 0)) {
+					fprintf(stderr, "x25519/%s mismatch with libsodium\n", backend->name);
+					result = false;
+				}
+			}
+			crypto_scalarmult_curve25519(expected, private_key, x25519_basepoint);
+			if ((backend->base(actual, private_key) != 0) || (memcmp(expected, actual, sizeof(expected)) != 0)) {
+				fprintf(stderr, "x25519_base/%s mismatch with libsodium\n", backend->name);
+				result = false;
+			}
+		}
+	}
+	return result;
+}
+
+static void bench_x25519(struct handshake_bench *hb) {
+	struct x25519_run run;
+	char name[64];
+	size_t b;
+
+	run.hb = hb;
+	for (b = 0; b < X25519_BACKEND_COUNT; b++) {
+		run.backend = &x25519_backends[b];
+		if (run.backend->scalarmult) {
+			snprintf(name, sizeof(name), "x25519/%s", run.backend->name);
+			report_ops(name, bench_measure(run_x25519_backend, &run, 0));
+		}
+	}
+	for (b = 0; b < X25519_BACKEND_COUNT; b++) {
+		run.backend = &x25519_backends[b];
+		snprintf(name, sizeof(name), "x25519_base/%s", run.backend->name);
+		report_ops(name, bench_measure(run_x25519_base_backend, &run, 0));
+	}
+	// What the protocol code uses with this build's configuration
+	report_ops("x25519", bench_measure(run_x25519, hb, 0));
+	report_ops("x25519_base", bench_measure(run_x25519_base, hb, 0));
+}
+
+static void run_create_initiation(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	struct message_handshake_initiation msg;
+	(void)len;
+	wireguard_create_handshake_initiation(&hb->initiator, hb->initiator_peer, &msg);
+}
+
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+static void run_pregenerate_initiation(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	(void)len;
+	hb->initiator_peer->pregen[0].valid = false;
+	wireguard_pregenerate_initiation(&hb->initiator, hb->initiator_peer, NULL);
+}
+
+static void run_create_pregenerated_initiation(void *arg, size_t len) {
+	// Only the send-time part: timestamp AEAD, hash and MACs
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	struct message_handshake_initiation msg;
+	(void)len;
+	memcpy(&hb->initiator_peer->pregen[0], &hb->pregen, sizeof(hb->pregen));
+	wireguard_create_handshake_initiation(&hb->initiator, hb->initiator_peer, &msg);
+}
+#endif
+
+static void reset_responder_peer(struct handshake_bench *hb) {
+	// Allow the same initiation to be accepted again - skips the timestamp replay check and the rate limit
+	memset(hb->responder_peer->greatest_timestamp, 0, WIREGUARD_TAI64N_LEN);
+	hb->responder_peer->last_initiation_rx = wireguard_sys_now() - 10000;
+}
+
+static void run_process_initiation(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	(void)len;
+	reset_responder_peer(hb);
+	wireguard_process_initiation_message(&hb->responder, &hb->msg, NULL);
+}
+
+// Processing an initiation split as wireguardif does it: the X25519 work on the handshake worker, then what is
+// left for the lwIP thread
+static void run_initiation_dh(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	struct wireguard_handshake_dh dh;
+	(void)len;
+	wireguard_handshake_dh_prepare(&dh, NULL);
+	wireguard_handshake_dh_initiation(hb->responder.private_key, hb->responder.initiation_hash, &hb->msg, &dh);
+}
+
+static void run_process_initiation_dh(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	(void)len;
+	reset_responder_peer(hb);
+	wireguard_process_initiation_message(&hb->responder, &hb->msg, &hb->dh);
+}
+
+static void run_receiver_lookup(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	(void)len;
+	keypair_lookup_by_receiver(&hb->initiator, hb->receiver, NULL);
+}
+
+static void run_pubkey_lookup(void *arg, size_t len) {
+	struct handshake_bench *hb = (struct handshake_bench *)arg;
+	(void)len;
+	peer_lookup_by_pubkey(&hb->responder, hb->initiator.public_key);
+}
+
+static void run_check_replay_in_order(void *arg, size_t len) {
+	struct wireguard_keypair *keypair = (struct wireguard_keypair *)arg;
+	static uint64_t seq = 0;
+	(void)len;
+	wireguard_check_replay(keypair, seq++);
+}
+
+static void run_check_replay_reordered(void *arg, size_t len) {
+	// Counters arrive in small bursts with the odd late packet, like a busy link with some reordering
+	static const int8_t pattern[16] = { 0, 2, 1, 3, 5, 4, 6, 7, 9, 8, 10, 13, 11, 12, 15, 14 };
+	struct wireguard_keypair *keypair = (struct wireguard_keypair *)arg;
+	static uint64_t base = 0;
+	static unsigned int i = 0;
+	(void)len;
+	wireguard_check_replay(keypair, base + pattern[i]);
+	if (++i == 16) {
+		i = 0;
+		base += 16;
+	}
+}
+
+static void run_check_replay_jump(void *arg, size_t len) {
+	// Every packet moves the window by its full width - the most words a check ever has to clear
+	struct wireguard_keypair *keypair = (struct wireguard_keypair *)arg;
+	static uint64_t seq = 0;
+	(void)len;
+	wireguard_check_replay(keypair, seq);
+	seq += WIREGUARD_REPLAY_WINDOW;
+}
+
+// Replay window check against a plain array of counters seen: each counter is accepted once, and only while
+// it is at most WIREGUARD_REPLAY_WINDOW_SIZE behind the newest one accepted
+#define REPLAY_CHECK_COUNTERS	(1 << 20)
+
+static bool bench_check_replay(void) {
+	static struct wireguard_keypair keypair;
+	static uint8_t seen[REPLAY_CHECK_COUNTERS];
+	uint64_t newest = 0;
+	uint64_t base = 0;
+	uint64_t seq;
+	uint32_t offset;
+	uint32_t r;
+	bool expected;
+	bool result = true;
+	int x;
+
+	memset(&keypair, 0, sizeof(keypair));
+	memset(seen, 0, sizeof(seen));
+	for (x = 0; result && (x < 400000); x++) {
+		// Mostly in order, with late packets reaching past the edge of the window and the odd duplicate
+		wireguard_random_bytes(&r, sizeof(r));
+		base += r & 3;
+		offset = (r >> 2) % (WIREGUARD_REPLAY_WINDOW + (WIREGUARD_REPLAY_WINDOW / 2));
+		seq = ((r & 0x80000000) && (offset <= base)) ? (base - offset) : base;
+
+		expected = !seen[seq] && ((seq + WIREGUARD_REPLAY_WINDOW_SIZE) >= newest);
+		result = (wireguard_check_replay(&keypair, seq) == expected);
+		if (expected) {
+			seen[seq] = 1;
+			if (seq >= newest) {
+				newest = seq;
+			}
+		}
+	}
+	if (!result) {
+		fprintf(stderr, "replay window mismatch with the reference\n");
+	}
+	return result;
+}
+
+// Finish the handshake started in bench_handshake_setup the way the handshake worker does, with the X25519 work
+// done up front - both ends must then find their keypair from the index the other sends to and agree on the keys
+static bool bench_handshake_complete(struct handshake_bench *hb) {
+	struct message_handshake_response response;
+	struct wireguard_handshake_dh dh;
+	bool result = false;
+
+	if (wireguard_create_handshake_response(&hb->responder, hb->responder_peer, &response, &hb->dh) &&
+			(peer_lookup_by_handshake(&hb->initiator, response.receiver) == hb->initiator_peer)) {
+		wireguard_handshake_dh_prepare(&dh, hb->initiator_peer->handshake->ephemeral_private);
+		result = wireguard_handshake_dh_response(hb->initiator.private_key, &response, &dh) &&
+			wireguard_process_handshake_response(&hb->initiator, hb->initiator_peer, &response, &dh);
+	}
+	if (result) {
+		wireguard_start_session(&hb->responder, hb->responder_peer, false);
+		wireguard_start_session(&hb->initiator, hb->initiator_peer, true);
+		hb->receiver = hb->responder_peer->next_keypair.remote_index;
+		result = (keypair_lookup_by_receiver(&hb->initiator, hb->receiver, NULL) == &hb->initiator_peer->curr_keypair) &&
+			(keypair_lookup_by_receiver(&hb->responder, hb->initiator_peer->curr_keypair.remote_index, NULL) == &hb->responder_peer->next_keypair) &&
+			(memcmp(&hb->initiator_peer->curr_keypair.sending_key, &hb->responder_peer->next_keypair.receiving_key, sizeof(struct wireguard_aead_key)) == 0);
+	}
+	return result;
+}
+
+static bool bench_handshake_setup(struct handshake_bench *hb) {
+	uint8_t private_key[WIREGUARD_PRIVATE_KEY_LEN];
+	bool result = false;
+
+	memset(hb, 0, sizeof(struct handshake_bench));
+
+	wireguard_random_bytes(private_key, sizeof(private_key));
+	if (wireguard_device_init(&hb->initiator, private_key)) {
+		wireguard_random_bytes(private_key, sizeof(private_key));
+		if (wireguard_device_init(&hb->responder, private_key)) {
+			hb->initiator_peer = peer_alloc(&hb->initiator);
+			hb->responder_peer = peer_alloc(&hb->responder);
+			if (wireguard_peer_init(&hb->initiator, hb->initiator_peer, hb->responder.public_key, NULL) &&
+					wireguard_peer_init(&hb->responder, hb->responder_peer, hb->initiator.public_key, NULL)) {
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+				// Built from a prefix pre-generated the way the handshake worker does it, so the responder check
+				// below covers that path too
+				wireguard_handshake_dh_prepare(&hb->dh, NULL);
+				if (wireguard_handshake_dh_pregen(hb->initiator_peer->public_key, &hb->dh)) {
+					wireguard_pregenerate_initiation(&hb->initiator, hb->initiator_peer, &hb->dh);
+				}
+				memcpy(&hb->pregen, &hb->initiator_peer->pregen[0], sizeof(hb->pregen));
+#endif
+				// One real initiation for the responder to process, checking that it is accepted both inline and
+				// with the X25519 work done beforehand
+				if (wireguard_create_handshake_initiation(&hb->initiator, hb->initiator_peer, &hb->msg)) {
+					reset_responder_peer(hb);
+					wireguard_handshake_dh_prepare(&hb->dh, NULL);
+					result = (wireguard_process_initiation_message(&hb->responder, &hb->msg, NULL) == hb->responder_peer) &&
+						wireguard_handshake_dh_initiation(hb->responder.private_key, hb->responder.initiation_hash, &hb->msg, &hb->dh);
+					reset_responder_peer(hb);
+					result = result && (wireguard_process_initiation_message(&hb->responder, &hb->msg, &hb->dh) == hb->responder_peer) &&
+						bench_handshake_complete(hb);
+				}
+			}
+		}
+	}
+	crypto_zero(private_key, sizeof(private_key));
+	return result;
+}
+
+// Cryptokey routing - the trie against a linear longest prefix match over the same routes, with overlapping
+// prefixes of every length, then lookup cost as the number of routes grows
+#define ALLOWEDIPS_BENCH_ROUTES	(1024)
+#define ALLOWEDIPS_BENCH_PEERS	(8)
+
+struct allowedips_route {
+	ip_addr_t ip;
+	uint8_t cidr;
+	struct wireguard_peer *peer;
+};
+
+struct allowedips_bench {
+	struct wireguard_allowedips table;
+	struct allowedips_route routes[ALLOWEDIPS_BENCH_ROUTES];
+	size_t route_count;
+	ip_addr_t probes[256];
+	size_t probe;
+};
+
+static struct wireguard_peer allowedips_peers[ALLOWEDIPS_BENCH_PEERS];
+
+static uint8_t *allowedips_bytes(ip_addr_t *ip, size_t *len) {
+	*len = IP_IS_V6(ip) ? 16 : 4;
+	return IP_IS_V6(ip) ? (uint8_t *)ip_2_ip6(ip)->addr : (uint8_t *)&ip_2_ip4(ip)->addr;
+}
+
+// Random address (or prefix) near a handful of bases so that routes nest and overlap
+static void allowedips_random_ip(ip_addr_t *ip, bool v6) {
+	uint8_t *bytes;
+	size_t len;
+	ip_addr_set_zero(ip);
+	ip->type = v6 ? IPADDR_TYPE_V6 : IPADDR_TYPE_V4;
+	bytes = allowedips_bytes(ip, &len);
+	wireguard_random_bytes(bytes, len);
+	bytes[0] = (bytes[0] & 0x03) | 0x0C;
+	if (bytes[1] & 0x80) {
+		bytes[1] &= 0x0F;
+	}
+}
+
+static void allowedips_mask(ip_addr_t *mask, bool v6, uint8_t cidr) {
+	uint8_t *bytes;
+	size_t len;
+	size_t x;
+	ip_addr_set_zero(mask);
+	mask->type = v6 ? IPADDR_TYPE_V6 : IPADDR_TYPE_V4;
+	bytes = allowedips_bytes(mask, &len);
+	for (x = 0; x < len; x++) {
+		bytes[x] = (cidr >= (x + 1) * 8) ? 0xFF : (cidr > x * 8) ? (uint8_t)(0xFF << (8 - (cidr - x * 8))) : 0;
+	}
+}
+
+static bool allowedips_contains(const struct allowedips_route *route, ip_addr_t *ip) {
+	ip_addr_t route_ip = route->ip;
+	uint8_t *a;
+	uint8_t *b;
+	size_t len;
+	uint8_t bit;
+	bool result = (IP_GET_TYPE(&route_ip) == IP_GET_TYPE(ip));
+	a = allowedips_bytes(&route_ip, &len);
+	b = allowedips_bytes(ip, &len);
+	for (bit = 0; result && (bit < route->cidr); bit++) {
+		result = (((a[bit >> 3] ^ b[bit >> 3]) >> (7 - (bit & 7))) & 1) == 0;
+	}
+	return result;
+}
+
+static struct wireguard_peer *allowedips_reference(struct allowedips_bench *ab, ip_addr_t *ip) {
+	struct wireguard_peer *result = NULL;
+	int best = -1;
+	size_t i;
+	for (i = 0; i < ab->route_count; i++) {
+		if (ab->routes[i].peer && ((int)ab->routes[i].cidr > best) && allowedips_contains(&ab->routes[i], ip)) {
+			best = ab->routes[i].cidr;
+			result = ab->routes[i].peer;
+		}
+	}
+	return result;
+}
+
+// Adds count random routes (replacing the peer of any identical prefix, as the trie does)
+static bool allowedips_fill(struct allowedips_bench *ab, size_t count, bool v6) {
+	struct allowedips_route *route;
+	ip_addr_t mask;
+	uint8_t max_bits = v6 ? 128 : 32;
+	uint8_t cidr;
+	bool result = true;
+	size_t i;
+	size_t j;
+	for (i = 0; result && (i < count) && (ab->route_count < ALLOWEDIPS_BENCH_ROUTES); i++) {
+		wireguard_random_bytes(&cidr, 1);
+		// Mostly long prefixes, as real tables have, with some short ones covering them
+		cidr = (cidr & 0x80) ? (max_bits - (cidr % 9)) : (cidr % (max_bits + 1));
+		route = &ab->routes[ab->route_count];
+		allowedips_random_ip(&route->ip, v6);
+		route->cidr = cidr;
+		route->peer = &allowedips_peers[i % ALLOWEDIPS_BENCH_PEERS];
+		allowedips_mask(&mask, v6, cidr);
+		result = wireguard_allowedips_insert(&ab->table, &route->ip, &mask, route->peer);
+		for (j = 0; j < ab->route_count; j++) {
+			if ((ab->routes[j].cidr == cidr) && allowedips_contains(&ab->routes[j], &route->ip)) {
+				ab->routes[j].peer = NULL;
+			}
+		}
+		ab->route_count++;
+	}
+	return result;
+}
+
+// Random address sharing the whole bytes of a route's prefix, so that lookups go deep
+static void allowedips_probe(struct allowedips_bench *ab, ip_addr_t *ip, size_t route) {
+	struct allowedips_route *r = &ab->routes[route % ab->route_count];
+	size_t len;
+	allowedips_random_ip(ip, IP_IS_V6(&r->ip));
+	memcpy(allowedips_bytes(ip, &len), allowedips_bytes(&r->ip, &len), r->cidr / 8);
+}
+
+static bool allowedips_compare(struct allowedips_bench *ab, bool v6, int count) {
+	ip_addr_t ip;
+	bool result = true;
+	uint32_t route;
+	int n;
+	for (n = 0; result && (n < count); n++) {
+		wireguard_random_bytes(&route, sizeof(route));
+		if (n & 1) {
+			allowedips_probe(ab, &ip, route);
+		} else {
+			allowedips_random_ip(&ip, v6);
+		}
+		result = (wireguard_allowedips_lookup(&ab->table, &ip) == allowedips_reference(ab, &ip));
+	}
+	return result;
+}
+
+static bool bench_check_allowedips(void) {
+	static struct allowedips_bench ab;
+	ip_addr_t ip;
+	ip_addr_t mask;
+	struct wireguard_peer *removed;
+	bool result = true;
+	size_t i;
+	size_t j;
+	int round;
+
+	for (round = 0; result && (round < 8); round++) {
+		memset(&ab, 0, sizeof(ab));
+		// Both families in one table, growing in steps, with a peer removed halfway
+		for (i = 0; result && (i < 4); i++) {
+			result = allowedips_fill(&ab, 64, false) && allowedips_fill(&ab, 64, true) &&
+				allowedips_compare(&ab, false, 500) && allowedips_compare(&ab, true, 500);
+			if (i == 1) {
+				removed = &allowedips_peers[round % ALLOWEDIPS_BENCH_PEERS];
+				wireguard_allowedips_remove_by_peer(&ab.table, removed);
+				for (j = 0; j < ab.route_count; j++) {
+					if (ab.routes[j].peer == removed) {
+						ab.routes[j].peer = NULL;
+					}
+				}
+			}
+		}
+		wireguard_allowedips_clear(&ab.table);
+		allowedips_random_ip(&ip, false);
+		result = result && (wireguard_allowedips_lookup(&ab.table, &ip) == NULL);
+	}
+
+	// Non-contiguous masks and mixed families are refused
+	allowedips_random_ip(&ip, false);
+	allowedips_mask(&mask, false, 24);
+	ip_2_ip4(&mask)->addr ^= 0x01000000;
+	result = result && !wireguard_allowedips_insert(&ab.table, &ip, &mask, &allowedips_peers[0]);
+	allowedips_mask(&mask, true, 24);
+	result = result && !wireguard_allowedips_insert(&ab.table, &ip, &mask, &allowedips_peers[0]);
+
+	if (!result) {
+		fprintf(stderr, "allowedips lookup mismatch with the linear reference\n");
+	}
+	return result;
+}
+
+static void run_allowedips_lookup(void *arg, size_t len) {
+	struct allowedips_bench *ab = (struct allowedips_bench *)arg;
+	(void)len;
+	wireguard_allowedips_lookup(&ab->table, &ab->probes[ab->probe++ & 255]);
+}
+
+static void bench_allowedips(void) {
+	static struct allowedips_bench ab;
+	static const size_t route_counts[] = { 16, ALLOWEDIPS_BENCH_ROUTES };
+	char name[64];
+	size_t r;
+	size_t i;
+	int v6;
+
+	for (v6 = 0; v6 < 2; v6++) {
+		for (r = 0; r < sizeof(route_counts) / sizeof(route_counts[0]); r++) {
+			memset(&ab, 0, sizeof(ab));
+			allowedips_fill(&ab, route_counts[r], v6);
+			for (i = 0; i < 256; i++) {
+				allowedips_probe(&ab, &ab.probes[i], i);
+			}
+			snprintf(name, sizeof(name), "allowedips_lookup_%s_%zu", v6 ? "v6" : "v4", ab.route_count);
+			report_ops(name, bench_measure(run_allowedips_lookup, &ab, 0));
+			wireguard_allowedips_clear(&ab.table);
+		}
+	}
+}
+
+// Peer timer wheel - checked against a plain array of deadlines: every run has to hand back exactly the timers
+// due, and wireguard_timer_next() the earliest one still armed
+#define TIMER_BENCH_COUNT	(1024)
+#define TIMER_CHECK_COUNT	(64)
+
+struct timer_bench {
+	struct wireguard_timer_wheel wheel;
+	struct wireguard_timer timers[TIMER_BENCH_COUNT];
+	bool armed[TIMER_BENCH_COUNT];
+	uint32_t expires[TIMER_BENCH_COUNT];
+	uint32_t now;
+};
+
+static bool timer_check_next(struct timer_bench *tb) {
+	uint32_t earliest = 0;
+	uint32_t next = 0;
+	bool pending = false;
+	size_t i;
+	for (i = 0; i < TIMER_CHECK_COUNT; i++) {
+		if (tb->armed[i] && (!pending || ((int32_t)(tb->expires[i] - earliest) < 0))) {
+			earliest = tb->expires[i];
+			pending = true;
+		}
+	}
+	return (wireguard_timer_next(&tb->wheel, &next) == pending) && (!pending || (next == earliest));
+}
+
+static bool bench_check_timers(void) {
+	static struct timer_bench tb;
+	struct wireguard_timer *timer;
+	uint32_t r;
+	bool result = true;
+	size_t i;
+	int step;
+	int x;
+
+	memset(&tb, 0, sizeof(tb));
+	tb.now = wireguard_sys_now();
+	for (step = 0; result && (step < 5000); step++) {
+		// Arm or disarm a few timers - a few already due, most within a handful of turns of the wheel
+		for (x = 0; x < 4; x++) {
+			wireguard_random_bytes(&r, sizeof(r));
+			i = r % TIMER_CHECK_COUNT;
+			if (r & 0x80000000) {
+				tb.expires[i] = tb.now + ((r >> 8) % 40000) - 1000;
+				wireguard_timer_arm(&tb.wheel, &tb.timers[i], tb.expires[i]);
+				tb.armed[i] = true;
+			} else {
+				wireguard_timer_disarm(&tb.wheel, &tb.timers[i]);
+				tb.armed[i] = false;
+			}
+		}
+		result = timer_check_next(&tb);
+
+		// Move the clock on, now and then by more than a turn
+		wireguard_random_bytes(&r, sizeof(r));
+		tb.now += (r & 0x100000) ? (r % 20000) : (r % 500);
+		while (result && ((timer = wireguard_timer_expire(&tb.wheel, tb.now)) != NULL)) {
+			i = timer - tb.timers;
+			result = tb.armed[i] && ((int32_t)(tb.expires[i] - tb.now) <= 0) && !wireguard_timer_armed(timer);
+			tb.armed[i] = false;
+		}
+		for (i = 0; result && (i < TIMER_CHECK_COUNT); i++) {
+			result = !tb.armed[i] || ((int32_t)(tb.expires[i] - tb.now) > 0);
+		}
+		result = result && timer_check_next(&tb);
+	}
+	if (!result) {
+		fprintf(stderr, "timer wheel mismatch with the reference\n");
+	}
+	return result;
+}
+
+static void run_timer_rearm(void *arg, size_t len) {
+	// Moving the deadline of one of many armed timers, as every peer event does
+	struct timer_bench *tb = (struct timer_bench *)arg;
+	static uint32_t i = 0;
+	(void)len;
+	i = (i * 1103515245 + 12345) & 0x7FFFFFFF;
+	wireguard_timer_arm(&tb->wheel, &tb->timers[i % TIMER_BENCH_COUNT], tb->now + (i % 60000));
+}
+
+static void run_timer_next(void *arg, size_t len) {
+	struct timer_bench *tb = (struct timer_bench *)arg;
+	uint32_t expires;
+	(void)len;
+	wireguard_timer_next(&tb->wheel, &expires);
+}
+
+static void bench_timers(void) {
+	static struct timer_bench tb;
+	uint32_t r;
+	size_t i;
+
+	memset(&tb, 0, sizeof(tb));
+	tb.now = wireguard_sys_now();
+	for (i = 0; i < TIMER_BENCH_COUNT; i++) {
+		wireguard_random_bytes(&r, sizeof(r));
+		wireguard_timer_arm(&tb.wheel, &tb.timers[i], tb.now + 1000 + (r % 60000));
+	}
+	report_ops("timer_rearm_1024", bench_measure(run_timer_rearm, &tb, 0));
+	report_ops("timer_next_1024", bench_measure(run_timer_next, &tb, 0));
+}
+
+// Handshake admission as wireguardif_check_handshake_message does it, in simulated time. Each admitted handshake is
+// charged FLOOD_HANDSHAKE_MSECS, about what a responder handshake takes on an ESP32
+#define FLOOD_HANDSHAKE_MSECS	(30)
+#define FLOOD_SECONDS			(10)
+
+struct flood_bench {
+	struct wireguard_load load;
+	struct wireguard_ratelimiter limiter;
+	uint32_t admitted;
+	uint32_t cookies;
+};
+
+static bool flood_admit(struct handshake_bench *hb, struct flood_bench *fb, const void *msg, size_t len, uint8_t *source, size_t source_len, uint32_t now) {
+	bool under_load = wireguard_load_check(&fb->load, now);
+	bool result = false;
+
+	switch (wireguard_check_handshake_macs(&hb->responder, (const uint8_t *)msg, len, under_load, source, source_len)) {
+		case WIREGUARD_MACS_VALID:
+			result = !under_load || wireguard_ratelimiter_allow(&fb->limiter, source, source_len, now);
+			break;
+		case WIREGUARD_MACS_NEED_COOKIE:
+			fb->cookies++;
+			break;
+		default:
+			break;
+	}
+	if (result) {
+		fb->admitted++;
+		wireguard_load_busy(&fb->load, now, FLOOD_HANDSHAKE_MSECS);
+	}
+	return result;
+}
+
+static void flood_source(uint8_t *source, uint32_t n) {
+	// 10.x.y.z:51820
+	source[0] = 10;
+	source[1] = (uint8_t)(n >> 16);
+	source[2] = (uint8_t)(n >> 8);
+	source[3] = (uint8_t)n;
+	source[4] = 0xCA;
+	source[5] = 0x6C;
+}
+
+static bool bench_check_flood(struct handshake_bench *hb) {
+	static struct flood_bench fb;
+	struct message_handshake_initiation msg;
+	struct message_cookie_reply reply;
+	uint8_t source[18];
+	uint8_t other[18];
+	uint32_t now = 0;
+	uint32_t ms;
+	uint32_t n;
+	bool result = true;
+
+	memset(&fb, 0, sizeof(fb));
+	wireguard_ratelimiter_init(&fb.limiter);
+	flood_source(source, 1);
+	flood_source(other, 2);
+
+	// Queued handshakes alone make for load, which then holds for a second
+	wireguard_load_queued(&fb.load, WIREGUARD_HANDSHAKE_QUEUE_LEN);
+	result = result && wireguard_load_check(&fb.load, now);
+	wireguard_load_queued(&fb.load, 0);
+	result = result && wireguard_load_check(&fb.load, now + 999) && !wireguard_load_check(&fb.load, now + 1000);
+	now += 5000;
+
+	// Cookies end to end: under load the initiation needs a mac2, the initiator gets one from the cookie reply and
+	// the next initiation is let through - from that source only
+	wireguard_load_queued(&fb.load, WIREGUARD_HANDSHAKE_QUEUE_LEN);
+	if (wireguard_create_handshake_initiation(&hb->initiator, hb->initiator_peer, &msg)) {
+		memcpy(hb->initiator_peer->handshake->mac1, msg.mac1, WIREGUARD_COOKIE_LEN);
+		hb->initiator_peer->handshake->mac1_valid = true;
+		result = result && !flood_admit(hb, &fb, &msg, sizeof(msg), source, 6, now) && (fb.cookies == 1);
+		wireguard_create_cookie_reply(&hb->responder, &reply, msg.mac1, msg.sender, source, 6);
+		result = result && (peer_lookup_by_handshake(&hb->initiator, reply.receiver) == hb->initiator_peer) &&
+			wireguard_process_cookie_message(&hb->initiator, hb->initiator_peer, &reply) &&
+			!wireguard_process_cookie_message(&hb->initiator, hb->initiator_peer, &reply);
+	} else {
+		result = false;
+	}
+	if (result && wireguard_create_handshake_initiation(&hb->initiator, hb->initiator_peer, &msg)) {
+		result = flood_admit(hb, &fb, &msg, sizeof(msg), source, 6, now) &&
+			!flood_admit(hb, &fb, &msg, sizeof(msg), other, 6, now) && (fb.cookies == 2);
+
+		// A device replaying it as fast as it can is held to its rate for as long as it keeps at it
+		fb.admitted = 0;
+		for (ms = 0; ms < (FLOOD_SECONDS * 1000); ms++) {
+			flood_admit(hb, &fb, &msg, sizeof(msg), source, 6, now + ms);
+		}
+		now += ms;
+		result = result && (fb.admitted >= (FLOOD_SECONDS * WIREGUARD_RATELIMIT_PER_SECOND)) &&
+			(fb.admitted <= (WIREGUARD_RATELIMIT_BURST + (FLOOD_SECONDS * WIREGUARD_RATELIMIT_PER_SECOND)));
+	} else {
+		result = false;
+	}
+	wireguard_load_queued(&fb.load, 0);
+	now += 5000;
+
+	// A spoofed flood of initiations with a valid mac1 (a scanner that knows our public key) - once the budget is
+	// spent it only gets cookie replies, so handshakes never take more than about the budget of each second
+	fb.admitted = 0;
+	fb.cookies = 0;
+	for (n = 0; n < (FLOOD_SECONDS * 1000); n++) {
+		flood_source(other, 1000 + n);
+		flood_admit(hb, &fb, &hb->msg, sizeof(hb->msg), other, 6, now + n);
+	}
+	now += n;
+	result = result && (fb.cookies > 0) &&
+		((fb.admitted * FLOOD_HANDSHAKE_MSECS) <= (FLOOD_SECONDS * (WIREGUARD_HANDSHAKE_BUDGET_MSECS + FLOOD_HANDSHAKE_MSECS)));
+
+	// Per source buckets: a fresh source gets its burst, IPv6 sources share theirs per /64, and once every entry a
+	// source may use is held by a busy one it is turned away until they go quiet
+	wireguard_ratelimiter_init(&fb.limiter);
+	memset(source, 0x20, sizeof(source));
+	memset(other, 0x20, sizeof(other));
+	other[15] = 0x21;
+	for (n = 0; n < WIREGUARD_RATELIMIT_BURST; n++) {
+		result = result && wireguard_ratelimiter_allow(&fb.limiter, (n & 1) ? other : source, sizeof(source), now);
+	}
+	result = result && !wireguard_ratelimiter_allow(&fb.limiter, other, sizeof(other), now);
+	for (n = 0; n < (2 * WIREGUARD_RATELIMIT_SOURCES); n++) {
+		flood_source(source, n);
+		if (!wireguard_ratelimiter_allow(&fb.limiter, source, 6, now)) {
+			break;
+		}
+	}
+	result = result && (n > 0) && (n < (2 * WIREGUARD_RATELIMIT_SOURCES)) &&
+		wireguard_ratelimiter_allow(&fb.limiter, source, 6, now + ((1000 / WIREGUARD_RATELIMIT_PER_SECOND) * WIREGUARD_RATELIMIT_BURST));
+
+	if (!result) {
+		fprintf(stderr, "handshake admission failed under the simulated flood\n");
+	}
+	return result;
+}
+
+static void run_ratelimiter_allow(void *arg, size_t len) {
+	struct flood_bench *fb = (struct flood_bench *)arg;
+	static uint32_t i = 0;
+	uint8_t source[6];
+	(void)len;
+	flood_source(source, (i++) % WIREGUARD_RATELIMIT_SOURCES);
+	wireguard_ratelimiter_allow(&fb->limiter, source, sizeof(source), i);
+}
+
+static bool bench_protocol(void) {
+	static struct handshake_bench hb;
+	static struct flood_bench fb;
+	struct wireguard_keypair keypair;
+	bool result = false;
+
+	if (bench_check_aead_stream() && bench_check_aead_batch() && bench_check_x25519() && bench_check_allowedips() && bench_check_replay() && bench_check_timers() && bench_handshake_setup(&hb) &&
+			bench_check_flood(&hb)) {
+		bench_x25519(&hb);
+		report_ops("handshake_initiation_create", bench_measure(run_create_initiation, &hb, 0));
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+		report_ops("handshake_initiation_pregenerate", bench_measure(run_pregenerate_initiation, &hb, 0));
+		report_ops("handshake_initiation_create_pregenerated", bench_measure(run_create_pregenerated_initiation, &hb, 0));
+#endif
+		report_ops("handshake_initiation_process", bench_measure(run_process_initiation, &hb, 0));
+		report_ops("handshake_initiation_dh", bench_measure(run_initiation_dh, &hb, 0));
+		report_ops("handshake_initiation_process_dh", bench_measure(run_process_initiation_dh, &hb, 0));
+		report_ops("receiver_lookup", bench_measure(run_receiver_lookup, &hb, 0));
+		report_ops("pubkey_lookup", bench_measure(run_pubkey_lookup, &hb, 0));
+
+		bench_allowedips();
+		bench_timers();
+
+		wireguard_ratelimiter_init(&fb.limiter);
+		report_ops("ratelimiter_allow", bench_measure(run_ratelimiter_allow, &fb, 0));
+
+		memset(&keypair, 0, sizeof(keypair));
+		report_ops("check_replay_in_order", bench_measure(run_check_replay_in_order, &keypair, 0));
+		memset(&keypair, 0, sizeof(keypair));
+		report_ops("check_replay_reordered", bench_measure(run_check_replay_reordered, &keypair, 0));
+		memset(&keypair, 0, sizeof(keypair));
+		report_ops("check_replay_jump", bench_measure(run_check_replay_jump, &keypair, 0));
+		result = true;
+	}
+	return result;
+}
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-q] [-o file]\n", argv0);
+}
+
+int main(int argc, char *argv[]) {
+	const char *filename = NULL;
+	double start_ns;
+	double calibrate_ns;
+	bool calibrated;
+	int primitive;
+	bool ok;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "qo:h")) != -1) {
+		switch (opt) {
+			case 'q':
+				sample_count = 3;
+				sample_min_ns = 2e6;
+				break;
+			case 'o':
+				filename = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return (opt == 'h') ? 0 : 2;
+		}
+	}
+
+	out = stdout;
+	if (filename) {
+		out = fopen(filename, "w");
+		if (!out) {
+			perror(filename);
+			return 1;
+		}
+	}
+
+	wireguard_platform_init();
+	start_ns = bench_now_ns();
+	calibrated = wireguard_crypto_calibrate();
+	calibrate_ns = bench_now_ns() - start_ns;
+	wireguard_init();
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"suite\": \"esp_wireguard\",\n");
+	fprintf(out, "  \"timer\": \"%s\",\n", bench_cycles() ? "tsc" : "clock_gettime");
+	fprintf(out, "  \"samples\": %d,\n", sample_count);
+	fprintf(out, "  \"crypto\": {\"calibrate_ms\": %.1f, \"chacha20\": \"%s\"", calibrate_ns / 1e6, chacha20_backend_name());
+	for (primitive = 0; primitive < WIREGUARD_CRYPTO_PRIMITIVE_COUNT; primitive++) {
+		fprintf(out, ", \"%s\": \"%s\"", wireguard_crypto_primitive_name((enum wireguard_crypto_primitive)primitive), wireguard_crypto_name((enum wireguard_crypto_primitive)primitive));
+	}
+	fprintf(out, "},\n");
+	// Everything before prev_keypair is what sending and receiving on an established session touches
+	fprintf(out, "  \"layout\": {\"peer\": %zu, \"peer_hot\": %zu, \"keypair\": %zu, \"handshake\": %zu, \"pregen_initiation\": %zu, \"replay_window\": %d},\n",
+		sizeof(struct wireguard_peer), offsetof(struct wireguard_peer, prev_keypair), sizeof(struct wireguard_keypair),
+		sizeof(struct wireguard_handshake), sizeof(struct wireguard_pregen_initiation), WIREGUARD_REPLAY_WINDOW);
+	fprintf(out, "  \"results\": [");
+
+	bench_symmetric();
+	ok = bench_protocol();
+
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	if (!calibrated) {
+		fprintf(stderr, "crypto provider known-answer tests failed\n");
+	}
+	if (!ok) {
+		fprintf(stderr, "handshake setup failed - protocol benchmarks skipped\n");
+	}
+	return (ok && calibrated) ? 0 : 1;
+}
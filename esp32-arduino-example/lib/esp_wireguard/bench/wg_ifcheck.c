@@ -0,0 +1,342 @@
+// Host checks for the WireGuard interface in src/wireguardif.c
+//
+// The interface is driven through the entry points lwIP uses - netif->output for packets to send, the UDP receive
+// callback for datagrams that arrive - on top of the stand-in lwIP runtime in lwip_host.c, which keeps what is sent
+// and handed to ip_input. A device built from wireguard.c alone plays the peer at the other end. Checked:
+//  - a burst of packets is queued and goes out as one batch from the lwIP callback, on consecutive counters in the
+//    order the packets were sent - contiguous and chained pbufs alike
+//  - a packet whose data may change is sent before the call returns, after whatever was queued ahead of it
+//  - batched packets the underlying interface refuses are counted by wireguardif_tx_dropped()
+//  - received packets arriving as a chain reach ip_input whole, wherever the chain splits them
+//  - no pbuf is leaked along the way
+//
+// Usage: make check, or ./wg_ifcheck - exits non-zero at the first check that fails
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "lwip_host.h"
+#include "lwip/ip.h"
+
+#include "wireguardif.h"
+#include "wireguard.h"
+#include "crypto.h"
+
+#if WIREGUARD_TX_BATCH < 2
+#error "wg_ifcheck checks batching - build it with CONFIG_WIREGUARD_TX_BATCH of 2 or more"
+#endif
+
+#define IFCHECK_PORT		(51820)
+#define IFCHECK_MAX_PACKET	(1420)
+
+struct ifcheck {
+	struct netif netif;
+	struct wireguard_device *device; // The interface under test
+	struct wireguard_peer *peer;
+	struct wireguard_device remote; // The other end
+	struct wireguard_peer *remote_peer;
+	ip_addr_t endpoint;
+	ip_addr_t remote_ip; // The other end inside the tunnel
+};
+
+static void ifcheck_ip4(ip_addr_t *ip, u8_t a, u8_t b, u8_t c, u8_t d) {
+	u8_t bytes[4] = { a, b, c, d };
+	ip_addr_set_zero(ip);
+	ip->type = IPADDR_TYPE_V4;
+	memcpy(&ip_2_ip4(ip)->addr, bytes, sizeof(bytes));
+}
+
+// An IPv4 packet of len bytes to or from the other end, its payload filled with seed
+static void ifcheck_packet(struct ifcheck *ic, u8_t *packet, u16_t len, u8_t seed) {
+	struct ip_hdr hdr;
+	u16_t x;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr._v_hl = 0x45;
+	hdr._len = PP_HTONS(len);
+	hdr._ttl = 64;
+	hdr._proto = 17;
+	hdr.src = *ip_2_ip4(&ic->remote_ip);
+	hdr.dest = *ip_2_ip4(&ic->remote_ip);
+	memcpy(packet, &hdr, sizeof(hdr));
+	for (x = sizeof(hdr); x < len; x++) {
+		packet[x] = (u8_t)(seed + x);
+	}
+}
+
+static void ifcheck_deliver(struct ifcheck *ic, struct pbuf *p) {
+	lwip_host_udp->recv(lwip_host_udp->recv_arg, lwip_host_udp, p, &ic->endpoint, IFCHECK_PORT);
+}
+
+// A transport data message from the other end carrying len bytes of packet, in datagram - its length
+static u16_t ifcheck_seal(struct ifcheck *ic, u8_t *datagram, const u8_t *packet, u16_t len) {
+	static u8_t padded[IFCHECK_MAX_PACKET];
+	struct message_transport_data *hdr = (struct message_transport_data *)datagram;
+	struct wireguard_keypair *keypair = &ic->remote_peer->curr_keypair;
+	u16_t padded_len = (u16_t)((len + 15) & ~15);
+
+	hdr->type = MESSAGE_TRANSPORT_DATA;
+	memset(hdr->reserved, 0, sizeof(hdr->reserved));
+	hdr->receiver = keypair->remote_index;
+	U64TO8_LITTLE(hdr->counter, keypair->sending_counter);
+	memset(padded, 0, padded_len);
+	if (len) {
+		memcpy(padded, packet, len);
+	}
+	wireguard_encrypt_packet(hdr->enc_packet, padded, padded_len, keypair);
+	return (u16_t)(sizeof(struct message_transport_data) + padded_len + WIREGUARD_AUTHTAG_LEN);
+}
+
+// Decrypts a datagram the interface sent as the other end does - true if it authenticates, with its counter and the
+// packet in it
+static bool ifcheck_open(struct ifcheck *ic, const struct lwip_host_datagram *datagram, uint64_t *counter, u8_t *packet, u16_t *len) {
+	const struct message_transport_data *hdr = (const struct message_transport_data *)datagram->data;
+	struct wireguard_keypair *keypair;
+	bool result = false;
+
+	if ((datagram->len >= sizeof(struct message_transport_data) + WIREGUARD_AUTHTAG_LEN) && (hdr->type == MESSAGE_TRANSPORT_DATA)) {
+		keypair = keypair_lookup_by_receiver(&ic->remote, hdr->receiver, NULL);
+		*counter = U8TO64_LITTLE(hdr->counter);
+		*len = (u16_t)(datagram->len - sizeof(struct message_transport_data) - WIREGUARD_AUTHTAG_LEN);
+		result = keypair && wireguard_decrypt_packet(packet, hdr->enc_packet, *len + WIREGUARD_AUTHTAG_LEN, *counter, keypair);
+	}
+	return result;
+}
+
+// The interface, with the other end as its one peer, and a session between the two that the other end initiated and
+// has confirmed
+static bool ifcheck_setup(struct ifcheck *ic) {
+	static struct wireguardif_init_data init_data;
+	static char private_key[64];
+	static char public_key[64];
+	struct message_handshake_initiation initiation;
+	struct message_handshake_response response;
+	struct wireguard_handshake_dh dh;
+	struct wireguardif_peer peer;
+	uint8_t key[WIREGUARD_PRIVATE_KEY_LEN];
+	size_t len;
+	u8_t index;
+	u8_t datagram[64];
+	bool result = false;
+
+	memset(ic, 0, sizeof(struct ifcheck));
+	ifcheck_ip4(&ic->endpoint, 192, 0, 2, 1);
+
+	wireguard_random_bytes(key, sizeof(key));
+	len = sizeof(private_key);
+	wireguard_base64_encode(key, sizeof(key), private_key, &len);
+	init_data.private_key = private_key;
+	init_data.listen_port = IFCHECK_PORT;
+	ic->netif.state = &init_data;
+	if (wireguardif_init(&ic->netif) != ERR_OK) {
+		return false;
+	}
+	ic->device = (struct wireguard_device *)ic->netif.state;
+
+	wireguard_random_bytes(key, sizeof(key));
+	if (!wireguard_device_init(&ic->remote, key)) {
+		return false;
+	}
+	ic->remote_peer = peer_alloc(&ic->remote);
+	if (!ic->remote_peer || !wireguard_peer_init(&ic->remote, ic->remote_peer, ic->device->public_key, NULL)) {
+		return false;
+	}
+
+	// The other end sits on 10.0.0.0/24
+	len = sizeof(public_key);
+	wireguard_base64_encode(ic->remote.public_key, WIREGUARD_PUBLIC_KEY_LEN, public_key, &len);
+	wireguardif_peer_init(&peer);
+	peer.public_key = public_key;
+	ifcheck_ip4(&peer.allowed_ip, 10, 0, 0, 0);
+	ifcheck_ip4(&peer.allowed_mask, 255, 255, 255, 0);
+	peer.endpoint_ip = ic->endpoint;
+	peer.endport_port = IFCHECK_PORT;
+	if (wireguardif_add_peer(&ic->netif, &peer, &index) != ERR_OK) {
+		return false;
+	}
+	ic->peer = peer_lookup_by_pubkey(ic->device, ic->remote.public_key);
+	ifcheck_ip4(&ic->remote_ip, 10, 0, 0, 2);
+
+	// The handshake, then a keepalive for the interface to confirm the session with
+	lwip_host_clear();
+	if (wireguard_create_handshake_initiation(&ic->remote, ic->remote_peer, &initiation)) {
+		ifcheck_deliver(ic, lwip_host_pbuf(PBUF_POOL, &initiation, sizeof(initiation)));
+		if ((lwip_host_sent_count == 1) && (lwip_host_sent[0].len == sizeof(response))) {
+			memcpy(&response, lwip_host_sent[0].data, sizeof(response));
+			wireguard_handshake_dh_prepare(&dh, ic->remote_peer->handshake->ephemeral_private);
+			if ((peer_lookup_by_handshake(&ic->remote, response.receiver) == ic->remote_peer) &&
+					wireguard_handshake_dh_response(ic->remote.private_key, &response, &dh) &&
+					wireguard_process_handshake_response(&ic->remote, ic->remote_peer, &response, &dh)) {
+				wireguard_start_session(&ic->remote, ic->remote_peer, true);
+				len = ifcheck_seal(ic, datagram, NULL, 0);
+				ifcheck_deliver(ic, lwip_host_pbuf(PBUF_POOL, datagram, (u16_t)len));
+				result = ic->peer && ic->peer->curr_keypair.valid;
+			}
+		}
+	}
+	lwip_host_clear();
+	return result;
+}
+
+// Sends packet through the interface as lwIP would, from a pbuf that is contiguous, chained at split, or whose data
+// may change once the call returns
+#define IFCHECK_CONTIGUOUS	(0)
+#define IFCHECK_CHAINED		(1)
+#define IFCHECK_VOLATILE	(2)
+
+static err_t ifcheck_send(struct ifcheck *ic, const u8_t *packet, u16_t len, int kind) {
+	u16_t split[4] = { 20, 7, (u16_t)(len - 27), 0 };
+	struct pbuf *p;
+	err_t result;
+
+	if (kind == IFCHECK_CHAINED) {
+		p = lwip_host_chain(packet, split);
+	} else {
+		p = lwip_host_pbuf((kind == IFCHECK_VOLATILE) ? PBUF_REF : PBUF_RAM, packet, len);
+	}
+	result = ic->netif.output(&ic->netif, p, ip_2_ip4(&ic->remote_ip));
+	// lwIP frees it once the netif is done with it
+	pbuf_free(p);
+	return result;
+}
+
+// The datagrams sent from first on must carry packets[], in order, on consecutive counters
+static bool ifcheck_expect(struct ifcheck *ic, int first, u8_t packets[][IFCHECK_MAX_PACKET], const u16_t *lens, int count) {
+	static u8_t plain[IFCHECK_MAX_PACKET + WIREGUARD_AUTHTAG_LEN];
+	uint64_t counter;
+	uint64_t previous = 0;
+	u16_t len;
+	int x;
+	bool result = (lwip_host_sent_count == first + count);
+
+	for (x = 0; result && (x < count); x++) {
+		result = ifcheck_open(ic, &lwip_host_sent[first + x], &counter, plain, &len) &&
+			(len == ((lens[x] + 15) & ~15)) && (memcmp(plain, packets[x], lens[x]) == 0) &&
+			((x == 0) || (counter == previous + 1));
+		previous = counter;
+	}
+	return result;
+}
+
+static bool ifcheck_fail(const char *check) {
+	fprintf(stderr, "wg_ifcheck: %s failed (%d datagrams sent, %d pbufs held)\n", check, lwip_host_sent_count, lwip_host_pbufs);
+	return false;
+}
+
+// A burst is held until the lwIP thread comes back to the interface, then sent as one batch in the order it was
+// queued - whether a pbuf took the ChaCha20 lanes or was streamed as a chain
+static bool ifcheck_tx_batch(struct ifcheck *ic) {
+	static const int kinds[][6] = {
+		{ IFCHECK_CONTIGUOUS, IFCHECK_CONTIGUOUS, IFCHECK_CONTIGUOUS, -1 },
+		{ IFCHECK_CHAINED, IFCHECK_CONTIGUOUS, IFCHECK_CHAINED, IFCHECK_CONTIGUOUS, IFCHECK_CONTIGUOUS, -1 },
+		{ IFCHECK_CONTIGUOUS, IFCHECK_CHAINED, IFCHECK_CHAINED, IFCHECK_CONTIGUOUS, -1 },
+	};
+	static u8_t packets[6][IFCHECK_MAX_PACKET];
+	u16_t lens[6];
+	size_t round;
+	int count;
+	bool result = true;
+
+	for (round = 0; result && (round < sizeof(kinds) / sizeof(kinds[0])); round++) {
+		lwip_host_clear();
+		for (count = 0; result && (kinds[round][count] >= 0); count++) {
+			lens[count] = (u16_t)(40 + (count * 37) + (round * 300));
+			ifcheck_packet(ic, packets[count], lens[count], (u8_t)count);
+			result = (ifcheck_send(ic, packets[count], lens[count], kinds[round][count]) == ERR_OK);
+		}
+		// Nothing went out yet but the queues that filled up, and one callback drains the rest
+		result = result && (lwip_host_sent_count == ((count - 1) / WIREGUARD_TX_BATCH) * WIREGUARD_TX_BATCH) && (lwip_host_pending_callbacks() == 1) &&
+			(lwip_host_run_callbacks() == 1) && ifcheck_expect(ic, 0, packets, lens, count) && (lwip_host_pbufs == 0);
+	}
+	return result || ifcheck_fail("tx batch");
+}
+
+// A packet that cannot wait goes out before the call returns - behind the packets queued before it
+static bool ifcheck_tx_volatile(struct ifcheck *ic) {
+	static u8_t packets[2][IFCHECK_MAX_PACKET];
+	u16_t lens[2] = { 100, 60 };
+	bool result;
+
+	lwip_host_clear();
+	ifcheck_packet(ic, packets[0], lens[0], 1);
+	ifcheck_packet(ic, packets[1], lens[1], 2);
+	result = (ifcheck_send(ic, packets[0], lens[0], IFCHECK_CONTIGUOUS) == ERR_OK) &&
+		(ifcheck_send(ic, packets[1], lens[1], IFCHECK_VOLATILE) == ERR_OK) &&
+		ifcheck_expect(ic, 0, packets, lens, 2);
+	lwip_host_run_callbacks();
+	result = result && (lwip_host_sent_count == 2) && (lwip_host_pbufs == 0);
+	return result || ifcheck_fail("tx volatile");
+}
+
+// Batched packets the underlying interface refuses are counted, the one sent directly gets the error back
+static bool ifcheck_tx_dropped(struct ifcheck *ic) {
+	static u8_t packet[IFCHECK_MAX_PACKET];
+	u32_t before = 0;
+	u32_t after = 0;
+	bool result;
+
+	lwip_host_clear();
+	ifcheck_packet(ic, packet, 80, 3);
+	lwip_host_send_result = ERR_IF;
+	result = (wireguardif_tx_dropped(&ic->netif, &before) == ERR_OK) &&
+		(ifcheck_send(ic, packet, 80, IFCHECK_CONTIGUOUS) == ERR_OK) &&
+		(ifcheck_send(ic, packet, 80, IFCHECK_CHAINED) == ERR_OK) &&
+		(lwip_host_run_callbacks() == 1) &&
+		(wireguardif_tx_dropped(&ic->netif, &after) == ERR_OK) && (after == before + 2) &&
+		(ifcheck_send(ic, packet, 80, IFCHECK_VOLATILE) == ERR_IF);
+	lwip_host_send_result = ERR_OK;
+	result = result && (lwip_host_sent_count == 0) && (lwip_host_pbufs == 0);
+	return result || ifcheck_fail("tx dropped");
+}
+
+// A received packet split anywhere across a chain - the WireGuard header alone in the first pbuf, the inner IP header
+// across two - is handed to ip_input whole
+static bool ifcheck_rx_chained(struct ifcheck *ic) {
+	static const u16_t splits[][5] = {
+		{ 0 },
+		{ 16, 0 },
+		{ 16, 10, 0 },
+		{ 24, 0 },
+		{ 30, 4, 33, 0 },
+		{ 36, 0 },
+	};
+	static u8_t packet[IFCHECK_MAX_PACKET];
+	static u8_t datagram[IFCHECK_MAX_PACKET + 64];
+	u16_t split[5];
+	u16_t len = 84;
+	u16_t datagram_len;
+	size_t round;
+	int x;
+	bool result = true;
+
+	ifcheck_packet(ic, packet, len, 4);
+	for (round = 0; result && (round < sizeof(splits) / sizeof(splits[0])); round++) {
+		lwip_host_clear();
+		datagram_len = ifcheck_seal(ic, datagram, packet, len);
+		// Whatever the split leaves goes in the last pbuf
+		memcpy(split, splits[round], sizeof(split));
+		for (x = 0; split[x]; x++) {
+			datagram_len = (u16_t)(datagram_len - split[x]);
+		}
+		split[x] = datagram_len;
+		ifcheck_deliver(ic, lwip_host_chain(datagram, split));
+		result = (lwip_host_input_count == 1) && (lwip_host_input[0].len >= len) &&
+			(memcmp(lwip_host_input[0].data, packet, len) == 0) && (lwip_host_pbufs == 0);
+	}
+	return result || ifcheck_fail("rx chained");
+}
+
+int main(void) {
+	static struct ifcheck ic;
+	bool result;
+
+	wireguard_platform_init();
+	result = ifcheck_setup(&ic) || ifcheck_fail("setup");
+	result = result && ifcheck_tx_batch(&ic) && ifcheck_tx_volatile(&ic) && ifcheck_tx_dropped(&ic) && ifcheck_rx_chained(&ic);
+	if (result) {
+		printf("wg_ifcheck: ok\n");
+	}
+	return result ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+// A second copy of crypto/refc/x25519.c forced onto 32-bit limbs, renamed so wg_bench can time it next to the others
+#define CONFIG_WIREGUARD_X25519_REFC32
+#undef CONFIG_WIREGUARD_X25519_REFC64
+#define x25519 bench_x25519_refc32
+#define x25519_base bench_x25519_base_refc32
+#define x25519_backend_name bench_x25519_backend_name_refc32
+
+#include "crypto/refc/x25519.c"
@@ -0,0 +1,10 @@
+// A second copy of crypto/refc/x25519.c forced onto 64-bit limbs, renamed so wg_bench can time it next to the others
+#if defined(__SIZEOF_INT128__) && defined(__LP64__)
+#define CONFIG_WIREGUARD_X25519_REFC64
+#undef CONFIG_WIREGUARD_X25519_REFC32
+#define x25519 bench_x25519_refc64
+#define x25519_base bench_x25519_base_refc64
+#define x25519_backend_name bench_x25519_backend_name_refc64
+
+#include "crypto/refc/x25519.c"
+#endif
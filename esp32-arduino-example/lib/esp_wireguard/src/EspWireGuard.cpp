@@ -13,7 +13,7 @@
 
 bool EspWireGuard::begin(const IPAddress& localIP, const IPAddress& subnet, const IPAddress& gateway,
                      const char* privateKey, const char* remotePeerAddress, 
-                     const char* remotePeerPublicKey, uint16_t remotePeerPort) {
+                     const char* remotePeerPublicKey, uint16_t remotePeerPort, uint16_t listenPort) {
     
     if (_is_initialized) {
         end();
@@ -24,6 +24,7 @@ bool EspWireGuard::begin(const IPAddress& localIP, const IPAddress& subnet, cons
     _netmask_str = subnet.toString();
     
     _wg_config.private_key = privateKey;
+    _wg_config.listen_port = listenPort;
     _wg_config.address = _address_str.c_str();
     _wg_config.netmask = _netmask_str.c_str();
     _wg_config.endpoint = remotePeerAddress;
@@ -133,6 +134,7 @@ void EspWireGuard::dump_config() {
     log_i("  Address: %s", _wg_config.address);
     log_i("  Netmask: %s", _wg_config.netmask);
     log_i("  Private Key: %s", _wg_config.private_key);
+    log_i("  Listen Port: %d", _wg_config.listen_port);
     log_i("  Peer Endpoint: %s", _wg_config.endpoint);
     log_i("  Peer Port: %d", _wg_config.port);
     log_i("  Peer Public Key: %s", _wg_config.public_key);
@@ -18,10 +18,6 @@ extern "C" {
 class EspWireGuard {
 private:
     bool _is_initialized = false;
-    struct netif _wg_netif_struct = {0};
-    struct netif *_wg_netif = NULL;
-    struct netif *_previous_default_netif = NULL;
-    uint8_t _wireguard_peer_index = WIREGUARDIF_INVALID_INDEX;
     String _address_str;
     String _netmask_str;
     
@@ -45,9 +41,11 @@ public:
     ~EspWireGuard() { end(); }
 
     // Full version compatible with ESPHome implementation
+    // Every instance drives its own tunnel: when several are up at once, give each a different listenPort
+    // (0 picks a free one)
     bool begin(const IPAddress& localIP, const IPAddress& subnet, const IPAddress& gateway, 
               const char* privateKey, const char* remotePeerAddress, 
-              const char* remotePeerPublicKey, uint16_t remotePeerPort);
+              const char* remotePeerPublicKey, uint16_t remotePeerPort, uint16_t listenPort = 0);
     
     // Version compatible with the old API
     bool begin(const IPAddress& localIP, const char* privateKey, 
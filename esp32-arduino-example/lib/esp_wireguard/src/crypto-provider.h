@@ -0,0 +1,90 @@
+// vim: noexpandtab
+// Crypto providers - each one is a table of implementations of the primitives WireGuard needs.
+// The table the protocol code calls through (wireguard_crypto) is assembled per primitive from the registered
+// providers: by default from the build configuration (see crypto.h), or by wireguard_crypto_calibrate() which
+// runs known-answer tests on every candidate and keeps the fastest one that passes.
+#ifndef _CRYPTO_PROVIDER_H_
+#define _CRYPTO_PROVIDER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Providers that can be registered on top of the built-in ones (refc, and sodium when enabled)
+#ifdef CONFIG_WIREGUARD_CRYPTO_MAX_PROVIDERS
+	#define WIREGUARD_CRYPTO_MAX_PROVIDERS (CONFIG_WIREGUARD_CRYPTO_MAX_PROVIDERS)
+#else
+	#define WIREGUARD_CRYPTO_MAX_PROVIDERS (4)
+#endif
+
+// Time spent measuring each candidate during calibration
+#ifdef CONFIG_WIREGUARD_CRYPTO_CALIBRATE_MS
+	#define WIREGUARD_CRYPTO_CALIBRATE_MS (CONFIG_WIREGUARD_CRYPTO_CALIBRATE_MS)
+#else
+	#define WIREGUARD_CRYPTO_CALIBRATE_MS (20)
+#endif
+
+enum wireguard_crypto_primitive {
+	WIREGUARD_CRYPTO_X25519 = 0,
+	WIREGUARD_CRYPTO_X25519_BASE,
+	WIREGUARD_CRYPTO_AEAD,
+	WIREGUARD_CRYPTO_XAEAD,
+	WIREGUARD_CRYPTO_BLAKE2S,
+	WIREGUARD_CRYPTO_HMAC,
+	WIREGUARD_CRYPTO_PRIMITIVE_COUNT
+};
+
+// Any entry may be NULL if the provider does not implement that primitive
+// Conventions follow crypto/refc: X25519 returns 0 or -1 for an all zero result, AEAD output is ciphertext || 16 byte tag,
+// the 64-bit AEAD nonce is the little endian counter in the last 8 bytes of the 96-bit IETF nonce
+struct wireguard_crypto_provider {
+	const char *name;
+	// Optional - false if the provider cannot run on this CPU
+	bool (*supported)(void);
+
+	int (*x25519)(uint8_t *out, const uint8_t *private_key, const uint8_t *public_key);
+	int (*x25519_base)(uint8_t *public_key, const uint8_t *private_key);
+
+	void (*aead_encrypt)(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key);
+	bool (*aead_decrypt)(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key);
+	void (*xaead_encrypt)(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, const uint8_t *nonce, const uint8_t *key);
+	bool (*xaead_decrypt)(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, const uint8_t *nonce, const uint8_t *key);
+
+	int (*blake2s)(void *out, size_t outlen, const void *key, size_t keylen, const void *in, size_t inlen);
+	// HMAC-BLAKE2s-256
+	void (*hmac)(void *digest, const void *key, size_t keylen, const void *text, size_t textlen);
+};
+
+// The implementations in use - one function pointer per primitive, each possibly from a different provider
+// Never NULL: every entry starts out pointing at the build-time default
+extern struct wireguard_crypto_provider wireguard_crypto;
+
+// Add a provider to the candidates (the pointer must stay valid). Returns false if the table is full
+bool wireguard_crypto_register(const struct wireguard_crypto_provider *provider);
+
+// Use the named provider for one primitive. Returns false (and changes nothing) if there is no such provider,
+// it does not implement the primitive or cannot run on this CPU
+bool wireguard_crypto_select(enum wireguard_crypto_primitive primitive, const char *name);
+
+// Name of the provider in use for a primitive
+const char *wireguard_crypto_name(enum wireguard_crypto_primitive primitive);
+
+// "x25519", "aead", ... - for logs and reports
+const char *wireguard_crypto_primitive_name(enum wireguard_crypto_primitive primitive);
+
+// Runs the known-answer tests for every registered provider and selects, for each primitive, the fastest one
+// that passes. Providers failing a test are never selected for that primitive. The ChaCha20 kernels of the refc
+// provider (see chacha20_set_backend) are measured as separate candidates for the AEAD.
+// Takes about WIREGUARD_CRYPTO_CALIBRATE_MS per candidate where there is more than one; only the first call does anything.
+// Returns false if a primitive has no provider passing its test.
+bool wireguard_crypto_calibrate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRYPTO_PROVIDER_H_ */
@@ -9,24 +9,74 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 
+// CRYPTO PROVIDERS
+// The one-shot primitives below are called through wireguard_crypto, a table of function pointers filled per primitive
+// from the registered providers (see crypto-provider.h):
+//  refc   - the portable implementations in crypto/refc, always available
+//  sodium - libsodium (X25519, ChaCha20-Poly1305, XChaCha20-Poly1305), registered when CONFIG_WIREGUARD_CRYPTO_SODIUM
+//           or one of the X25519 sodium options below is defined
+// Other providers (hardware accelerators, assembly) can be added with wireguard_crypto_register().
+// Without CONFIG_WIREGUARD_CRYPTO_CALIBRATE the build-time defaults below stay in place. With it, wireguard_init()
+// runs wireguard_crypto_calibrate() once, which tests every provider against known answers and keeps the fastest
+// passing one for each primitive - so one image picks the right code on ESP32, ESP32-S3 or an x86 gateway.
+#include "crypto-provider.h"
+
 // BLAKE2S IMPLEMENTATION
+// The incremental API works on a blake2s_ctx state and always uses crypto/refc
 #include "crypto/refc/blake2s.h"
 #define wireguard_blake2s_ctx blake2s_ctx
 #define wireguard_blake2s_init(ctx,outlen,key,keylen) blake2s_init(ctx,outlen,key,keylen)
 #define wireguard_blake2s_update(ctx,in,inlen) blake2s_update(ctx,in,inlen)
+#define wireguard_blake2s_update_block(ctx,block) blake2s_update_block(ctx,block)
 #define wireguard_blake2s_final(ctx,out) blake2s_final(ctx,out)
-#define wireguard_blake2s(out,outlen,key,keylen,in,inlen) blake2s(out,outlen,key,keylen,in,inlen)
+#define wireguard_blake2s(out,outlen,key,keylen,in,inlen) wireguard_crypto.blake2s(out,outlen,key,keylen,in,inlen)
+#define wireguard_hmac(digest,key,keylen,text,textlen) wireguard_crypto.hmac(digest,key,keylen,text,textlen)
 
 // X25519 IMPLEMENTATION
-#include <sodium.h>
-#define wireguard_x25519(a,b,c) crypto_scalarmult_curve25519(a,b,c)
+// Default provider:
+//  CONFIG_WIREGUARD_X25519_SODIUM - libsodium's crypto_scalarmult_curve25519()
+//  otherwise crypto/refc/x25519.c, whose field arithmetic is picked at build time:
+//   CONFIG_WIREGUARD_X25519_REFC32 - 10 x 25.5-bit limbs (32x32=64 multiplies) - 32-bit MCUs
+//   CONFIG_WIREGUARD_X25519_REFC64 - 5 x 51-bit limbs (64x64=128 multiplies) - 64-bit hosts
+//   With neither defined, 64-bit limbs where the compiler has 128-bit integers, 32-bit limbs otherwise.
+// Compare them with the host benchmark (bench/) before changing the default for a target.
+// Public keys (X25519 against the base point) use the precomputed comb in crypto/refc/x25519.c unless
+// CONFIG_WIREGUARD_X25519_BASE_SODIUM makes libsodium's crypto_scalarmult_curve25519_base() the default
+#include "crypto/refc/x25519.h"
+#define wireguard_x25519(a,b,c) wireguard_crypto.x25519(a,b,c)
+#define wireguard_x25519_base(a,b) wireguard_crypto.x25519_base(a,b)
 
 // CHACHA20POLY1305 IMPLEMENTATION
+// The ChaCha20 keystream comes from the multi-block kernels in crypto/refc/chacha20.c, picked at runtime (see chacha20_set_backend)
+// Define CONFIG_WIREGUARD_CHACHA20_PORTABLE_ONLY to build only the one-block-at-a-time kernel
+// Poly1305 uses 64-bit limbs where a 64x64=128 multiply is available, otherwise 26-bit limbs absorbing
+// POLY1305_DONNA32_WAYS (1, 2 or 4, default 4) blocks per reduction - see crypto/refc/poly1305-donna.c
 #include "crypto/refc/chacha20poly1305.h"
-#define wireguard_aead_encrypt(dst,src,srclen,ad,adlen,nonce,key) chacha20poly1305_encrypt(dst,src,srclen,ad,adlen,nonce,key)
-#define wireguard_aead_decrypt(dst,src,srclen,ad,adlen,nonce,key) chacha20poly1305_decrypt(dst,src,srclen,ad,adlen,nonce,key)
-#define wireguard_xaead_encrypt(dst,src,srclen,ad,adlen,nonce,key) xchacha20poly1305_encrypt(dst,src,srclen,ad,adlen,nonce,key)
-#define wireguard_xaead_decrypt(dst,src,srclen,ad,adlen,nonce,key) xchacha20poly1305_decrypt(dst,src,srclen,ad,adlen,nonce,key)
+#define wireguard_aead_encrypt(dst,src,srclen,ad,adlen,nonce,key) wireguard_crypto.aead_encrypt(dst,src,srclen,ad,adlen,nonce,key)
+#define wireguard_aead_decrypt(dst,src,srclen,ad,adlen,nonce,key) wireguard_crypto.aead_decrypt(dst,src,srclen,ad,adlen,nonce,key)
+// Session keys are expanded once into a wireguard_aead_key so each packet only has to set the nonce
+// Transport data stays on crypto/refc for that reason; calibration still picks its fastest ChaCha20 kernel
+#define wireguard_aead_key chacha20poly1305_key
+#define wireguard_aead_key_init(ctx,key) chacha20poly1305_key_init(ctx,key)
+#define wireguard_aead_encrypt_key(dst,src,srclen,ad,adlen,nonce,ctx) chacha20poly1305_encrypt_key(dst,src,srclen,ad,adlen,nonce,ctx)
+#define wireguard_aead_decrypt_key(dst,src,srclen,ad,adlen,nonce,ctx) chacha20poly1305_decrypt_key(dst,src,srclen,ad,adlen,nonce,ctx)
+// Scatter-gather: the same AEAD streamed over a message in segments
+#define wireguard_aead_stream chacha20poly1305_stream
+#define wireguard_aead_stream_init(stream,ad,adlen,nonce,ctx) chacha20poly1305_stream_init(stream,ad,adlen,nonce,ctx)
+#define wireguard_aead_stream_encrypt(stream,dst,src,len) chacha20poly1305_stream_encrypt(stream,dst,src,len)
+#define wireguard_aead_stream_decrypt(stream,dst,src,len) chacha20poly1305_stream_decrypt(stream,dst,src,len)
+#define wireguard_aead_stream_finish(stream,mac) chacha20poly1305_stream_finish(stream,mac)
+#define wireguard_aead_stream_verify(stream,mac) chacha20poly1305_stream_verify(stream,mac)
+// Batches: several messages under one key encrypted in place together
+#define wireguard_aead_message chacha20poly1305_message
+#define wireguard_aead_encrypt_batch(messages,count,ctx) chacha20poly1305_encrypt_batch(messages,count,ctx)
+#define wireguard_xaead_encrypt(dst,src,srclen,ad,adlen,nonce,key) wireguard_crypto.xaead_encrypt(dst,src,srclen,ad,adlen,nonce,key)
+#define wireguard_xaead_decrypt(dst,src,srclen,ad,adlen,nonce,key) wireguard_crypto.xaead_decrypt(dst,src,srclen,ad,adlen,nonce,key)
+
+// SIPHASH IMPLEMENTATION
+// Keyed hash for the device's public key index - not a WireGuard primitive, always crypto/refc
+#include "crypto/refc/siphash.h"
+#define wireguard_siphash(key,in,inlen) siphash24(key,in,inlen)
 
 
 // Endian / unaligned helper macros
@@ -1,6 +1,7 @@
 // Taken from RFC7693 - https://tools.ietf.org/html/rfc7693
 
 #include "blake2s.h"
+#include <string.h>
 #include "../../crypto.h"
 
 // Cyclic right rotation.
@@ -27,49 +28,85 @@ static const uint32_t blake2s_iv[8] =
 	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
 };
 
+// One full round - the message schedule for the round is passed as literal indices so every
+// m[] access is constant-indexed and the whole function can be kept in registers
+#define B2S_ROUND(s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12, s13, s14, s15) { \
+	B2S_G( 0, 4,  8, 12, m[s0],  m[s1]);  \
+	B2S_G( 1, 5,  9, 13, m[s2],  m[s3]);  \
+	B2S_G( 2, 6, 10, 14, m[s4],  m[s5]);  \
+	B2S_G( 3, 7, 11, 15, m[s6],  m[s7]);  \
+	B2S_G( 0, 5, 10, 15, m[s8],  m[s9]);  \
+	B2S_G( 1, 6, 11, 12, m[s10], m[s11]); \
+	B2S_G( 2, 7,  8, 13, m[s12], m[s13]); \
+	B2S_G( 3, 4,  9, 14, m[s14], m[s15]); }
+
 // Compression function. "last" flag indicates last block.
-static void blake2s_compress(blake2s_ctx *ctx, int last)
+static void blake2s_compress(blake2s_ctx *ctx, const uint8_t *block, int last)
 {
-	const uint8_t sigma[10][16] = {
-		{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
-		{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
-		{ 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
-		{ 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
-		{ 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
-		{ 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
-		{ 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
-		{ 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
-		{ 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
-		{ 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 }
-	};
-	int i;
 	uint32_t v[16], m[16];
 
-	for (i = 0; i < 8; i++) {           // init work variables
-	   v[i] = ctx->h[i];
-	   v[i + 8] = blake2s_iv[i];
-	}
+	v[ 0] = ctx->h[0];                  // init work variables
+	v[ 1] = ctx->h[1];
+	v[ 2] = ctx->h[2];
+	v[ 3] = ctx->h[3];
+	v[ 4] = ctx->h[4];
+	v[ 5] = ctx->h[5];
+	v[ 6] = ctx->h[6];
+	v[ 7] = ctx->h[7];
+	v[ 8] = blake2s_iv[0];
+	v[ 9] = blake2s_iv[1];
+	v[10] = blake2s_iv[2];
+	v[11] = blake2s_iv[3];
+	v[12] = blake2s_iv[4] ^ ctx->t[0];  // low 32 bits of offset
+	v[13] = blake2s_iv[5] ^ ctx->t[1];  // high 32 bits
+	v[14] = last ? ~blake2s_iv[6] : blake2s_iv[6]; // last block flag set ?
+	v[15] = blake2s_iv[7];
 
-	v[12] ^= ctx->t[0];                 // low 32 bits of offset
-	v[13] ^= ctx->t[1];                 // high 32 bits
-	if (last)                           // last block flag set ?
-		v[14] = ~v[14];
-	for (i = 0; i < 16; i++)            // get little-endian words
-		m[i] = U8TO32_LITTLE(&ctx->b[4 * i]);
-
-	for (i = 0; i < 10; i++) {          // ten rounds
-		B2S_G( 0, 4,  8, 12, m[sigma[i][ 0]], m[sigma[i][ 1]]);
-		B2S_G( 1, 5,  9, 13, m[sigma[i][ 2]], m[sigma[i][ 3]]);
-		B2S_G( 2, 6, 10, 14, m[sigma[i][ 4]], m[sigma[i][ 5]]);
-		B2S_G( 3, 7, 11, 15, m[sigma[i][ 6]], m[sigma[i][ 7]]);
-		B2S_G( 0, 5, 10, 15, m[sigma[i][ 8]], m[sigma[i][ 9]]);
-		B2S_G( 1, 6, 11, 12, m[sigma[i][10]], m[sigma[i][11]]);
-		B2S_G( 2, 7,  8, 13, m[sigma[i][12]], m[sigma[i][13]]);
-		B2S_G( 3, 4,  9, 14, m[sigma[i][14]], m[sigma[i][15]]);
-	}
+	m[ 0] = U8TO32_LITTLE(&block[ 0]);  // get little-endian words
+	m[ 1] = U8TO32_LITTLE(&block[ 4]);
+	m[ 2] = U8TO32_LITTLE(&block[ 8]);
+	m[ 3] = U8TO32_LITTLE(&block[12]);
+	m[ 4] = U8TO32_LITTLE(&block[16]);
+	m[ 5] = U8TO32_LITTLE(&block[20]);
+	m[ 6] = U8TO32_LITTLE(&block[24]);
+	m[ 7] = U8TO32_LITTLE(&block[28]);
+	m[ 8] = U8TO32_LITTLE(&block[32]);
+	m[ 9] = U8TO32_LITTLE(&block[36]);
+	m[10] = U8TO32_LITTLE(&block[40]);
+	m[11] = U8TO32_LITTLE(&block[44]);
+	m[12] = U8TO32_LITTLE(&block[48]);
+	m[13] = U8TO32_LITTLE(&block[52]);
+	m[14] = U8TO32_LITTLE(&block[56]);
+	m[15] = U8TO32_LITTLE(&block[60]);
+
+	// ten rounds - sigma[0..9] from RFC7693 section 2.7
+	B2S_ROUND(  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 );
+	B2S_ROUND( 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 );
+	B2S_ROUND( 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 );
+	B2S_ROUND(  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 );
+	B2S_ROUND(  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 );
+	B2S_ROUND(  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 );
+	B2S_ROUND( 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 );
+	B2S_ROUND( 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 );
+	B2S_ROUND(  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 );
+	B2S_ROUND( 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 );
 
-	for( i = 0; i < 8; ++i )
-		ctx->h[i] ^= v[i] ^ v[i + 8];
+	ctx->h[0] ^= v[0] ^ v[ 8];
+	ctx->h[1] ^= v[1] ^ v[ 9];
+	ctx->h[2] ^= v[2] ^ v[10];
+	ctx->h[3] ^= v[3] ^ v[11];
+	ctx->h[4] ^= v[4] ^ v[12];
+	ctx->h[5] ^= v[5] ^ v[13];
+	ctx->h[6] ^= v[6] ^ v[14];
+	ctx->h[7] ^= v[7] ^ v[15];
+}
+
+// Add a full block to the byte counter
+static void blake2s_increment(blake2s_ctx *ctx, size_t inc)
+{
+	ctx->t[0] += inc;                   // add counters
+	if (ctx->t[0] < inc)                // carry overflow ?
+		ctx->t[1]++;                    // high word
 }
 
 // Initialize the hashing context "ctx" with optional key "key".
@@ -106,33 +143,53 @@ int blake2s_init(blake2s_ctx *ctx, size_t outlen,
 void blake2s_update(blake2s_ctx *ctx,
 	const void *in, size_t inlen)       // data bytes
 {
-	size_t i;
+	const uint8_t *p = (const uint8_t *) in;
+	size_t n;
 
-	for (i = 0; i < inlen; i++) {
+	// The final block has to be compressed with the "last" flag, so a full
+	// buffer is only compressed once there is more data to follow it
+	while (inlen > 0) {
 		if (ctx->c == 64) {             // buffer full ?
-			ctx->t[0] += ctx->c;        // add counters
-			if (ctx->t[0] < ctx->c)     // carry overflow ?
-				ctx->t[1]++;            // high word
-			blake2s_compress(ctx, 0);   // compress (not last)
+			blake2s_increment(ctx, 64);
+			blake2s_compress(ctx, ctx->b, 0); // compress (not last)
 			ctx->c = 0;                 // counter to zero
 		}
-		ctx->b[ctx->c++] = ((const uint8_t *) in)[i];
+		if (ctx->c == 0) {
+			while (inlen > 64) {        // whole blocks straight from the input
+				blake2s_increment(ctx, 64);
+				blake2s_compress(ctx, p, 0);
+				p += 64;
+				inlen -= 64;
+			}
+		}
+		n = 64 - ctx->c;
+		if (n > inlen)
+			n = inlen;
+		memcpy(&ctx->b[ctx->c], p, n);
+		ctx->c += n;
+		p += n;
+		inlen -= n;
 	}
 }
 
+// Compress a whole 64-byte block as a non-final block.
+void blake2s_update_block(blake2s_ctx *ctx, const void *block)
+{
+	blake2s_increment(ctx, 64);
+	blake2s_compress(ctx, (const uint8_t *) block, 0);
+}
+
 // Generate the message digest (size given in init).
 //      Result placed in "out".
 void blake2s_final(blake2s_ctx *ctx, void *out)
 {
 	size_t i;
 
-	ctx->t[0] += ctx->c;                // mark last block offset
-	if (ctx->t[0] < ctx->c)             // carry overflow
-		ctx->t[1]++;                    // high word
+	blake2s_increment(ctx, ctx->c);     // mark last block offset
 
 	while (ctx->c < 64)                 // fill up with zeros
 		ctx->b[ctx->c++] = 0;
-	blake2s_compress(ctx, 1);           // final block flag = 1
+	blake2s_compress(ctx, ctx->b, 1);   // final block flag = 1
 
 	// little endian convert and store
 	for (i = 0; i < ctx->outlen; i++) {
@@ -154,3 +211,47 @@ int blake2s(void *out, size_t outlen,
 
 	return 0;
 }
+
+// HMAC - adapted from the appendix example in RFC2104 to use BLAKE2s instead of MD5.
+void blake2s_hmac(void *digest,
+	const void *key, size_t keylen,
+	const void *text, size_t textlen)
+{
+	blake2s_ctx ctx;
+	uint8_t tk[32];
+	uint8_t k_ipad[64];                 // inner padding - key XORd with ipad
+	uint8_t k_opad[64];                 // outer padding - key XORd with opad
+	size_t i;
+
+	// if key is longer than 64 bytes reset it to key = BLAKE2s(key)
+	if (keylen > 64) {
+		blake2s(tk, 32, NULL, 0, key, keylen);
+		key = tk;
+		keylen = 32;
+	}
+
+	memset(k_ipad, 0, sizeof(k_ipad));
+	memset(k_opad, 0, sizeof(k_opad));
+	memcpy(k_ipad, key, keylen);
+	memcpy(k_opad, key, keylen);
+	for (i = 0; i < 64; i++) {
+		k_ipad[i] ^= 0x36;
+		k_opad[i] ^= 0x5c;
+	}
+
+	// HASH(K XOR opad, HASH(K XOR ipad, text))
+	blake2s_init(&ctx, 32, NULL, 0);
+	blake2s_update(&ctx, k_ipad, 64);
+	blake2s_update(&ctx, text, textlen);
+	blake2s_final(&ctx, digest);
+
+	blake2s_init(&ctx, 32, NULL, 0);
+	blake2s_update(&ctx, k_opad, 64);
+	blake2s_update(&ctx, digest, 32);
+	blake2s_final(&ctx, digest);
+
+	crypto_zero(&ctx, sizeof(ctx));
+	crypto_zero(tk, sizeof(tk));
+	crypto_zero(k_ipad, sizeof(k_ipad));
+	crypto_zero(k_opad, sizeof(k_opad));
+}
@@ -31,6 +31,12 @@ int blake2s_init(blake2s_ctx *ctx, size_t outlen,
 void blake2s_update(blake2s_ctx *ctx,   // context
     const void *in, size_t inlen);      // data to be hashed
 
+// Compress one whole 64-byte block directly into the chained state, as a non-final block.
+//      Only valid while nothing is buffered (right after init without a key, or after another
+//      blake2s_update_block) and when more data will follow. The context can then be copied and
+//      reused as a midstate, e.g. for HMAC pads.
+void blake2s_update_block(blake2s_ctx *ctx, const void *block);
+
 // Generate the message digest (size given in init).
 //      Result placed in "out".
 void blake2s_final(blake2s_ctx *ctx, void *out);
@@ -40,6 +46,12 @@ int blake2s(void *out, size_t outlen,   // return buffer for digest
     const void *key, size_t keylen,     // optional secret key
     const void *in, size_t inlen);      // data to be hashed
 
+// HMAC-BLAKE2s-256 (RFC 2104 with BLAKE2s as the hash), as used by WireGuard.
+//      Result (32 bytes) placed in "digest". Text may be empty.
+void blake2s_hmac(void *digest,
+    const void *key, size_t keylen,     // any length, hashed first if over 64 bytes
+    const void *text, size_t textlen);  // data to be authenticated
+
 #ifdef __cplusplus
 }
 #endif
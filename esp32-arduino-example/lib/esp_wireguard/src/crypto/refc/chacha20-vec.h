@@ -0,0 +1,162 @@
+// Word-sliced multi-block ChaCha20 keystream kernel, included from chacha20.c
+// Instantiated once per vector width - the includer defines:
+//  CHACHA20_VEC_NAME  - name of the generated kernel function
+//  CHACHA20_VEC_LANES_NAME - name of the generated per-lane kernel (see chacha20_lanes())
+//  CHACHA20_VEC_T     - GCC/Clang vector type of uint32_t with CHACHA20_VEC_LANES elements
+//  CHACHA20_VEC_LANES - number of blocks processed together (4 or 8)
+//  CHACHA20_VEC_ATTR  - function attributes (e.g. target("avx2")) or empty
+// Each vector holds one state word for CHACHA20_VEC_LANES consecutive blocks; once the rounds are done the words are
+// transposed back into block order so the keystream can be XORed with the input a whole vector at a time.
+// The per-lane kernel is the same with words 12-15 (counter and nonce) loaded per lane, so the blocks need not come
+// from the same message.
+
+#define CHACHA20_VROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define CHACHA20_VQUARTERROUND(a, b, c, d)       \
+    a += b;  d ^= a;  d = CHACHA20_VROTL32(d, 16);  \
+    c += d;  b ^= c;  b = CHACHA20_VROTL32(b, 12);  \
+    a += b;  d ^= a;  d = CHACHA20_VROTL32(d,  8);  \
+    c += d;  b ^= c;  b = CHACHA20_VROTL32(b,  7)
+
+// Twenty rounds over x, then the input state s added back in
+#define CHACHA20_VEC_ROUNDS(x, s, i) do { \
+	for (i = 0; i < 10; i++) { \
+		CHACHA20_VQUARTERROUND((x)[0], (x)[4], (x)[ 8], (x)[12]); /* column 0 */ \
+		CHACHA20_VQUARTERROUND((x)[1], (x)[5], (x)[ 9], (x)[13]); /* column 1 */ \
+		CHACHA20_VQUARTERROUND((x)[2], (x)[6], (x)[10], (x)[14]); /* column 2 */ \
+		CHACHA20_VQUARTERROUND((x)[3], (x)[7], (x)[11], (x)[15]); /* column 3 */ \
+		CHACHA20_VQUARTERROUND((x)[0], (x)[5], (x)[10], (x)[15]); /* diagonal 1 */ \
+		CHACHA20_VQUARTERROUND((x)[1], (x)[6], (x)[11], (x)[12]); /* diagonal 2 */ \
+		CHACHA20_VQUARTERROUND((x)[2], (x)[7], (x)[ 8], (x)[13]); /* diagonal 3 */ \
+		CHACHA20_VQUARTERROUND((x)[3], (x)[4], (x)[ 9], (x)[14]); /* diagonal 4 */ \
+	} \
+	for (i = 0; i < 16; i++) { \
+		(x)[i] += (s)[i]; \
+	} \
+} while (0)
+
+#if CHACHA20_VEC_LANES == 4
+// 4x4 transpose: r[n] receives element n of a,b,c,d (i.e. 4 consecutive words of block n)
+#define CHACHA20_VEC_TRANSPOSE(v, r) do { \
+	CHACHA20_VEC_T t0_ = CHACHA20_SHUFFLE((v)[0], (v)[1], 0, 4, 1, 5); \
+	CHACHA20_VEC_T t1_ = CHACHA20_SHUFFLE((v)[0], (v)[1], 2, 6, 3, 7); \
+	CHACHA20_VEC_T t2_ = CHACHA20_SHUFFLE((v)[2], (v)[3], 0, 4, 1, 5); \
+	CHACHA20_VEC_T t3_ = CHACHA20_SHUFFLE((v)[2], (v)[3], 2, 6, 3, 7); \
+	(r)[0] = CHACHA20_SHUFFLE(t0_, t2_, 0, 1, 4, 5); \
+	(r)[1] = CHACHA20_SHUFFLE(t0_, t2_, 2, 3, 6, 7); \
+	(r)[2] = CHACHA20_SHUFFLE(t1_, t3_, 0, 1, 4, 5); \
+	(r)[3] = CHACHA20_SHUFFLE(t1_, t3_, 2, 3, 6, 7); \
+} while (0)
+#elif CHACHA20_VEC_LANES == 8
+// 8x8 transpose in three interleave stages: r[n] receives 8 consecutive words of block n
+#define CHACHA20_VEC_TRANSPOSE(v, r) do { \
+	CHACHA20_VEC_T a_[8], b_[8]; \
+	int k_; \
+	for (k_ = 0; k_ < 8; k_ += 2) { \
+		a_[k_ + 0] = CHACHA20_SHUFFLE((v)[k_], (v)[k_ + 1], 0, 8, 1, 9, 4, 12, 5, 13); \
+		a_[k_ + 1] = CHACHA20_SHUFFLE((v)[k_], (v)[k_ + 1], 2, 10, 3, 11, 6, 14, 7, 15); \
+	} \
+	for (k_ = 0; k_ < 8; k_ += 4) { \
+		b_[k_ + 0] = CHACHA20_SHUFFLE(a_[k_ + 0], a_[k_ + 2], 0, 1, 8, 9, 4, 5, 12, 13); \
+		b_[k_ + 1] = CHACHA20_SHUFFLE(a_[k_ + 0], a_[k_ + 2], 2, 3, 10, 11, 6, 7, 14, 15); \
+		b_[k_ + 2] = CHACHA20_SHUFFLE(a_[k_ + 1], a_[k_ + 3], 0, 1, 8, 9, 4, 5, 12, 13); \
+		b_[k_ + 3] = CHACHA20_SHUFFLE(a_[k_ + 1], a_[k_ + 3], 2, 3, 10, 11, 6, 7, 14, 15); \
+	} \
+	for (k_ = 0; k_ < 4; k_++) { \
+		(r)[k_ + 0] = CHACHA20_SHUFFLE(b_[k_], b_[k_ + 4], 0, 1, 2, 3, 8, 9, 10, 11); \
+		(r)[k_ + 4] = CHACHA20_SHUFFLE(b_[k_], b_[k_ + 4], 4, 5, 6, 7, 12, 13, 14, 15); \
+	} \
+} while (0)
+#else
+#error "Unsupported CHACHA20_VEC_LANES"
+#endif
+
+CHACHA20_VEC_ATTR static void CHACHA20_VEC_NAME(const uint32_t *state, uint8_t *out, const uint8_t *in, size_t nblocks) {
+	CHACHA20_VEC_T x[16];
+	CHACHA20_VEC_T s[16];
+	CHACHA20_VEC_T r[CHACHA20_VEC_LANES];
+	CHACHA20_VEC_T data;
+	CHACHA20_VEC_T lanes;
+	int i, j, w;
+
+	for (i = 0; i < 16; i++) {
+		for (j = 0; j < CHACHA20_VEC_LANES; j++) {
+			s[i][j] = state[i];
+		}
+	}
+	// Word 12 is a block counter - each lane gets its own
+	for (j = 0; j < CHACHA20_VEC_LANES; j++) {
+		lanes[j] = j;
+	}
+	s[12] += lanes;
+
+	for (; nblocks >= CHACHA20_VEC_LANES; nblocks -= CHACHA20_VEC_LANES) {
+		for (i = 0; i < 16; i++) {
+			x[i] = s[i];
+		}
+
+		CHACHA20_VEC_ROUNDS(x, s, i);
+
+		// Transpose a group of CHACHA20_VEC_LANES words at a time and XOR them into each block
+		for (w = 0; w < 16; w += CHACHA20_VEC_LANES) {
+			CHACHA20_VEC_TRANSPOSE(&x[w], r);
+			for (j = 0; j < CHACHA20_VEC_LANES; j++) {
+				memcpy(&data, in + (j * CHACHA20_BLOCK_SIZE) + (w * 4), sizeof(data));
+				data ^= r[j];
+				memcpy(out + (j * CHACHA20_BLOCK_SIZE) + (w * 4), &data, sizeof(data));
+			}
+		}
+
+		s[12] += (CHACHA20_VEC_T){ 0 } + CHACHA20_VEC_LANES;
+		out += CHACHA20_VEC_LANES * CHACHA20_BLOCK_SIZE;
+		in += CHACHA20_VEC_LANES * CHACHA20_BLOCK_SIZE;
+	}
+}
+
+CHACHA20_VEC_ATTR static void CHACHA20_VEC_LANES_NAME(const uint32_t *state, const struct chacha20_lane *lanes, size_t count) {
+	CHACHA20_VEC_T x[16];
+	CHACHA20_VEC_T s[16];
+	CHACHA20_VEC_T r[CHACHA20_VEC_LANES];
+	CHACHA20_VEC_T data;
+	int i, j, w;
+
+	for (i = 0; i < 12; i++) {
+		for (j = 0; j < CHACHA20_VEC_LANES; j++) {
+			s[i][j] = state[i];
+		}
+	}
+
+	for (; count >= CHACHA20_VEC_LANES; count -= CHACHA20_VEC_LANES) {
+		for (i = 12; i < 16; i++) {
+			for (j = 0; j < CHACHA20_VEC_LANES; j++) {
+				s[i][j] = lanes[j].words[i - 12];
+			}
+		}
+		for (i = 0; i < 16; i++) {
+			x[i] = s[i];
+		}
+
+		CHACHA20_VEC_ROUNDS(x, s, i);
+
+		for (w = 0; w < 16; w += CHACHA20_VEC_LANES) {
+			CHACHA20_VEC_TRANSPOSE(&x[w], r);
+			for (j = 0; j < CHACHA20_VEC_LANES; j++) {
+				memcpy(&data, lanes[j].src + (w * 4), sizeof(data));
+				data ^= r[j];
+				memcpy(lanes[j].dst + (w * 4), &data, sizeof(data));
+			}
+		}
+
+		lanes += CHACHA20_VEC_LANES;
+	}
+}
+
+#undef CHACHA20_VEC_ROUNDS
+#undef CHACHA20_VEC_TRANSPOSE
+#undef CHACHA20_VQUARTERROUND
+#undef CHACHA20_VROTL32
+#undef CHACHA20_VEC_NAME
+#undef CHACHA20_VEC_LANES_NAME
+#undef CHACHA20_VEC_T
+#undef CHACHA20_VEC_LANES
+#undef CHACHA20_VEC_ATTR
@@ -99,46 +99,245 @@ static inline void INNER_BLOCK(uint32_t *block) {
 //	state += working_state
 //	return serialize(state)
 // end
-static void chacha20_block(struct chacha20_ctx *ctx, uint8_t *stream) {
+static void chacha20_block(const uint32_t *state, uint8_t *stream) {
 	uint32_t working_state[16];
 	int i;
 
 	for (i = 0; i < 16; ++i) {
-		working_state[i] = ctx->state[i];
+		working_state[i] = state[i];
 	}
 
 	TWENTY_ROUNDS(working_state);
 
 	for (i = 0; i < 16; ++i) {
-		U32TO8_LITTLE(stream + (4 * i), PLUS(working_state[i], ctx->state[i]));
+		U32TO8_LITTLE(stream + (4 * i), PLUS(working_state[i], state[i]));
 	}
 }
 
+// Keystream kernels
+// Each kernel XORs nblocks whole blocks of keystream into in/out starting at the block counter in state[12] (state is not modified).
+// The portable kernel works on one block at a time; the vector kernels lay the state out word-sliced (one vector per state word,
+// one lane per block) so several blocks run through the rounds together. GCC/Clang vector extensions lower these to SSE2/AVX2 on x86,
+// NEON on ARM and plain 32-bit words on Xtensa.
+
+static void chacha20_blocks_portable(const uint32_t *state, uint8_t *out, const uint8_t *in, size_t nblocks) {
+	uint32_t working_state[16];
+	uint32_t counter = state[12];
+	uint32_t word;
+	int i;
+
+	while (nblocks--) {
+		for (i = 0; i < 16; ++i) {
+			working_state[i] = state[i];
+		}
+		working_state[12] = counter;
+
+		TWENTY_ROUNDS(working_state);
+
+		working_state[12] = PLUS(working_state[12], counter);
+		for (i = 0; i < 16; ++i) {
+			if (i != 12) {
+				working_state[i] = PLUS(working_state[i], state[i]);
+			}
+		}
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+		if ((((uintptr_t)in | (uintptr_t)out) & 3) == 0) {
+			// Aligned buffers (the usual case for pbuf payloads) - XOR a whole word at a time
+			for (i = 0; i < 16; ++i) {
+				((uint32_t *)out)[i] = ((const uint32_t *)in)[i] ^ working_state[i];
+			}
+		} else
+#endif
+		{
+			for (i = 0; i < 16; ++i) {
+				word = U8TO32_LITTLE(in + (4 * i)) ^ working_state[i];
+				U32TO8_LITTLE(out + (4 * i), word);
+			}
+		}
+		counter = PLUSONE(counter);
+		out += CHACHA20_BLOCK_SIZE;
+		in += CHACHA20_BLOCK_SIZE;
+	}
+}
+
+static void chacha20_lanes_portable(const uint32_t *state, const struct chacha20_lane *lanes, size_t count) {
+	uint32_t lane_state[16];
+
+	memcpy(lane_state, state, 12 * sizeof(uint32_t));
+	for (; count; count--, lanes++) {
+		memcpy(&lane_state[12], lanes->words, sizeof(lanes->words));
+		chacha20_blocks_portable(lane_state, lanes->dst, lanes->src, 1);
+	}
+}
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) && !defined(CONFIG_WIREGUARD_CHACHA20_PORTABLE_ONLY)
+#define CHACHA20_HAVE_VECTOR 1
+
+#if defined(__clang__)
+#define CHACHA20_SHUFFLE(a, b, ...) __builtin_shufflevector(a, b, __VA_ARGS__)
+#else
+#define CHACHA20_SHUFFLE(a, b, ...) __builtin_shuffle(a, b, (__typeof__(a)){ __VA_ARGS__ })
+#endif
+
+// Where the 4-lane kernel has real vector registers to run in. Elsewhere (Xtensa, RISC-V without V) GCC lowers it to
+// four sets of 16 scalar words that do not fit the register file, so AUTO only takes it there if calibration says so
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(__ALTIVEC__)
+#define CHACHA20_HAVE_SIMD 1
+#endif
+
+typedef uint32_t chacha20_u32x4 __attribute__((vector_size(16)));
+#define CHACHA20_VEC_NAME chacha20_blocks_vec4
+#define CHACHA20_VEC_LANES_NAME chacha20_lanes_vec4
+#define CHACHA20_VEC_T chacha20_u32x4
+#define CHACHA20_VEC_LANES 4
+#define CHACHA20_VEC_ATTR
+#include "chacha20-vec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+// 8 blocks per iteration with AVX2, selected at runtime
+#define CHACHA20_HAVE_AVX2 1
+typedef uint32_t chacha20_u32x8 __attribute__((vector_size(32)));
+#define CHACHA20_VEC_NAME chacha20_blocks_avx2
+#define CHACHA20_VEC_LANES_NAME chacha20_lanes_avx2
+#define CHACHA20_VEC_T chacha20_u32x8
+#define CHACHA20_VEC_LANES 8
+#define CHACHA20_VEC_ATTR __attribute__((target("avx2")))
+#include "chacha20-vec.h"
+#endif
+
+#endif
+
+struct chacha20_backend {
+	const char *name;
+	size_t stride; // number of blocks handled per kernel iteration
+	void (*blocks)(const uint32_t *state, uint8_t *out, const uint8_t *in, size_t nblocks);
+	void (*lanes)(const uint32_t *state, const struct chacha20_lane *lanes, size_t count);
+};
+
+static const struct chacha20_backend chacha20_backends[] = {
+	[CHACHA20_BACKEND_PORTABLE] = { "portable", 1, chacha20_blocks_portable, chacha20_lanes_portable },
+#if defined(CHACHA20_HAVE_VECTOR)
+	[CHACHA20_BACKEND_VEC4] = { "vec4", 4, chacha20_blocks_vec4, chacha20_lanes_vec4 },
+#endif
+#if defined(CHACHA20_HAVE_AVX2)
+	[CHACHA20_BACKEND_AVX2] = { "avx2", 8, chacha20_blocks_avx2, chacha20_lanes_avx2 },
+#endif
+};
+
+static const struct chacha20_backend *chacha20_active_backend = NULL;
+
+static bool chacha20_backend_supported(enum chacha20_backend_id id) {
+	bool result = false;
+	switch (id) {
+		case CHACHA20_BACKEND_PORTABLE:
+			result = true;
+			break;
+#if defined(CHACHA20_HAVE_VECTOR)
+		case CHACHA20_BACKEND_VEC4:
+			result = true;
+			break;
+#endif
+#if defined(CHACHA20_HAVE_AVX2)
+		case CHACHA20_BACKEND_AVX2:
+			result = __builtin_cpu_supports("avx2");
+			break;
+#endif
+		default:
+			break;
+	}
+	return result;
+}
+
+// Whether AUTO may pick the kernel - the word-sliced ones only pay off in vector registers
+static bool chacha20_backend_preferred(enum chacha20_backend_id id) {
+	bool result = true;
+#if !defined(CHACHA20_HAVE_SIMD)
+	if (id == CHACHA20_BACKEND_VEC4) {
+		result = false;
+	}
+#endif
+	return result;
+}
+
+static const struct chacha20_backend *chacha20_backend(void) {
+	// Benign race: concurrent first callers all resolve to the same entry
+	if (!chacha20_active_backend) {
+		chacha20_set_backend(CHACHA20_BACKEND_AUTO);
+	}
+	return chacha20_active_backend;
+}
+
+bool chacha20_set_backend(enum chacha20_backend_id id) {
+	bool result = false;
+	if (id == CHACHA20_BACKEND_AUTO) {
+		// Widest kernel the running CPU supports in vector registers, portable without any
+		for (id = CHACHA20_BACKEND_AVX2; id > CHACHA20_BACKEND_PORTABLE; id--) {
+			if (chacha20_backend_supported(id) && chacha20_backend_preferred(id)) {
+				break;
+			}
+		}
+	}
+	if (chacha20_backend_supported(id)) {
+		chacha20_active_backend = &chacha20_backends[id];
+		result = true;
+	}
+	return result;
+}
+
+const char *chacha20_backend_name(void) {
+	return chacha20_backend()->name;
+}
+
 void chacha20(struct chacha20_ctx *ctx, uint8_t *out, const uint8_t *in, uint32_t len) {
+	const struct chacha20_backend *backend = chacha20_backend();
 	uint8_t output[CHACHA20_BLOCK_SIZE];
+	size_t nblocks = len / CHACHA20_BLOCK_SIZE;
+	size_t count;
 	int i;
 
-	if (len) {
-		for (;;) {
-			chacha20_block(ctx, output);
+	// Whole blocks go through the selected kernel, what is left over drops down to the narrower kernels
+	while (nblocks) {
+		count = nblocks - (nblocks % backend->stride);
+		if (count) {
+			backend->blocks(ctx->state, out, in, count);
 			// Word 12 is a block counter
-			ctx->state[12] = PLUSONE(ctx->state[12]);
-			if (len <= 64) {
-				for (i = 0;i < len;++i) {
-					out[i] = in[i] ^ output[i];
-			    }
-			    return;
-			}
-			for (i = 0;i < 64;++i) {
-				out[i] = in[i] ^ output[i];
-			}
-			len -= 64;
-			out += 64;
-			in += 64;
+			ctx->state[12] = PLUS(ctx->state[12], (uint32_t)count);
+			out += count * CHACHA20_BLOCK_SIZE;
+			in += count * CHACHA20_BLOCK_SIZE;
+			nblocks -= count;
+		}
+		if (backend > &chacha20_backends[CHACHA20_BACKEND_PORTABLE]) {
+			backend--;
+		}
+	}
+
+	len %= CHACHA20_BLOCK_SIZE;
+	if (len) {
+		chacha20_block(ctx->state, output);
+		ctx->state[12] = PLUSONE(ctx->state[12]);
+		for (i = 0; i < len; ++i) {
+			out[i] = in[i] ^ output[i];
 		}
 	}
 }
 
+void chacha20_lanes(const struct chacha20_ctx *key_ctx, const struct chacha20_lane *lanes, size_t count) {
+	const struct chacha20_backend *backend = chacha20_backend();
+	size_t n;
+
+	// As chacha20() - as many lanes as the selected kernel takes at a time, the rest through the narrower kernels
+	while (count) {
+		n = count - (count % backend->stride);
+		if (n) {
+			backend->lanes(key_ctx->state, lanes, n);
+			lanes += n;
+			count -= n;
+		}
+		if (backend > &chacha20_backends[CHACHA20_BACKEND_PORTABLE]) {
+			backend--;
+		}
+	}
+}
 
 // 2.3.  The ChaCha20 Block Function
 // The first four words (0-3) are constants: 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574
@@ -165,6 +364,14 @@ void chacha20_init(struct chacha20_ctx *ctx, const uint8_t *key, const uint64_t
 	ctx->state[15] = nonce >> 32;
 }
 
+void chacha20_reinit(struct chacha20_ctx *ctx, const struct chacha20_ctx *key_ctx, const uint64_t nonce) {
+	memcpy(ctx->state, key_ctx->state, 12 * sizeof(uint32_t));
+	ctx->state[12] = 0;
+	ctx->state[13] = 0;
+	ctx->state[14] = nonce & 0xFFFFFFFF;
+	ctx->state[15] = nonce >> 32;
+}
+
 // 2.2. HChaCha20
 // HChaCha20 is initialized the same way as the ChaCha cipher, except that HChaCha20 uses a 128-bit nonce and has no counter.
 // After initialization, proceed through the ChaCha rounds as usual.
@@ -42,6 +42,8 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #define CHACHA20_BLOCK_SIZE		(64)
 #define CHACHA20_KEY_SIZE		(32)
@@ -51,9 +53,35 @@ struct chacha20_ctx {
 };
 
 void chacha20_init(struct chacha20_ctx *ctx, const uint8_t *key, const uint64_t nonce);
+// Start a new message from a context whose key has already been set up by chacha20_init - only the counter and nonce are reset
+void chacha20_reinit(struct chacha20_ctx *ctx, const struct chacha20_ctx *key_ctx, const uint64_t nonce);
 void chacha20(struct chacha20_ctx *ctx, uint8_t *out, const uint8_t *in, uint32_t len);
 void hchacha20(uint8_t *out, const uint8_t *nonce, const uint8_t *key);
 
+// A block of keystream for chacha20_lanes() - XORed with the 64 bytes at src into dst (the same block, or one that
+// does not overlap it), at the block counter and nonce in words (state words 12-15, laid out as chacha20_reinit() does)
+struct chacha20_lane {
+	const uint8_t *src;
+	uint8_t *dst;
+	uint32_t words[4];
+};
+// Blocks of any number of messages under the key set up in key_ctx, e.g. the first blocks of several short packets -
+// they go through the kernels together, so that short messages keep the vector lanes as full as long ones do
+void chacha20_lanes(const struct chacha20_ctx *key_ctx, const struct chacha20_lane *lanes, size_t count);
+
+// Keystream kernels used by chacha20() for whole blocks
+// AUTO picks the widest kernel supported by the running CPU (the default) - but not VEC4 on targets without SIMD
+// registers, where it spills instead of gaining on PORTABLE, unless wireguard_crypto_calibrate() measures otherwise. Selecting an
+// unsupported kernel returns false
+enum chacha20_backend_id {
+	CHACHA20_BACKEND_AUTO = 0,
+	CHACHA20_BACKEND_PORTABLE,	// one block at a time
+	CHACHA20_BACKEND_VEC4,		// 4 blocks word-sliced (SSE2 / NEON, or 32-bit words on Xtensa)
+	CHACHA20_BACKEND_AVX2,		// 8 blocks word-sliced, x86 with AVX2 only
+};
+bool chacha20_set_backend(enum chacha20_backend_id id);
+const char *chacha20_backend_name(void);
+
 #ifdef __cplusplus
 }
 #endif
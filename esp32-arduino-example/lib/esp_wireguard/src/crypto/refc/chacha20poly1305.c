@@ -38,6 +38,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include "../../crypto.h"
 
 #define POLY1305_KEY_SIZE		32
@@ -45,15 +46,25 @@
 
 static const uint8_t zero[CHACHA20_BLOCK_SIZE] = { 0 };
 
+// Data is encrypted/decrypted and authenticated in chunks of this many bytes (a whole number of ChaCha20 blocks, wide enough for the 8-block kernel)
+#define CHACHA20POLY1305_CHUNK_SIZE	(8 * CHACHA20_BLOCK_SIZE)
+
+// Blocks handed to the ChaCha20 kernels at a time when encrypting a batch - as many as the widest kernel built takes
+#if defined(__x86_64__) || defined(__i386__)
+#define CHACHA20POLY1305_BATCH_LANES	8
+#else
+#define CHACHA20POLY1305_BATCH_LANES	4
+#endif
+
 // 2.6.  Generating the Poly1305 Key Using ChaCha20
-static void generate_poly1305_key(struct poly1305_context *poly1305_state, struct chacha20_ctx *chacha20_state, const uint8_t *key, uint64_t nonce) {
+static void generate_poly1305_key(struct poly1305_context *poly1305_state, struct chacha20_ctx *chacha20_state, const struct chacha20poly1305_key *key, uint64_t nonce) {
 	uint8_t block[POLY1305_KEY_SIZE] = {0};
 
 	// The method is to call the block function with the following parameters:
 	// - The 256-bit session integrity key is used as the ChaCha20 key.
 	// - The block counter is set to zero.
 	// - The protocol will specify a 96-bit or 64-bit nonce
-	chacha20_init(chacha20_state, key, nonce);
+	chacha20_reinit(chacha20_state, &key->chacha20, nonce);
 
 	// We take the first 256 bits or the serialized state, and use those as the one-time Poly1305 key
 	chacha20(chacha20_state, block, block, sizeof(block));
@@ -63,55 +74,79 @@ static void generate_poly1305_key(struct poly1305_context *poly1305_state, struc
 	crypto_zero(&block, sizeof(block));
 }
 
+// The Poly1305 message is AAD || padding1 || ciphertext || padding2 || len(AAD) || len(ciphertext)
+static void poly1305_update_ad(struct poly1305_context *poly1305_state, const uint8_t *ad, size_t ad_len) {
+	size_t padded_len;
+	// - The AAD
+	poly1305_update(poly1305_state, ad, ad_len);
+	// - padding1 -- the padding is up to 15 zero bytes, and it brings the total length so far to an integral multiple of 16
+	padded_len = (ad_len + 15) & 0xFFFFFFF0; // Round up to next 16 bytes
+	poly1305_update(poly1305_state, zero, padded_len - ad_len);
+}
+
+static void poly1305_update_lengths(struct poly1305_context *poly1305_state, size_t ad_len, size_t ciphertext_len) {
+	uint8_t block[8];
+	size_t padded_len;
+	// - padding2 -- the padding is up to 15 zero bytes, and it brings the total length so far to an integral multiple of 16.
+	padded_len = (ciphertext_len + 15) & 0xFFFFFFF0; // Round up to next 16 bytes
+	poly1305_update(poly1305_state, zero, padded_len - ciphertext_len);
+	// - The length of the additional data in octets (as a 64-bit little-endian integer)
+	U64TO8_LITTLE(block, (uint64_t)ad_len);
+	poly1305_update(poly1305_state, block, sizeof(block));
+	// - The length of the ciphertext in octets (as a 64-bit little-endian integer).
+	U64TO8_LITTLE(block, (uint64_t)ciphertext_len);
+	poly1305_update(poly1305_state, block, sizeof(block));
+}
+
+void chacha20poly1305_key_init(struct chacha20poly1305_key *ctx, const uint8_t *key) {
+	chacha20_init(&ctx->chacha20, key, 0);
+}
+
 // 2.8.  AEAD Construction (Encryption)
-void chacha20poly1305_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key) {
+void chacha20poly1305_encrypt_key(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const struct chacha20poly1305_key *key) {
 	struct poly1305_context poly1305_state;
 	struct chacha20_ctx chacha20_state;
-	uint8_t block[8];
-	size_t padded_len;
+	size_t remaining = src_len;
+	size_t chunk;
 
 	// First, a Poly1305 one-time key is generated from the 256-bit key and nonce using the procedure described in Section 2.6.
 	generate_poly1305_key(&poly1305_state, &chacha20_state, key, nonce);
 
+	// Finally, the Poly1305 function is called with the Poly1305 key calculated above, and a message constructed as a concatenation of the following:
+	poly1305_update_ad(&poly1305_state, ad, ad_len);
+
 	// Next, the ChaCha20 encryption function is called to encrypt the plaintext, using the same key and nonce, and with the initial counter set to 1.
-	chacha20(&chacha20_state, dst, src, src_len);
+	// - The ciphertext -- each chunk is MACed straight after it has been encrypted while it is still hot in cache
+	while (remaining) {
+		chunk = (remaining < CHACHA20POLY1305_CHUNK_SIZE) ? remaining : CHACHA20POLY1305_CHUNK_SIZE;
+		chacha20(&chacha20_state, dst, src, chunk);
+		poly1305_update(&poly1305_state, dst, chunk);
+		dst += chunk;
+		src += chunk;
+		remaining -= chunk;
+	}
 
-	// Finally, the Poly1305 function is called with the Poly1305 key calculated above, and a message constructed as a concatenation of the following:
-	// - The AAD
-	poly1305_update(&poly1305_state, ad, ad_len);
-	// - padding1 -- the padding is up to 15 zero bytes, and it brings the total length so far to an integral multiple of 16
-	padded_len = (ad_len + 15) & 0xFFFFFFF0; // Round up to next 16 bytes
-	poly1305_update(&poly1305_state, zero, padded_len - ad_len);
-	// - The ciphertext
-	poly1305_update(&poly1305_state, dst, src_len);
-	// - padding2 -- the padding is up to 15 zero bytes, and it brings the total length so far to an integral multiple of 16.
-	padded_len = (src_len + 15) & 0xFFFFFFF0; // Round up to next 16 bytes
-	poly1305_update(&poly1305_state, zero, padded_len - src_len);
-	// - The length of the additional data in octets (as a 64-bit little-endian integer)
-	U64TO8_LITTLE(block, (uint64_t)ad_len);
-	poly1305_update(&poly1305_state, block, sizeof(block));
-	// - The length of the ciphertext in octets (as a 64-bit little-endian integer).
-	U64TO8_LITTLE(block, (uint64_t)src_len);
-	poly1305_update(&poly1305_state, block, sizeof(block));
+	poly1305_update_lengths(&poly1305_state, ad_len, src_len);
 
 	// The output from the AEAD is twofold:
 	// - A ciphertext of the same length as the plaintext. (above, output of chacha20 into dst)
 	// - A 128-bit tag, which is the output of the Poly1305 function. (append to dst)
-	poly1305_finish(&poly1305_state, dst + src_len);
+	poly1305_finish(&poly1305_state, dst);
 
 	// Make sure we leave nothing sensitive on the stack
 	crypto_zero(&chacha20_state, sizeof(chacha20_state));
-	crypto_zero(&block, sizeof(block));
 }
 
 // 2.8.  AEAD Construction (Decryption)
-bool chacha20poly1305_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key) {
+bool chacha20poly1305_decrypt_key(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const struct chacha20poly1305_key *key) {
 	struct poly1305_context poly1305_state;
 	struct chacha20_ctx chacha20_state;
-	uint8_t block[8];
 	uint8_t mac[POLY1305_MAC_SIZE];
-	size_t padded_len;
-	int dst_len;
+	const uint8_t *received_mac;
+	size_t dst_len;
+	size_t remaining;
+	size_t chunk;
+	uint8_t *out = dst;
 	bool result = false;
 
 	// Decryption is similar [to encryption] with the following differences:
@@ -121,46 +156,249 @@ bool chacha20poly1305_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len,
 
 	if (src_len >= POLY1305_MAC_SIZE) {
 		dst_len = src_len - POLY1305_MAC_SIZE;
+		received_mac = src + dst_len;
 
 		// First, a Poly1305 one-time key is generated from the 256-bit key and nonce using the procedure described in Section 2.6.
 		generate_poly1305_key(&poly1305_state, &chacha20_state, key, nonce);
 
-		// Calculate the MAC before attempting decryption
-
 		// the Poly1305 function is called with the Poly1305 key calculated above, and a message constructed as a concatenation of the following:
-		// - The AAD
-		poly1305_update(&poly1305_state, ad, ad_len);
-		// - padding1 -- the padding is up to 15 zero bytes, and it brings the total length so far to an integral multiple of 16
-		padded_len = (ad_len + 15) & 0xFFFFFFF0; // Round up to next 16 bytes
-		poly1305_update(&poly1305_state, zero, padded_len - ad_len);
+		poly1305_update_ad(&poly1305_state, ad, ad_len);
+
 		// - The ciphertext (note the Poly1305 function is still run on the AAD and the ciphertext, not the plaintext)
-		poly1305_update(&poly1305_state, src, dst_len);
-		// - padding2 -- the padding is up to 15 zero bytes, and it brings the total length so far to an integral multiple of 16.
-		padded_len = (dst_len + 15) & 0xFFFFFFF0; // Round up to next 16 bytes
-		poly1305_update(&poly1305_state, zero, padded_len - dst_len);
-		// - The length of the additional data in octets (as a 64-bit little-endian integer)
-		U64TO8_LITTLE(block, (uint64_t)ad_len);
-		poly1305_update(&poly1305_state, block, sizeof(block));
-		// - The length of the ciphertext in octets (as a 64-bit little-endian integer).
-		U64TO8_LITTLE(block, (uint64_t)dst_len);
-		poly1305_update(&poly1305_state, block, sizeof(block));
+		// Each chunk is MACed and then decrypted in the same pass - the MAC is read before the chunk is overwritten so dst may equal src
+		remaining = dst_len;
+		while (remaining) {
+			chunk = (remaining < CHACHA20POLY1305_CHUNK_SIZE) ? remaining : CHACHA20POLY1305_CHUNK_SIZE;
+			poly1305_update(&poly1305_state, src, chunk);
+			chacha20(&chacha20_state, out, src, chunk);
+			out += chunk;
+			src += chunk;
+			remaining -= chunk;
+		}
+
+		poly1305_update_lengths(&poly1305_state, ad_len, dst_len);
 
 		// The output from the AEAD is twofold:
-		// - A plaintext of the same length as the ciphertext. (below, output of chacha20 into dst)
+		// - A plaintext of the same length as the ciphertext. (above, output of chacha20 into dst)
 		// - A 128-bit tag, which is the output of the Poly1305 function. (into mac for checking against passed mac)
 		poly1305_finish(&poly1305_state, mac);
 
-
-		if (crypto_equal(mac, src + dst_len, POLY1305_MAC_SIZE)) {
-			// mac is correct - do the decryption
-			// Next, the ChaCha20 encryption function is called to decrypt the ciphertext, using the same key and nonce, and with the initial counter set to 1.
-			chacha20(&chacha20_state, dst, src, dst_len);
+		if (crypto_equal(mac, received_mac, POLY1305_MAC_SIZE)) {
 			result = true;
+		} else {
+			// Never hand back plaintext that failed authentication
+			crypto_zero(dst, dst_len);
+		}
+
+		crypto_zero(&chacha20_state, sizeof(chacha20_state));
+	}
+	return result;
+}
+
+void chacha20poly1305_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key) {
+	struct chacha20poly1305_key key_ctx;
+	chacha20poly1305_key_init(&key_ctx, key);
+	chacha20poly1305_encrypt_key(dst, src, src_len, ad, ad_len, nonce, &key_ctx);
+	crypto_zero(&key_ctx, sizeof(key_ctx));
+}
+
+bool chacha20poly1305_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key) {
+	struct chacha20poly1305_key key_ctx;
+	bool result;
+	chacha20poly1305_key_init(&key_ctx, key);
+	result = chacha20poly1305_decrypt_key(dst, src, src_len, ad, ad_len, nonce, &key_ctx);
+	crypto_zero(&key_ctx, sizeof(key_ctx));
+	return result;
+}
+
+void chacha20poly1305_stream_init(struct chacha20poly1305_stream *stream, const uint8_t *ad, size_t ad_len, uint64_t nonce, const struct chacha20poly1305_key *key) {
+	generate_poly1305_key(&stream->poly1305, &stream->chacha20, key, nonce);
+	poly1305_update_ad(&stream->poly1305, ad, ad_len);
+	stream->keystream_used = CHACHA20_BLOCK_SIZE;
+	stream->ad_len = ad_len;
+	stream->len = 0;
+}
+
+// XORs a segment with the keystream, carrying on from where the last one stopped
+static void chacha20poly1305_stream_xor(struct chacha20poly1305_stream *stream, uint8_t *dst, const uint8_t *src, size_t len) {
+	size_t blocks_len;
+
+	// Finish off a keystream block the previous segment only used part of
+	while (len && (stream->keystream_used < CHACHA20_BLOCK_SIZE)) {
+		*dst++ = *src++ ^ stream->keystream[stream->keystream_used++];
+		len--;
+	}
+	// Whole blocks go straight through the ChaCha20 kernels
+	blocks_len = len & ~(size_t)(CHACHA20_BLOCK_SIZE - 1);
+	if (blocks_len) {
+		chacha20(&stream->chacha20, dst, src, blocks_len);
+		dst += blocks_len;
+		src += blocks_len;
+		len -= blocks_len;
+	}
+	// A block the segment ends part way into - the rest of its keystream is kept for the next segment
+	if (len) {
+		chacha20(&stream->chacha20, stream->keystream, zero, CHACHA20_BLOCK_SIZE);
+		stream->keystream_used = 0;
+		while (len) {
+			*dst++ = *src++ ^ stream->keystream[stream->keystream_used++];
+			len--;
 		}
 	}
+}
+
+// Up to the end of a keystream block the last segment left part used, then whole chunks - so that chunks start on a
+// block and the ChaCha20 kernels get to run at their full width
+static size_t chacha20poly1305_stream_chunk(const struct chacha20poly1305_stream *stream, size_t len) {
+	size_t chunk = (stream->keystream_used < CHACHA20_BLOCK_SIZE) ? (CHACHA20_BLOCK_SIZE - stream->keystream_used) : CHACHA20POLY1305_CHUNK_SIZE;
+	return (len < chunk) ? len : chunk;
+}
+
+void chacha20poly1305_stream_encrypt(struct chacha20poly1305_stream *stream, uint8_t *dst, const uint8_t *src, size_t len) {
+	size_t chunk;
+
+	stream->len += len;
+	while (len) {
+		chunk = chacha20poly1305_stream_chunk(stream, len);
+		chacha20poly1305_stream_xor(stream, dst, src, chunk);
+		poly1305_update(&stream->poly1305, dst, chunk);
+		dst += chunk;
+		src += chunk;
+		len -= chunk;
+	}
+}
+
+void chacha20poly1305_stream_decrypt(struct chacha20poly1305_stream *stream, uint8_t *dst, const uint8_t *src, size_t len) {
+	size_t chunk;
+
+	stream->len += len;
+	while (len) {
+		chunk = chacha20poly1305_stream_chunk(stream, len);
+		// The MAC is over the ciphertext, so it is taken before the chunk is decrypted over
+		poly1305_update(&stream->poly1305, src, chunk);
+		chacha20poly1305_stream_xor(stream, dst, src, chunk);
+		dst += chunk;
+		src += chunk;
+		len -= chunk;
+	}
+}
+
+void chacha20poly1305_stream_finish(struct chacha20poly1305_stream *stream, uint8_t *mac) {
+	poly1305_update_lengths(&stream->poly1305, stream->ad_len, stream->len);
+	poly1305_finish(&stream->poly1305, mac);
+	crypto_zero(stream, sizeof(struct chacha20poly1305_stream));
+}
+
+bool chacha20poly1305_stream_verify(struct chacha20poly1305_stream *stream, const uint8_t *mac) {
+	uint8_t calculated[POLY1305_MAC_SIZE];
+	bool result;
+
+	chacha20poly1305_stream_finish(stream, calculated);
+	result = crypto_equal(calculated, mac, POLY1305_MAC_SIZE);
+	crypto_zero(calculated, sizeof(calculated));
 	return result;
 }
 
+// Blocks of a batch on their way to chacha20_lanes(). A block the message or its src ends part way into, and a
+// Poly1305 key block, is worked on in blocks[] - the kernels always read and write a whole block
+struct chacha20poly1305_batch {
+	const struct chacha20poly1305_key *key;
+	struct chacha20_lane lanes[CHACHA20POLY1305_BATCH_LANES];
+	uint8_t blocks[CHACHA20POLY1305_BATCH_LANES][CHACHA20_BLOCK_SIZE];
+	uint8_t *partial[CHACHA20POLY1305_BATCH_LANES]; // Where a block worked on in blocks[] goes back to, if anywhere
+	size_t partial_len[CHACHA20POLY1305_BATCH_LANES];
+	size_t count;
+};
+
+// Adds block counter of the message with nonce - len bytes to dst, from src_len bytes at src followed by zeros - or
+// a Poly1305 key when dst is NULL
+static void chacha20poly1305_batch_add(struct chacha20poly1305_batch *batch, uint8_t *dst, const uint8_t *src, size_t src_len, size_t len, uint32_t counter, uint64_t nonce) {
+	struct chacha20_lane *lane = &batch->lanes[batch->count];
+
+	batch->partial[batch->count] = NULL;
+	if (!dst) {
+		memset(batch->blocks[batch->count], 0, POLY1305_KEY_SIZE);
+		lane->src = batch->blocks[batch->count];
+		lane->dst = batch->blocks[batch->count];
+	} else if (src_len < CHACHA20_BLOCK_SIZE) {
+		if (src_len) {
+			memcpy(batch->blocks[batch->count], src, src_len);
+		}
+		memset(batch->blocks[batch->count] + src_len, 0, len - src_len);
+		batch->partial[batch->count] = dst;
+		batch->partial_len[batch->count] = len;
+		lane->src = batch->blocks[batch->count];
+		lane->dst = batch->blocks[batch->count];
+	} else {
+		lane->src = src;
+		lane->dst = dst;
+	}
+	lane->words[0] = counter;
+	lane->words[1] = 0;
+	lane->words[2] = nonce & 0xFFFFFFFF;
+	lane->words[3] = nonce >> 32;
+	batch->count++;
+}
+
+static void chacha20poly1305_batch_run(struct chacha20poly1305_batch *batch) {
+	size_t x;
+
+	chacha20_lanes(&batch->key->chacha20, batch->lanes, batch->count);
+	for (x = 0; x < batch->count; x++) {
+		if (batch->partial[x]) {
+			memcpy(batch->partial[x], batch->blocks[x], batch->partial_len[x]);
+		}
+	}
+	batch->count = 0;
+}
+
+void chacha20poly1305_encrypt_batch(const struct chacha20poly1305_message *messages, size_t count, const struct chacha20poly1305_key *key) {
+	struct chacha20poly1305_batch batch;
+	struct poly1305_context poly1305_state;
+	size_t offset;
+	size_t len;
+	size_t src_len;
+	size_t first;
+	size_t x;
+	size_t y;
+
+	batch.key = key;
+	batch.count = 0;
+
+	// The plaintext of every message, with the initial counter set to 1...
+	for (x = 0; x < count; x++) {
+		for (offset = 0; offset < messages[x].len; offset += CHACHA20_BLOCK_SIZE) {
+			len = messages[x].len - offset;
+			len = (len < CHACHA20_BLOCK_SIZE) ? len : CHACHA20_BLOCK_SIZE;
+			src_len = (messages[x].src_len > offset) ? (messages[x].src_len - offset) : 0;
+			src_len = (src_len < len) ? src_len : len;
+			chacha20poly1305_batch_add(&batch, messages[x].dst + offset, src_len ? (messages[x].src + offset) : NULL, src_len, len, (uint32_t)(1 + (offset / CHACHA20_BLOCK_SIZE)), messages[x].nonce);
+			if (batch.count == CHACHA20POLY1305_BATCH_LANES) {
+				chacha20poly1305_batch_run(&batch);
+			}
+		}
+	}
+	if (batch.count) {
+		chacha20poly1305_batch_run(&batch);
+	}
+
+	// ...then the Poly1305 one-time keys from block 0 (2.6), each used on its ciphertext as soon as it is made
+	for (first = 0; first < count; first = x) {
+		for (x = first; (x < count) && (batch.count < CHACHA20POLY1305_BATCH_LANES); x++) {
+			chacha20poly1305_batch_add(&batch, NULL, NULL, 0, 0, 0, messages[x].nonce);
+		}
+		chacha20poly1305_batch_run(&batch);
+		for (y = first; y < x; y++) {
+			poly1305_init(&poly1305_state, batch.blocks[y - first]);
+			poly1305_update(&poly1305_state, messages[y].dst, messages[y].len);
+			poly1305_update_lengths(&poly1305_state, 0, messages[y].len);
+			poly1305_finish(&poly1305_state, messages[y].dst + messages[y].len);
+		}
+	}
+
+	crypto_zero(&batch, sizeof(batch));
+}
+
 // AEAD_XChaCha20_Poly1305
 // XChaCha20-Poly1305 is a variant of the ChaCha20-Poly1305 AEAD construction as defined in [RFC7539] that uses a 192-bit nonce instead of a 96-bit nonce.
 // The algorithm for XChaCha20-Poly1305 is as follows:
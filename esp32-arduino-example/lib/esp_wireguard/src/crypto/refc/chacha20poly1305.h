@@ -40,12 +40,63 @@ extern "C" {
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include "chacha20.h"
+#include "poly1305-donna.h"
+
+// Expanded session key - the ChaCha20 state with the 256-bit key already parsed, only the nonce is filled in per message
+// Keeping one of these per session avoids re-parsing the key on every packet
+struct chacha20poly1305_key {
+	struct chacha20_ctx chacha20;
+};
+
+void chacha20poly1305_key_init(struct chacha20poly1305_key *ctx, const uint8_t *key);
 
 // Aead(key, counter, plain text, auth text) ChaCha20Poly1305 AEAD, as specified in RFC7539 [17], with its nonce being composed of 32 bits of zeros followed by the 64-bit little-endian value of counter.
 // AEAD_CHACHA20_POLY1305 as described in https://tools.ietf.org/html/rfc7539
 void chacha20poly1305_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key);
 bool chacha20poly1305_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key);
 
+// As above but with a key expanded by chacha20poly1305_key_init()
+// Encryption and authentication are done in a single pass over the data so each chunk is MACed while it is still in cache
+// On decryption failure the output buffer is wiped. Decryption may be done in place (dst == src)
+void chacha20poly1305_encrypt_key(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const struct chacha20poly1305_key *key);
+bool chacha20poly1305_decrypt_key(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const struct chacha20poly1305_key *key);
+
+// The same AEAD over a message that comes in segments of any length, e.g. a chain of network buffers: init, then
+// every segment in order, then finish (encryption) or verify (decryption). The keystream block a segment stops part
+// way into is kept for the next one. Segments may be processed in place (dst == src); a message that fails to verify
+// is left decrypted, callers are expected to throw it away
+struct chacha20poly1305_stream {
+	poly1305_context poly1305;
+	struct chacha20_ctx chacha20;
+	uint8_t keystream[CHACHA20_BLOCK_SIZE];
+	size_t keystream_used; // Of the keystream block, CHACHA20_BLOCK_SIZE when there is none left
+	size_t ad_len;
+	size_t len;
+};
+
+void chacha20poly1305_stream_init(struct chacha20poly1305_stream *stream, const uint8_t *ad, size_t ad_len, uint64_t nonce, const struct chacha20poly1305_key *key);
+void chacha20poly1305_stream_encrypt(struct chacha20poly1305_stream *stream, uint8_t *dst, const uint8_t *src, size_t len);
+void chacha20poly1305_stream_decrypt(struct chacha20poly1305_stream *stream, uint8_t *dst, const uint8_t *src, size_t len);
+// Writes the 16-byte tag
+void chacha20poly1305_stream_finish(struct chacha20poly1305_stream *stream, uint8_t *mac);
+// Compares the calculated tag to the received one
+bool chacha20poly1305_stream_verify(struct chacha20poly1305_stream *stream, const uint8_t *mac);
+
+// Several messages under the same key, for a sender that has a batch of them to hand: the ChaCha20 blocks of all of
+// them, Poly1305 key blocks included, go through the kernels together so that short messages keep the vector lanes
+// full. Each message is encrypted from src into dst, with no additional data, and its tag written straight after it.
+// The plaintext is the src_len bytes at src padded with zeros to len, so a sender can pad without copying
+struct chacha20poly1305_message {
+	uint8_t *dst;
+	const uint8_t *src; // dst itself, or memory that does not overlap it
+	size_t src_len; // Up to len
+	size_t len;
+	uint64_t nonce;
+};
+
+void chacha20poly1305_encrypt_batch(const struct chacha20poly1305_message *messages, size_t count, const struct chacha20poly1305_key *key);
+
 // Xaead(key, nonce, plain text, auth text) XChaCha20Poly1305 AEAD, with a 24-byte random nonce, instantiated using HChaCha20 [6] and ChaCha20Poly1305.
 // AEAD_XChaCha20_Poly1305 as described in https://tools.ietf.org/id/draft-arciszewski-xchacha-02.html
 void xchacha20poly1305_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, const uint8_t *nonce, const uint8_t *key);
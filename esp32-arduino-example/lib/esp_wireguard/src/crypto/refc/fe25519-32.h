@@ -0,0 +1,215 @@
+// Field arithmetic mod 2^255-19 on 10 signed limbs of 26/25 bits (radix 2^25.5), included from x25519.c
+// Only 32x32=64 bit multiplies are needed, which suits 32-bit MCUs. The limb bounds are those of the ref10 code:
+// fe25519_mul/fe25519_sq accept the sum or difference of up to three reduced elements, which holds for the sequences
+// used by the ladder and the comb in x25519.c.
+
+#define FE25519_LIMBS 10
+#define FE25519_NAME "refc32"
+
+typedef int32_t fe25519[FE25519_LIMBS];
+
+static void fe25519_0(fe25519 h) {
+	memset(h, 0, sizeof(fe25519));
+}
+
+static void fe25519_1(fe25519 h) {
+	memset(h, 0, sizeof(fe25519));
+	h[0] = 1;
+}
+
+static void fe25519_add(fe25519 h, const fe25519 f, const fe25519 g) {
+	int i;
+	for (i = 0; i < 10; i++) {
+		h[i] = f[i] + g[i];
+	}
+}
+
+static void fe25519_sub(fe25519 h, const fe25519 f, const fe25519 g) {
+	int i;
+	for (i = 0; i < 10; i++) {
+		h[i] = f[i] - g[i];
+	}
+}
+
+static void fe25519_neg(fe25519 h, const fe25519 f) {
+	int i;
+	for (i = 0; i < 10; i++) {
+		h[i] = -f[i];
+	}
+}
+
+// h := f if b is 1, unchanged if b is 0
+static void fe25519_cmov(fe25519 h, const fe25519 f, unsigned int b) {
+	int32_t mask = -(int32_t)b;
+	int i;
+	for (i = 0; i < 10; i++) {
+		h[i] ^= (h[i] ^ f[i]) & mask;
+	}
+}
+
+// Swap f and g if b is 1
+static void fe25519_cswap(fe25519 f, fe25519 g, unsigned int b) {
+	int32_t mask = -(int32_t)b;
+	int32_t x;
+	int i;
+	for (i = 0; i < 10; i++) {
+		x = (f[i] ^ g[i]) & mask;
+		f[i] ^= x;
+		g[i] ^= x;
+	}
+}
+
+#define FE25519_CARRY(h, i, bits) do { \
+	int64_t c_ = (h[i] + ((int64_t)1 << ((bits) - 1))) >> (bits); \
+	h[(i) + 1] += c_; \
+	h[i] -= c_ * ((int64_t)1 << (bits)); \
+} while (0)
+
+// Brings the 64-bit column sums of a product back to 26/25 bit limbs (the last carry wraps around times 19)
+static void fe25519_reduce(fe25519 out, int64_t h[10]) {
+	int64_t c;
+	int i;
+
+	FE25519_CARRY(h, 0, 26);
+	FE25519_CARRY(h, 4, 26);
+	FE25519_CARRY(h, 1, 25);
+	FE25519_CARRY(h, 5, 25);
+	FE25519_CARRY(h, 2, 26);
+	FE25519_CARRY(h, 6, 26);
+	FE25519_CARRY(h, 3, 25);
+	FE25519_CARRY(h, 7, 25);
+	FE25519_CARRY(h, 4, 26);
+	FE25519_CARRY(h, 8, 26);
+
+	c = (h[9] + ((int64_t)1 << 24)) >> 25;
+	h[0] += c * 19;
+	h[9] -= c * ((int64_t)1 << 25);
+
+	FE25519_CARRY(h, 0, 26);
+
+	for (i = 0; i < 10; i++) {
+		out[i] = (int32_t)h[i];
+	}
+}
+
+static void fe25519_mul(fe25519 out, const fe25519 f, const fe25519 g) {
+	int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4], f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+	int32_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4], g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+	int32_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4, g5_19 = 19 * g5;
+	int32_t g6_19 = 19 * g6, g7_19 = 19 * g7, g8_19 = 19 * g8, g9_19 = 19 * g9;
+	int32_t f1_2 = 2 * f1, f3_2 = 2 * f3, f5_2 = 2 * f5, f7_2 = 2 * f7, f9_2 = 2 * f9;
+	int64_t h[10];
+
+	h[0] = f0 * (int64_t)g0 + f1_2 * (int64_t)g9_19 + f2 * (int64_t)g8_19 + f3_2 * (int64_t)g7_19 + f4 * (int64_t)g6_19 + f5_2 * (int64_t)g5_19 + f6 * (int64_t)g4_19 + f7_2 * (int64_t)g3_19 + f8 * (int64_t)g2_19 + f9_2 * (int64_t)g1_19;
+	h[1] = f0 * (int64_t)g1 + f1 * (int64_t)g0 + f2 * (int64_t)g9_19 + f3 * (int64_t)g8_19 + f4 * (int64_t)g7_19 + f5 * (int64_t)g6_19 + f6 * (int64_t)g5_19 + f7 * (int64_t)g4_19 + f8 * (int64_t)g3_19 + f9 * (int64_t)g2_19;
+	h[2] = f0 * (int64_t)g2 + f1_2 * (int64_t)g1 + f2 * (int64_t)g0 + f3_2 * (int64_t)g9_19 + f4 * (int64_t)g8_19 + f5_2 * (int64_t)g7_19 + f6 * (int64_t)g6_19 + f7_2 * (int64_t)g5_19 + f8 * (int64_t)g4_19 + f9_2 * (int64_t)g3_19;
+	h[3] = f0 * (int64_t)g3 + f1 * (int64_t)g2 + f2 * (int64_t)g1 + f3 * (int64_t)g0 + f4 * (int64_t)g9_19 + f5 * (int64_t)g8_19 + f6 * (int64_t)g7_19 + f7 * (int64_t)g6_19 + f8 * (int64_t)g5_19 + f9 * (int64_t)g4_19;
+	h[4] = f0 * (int64_t)g4 + f1_2 * (int64_t)g3 + f2 * (int64_t)g2 + f3_2 * (int64_t)g1 + f4 * (int64_t)g0 + f5_2 * (int64_t)g9_19 + f6 * (int64_t)g8_19 + f7_2 * (int64_t)g7_19 + f8 * (int64_t)g6_19 + f9_2 * (int64_t)g5_19;
+	h[5] = f0 * (int64_t)g5 + f1 * (int64_t)g4 + f2 * (int64_t)g3 + f3 * (int64_t)g2 + f4 * (int64_t)g1 + f5 * (int64_t)g0 + f6 * (int64_t)g9_19 + f7 * (int64_t)g8_19 + f8 * (int64_t)g7_19 + f9 * (int64_t)g6_19;
+	h[6] = f0 * (int64_t)g6 + f1_2 * (int64_t)g5 + f2 * (int64_t)g4 + f3_2 * (int64_t)g3 + f4 * (int64_t)g2 + f5_2 * (int64_t)g1 + f6 * (int64_t)g0 + f7_2 * (int64_t)g9_19 + f8 * (int64_t)g8_19 + f9_2 * (int64_t)g7_19;
+	h[7] = f0 * (int64_t)g7 + f1 * (int64_t)g6 + f2 * (int64_t)g5 + f3 * (int64_t)g4 + f4 * (int64_t)g3 + f5 * (int64_t)g2 + f6 * (int64_t)g1 + f7 * (int64_t)g0 + f8 * (int64_t)g9_19 + f9 * (int64_t)g8_19;
+	h[8] = f0 * (int64_t)g8 + f1_2 * (int64_t)g7 + f2 * (int64_t)g6 + f3_2 * (int64_t)g5 + f4 * (int64_t)g4 + f5_2 * (int64_t)g3 + f6 * (int64_t)g2 + f7_2 * (int64_t)g1 + f8 * (int64_t)g0 + f9_2 * (int64_t)g9_19;
+	h[9] = f0 * (int64_t)g9 + f1 * (int64_t)g8 + f2 * (int64_t)g7 + f3 * (int64_t)g6 + f4 * (int64_t)g5 + f5 * (int64_t)g4 + f6 * (int64_t)g3 + f7 * (int64_t)g2 + f8 * (int64_t)g1 + f9 * (int64_t)g0;
+
+	fe25519_reduce(out, h);
+}
+
+// Column sums of f^2, before reduction
+static void fe25519_sq_wide(int64_t h[10], const fe25519 f) {
+	int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4], f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+	int32_t f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3, f4_2 = 2 * f4;
+	int32_t f5_2 = 2 * f5, f6_2 = 2 * f6, f7_2 = 2 * f7, f8_2 = 2 * f8;
+	int32_t f5_38 = 38 * f5, f6_19 = 19 * f6, f7_38 = 38 * f7, f8_19 = 19 * f8, f9_38 = 38 * f9;
+	int32_t f7_19 = 19 * f7, f9_19 = 19 * f9;
+
+	h[0] = f0 * (int64_t)f0 + f1_2 * (int64_t)f9_38 + f2_2 * (int64_t)f8_19 + f3_2 * (int64_t)f7_38 + f4_2 * (int64_t)f6_19 + f5 * (int64_t)f5_38;
+	h[1] = f0_2 * (int64_t)f1 + f2_2 * (int64_t)f9_19 + f3_2 * (int64_t)f8_19 + f4_2 * (int64_t)f7_19 + f5_2 * (int64_t)f6_19;
+	h[2] = f0_2 * (int64_t)f2 + f1 * (int64_t)f1_2 + f3_2 * (int64_t)f9_38 + f4_2 * (int64_t)f8_19 + f5_2 * (int64_t)f7_38 + f6 * (int64_t)f6_19;
+	h[3] = f0_2 * (int64_t)f3 + f1_2 * (int64_t)f2 + f4_2 * (int64_t)f9_19 + f5_2 * (int64_t)f8_19 + f6_2 * (int64_t)f7_19;
+	h[4] = f0_2 * (int64_t)f4 + f1_2 * (int64_t)f3_2 + f2 * (int64_t)f2 + f5_2 * (int64_t)f9_38 + f6_2 * (int64_t)f8_19 + f7 * (int64_t)f7_38;
+	h[5] = f0_2 * (int64_t)f5 + f1_2 * (int64_t)f4 + f2_2 * (int64_t)f3 + f6_2 * (int64_t)f9_19 + f7_2 * (int64_t)f8_19;
+	h[6] = f0_2 * (int64_t)f6 + f1_2 * (int64_t)f5_2 + f2_2 * (int64_t)f4 + f3 * (int64_t)f3_2 + f7_2 * (int64_t)f9_38 + f8 * (int64_t)f8_19;
+	h[7] = f0_2 * (int64_t)f7 + f1_2 * (int64_t)f6 + f2_2 * (int64_t)f5 + f3_2 * (int64_t)f4 + f8_2 * (int64_t)f9_19;
+	h[8] = f0_2 * (int64_t)f8 + f1_2 * (int64_t)f7_2 + f2_2 * (int64_t)f6 + f3_2 * (int64_t)f5_2 + f4 * (int64_t)f4 + f9 * (int64_t)f9_38;
+	h[9] = f0_2 * (int64_t)f9 + f1_2 * (int64_t)f8 + f2_2 * (int64_t)f7 + f3_2 * (int64_t)f6 + f4_2 * (int64_t)f5;
+
+}
+
+static void fe25519_sq(fe25519 out, const fe25519 f) {
+	int64_t h[10];
+	fe25519_sq_wide(h, f);
+	fe25519_reduce(out, h);
+}
+
+// out := 2*f^2
+static void fe25519_sq2(fe25519 out, const fe25519 f) {
+	int64_t h[10];
+	int i;
+	fe25519_sq_wide(h, f);
+	for (i = 0; i < 10; i++) {
+		h[i] += h[i];
+	}
+	fe25519_reduce(out, h);
+}
+
+// out := 121666 * f (the (A+2)/4 constant of the Montgomery ladder)
+static void fe25519_mul121666(fe25519 out, const fe25519 f) {
+	int64_t h[10];
+	int i;
+	for (i = 0; i < 10; i++) {
+		h[i] = f[i] * (int64_t)121666;
+	}
+	fe25519_reduce(out, h);
+}
+
+// Load 255 bits little endian (the top bit is ignored, as X25519 requires)
+static void fe25519_frombytes(fe25519 h, const uint8_t *s) {
+	int pos = 0;
+	int i;
+	for (i = 0; i < 10; i++) {
+		int bits = (i & 1) ? 25 : 26;
+		h[i] = (int32_t)(fe25519_load(s, pos) & (((uint64_t)1 << bits) - 1));
+		pos += bits;
+	}
+}
+
+// Fully reduce mod p and serialise little endian
+static void fe25519_tobytes(uint8_t *s, const fe25519 f) {
+	int32_t h[10];
+	int32_t q;
+	uint64_t acc = 0;
+	int bits = 0;
+	int i;
+	int n = 0;
+
+	memcpy(h, f, sizeof(h));
+
+	// q = 1 if h >= p, computed from the carries of h + 19
+	q = (19 * h[9] + ((int32_t)1 << 24)) >> 25;
+	for (i = 0; i < 10; i++) {
+		q = (h[i] + q) >> ((i & 1) ? 25 : 26);
+	}
+
+	// h - q*p = h + 19*q - q*2^255
+	h[0] += 19 * q;
+	for (i = 0; i < 9; i++) {
+		int shift = (i & 1) ? 25 : 26;
+		int32_t c = h[i] >> shift;
+		h[i + 1] += c;
+		h[i] -= c * ((int32_t)1 << shift);
+	}
+	h[9] &= ((int32_t)1 << 25) - 1;
+
+	for (i = 0; i < 10; i++) {
+		acc |= (uint64_t)(uint32_t)h[i] << bits;
+		bits += (i & 1) ? 25 : 26;
+		while (bits >= 8) {
+			s[n++] = (uint8_t)acc;
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+	s[n] = (uint8_t)acc;
+
+	crypto_zero(h, sizeof(h));
+}
@@ -0,0 +1,204 @@
+// Field arithmetic mod 2^255-19 on 5 unsigned limbs of 51 bits, included from x25519.c
+// Needs a 64x64=128 bit multiply (unsigned __int128), so this is for 64-bit hosts. Subtraction adds 4p and carries
+// so its output is always back to ~51 bit limbs; fe25519_mul/fe25519_sq accept inputs of up to 54 bits per limb,
+// which covers the sums of up to three reduced elements used by the ladder and the comb in x25519.c.
+
+#define FE25519_LIMBS 5
+#define FE25519_NAME "refc64"
+
+typedef uint64_t fe25519[FE25519_LIMBS];
+typedef unsigned __int128 fe25519_wide;
+
+#define FE25519_MASK51 ((((uint64_t)1) << 51) - 1)
+
+static void fe25519_0(fe25519 h) {
+	memset(h, 0, sizeof(fe25519));
+}
+
+static void fe25519_1(fe25519 h) {
+	memset(h, 0, sizeof(fe25519));
+	h[0] = 1;
+}
+
+static void fe25519_add(fe25519 h, const fe25519 f, const fe25519 g) {
+	int i;
+	for (i = 0; i < 5; i++) {
+		h[i] = f[i] + g[i];
+	}
+}
+
+// One carry pass - limbs below 2^51 (limb 0 may be a little above)
+static void fe25519_carry(fe25519 h) {
+	uint64_t c;
+	int i;
+	for (i = 0; i < 4; i++) {
+		c = h[i] >> 51;
+		h[i] &= FE25519_MASK51;
+		h[i + 1] += c;
+	}
+	c = h[4] >> 51;
+	h[4] &= FE25519_MASK51;
+	h[0] += c * 19;
+}
+
+// h := f - g, computed as f + 4p - g so no limb goes negative (g limbs must be below 2^53)
+static void fe25519_sub(fe25519 h, const fe25519 f, const fe25519 g) {
+	h[0] = (f[0] + 0x1FFFFFFFFFFFB4ULL) - g[0];
+	h[1] = (f[1] + 0x1FFFFFFFFFFFFCULL) - g[1];
+	h[2] = (f[2] + 0x1FFFFFFFFFFFFCULL) - g[2];
+	h[3] = (f[3] + 0x1FFFFFFFFFFFFCULL) - g[3];
+	h[4] = (f[4] + 0x1FFFFFFFFFFFFCULL) - g[4];
+	fe25519_carry(h);
+}
+
+static void fe25519_neg(fe25519 h, const fe25519 f) {
+	fe25519 zero;
+	fe25519_0(zero);
+	fe25519_sub(h, zero, f);
+}
+
+// h := f if b is 1, unchanged if b is 0
+static void fe25519_cmov(fe25519 h, const fe25519 f, unsigned int b) {
+	uint64_t mask = 0 - (uint64_t)b;
+	int i;
+	for (i = 0; i < 5; i++) {
+		h[i] ^= (h[i] ^ f[i]) & mask;
+	}
+}
+
+// Swap f and g if b is 1
+static void fe25519_cswap(fe25519 f, fe25519 g, unsigned int b) {
+	uint64_t mask = 0 - (uint64_t)b;
+	uint64_t x;
+	int i;
+	for (i = 0; i < 5; i++) {
+		x = (f[i] ^ g[i]) & mask;
+		f[i] ^= x;
+		g[i] ^= x;
+	}
+}
+
+// Carries the 128-bit column sums of a product back to 51 bit limbs (the top carry wraps around times 19)
+static void fe25519_reduce(fe25519 out, fe25519_wide r[5]) {
+	uint64_t c;
+
+	r[1] += (uint64_t)(r[0] >> 51);
+	r[2] += (uint64_t)(r[1] >> 51);
+	r[3] += (uint64_t)(r[2] >> 51);
+	r[4] += (uint64_t)(r[3] >> 51);
+	c = (uint64_t)(r[4] >> 51);
+
+	out[0] = ((uint64_t)r[0] & FE25519_MASK51) + (c * 19);
+	out[1] = (uint64_t)r[1] & FE25519_MASK51;
+	out[2] = (uint64_t)r[2] & FE25519_MASK51;
+	out[3] = (uint64_t)r[3] & FE25519_MASK51;
+	out[4] = (uint64_t)r[4] & FE25519_MASK51;
+
+	out[1] += out[0] >> 51;
+	out[0] &= FE25519_MASK51;
+}
+
+static void fe25519_mul(fe25519 out, const fe25519 f, const fe25519 g) {
+	uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+	uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+	uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+	fe25519_wide r[5];
+
+	r[0] = (fe25519_wide)f0 * g0 + (fe25519_wide)f1 * g4_19 + (fe25519_wide)f2 * g3_19 + (fe25519_wide)f3 * g2_19 + (fe25519_wide)f4 * g1_19;
+	r[1] = (fe25519_wide)f0 * g1 + (fe25519_wide)f1 * g0 + (fe25519_wide)f2 * g4_19 + (fe25519_wide)f3 * g3_19 + (fe25519_wide)f4 * g2_19;
+	r[2] = (fe25519_wide)f0 * g2 + (fe25519_wide)f1 * g1 + (fe25519_wide)f2 * g0 + (fe25519_wide)f3 * g4_19 + (fe25519_wide)f4 * g3_19;
+	r[3] = (fe25519_wide)f0 * g3 + (fe25519_wide)f1 * g2 + (fe25519_wide)f2 * g1 + (fe25519_wide)f3 * g0 + (fe25519_wide)f4 * g4_19;
+	r[4] = (fe25519_wide)f0 * g4 + (fe25519_wide)f1 * g3 + (fe25519_wide)f2 * g2 + (fe25519_wide)f3 * g1 + (fe25519_wide)f4 * g0;
+
+	fe25519_reduce(out, r);
+}
+
+// Column sums of f^2, before reduction
+static void fe25519_sq_wide(fe25519_wide r[5], const fe25519 f) {
+	uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+	uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3;
+	uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+
+	r[0] = (fe25519_wide)f0 * f0 + (fe25519_wide)f1_2 * f4_19 + (fe25519_wide)f2_2 * f3_19;
+	r[1] = (fe25519_wide)f0_2 * f1 + (fe25519_wide)f2_2 * f4_19 + (fe25519_wide)f3 * f3_19;
+	r[2] = (fe25519_wide)f0_2 * f2 + (fe25519_wide)f1 * f1 + (fe25519_wide)f3_2 * f4_19;
+	r[3] = (fe25519_wide)f0_2 * f3 + (fe25519_wide)f1_2 * f2 + (fe25519_wide)f4 * f4_19;
+	r[4] = (fe25519_wide)f0_2 * f4 + (fe25519_wide)f1_2 * f3 + (fe25519_wide)f2 * f2;
+}
+
+static void fe25519_sq(fe25519 out, const fe25519 f) {
+	fe25519_wide r[5];
+	fe25519_sq_wide(r, f);
+	fe25519_reduce(out, r);
+}
+
+// out := 2*f^2
+static void fe25519_sq2(fe25519 out, const fe25519 f) {
+	fe25519_wide r[5];
+	int i;
+	fe25519_sq_wide(r, f);
+	for (i = 0; i < 5; i++) {
+		r[i] += r[i];
+	}
+	fe25519_reduce(out, r);
+}
+
+// out := 121666 * f (the (A+2)/4 constant of the Montgomery ladder)
+static void fe25519_mul121666(fe25519 out, const fe25519 f) {
+	fe25519_wide r[5];
+	int i;
+	for (i = 0; i < 5; i++) {
+		r[i] = (fe25519_wide)f[i] * 121666;
+	}
+	fe25519_reduce(out, r);
+}
+
+// Load 255 bits little endian (the top bit is ignored, as X25519 requires)
+static void fe25519_frombytes(fe25519 h, const uint8_t *s) {
+	int i;
+	for (i = 0; i < 5; i++) {
+		h[i] = fe25519_load(s, i * 51) & FE25519_MASK51;
+	}
+}
+
+// Fully reduce mod p and serialise little endian
+static void fe25519_tobytes(uint8_t *s, const fe25519 f) {
+	fe25519 h;
+	uint64_t q;
+	uint64_t acc = 0;
+	int bits = 0;
+	int i;
+	int n = 0;
+
+	memcpy(h, f, sizeof(h));
+	fe25519_carry(h);
+	fe25519_carry(h);
+
+	// h < 2^255 + small now; q = 1 if h >= p, computed from the carries of h + 19
+	q = (h[0] + 19) >> 51;
+	q = (h[1] + q) >> 51;
+	q = (h[2] + q) >> 51;
+	q = (h[3] + q) >> 51;
+	q = (h[4] + q) >> 51;
+
+	// h - q*p = h + 19*q - q*2^255
+	h[0] += 19 * q;
+	for (i = 0; i < 4; i++) {
+		h[i + 1] += h[i] >> 51;
+		h[i] &= FE25519_MASK51;
+	}
+	h[4] &= FE25519_MASK51;
+
+	for (i = 0; i < 5; i++) {
+		acc |= h[i] << bits;
+		bits += 51;
+		while (bits >= 8) {
+			s[n++] = (uint8_t)acc;
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+	s[n] = (uint8_t)acc;
+
+	crypto_zero(h, sizeof(h));
+}
@@ -17,9 +17,23 @@ extern "C" {
 
 #define poly1305_block_size 16
 
-/* 17 + sizeof(size_t) + 14*sizeof(unsigned long) */
+/*
+	POLY1305_DONNA32_WAYS blocks are absorbed per iteration using precomputed powers of r:
+		h = (h + m[0]) * r^n + m[1] * r^(n-1) + ... + m[n-1] * r
+	the products are summed in 64 bit before a single carry chain, so a reduction is paid once per n blocks
+	rather than once per block. 1 gives the plain one-block-at-a-time loop
+*/
+#ifndef POLY1305_DONNA32_WAYS
+	#define POLY1305_DONNA32_WAYS 4
+#endif
+
+#if (POLY1305_DONNA32_WAYS != 1) && (POLY1305_DONNA32_WAYS != 2) && (POLY1305_DONNA32_WAYS != 4)
+	#error "POLY1305_DONNA32_WAYS must be 1, 2 or 4"
+#endif
+
+/* 17 + sizeof(size_t) + (9 + 5*POLY1305_DONNA32_WAYS)*sizeof(unsigned long) */
 typedef struct poly1305_state_internal_t {
-	unsigned long r[5];
+	unsigned long r[POLY1305_DONNA32_WAYS][5]; /* r, r^2, .. r^n */
 	unsigned long h[5];
 	unsigned long pad[4];
 	size_t leftover;
@@ -46,16 +60,62 @@ U32TO8(unsigned char *p, unsigned long v) {
 	p[3] = (v >> 24) & 0xff;
 }
 
+/* d += x * r, where s = r * 5 */
+#define POLY1305_MULADD(x0, x1, x2, x3, x4, r, s) \
+	d0 += ((unsigned long long)(x0) * (r)[0]) + ((unsigned long long)(x1) * (s)[4]) + ((unsigned long long)(x2) * (s)[3]) + ((unsigned long long)(x3) * (s)[2]) + ((unsigned long long)(x4) * (s)[1]); \
+	d1 += ((unsigned long long)(x0) * (r)[1]) + ((unsigned long long)(x1) * (r)[0]) + ((unsigned long long)(x2) * (s)[4]) + ((unsigned long long)(x3) * (s)[3]) + ((unsigned long long)(x4) * (s)[2]); \
+	d2 += ((unsigned long long)(x0) * (r)[2]) + ((unsigned long long)(x1) * (r)[1]) + ((unsigned long long)(x2) * (r)[0]) + ((unsigned long long)(x3) * (s)[4]) + ((unsigned long long)(x4) * (s)[3]); \
+	d3 += ((unsigned long long)(x0) * (r)[3]) + ((unsigned long long)(x1) * (r)[2]) + ((unsigned long long)(x2) * (r)[1]) + ((unsigned long long)(x3) * (r)[0]) + ((unsigned long long)(x4) * (s)[4]); \
+	d4 += ((unsigned long long)(x0) * (r)[4]) + ((unsigned long long)(x1) * (r)[3]) + ((unsigned long long)(x2) * (r)[2]) + ((unsigned long long)(x3) * (r)[1]) + ((unsigned long long)(x4) * (r)[0])
+
+/* (partial) h = d % p - the powers of r are not clamped so the top carry can exceed 32 bits */
+#define POLY1305_CARRY_WIDE(h) \
+	              c = d0 >> 26; (h)[0] = (unsigned long)d0 & 0x3ffffff; \
+	d1 += c;      c = d1 >> 26; (h)[1] = (unsigned long)d1 & 0x3ffffff; \
+	d2 += c;      c = d2 >> 26; (h)[2] = (unsigned long)d2 & 0x3ffffff; \
+	d3 += c;      c = d3 >> 26; (h)[3] = (unsigned long)d3 & 0x3ffffff; \
+	d4 += c;      c = d4 >> 26; (h)[4] = (unsigned long)d4 & 0x3ffffff; \
+	d0 = (h)[0] + (c * 5); c = d0 >> 26; (h)[0] = (unsigned long)d0 & 0x3ffffff; \
+	(h)[1] += (unsigned long)c
+
+#if (POLY1305_DONNA32_WAYS > 1)
+/* out = a * b */
+static void
+poly1305_mul(unsigned long out[5], const unsigned long a[5], const unsigned long b[5]) {
+	unsigned long s[5];
+	unsigned long long d0 = 0,d1 = 0,d2 = 0,d3 = 0,d4 = 0;
+	unsigned long long c;
+
+	s[0] = 0;
+	s[1] = b[1] * 5;
+	s[2] = b[2] * 5;
+	s[3] = b[3] * 5;
+	s[4] = b[4] * 5;
+
+	POLY1305_MULADD(a[0], a[1], a[2], a[3], a[4], b, s);
+	POLY1305_CARRY_WIDE(out);
+}
+#endif
+
 void
 poly1305_init(poly1305_context *ctx, const unsigned char key[32]) {
 	poly1305_state_internal_t *st = (poly1305_state_internal_t *)ctx;
 
 	/* r &= 0xffffffc0ffffffc0ffffffc0fffffff */
-	st->r[0] = (U8TO32(&key[ 0])     ) & 0x3ffffff;
-	st->r[1] = (U8TO32(&key[ 3]) >> 2) & 0x3ffff03;
-	st->r[2] = (U8TO32(&key[ 6]) >> 4) & 0x3ffc0ff;
-	st->r[3] = (U8TO32(&key[ 9]) >> 6) & 0x3f03fff;
-	st->r[4] = (U8TO32(&key[12]) >> 8) & 0x00fffff;
+	st->r[0][0] = (U8TO32(&key[ 0])     ) & 0x3ffffff;
+	st->r[0][1] = (U8TO32(&key[ 3]) >> 2) & 0x3ffff03;
+	st->r[0][2] = (U8TO32(&key[ 6]) >> 4) & 0x3ffc0ff;
+	st->r[0][3] = (U8TO32(&key[ 9]) >> 6) & 0x3f03fff;
+	st->r[0][4] = (U8TO32(&key[12]) >> 8) & 0x00fffff;
+
+#if (POLY1305_DONNA32_WAYS > 1)
+	/* r^2 .. r^n */
+	{
+		int i;
+		for (i = 1; i < POLY1305_DONNA32_WAYS; i++)
+			poly1305_mul(st->r[i], st->r[i - 1], st->r[0]);
+	}
+#endif
 
 	/* h = 0 */
 	st->h[0] = 0;
@@ -83,11 +143,11 @@ poly1305_blocks(poly1305_state_internal_t *st, const unsigned char *m, size_t by
 	unsigned long long d0,d1,d2,d3,d4;
 	unsigned long c;
 
-	r0 = st->r[0];
-	r1 = st->r[1];
-	r2 = st->r[2];
-	r3 = st->r[3];
-	r4 = st->r[4];
+	r0 = st->r[0][0];
+	r1 = st->r[0][1];
+	r2 = st->r[0][2];
+	r3 = st->r[0][3];
+	r4 = st->r[0][4];
 
 	s1 = r1 * 5;
 	s2 = r2 * 5;
@@ -100,6 +160,65 @@ poly1305_blocks(poly1305_state_internal_t *st, const unsigned char *m, size_t by
 	h3 = st->h[3];
 	h4 = st->h[4];
 
+#if (POLY1305_DONNA32_WAYS > 1)
+	if (bytes >= (POLY1305_DONNA32_WAYS * poly1305_block_size)) {
+		unsigned long rn[POLY1305_DONNA32_WAYS][5];
+		unsigned long sn[POLY1305_DONNA32_WAYS][5];
+		unsigned long h[5];
+		int i;
+
+		for (i = 0; i < POLY1305_DONNA32_WAYS; i++) {
+			rn[i][0] = st->r[i][0];
+			rn[i][1] = st->r[i][1];
+			rn[i][2] = st->r[i][2];
+			rn[i][3] = st->r[i][3];
+			rn[i][4] = st->r[i][4];
+			sn[i][0] = 0;
+			sn[i][1] = rn[i][1] * 5;
+			sn[i][2] = rn[i][2] * 5;
+			sn[i][3] = rn[i][3] * 5;
+			sn[i][4] = rn[i][4] * 5;
+		}
+
+		while (bytes >= (POLY1305_DONNA32_WAYS * poly1305_block_size)) {
+			d0 = d1 = d2 = d3 = d4 = 0;
+
+			/* (h + m[0]) * r^n */
+			h0 += (U8TO32(m+ 0)     ) & 0x3ffffff;
+			h1 += (U8TO32(m+ 3) >> 2) & 0x3ffffff;
+			h2 += (U8TO32(m+ 6) >> 4) & 0x3ffffff;
+			h3 += (U8TO32(m+ 9) >> 6) & 0x3ffffff;
+			h4 += (U8TO32(m+12) >> 8) | hibit;
+			POLY1305_MULADD(h0, h1, h2, h3, h4, rn[POLY1305_DONNA32_WAYS - 1], sn[POLY1305_DONNA32_WAYS - 1]);
+			m += poly1305_block_size;
+
+			/* + m[i] * r^(n-i) */
+			for (i = POLY1305_DONNA32_WAYS - 2; i >= 0; i--) {
+				unsigned long t0,t1,t2,t3,t4;
+				t0 = (U8TO32(m+ 0)     ) & 0x3ffffff;
+				t1 = (U8TO32(m+ 3) >> 2) & 0x3ffffff;
+				t2 = (U8TO32(m+ 6) >> 4) & 0x3ffffff;
+				t3 = (U8TO32(m+ 9) >> 6) & 0x3ffffff;
+				t4 = (U8TO32(m+12) >> 8) | hibit;
+				POLY1305_MULADD(t0, t1, t2, t3, t4, rn[i], sn[i]);
+				m += poly1305_block_size;
+			}
+
+			{
+				unsigned long long c;
+				POLY1305_CARRY_WIDE(h);
+			}
+			h0 = h[0];
+			h1 = h[1];
+			h2 = h[2];
+			h3 = h[3];
+			h4 = h[4];
+
+			bytes -= (POLY1305_DONNA32_WAYS * poly1305_block_size);
+		}
+	}
+#endif
+
 	while (bytes >= poly1305_block_size) {
 		/* h += m[i] */
 		h0 += (U8TO32(m+ 0)     ) & 0x3ffffff;
@@ -211,11 +330,13 @@ poly1305_finish(poly1305_context *ctx, unsigned char mac[16]) {
 	st->h[2] = 0;
 	st->h[3] = 0;
 	st->h[4] = 0;
-	st->r[0] = 0;
-	st->r[1] = 0;
-	st->r[2] = 0;
-	st->r[3] = 0;
-	st->r[4] = 0;
+	for (c = 0; c < POLY1305_DONNA32_WAYS; c++) {
+		st->r[c][0] = 0;
+		st->r[c][1] = 0;
+		st->r[c][2] = 0;
+		st->r[c][3] = 0;
+		st->r[c][4] = 0;
+	}
 	st->pad[0] = 0;
 	st->pad[1] = 0;
 	st->pad[2] = 0;
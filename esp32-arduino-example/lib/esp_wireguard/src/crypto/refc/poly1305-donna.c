@@ -1,7 +1,30 @@
 // Taken from https://github.com/floodyberry/poly1305-donna - public domain or MIT
 
 #include "poly1305-donna.h"
+
+#if defined(POLY1305_32BIT)
+#include "poly1305-donna-32.h"
+#elif defined(POLY1305_64BIT)
+#include "poly1305-donna-64.h"
+#else
+
+/* auto detect between 32bit / 64bit - 64 bit limbs need a native 64x64=128 multiply */
+#if defined(__SIZEOF_INT128__) && defined(__LP64__)
+#define POLY1305_HAS_64BIT_MUL 1
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define POLY1305_HAS_64BIT_MUL 1
+#endif
+
+#if defined(POLY1305_HAS_64BIT_MUL)
+#include "poly1305-donna-64.h"
+#else
 #include "poly1305-donna-32.h"
+#endif
+
+#endif
+
+/* poly1305_context must be able to hold whichever backend was picked */
+typedef char poly1305_context_size_check[(sizeof(poly1305_state_internal_t) <= sizeof(((poly1305_context *)0)->opaque)) ? 1 : -1];
 
 void
 poly1305_update(poly1305_context *ctx, const unsigned char *m, size_t bytes) {
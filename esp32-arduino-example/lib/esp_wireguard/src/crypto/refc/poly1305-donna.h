@@ -8,9 +8,10 @@ extern "C" {
 
 #include <stddef.h>
 
+/* large enough for the 4-way donna-32 state (precomputed r^1..r^4) even where unsigned long is 64 bits */
 typedef struct poly1305_context {
 	size_t aligner;
-	unsigned char opaque[136];
+	unsigned char opaque[264];
 } poly1305_context;
 
 void poly1305_init(poly1305_context *ctx, const unsigned char key[32]);
@@ -0,0 +1,52 @@
+// SipHash-2-4 - follows the reference implementation at https://github.com/veorq/SipHash
+
+#include "siphash.h"
+#include "../../crypto.h"
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND \
+	do { \
+		v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32); \
+		v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2; \
+		v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0; \
+		v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32); \
+	} while (0)
+
+uint64_t siphash24(const uint8_t *key, const void *in, size_t inlen) {
+	const uint8_t *p = (const uint8_t *)in;
+	const uint8_t *end = p + (inlen - (inlen % 8));
+	uint64_t k0 = U8TO64_LITTLE(key);
+	uint64_t k1 = U8TO64_LITTLE(key + 8);
+	uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+	uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+	uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+	uint64_t v3 = 0x7465646279746573ULL ^ k1;
+	uint64_t b = ((uint64_t)inlen) << 56;
+	uint64_t m;
+	int i;
+
+	for (; p != end; p += 8) {
+		m = U8TO64_LITTLE(p);
+		v3 ^= m;
+		SIPROUND;
+		SIPROUND;
+		v0 ^= m;
+	}
+
+	// Last 0-7 bytes, with the length in the top byte
+	for (i = 0; i < (int)(inlen % 8); i++) {
+		b |= ((uint64_t)p[i]) << (8 * i);
+	}
+	v3 ^= b;
+	SIPROUND;
+	SIPROUND;
+	v0 ^= b;
+
+	v2 ^= 0xff;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,21 @@
+// SipHash-2-4 (Aumasson & Bernstein, https://www.aumasson.jp/siphash/siphash.pdf)
+// A keyed hash for hash tables whose keys come from the network - see the public key index in wireguard.c
+#ifndef _SIPHASH_H_
+#define _SIPHASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIPHASH_KEY_SIZE 16
+
+uint64_t siphash24(const uint8_t *key, const void *in, size_t inlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SIPHASH_H_ */
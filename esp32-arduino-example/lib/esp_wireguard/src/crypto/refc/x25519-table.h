@@ -0,0 +1,671 @@
+// Precomputed comb table for x25519_base() - generated by tools/x25519_table.py, do not edit
+// 4 combs x 16 entries, 5 teeth spaced 13 bits apart (260 scalar bits)
+
+#define X25519_COMB_TEETH 5
+#define X25519_COMB_SPACING 13
+#define X25519_COMB_COUNT 4
+#define X25519_COMB_ENTRIES 16
+
+#if FE25519_LIMBS == 5
+static const x25519_niels x25519_comb_table[X25519_COMB_COUNT][X25519_COMB_ENTRIES] = {
+	{
+		{
+			{ 0x0647fcdf2ae99ULL, 0x74dcdca950159ULL, 0x3d64e3a821227ULL, 0x06350628d5243ULL, 0x280fa85f22fcbULL },
+			{ 0x067de91d9f931ULL, 0x77e4521bdb79eULL, 0x0f6c6c31e79ccULL, 0x63c0b402eda16ULL, 0x119e0bfcb6157ULL },
+			{ 0x59b9618f4e03cULL, 0x218145a232402ULL, 0x3add32f09fd15ULL, 0x27599c04b44e7ULL, 0x41cec428c31cdULL }
+		},
+		{
+			{ 0x4838e14e709f7ULL, 0x1cea592737412ULL, 0x2c0ac5edea182ULL, 0x702db8011aae4ULL, 0x459d297060b58ULL },
+			{ 0x78c79c2a19e82ULL, 0x5e85c449f181cULL, 0x4ef20f578b878ULL, 0x5675ba9c4f4c3ULL, 0x01ed9bd1b8e28ULL },
+			{ 0x1c7e9da76655aULL, 0x7b9020ba1d321ULL, 0x1074ecfc5b592ULL, 0x30086aacf99efULL, 0x794244dba0335ULL }
+		},
+		{
+			{ 0x13007a3f59f92ULL, 0x206f2b7f5deaaULL, 0x393c926222967ULL, 0x19bc6d85d9074ULL, 0x64aea355cb9fbULL },
+			{ 0x6735972550d9aULL, 0x01ee80969f8daULL, 0x0528192338814ULL, 0x1620069586121ULL, 0x7d4e8b6a2fde1ULL },
+			{ 0x0ac5a93b3ce24ULL, 0x316dfb44cef31ULL, 0x674461b429ebbULL, 0x040ee0bc5d166ULL, 0x738608e46ac93ULL }
+		},
+		{
+			{ 0x529a9ed341491ULL, 0x432f3a8c3b4bcULL, 0x0da947bb9a8adULL, 0x7ef85fb0a3c64ULL, 0x1ea1d24d41abfULL },
+			{ 0x045a25188f4cbULL, 0x4f1e5e8bc23efULL, 0x7e1ba7b30686cULL, 0x58b367cf87479ULL, 0x26d495e7cf928ULL },
+			{ 0x412de01cec358ULL, 0x5bb8500da223fULL, 0x1ffd58948b418ULL, 0x347469be0ea0bULL, 0x378d1a779505fULL }
+		},
+		{
+			{ 0x4b30e888c15d0ULL, 0x697168ea575aaULL, 0x13ea942655a8bULL, 0x5b4412442d30aULL, 0x1ea1feff1d782ULL },
+			{ 0x12226ad1cd34cULL, 0x0d07eec635413ULL, 0x6153d23eb7d86ULL, 0x7a781f011a9fdULL, 0x0f15f3fcb4fbdULL },
+			{ 0x6009abced4962ULL, 0x4ec61ab088addULL, 0x3bbe67e014e17ULL, 0x510324287dd0bULL, 0x57e8198e36ef4ULL }
+		},
+		{
+			{ 0x54cebe7892aaeULL, 0x4f1ae6ca48546ULL, 0x51357cbe9dfe7ULL, 0x428d25bcb6b28ULL, 0x155ee47a030ccULL },
+			{ 0x0fc4c83ace6a6ULL, 0x3575eceaeeffdULL, 0x3cd52a5bf414dULL, 0x0a32476212432ULL, 0x0f7845ed28b51ULL },
+			{ 0x777a39683ccd1ULL, 0x1a66c039adc1aULL, 0x547253561f1c1ULL, 0x1562379382280ULL, 0x00f5218c37ac2ULL }
+		},
+		{
+			{ 0x5bf453fdc9686ULL, 0x4577e46846b84ULL, 0x14edbc7de4af8ULL, 0x3fe6d101ae929ULL, 0x68b3985b90cfeULL },
+			{ 0x0f36a959a1f96ULL, 0x279f66114d0c0ULL, 0x7e6a3feafac66ULL, 0x101c5c4049fa8ULL, 0x49c5d48ba73f6ULL },
+			{ 0x05ce225a2d532ULL, 0x0fbe63d58633bULL, 0x54eb3a86ce98aULL, 0x026df2a33d277ULL, 0x427cbd8f0cb08ULL }
+		},
+		{
+			{ 0x7367dc2066394ULL, 0x36f89e9ccb7e7ULL, 0x0d59544711a17ULL, 0x217e667267158ULL, 0x2d41bf7856f46ULL },
+			{ 0x298b3dee9bb6dULL, 0x69bd6c429c17eULL, 0x7c2a22b4f283aULL, 0x62ee3b1808aa7ULL, 0x3466a1ab421d3ULL },
+			{ 0x1c447c4824f4fULL, 0x28d349bdd81c6ULL, 0x61e6a370e51d9ULL, 0x77d9100a4cf7eULL, 0x31b7ebdb017adULL }
+		},
+		{
+			{ 0x38233ed7b7fa6ULL, 0x6e09f4052b481ULL, 0x5a7df96c5c89bULL, 0x49df548a41e89ULL, 0x554943846ba40ULL },
+			{ 0x50db98f712e06ULL, 0x467a28b83e927ULL, 0x4037ce1e8a12eULL, 0x5fae27af2a597ULL, 0x6e79969ad3fc2ULL },
+			{ 0x2fc6092e1f05aULL, 0x2fcd7be5610a2ULL, 0x32f24872e60fdULL, 0x2d0ae44fbd3abULL, 0x37922b9fd8c20ULL }
+		},
+		{
+			{ 0x2ada466f14186ULL, 0x4a2fc83f183e7ULL, 0x35ae8f819274aULL, 0x44811c57b114bULL, 0x7064377d12054ULL },
+			{ 0x4d3ef1c753972ULL, 0x5a10ba0c396e0ULL, 0x33610146475b5ULL, 0x793aba16e4e6cULL, 0x735d935d5bcf1ULL },
+			{ 0x5a62d3f3a1bb2ULL, 0x1cbe4991b8c3cULL, 0x73c7deb41aef0ULL, 0x289005c39a3f5ULL, 0x69e3dd6d9ddcdULL }
+		},
+		{
+			{ 0x433234cf8cfadULL, 0x5eb7373c61bb1ULL, 0x3a7d367b29f4cULL, 0x769327e2cfd51ULL, 0x043394b07c821ULL },
+			{ 0x1d553c56d10abULL, 0x2d1e5f206c6cfULL, 0x765ce2e7e9de5ULL, 0x1d66c65394018ULL, 0x6d3d8b81329dcULL },
+			{ 0x5b5e12d7596c1ULL, 0x13b99cb94021cULL, 0x0f66b828c2d90ULL, 0x76d8a3562983dULL, 0x512db6e5897a8ULL }
+		},
+		{
+			{ 0x5c83352aa25d5ULL, 0x5fcded0ddffa2ULL, 0x02c63b9218d1cULL, 0x5c193f3018552ULL, 0x3512cdd2bdeceULL },
+			{ 0x2a7c9fbcc8a98ULL, 0x5f82edee22110ULL, 0x347dc9660f1d7ULL, 0x2cc07d6174208ULL, 0x6ae760bacf5d2ULL },
+			{ 0x02b97843f9ceeULL, 0x09588107ee816ULL, 0x7b30bdae39509ULL, 0x353c182ec8e6bULL, 0x4415b5e2ad52bULL }
+		},
+		{
+			{ 0x398a0ebafa92dULL, 0x6d0da10a5baf7ULL, 0x405f9aa4b0d32ULL, 0x307ce92c58001ULL, 0x77b61b2d33362ULL },
+			{ 0x4242255265c18ULL, 0x52a97bccd0e35ULL, 0x024fc52f37fedULL, 0x27a56fe25db3fULL, 0x0675a96c4a6f9ULL },
+			{ 0x21a5f03bb2377ULL, 0x24d588068bf13ULL, 0x1a12d6163769dULL, 0x270e829ffc387ULL, 0x2a12c23d004e0ULL }
+		},
+		{
+			{ 0x14102dcd304d5ULL, 0x77e6229d403daULL, 0x79caf8a3cdc67ULL, 0x0bd45c1c1ae67ULL, 0x3b438d5743f6dULL },
+			{ 0x4ec9cad150397ULL, 0x1a88eba1a6244ULL, 0x1f1b29fadb294ULL, 0x6630f2fa0b45bULL, 0x379bb78305c00ULL },
+			{ 0x6690e92b13c99ULL, 0x6473ab2b55ac2ULL, 0x607625038a771ULL, 0x5aacb5dff5b31ULL, 0x0ea7e5fb1fabcULL }
+		},
+		{
+			{ 0x559120e1c0af4ULL, 0x2126888bfca37ULL, 0x40920ad1dd15fULL, 0x7c08ab7188961ULL, 0x7f3f6705ed009ULL },
+			{ 0x3530d98b1f65fULL, 0x5b972a2622132ULL, 0x22dca79e4130aULL, 0x57b635dd344f0ULL, 0x7de553cc3073bULL },
+			{ 0x22b416027339dULL, 0x1f62f3f9d344dULL, 0x308d8be9b4cf9ULL, 0x5743950203105ULL, 0x6d13e7ba3d6b0ULL }
+		},
+		{
+			{ 0x0f08e05b7f4d1ULL, 0x68b895a8a2763ULL, 0x23fd56a24b384ULL, 0x5818dca27cb64ULL, 0x155e8f29999b3ULL },
+			{ 0x017bab1d30c7dULL, 0x2b0e53a3ee49dULL, 0x583ecde910bafULL, 0x57a9a99d79536ULL, 0x388cc42fd32b6ULL },
+			{ 0x430b89902faabULL, 0x47c4c82249504ULL, 0x6d3759681e5c8ULL, 0x5d8fe05dac85dULL, 0x3cda6f39c59d8ULL }
+		},
+	},
+	{
+		{
+			{ 0x7ae8bf8fb1aebULL, 0x0c8f4f9e0d17fULL, 0x1df9157704c57ULL, 0x195c607734963ULL, 0x78f63ba7c308eULL },
+			{ 0x61af7c78d6096ULL, 0x0fbc4e520d266ULL, 0x6291f9fb659b5ULL, 0x297c0717ca1bfULL, 0x1f82d458f6b00ULL },
+			{ 0x0cba97b9fa4a9ULL, 0x7865b90c65dfeULL, 0x6029b3fc2327bULL, 0x40c3bc0169addULL, 0x3ab6461f85af9ULL }
+		},
+		{
+			{ 0x6233b3cac19aeULL, 0x25e78445622cfULL, 0x340c9946172f4ULL, 0x3de1abafccd97ULL, 0x40b46561d8a64ULL },
+			{ 0x277a052995dc7ULL, 0x5c44d6064c54bULL, 0x4d1bbd8c59831ULL, 0x05d31e4254653ULL, 0x719666d8ca1d8ULL },
+			{ 0x23dc43c59e5ebULL, 0x773961595ae8dULL, 0x6fc53a52be3afULL, 0x32d36d7011337ULL, 0x29edcfc86123cULL }
+		},
+		{
+			{ 0x5ca1afdffa031ULL, 0x7ca718edbbc96ULL, 0x1d82f3ec199b5ULL, 0x5a45466816ed5ULL, 0x0f4e422091e4bULL },
+			{ 0x5d9e0ce97f032ULL, 0x5994f5db9695aULL, 0x5bded6f6167f9ULL, 0x33a0891ad7f9fULL, 0x410d11132bc0dULL },
+			{ 0x206888b6f7da7ULL, 0x6c3b97e258d92ULL, 0x6d57719ddcc6bULL, 0x388ba18e9f123ULL, 0x2b3756a22379cULL }
+		},
+		{
+			{ 0x68089a25e4a6dULL, 0x634134ec10b0aULL, 0x36dc77637d759ULL, 0x386bb9e31c22aULL, 0x34cc95c896c83ULL },
+			{ 0x15ea5d9bb4851ULL, 0x6f5e3ed313380ULL, 0x7e48f3e5171b9ULL, 0x15c8a0d6ef41fULL, 0x513c40e63b747ULL },
+			{ 0x6a5b9dc783884ULL, 0x3151e93c1eb9eULL, 0x5acd61764f96fULL, 0x499ab75f68afeULL, 0x6df5d2e100586ULL }
+		},
+		{
+			{ 0x0109f8e7892d2ULL, 0x611a7f216329dULL, 0x4112ecf4c98bcULL, 0x6212398c77d34ULL, 0x1c4dd886a3b32ULL },
+			{ 0x4f64ba9fac7edULL, 0x4aa78c0be2431ULL, 0x0f2d756f42165ULL, 0x7cf3c7ef3114eULL, 0x5b12571b76a18ULL },
+			{ 0x6261df5d79a9cULL, 0x3aa1ec9eb0683ULL, 0x34b18df912ba7ULL, 0x71770f235361fULL, 0x078726026ac7eULL }
+		},
+		{
+			{ 0x60a29388cb5fcULL, 0x7ab6270f0935aULL, 0x2304e3394fd9eULL, 0x32fa7262c29caULL, 0x57932baed26ebULL },
+			{ 0x77afd0899eb7fULL, 0x6a855a1b314ddULL, 0x6a5d8ee8152b1ULL, 0x431d6825880edULL, 0x32e2a15315416ULL },
+			{ 0x5043f0d7ea22dULL, 0x18d71f683eb6eULL, 0x7b548d982ed97ULL, 0x662c70b062c64ULL, 0x224e59353dee0ULL }
+		},
+		{
+			{ 0x1ee1ae817534fULL, 0x32d5ebed6fde3ULL, 0x5ce766115aea5ULL, 0x1027ec1e10fafULL, 0x624d03f469aedULL },
+			{ 0x561c98d0dbca9ULL, 0x36450bb517281ULL, 0x1f1a47cc958b2ULL, 0x6a66d0454488cULL, 0x12703a200ce95ULL },
+			{ 0x12929983385e8ULL, 0x61c493045988bULL, 0x5f4959ea04132ULL, 0x1b50bcb567c37ULL, 0x541acada2352fULL }
+		},
+		{
+			{ 0x19a717591a190ULL, 0x734b2a561b98aULL, 0x0d43fd90f0298ULL, 0x16a22491ed5b0ULL, 0x7dbef9813c85aULL },
+			{ 0x32e68f6cdf2b1ULL, 0x5168f6a8d481aULL, 0x093d19eadf771ULL, 0x3df9f242734f9ULL, 0x6a4349566bbacULL },
+			{ 0x19766cca16071ULL, 0x51e73b2eb9daeULL, 0x523054ad6663eULL, 0x2cb304e725fe6ULL, 0x377b892f65ce5ULL }
+		},
+		{
+			{ 0x346e8607557b2ULL, 0x1827e49abd7feULL, 0x158dbdabfb44cULL, 0x691b74a06c537ULL, 0x362f5dbaa54b6ULL },
+			{ 0x7b3fc2140bf92ULL, 0x3c22f661512b6ULL, 0x688cadc603eacULL, 0x2fff2416002d5ULL, 0x47d95c75b97edULL },
+			{ 0x090327ceaa982ULL, 0x141a10e6bb292ULL, 0x3e1fbdc063cdaULL, 0x3535bd83ad93bULL, 0x5245ded2321dfULL }
+		},
+		{
+			{ 0x293a6032cec0fULL, 0x5e99bb9f03d3fULL, 0x5afb77332b5ddULL, 0x163245ba30713ULL, 0x682e8f746efaeULL },
+			{ 0x53ab329aefef8ULL, 0x3987c921faf81ULL, 0x6392685f06d1bULL, 0x58e8a6e7259a4ULL, 0x30c910da332d6ULL },
+			{ 0x31d8f85a7d36fULL, 0x0b9d3c3cbc118ULL, 0x3f48fa18d7514ULL, 0x4d7e3d302aba7ULL, 0x02440439222c3ULL }
+		},
+		{
+			{ 0x3d23ea40f91ccULL, 0x6ee5e39c4b884ULL, 0x7f2536a61e4ccULL, 0x7dc49f29cccd5ULL, 0x5b8819e523febULL },
+			{ 0x76ccfb4ff9bc0ULL, 0x7f1605761714dULL, 0x323456af9b58bULL, 0x2b7b8b155d4dbULL, 0x07c0b63240486ULL },
+			{ 0x37f11ffa330d4ULL, 0x20418d852bf76ULL, 0x14ee7b13ad1cfULL, 0x165d8acfbd2a5ULL, 0x63873b453e717ULL }
+		},
+		{
+			{ 0x5b49d1b5088dfULL, 0x75e159cae5fe0ULL, 0x22430ade38867ULL, 0x1649b95369467ULL, 0x29b0b2255bf3fULL },
+			{ 0x74c1e7afa3c27ULL, 0x6d8c6ac6907deULL, 0x08d658801c994ULL, 0x3b7c1618abb3dULL, 0x2ca44f53cbff0ULL },
+			{ 0x09373c37e1fb6ULL, 0x00691cad354a8ULL, 0x6930c1291438dULL, 0x1381c2106c98fULL, 0x6a25055c9774aULL }
+		},
+		{
+			{ 0x6c4e5aaf9ad8dULL, 0x033ddc068778dULL, 0x5f0e64a02b20fULL, 0x666a4ddfab260ULL, 0x61eae9ca98e38ULL },
+			{ 0x4b5aafc41212eULL, 0x1a046c3cd401bULL, 0x434b7ce85bd54ULL, 0x5ec7186ebc376ULL, 0x4c6df93e9777aULL },
+			{ 0x58c36a414062dULL, 0x032124b7d0a86ULL, 0x77b212b1c9118ULL, 0x44bc285cb9c1cULL, 0x653c65cb91300ULL }
+		},
+		{
+			{ 0x1cf216d3f4c6cULL, 0x5b3037a877f56ULL, 0x4fdb5865e677eULL, 0x15918c3d4f365ULL, 0x178affdb4974cULL },
+			{ 0x38a90e93c080eULL, 0x5f80856407d7dULL, 0x54d76c95d2a54ULL, 0x0002b9112988dULL, 0x49572cc8a7ee1ULL },
+			{ 0x0bf4d7a8661eaULL, 0x008a644d6cad5ULL, 0x0f304faf62656ULL, 0x40bdfde65ab5cULL, 0x145ccd4d4afdbULL }
+		},
+		{
+			{ 0x3656e8b22cdaeULL, 0x3f182d2881223ULL, 0x02672eb9f9951ULL, 0x7af309310f783ULL, 0x0659a7541c500ULL },
+			{ 0x7c1bd4749d389ULL, 0x19a0c249b97caULL, 0x1f8242e49e805ULL, 0x24f810846e1c3ULL, 0x7b4fed40f21b6ULL },
+			{ 0x2e4152568a77aULL, 0x161555a3f5e2bULL, 0x6c5bb20820c06ULL, 0x514edab5909b0ULL, 0x4f060fb998610ULL }
+		},
+		{
+			{ 0x7062979295d0eULL, 0x1cee5f071095cULL, 0x7c6c8501563afULL, 0x243f757122afcULL, 0x4ae1cf74df582ULL },
+			{ 0x0f09828aa3bc8ULL, 0x005bb52312fd5ULL, 0x245dd5c0dc81aULL, 0x6b0240ac759cdULL, 0x2395bc737e1c8ULL },
+			{ 0x5a0c14eea716eULL, 0x160b2cacf9a59ULL, 0x12900936b87d7ULL, 0x7c3b750282f40ULL, 0x6fc957e1ec37eULL }
+		},
+	},
+	{
+		{
+			{ 0x74c4691ec29ffULL, 0x05191f4ffa5fbULL, 0x2b054237b1748ULL, 0x775669f2ce305ULL, 0x540e26f86b3b7ULL },
+			{ 0x221512c7383b8ULL, 0x49141924531f9ULL, 0x2c90386a123dfULL, 0x7109735aa110dULL, 0x2a1591860a033ULL },
+			{ 0x3155823e00ebfULL, 0x1029407c47616ULL, 0x2f6683366a33eULL, 0x0389922709bcbULL, 0x46fd42e165b1aULL }
+		},
+		{
+			{ 0x59b4859f88d50ULL, 0x709042dee17dbULL, 0x1ae5bfe021526ULL, 0x350c6d7241121ULL, 0x29da89a9665d4ULL },
+			{ 0x118491c668e61ULL, 0x73bc846f1d586ULL, 0x1a583179f00d7ULL, 0x3d2e642fdddeaULL, 0x5618a61bb2290ULL },
+			{ 0x14f8ec3f8b72aULL, 0x094a27152cdacULL, 0x35fbe651718daULL, 0x57dc5c4ad6151ULL, 0x446565b70517cULL }
+		},
+		{
+			{ 0x55523d343f48bULL, 0x0380a7f8e04c8ULL, 0x5849dd6ee9fa4ULL, 0x71623e72e16ceULL, 0x7dd251986d927ULL },
+			{ 0x68394cdc43b3cULL, 0x11d57223ccca5ULL, 0x1d77763ad6418ULL, 0x53f37a4c3497aULL, 0x1e4eb2398bb64ULL },
+			{ 0x3f408705a3aecULL, 0x439f0bf5ef8e8ULL, 0x5bef0e359c7dcULL, 0x2ec437e03a8eeULL, 0x1a2e3bf891df5ULL }
+		},
+		{
+			{ 0x0ff3df6b5e0d0ULL, 0x3644bcacb4450ULL, 0x535f543cd23c8ULL, 0x0fa3e05ec9b5cULL, 0x4905394ce869eULL },
+			{ 0x0c9f15849686dULL, 0x22515ad1efdc5ULL, 0x09b37e8b8276bULL, 0x3cced4eb86fb9ULL, 0x59291315ee42dULL },
+			{ 0x28cfd8784dda5ULL, 0x1e3c2c879c903ULL, 0x48f6ac3837906ULL, 0x24e3a9d14d0d7ULL, 0x72c1c1ae55edbULL }
+		},
+		{
+			{ 0x144ab13177103ULL, 0x5d67a2d6ba45bULL, 0x7775dd970af79ULL, 0x3e80aaa961479ULL, 0x7a8c3d6ecf58fULL },
+			{ 0x4525403b8f5dbULL, 0x663d63a8507cbULL, 0x336b9a7d23237ULL, 0x13cd1660d0892ULL, 0x6f90757e14c16ULL },
+			{ 0x31c56673e7aa3ULL, 0x66bce3dfb5ddaULL, 0x6713ea7c7e71fULL, 0x7fb22f4c9caadULL, 0x4d6150e4ac8e6ULL }
+		},
+		{
+			{ 0x29c94560912c2ULL, 0x643a77fb45f3aULL, 0x467308b20cebdULL, 0x47b36d50f02d3ULL, 0x6bc915ab2dd9bULL },
+			{ 0x3e8ffbca50a83ULL, 0x3c67c576cd1c3ULL, 0x04d6b481c9757ULL, 0x38f82121f4065ULL, 0x1e5ae7fdcdfe8ULL },
+			{ 0x4e87586f4204eULL, 0x0065071533242ULL, 0x7654e074a349fULL, 0x39aa93d04eab4ULL, 0x0a46651afb7d7ULL }
+		},
+		{
+			{ 0x12fb945e636e5ULL, 0x52197d9230b53ULL, 0x4dca7c37a102fULL, 0x66e1e47d2b043ULL, 0x205851ea2e055ULL },
+			{ 0x76b4ed0e75229ULL, 0x35cc297a4f226ULL, 0x214569e1626d6ULL, 0x26ad449cf468fULL, 0x42f686c8da2dcULL },
+			{ 0x2ba3d4ace9a39ULL, 0x28756387d5258ULL, 0x0f86b3b3ef288ULL, 0x3c05ed3a7431eULL, 0x620e79d6274ecULL }
+		},
+		{
+			{ 0x215011670288bULL, 0x67a9c9a366c7fULL, 0x6e4be60342b08ULL, 0x2ece77c32c475ULL, 0x62555d1501e98ULL },
+			{ 0x1b7558caf1348ULL, 0x2d015109fe470ULL, 0x791396d3c8a0aULL, 0x3ceac25d25d5aULL, 0x21a0799318e8cULL },
+			{ 0x36e211269f389ULL, 0x054504669fe09ULL, 0x2e53383f877b1ULL, 0x0388a2a52a6e0ULL, 0x0d7b18c6c249dULL }
+		},
+		{
+			{ 0x1300991672534ULL, 0x2269465a13ba3ULL, 0x00c584a14128cULL, 0x4ca797ce337edULL, 0x2f4176f5437f2ULL },
+			{ 0x5ec82e1ef9a0cULL, 0x60bdaf90a5a88ULL, 0x62a399f546c9aULL, 0x436cb5093343bULL, 0x4b19e4c2d38bdULL },
+			{ 0x570b67b770b69ULL, 0x20110f597caf8ULL, 0x4d77cff6f67e4ULL, 0x7d0a51a06c65aULL, 0x3a6097e21d951ULL }
+		},
+		{
+			{ 0x08ba7bff25330ULL, 0x6cbd19af90b6eULL, 0x7876c8d2bb345ULL, 0x1ac4de3c85f58ULL, 0x4ef06387272c7ULL },
+			{ 0x77ca7f1ea7bd1ULL, 0x61003150ca0b6ULL, 0x4615d200ba4c7ULL, 0x3e99a570f2198ULL, 0x47f73e5560e60ULL },
+			{ 0x5442053ea1807ULL, 0x6bb030e1e61bfULL, 0x64a8baeb03ba5ULL, 0x42a7585c8152cULL, 0x10791d5d8b529ULL }
+		},
+		{
+			{ 0x7c5ac1f1ceb59ULL, 0x0ce24e0f96180ULL, 0x0751b7eb4f13fULL, 0x0642a91b95611ULL, 0x19f12fb38f0a6ULL },
+			{ 0x27d9ec922db93ULL, 0x1cf0faca0154dULL, 0x68df81134c8dcULL, 0x264178fc5b914ULL, 0x7d30405abcf14ULL },
+			{ 0x351e604d07d06ULL, 0x30f79094e61e6ULL, 0x4c47d3202d2fdULL, 0x282a78a3b5f22ULL, 0x2513f421f104bULL }
+		},
+		{
+			{ 0x2451858a6c7d5ULL, 0x03c0344d99b9cULL, 0x19bde48826ea8ULL, 0x453ab6954c6a5ULL, 0x2902ff1e43084ULL },
+			{ 0x5f260b94befecULL, 0x3b4bfdd1b117bULL, 0x0aed8525b99d9ULL, 0x377a46d260985ULL, 0x07cc8741dbcb0ULL },
+			{ 0x57396cd52ab8aULL, 0x58d811c16ad02ULL, 0x09122de16bd93ULL, 0x28c70832c1c4aULL, 0x2ea0d953be5d4ULL }
+		},
+		{
+			{ 0x7f10381ccb0e8ULL, 0x43380a392a7aeULL, 0x40e54f8b71eeaULL, 0x062f018a7814fULL, 0x4acda26ff2973ULL },
+			{ 0x1b0efacf4145cULL, 0x20d0a340111a3ULL, 0x2f5c5b601bdb1ULL, 0x6d13717acff90ULL, 0x32bc643464961ULL },
+			{ 0x3a8b928342c6dULL, 0x291251b4bcf8aULL, 0x17910d8428a4fULL, 0x5ffd2c50f1ea4ULL, 0x27b297f94d9e6ULL }
+		},
+		{
+			{ 0x778a6b4406620ULL, 0x0efce314b15dcULL, 0x0039f3c0eb77cULL, 0x5ecf5f17d4abcULL, 0x2ff1c7d0d8836ULL },
+			{ 0x4c7f9035c3a73ULL, 0x59ec9037555d0ULL, 0x2a9a7e2cf2064ULL, 0x15d8d9d02e289ULL, 0x277fd7874c235ULL },
+			{ 0x25ce38270d5fdULL, 0x5251924df05b1ULL, 0x1c4945e896f77ULL, 0x7d4bb6130e185ULL, 0x54735f10699faULL }
+		},
+		{
+			{ 0x730809f3593d1ULL, 0x17f6328c51f8eULL, 0x55df9fbe41853ULL, 0x07dd50e040cd5ULL, 0x61b0d43652797ULL },
+			{ 0x78854e47c6937ULL, 0x5ce1f09f082a1ULL, 0x4137bdcb50be8ULL, 0x5d8bd026eb0c3ULL, 0x27b4cb6129a18ULL },
+			{ 0x13948ddb70958ULL, 0x1a63945dc8916ULL, 0x7b9c37660c1c9ULL, 0x0a5eca70616d4ULL, 0x1212cc59a72f6ULL }
+		},
+		{
+			{ 0x49282ad4f9e7dULL, 0x2d35d657e64e2ULL, 0x29f9393da3218ULL, 0x7f0c9c642a182ULL, 0x5933c42c6fac2ULL },
+			{ 0x6e681ff63f77cULL, 0x0350c42c85853ULL, 0x61c9936096c0eULL, 0x06d8bb1068ac0ULL, 0x25726cc895aceULL },
+			{ 0x27d854fecf8bcULL, 0x5fb95c3e08e8eULL, 0x130d606f48bd5ULL, 0x60536eee5b53cULL, 0x312b1cfdc95eaULL }
+		},
+	},
+	{
+		{
+			{ 0x1ffc44aca61c4ULL, 0x2741c79f0d3dcULL, 0x75b3c57b0e17dULL, 0x2c077bb02bacaULL, 0x14afec16b6793ULL },
+			{ 0x3db84c1557c0fULL, 0x469ae3e1c150aULL, 0x2574de5b58ec6ULL, 0x07b12ba237bf8ULL, 0x04a0a87142282ULL },
+			{ 0x743383366fcb1ULL, 0x5dc578410ff33ULL, 0x6441bb0e83d5fULL, 0x3006d1cf984c7ULL, 0x790989709ff3cULL }
+		},
+		{
+			{ 0x2600209169faaULL, 0x418550a508ea2ULL, 0x0c10979c31673ULL, 0x27b78bf7dc3c9ULL, 0x7d5d7721ba896ULL },
+			{ 0x37bebddfc61b0ULL, 0x2dfd5140269eeULL, 0x5ecda65bc2322ULL, 0x7d0c07ba06c90ULL, 0x1d7d20cdb5d11ULL },
+			{ 0x08eb4d8ad2f8dULL, 0x2f951cb5ebe9bULL, 0x20dcd734fc2e7ULL, 0x06427aef2dcd2ULL, 0x05639ad48ae2bULL }
+		},
+		{
+			{ 0x0b7e439f3091bULL, 0x07f083c98380aULL, 0x19247fd03cde6ULL, 0x71fd4ddbac118ULL, 0x32d802da82899ULL },
+			{ 0x60446b57ec60aULL, 0x54483bc1b8faaULL, 0x0714eab2a1a08ULL, 0x190d007ff393fULL, 0x25843c096986aULL },
+			{ 0x46d651d5b7ddcULL, 0x095d676e01be3ULL, 0x1781f5092a916ULL, 0x3baf4503f3bdeULL, 0x2b678917fce26ULL }
+		},
+		{
+			{ 0x7f99635e1f9b3ULL, 0x4cd5b340b5155ULL, 0x65df746efe3cfULL, 0x759ac8ccd60e9ULL, 0x58c2bd81f9cdeULL },
+			{ 0x0d1d1e01490bbULL, 0x4716359662bccULL, 0x1276ba16bbaacULL, 0x2f1592f55e671ULL, 0x474a3eef788caULL },
+			{ 0x140f83bbee260ULL, 0x158510de58266ULL, 0x34938c0afa540ULL, 0x29d6a90a90cadULL, 0x67caed99fa0e6ULL }
+		},
+		{
+			{ 0x7fe4ed47b4aa6ULL, 0x1f77ca94ff9a1ULL, 0x04d81827172f2ULL, 0x57200b9dec448ULL, 0x1fe04a6f14699ULL },
+			{ 0x5decd62e03d01ULL, 0x65ace5c24b054ULL, 0x1abe9819046dfULL, 0x568d8c6c7cd94ULL, 0x428e084526feaULL },
+			{ 0x01b02d7a3cee4ULL, 0x39bb872780945ULL, 0x76074b075b5d1ULL, 0x2f0b8e358670bULL, 0x1547cbb609882ULL }
+		},
+		{
+			{ 0x5db55cc98008cULL, 0x696b0289e4381ULL, 0x04c95dbf9e871ULL, 0x71756c00f171cULL, 0x6d8932bb1b7edULL },
+			{ 0x72f241917efadULL, 0x31d499b788bd0ULL, 0x48e3d9991c911ULL, 0x583b367706646ULL, 0x402cc24f8c7b5ULL },
+			{ 0x761f97821aa37ULL, 0x34a630b77cea0ULL, 0x30f8280a862ceULL, 0x02a91a793053cULL, 0x6402baa4a346cULL }
+		},
+		{
+			{ 0x1ae37463e73c7ULL, 0x28fe05dfa87ceULL, 0x789377097db38ULL, 0x67fbc0d95cdebULL, 0x6277eec53afffULL },
+			{ 0x7ef05d6c879b6ULL, 0x2e7faba58717bULL, 0x4f7e71a9541eeULL, 0x78e41f13c8a41ULL, 0x20b46f3842c52ULL },
+			{ 0x58ba09ac1aabbULL, 0x307efb720a774ULL, 0x2add429554b1cULL, 0x4c00fdda165d7ULL, 0x36ffca6786f61ULL }
+		},
+		{
+			{ 0x405d22ff62a50ULL, 0x03632148437d6ULL, 0x298e462f346faULL, 0x4d397c177705eULL, 0x64fd211eca8eaULL },
+			{ 0x68314e96b4cbcULL, 0x6a331002fab55ULL, 0x6cc33215ce27eULL, 0x4f8c61e2b23b1ULL, 0x6179aab73b6cdULL },
+			{ 0x13b79f9ead8ccULL, 0x5d6c624e6e700ULL, 0x069c6ca705c3cULL, 0x18cbf4ad88d71ULL, 0x7b181ad5b8bf9ULL }
+		},
+		{
+			{ 0x5fda929465cf0ULL, 0x3f227e14d9796ULL, 0x630d24b3baec8ULL, 0x0a817309380bfULL, 0x44106de565912ULL },
+			{ 0x7aaa4ed3ea7d4ULL, 0x424a01877030aULL, 0x0ae7d66efa16cULL, 0x2d956315fce32ULL, 0x0c56debadff21ULL },
+			{ 0x3d622c916407aULL, 0x74215dfc63eddULL, 0x486c86a8aa4e7ULL, 0x235c04dc5068cULL, 0x41f49367c9bacULL }
+		},
+		{
+			{ 0x3df77a34a4729ULL, 0x3cdf8c3c1823dULL, 0x1ca920f9decd8ULL, 0x0684aad4c20aaULL, 0x110eea9c8cde1ULL },
+			{ 0x7007c203796e5ULL, 0x0d42d078d1685ULL, 0x6b0806f8aeb71ULL, 0x7b9d94d2072d7ULL, 0x69c26bd4b9fb9ULL },
+			{ 0x0c83925ec3936ULL, 0x14fa0ce22ef3eULL, 0x6513183dbb73cULL, 0x034c351b5eff1ULL, 0x0270085ffb0e5ULL }
+		},
+		{
+			{ 0x7241834afab79ULL, 0x4ca6b5d82f2efULL, 0x75efb1b1d2d44ULL, 0x3b8a47cd9423aULL, 0x75b34dc472889ULL },
+			{ 0x0b624cbd68dddULL, 0x54786c04d474eULL, 0x28dcf0bd686ceULL, 0x1f995131e51a8ULL, 0x48a5fc725457eULL },
+			{ 0x471fae5aef117ULL, 0x12feaf5d801feULL, 0x391858f34e622ULL, 0x1af66d9c237d4ULL, 0x03422b6eba010ULL }
+		},
+		{
+			{ 0x30486b650002eULL, 0x35b5be6787361ULL, 0x4898478734c80ULL, 0x18b5deb57535dULL, 0x5fc4abc69763aULL },
+			{ 0x3235059401113ULL, 0x44d00c189547bULL, 0x7bceec7512e8aULL, 0x7d3aca4401dddULL, 0x29a567598e820ULL },
+			{ 0x0b30905f71673ULL, 0x13cd0a079d9d5ULL, 0x3523ec958ded5ULL, 0x6d599de95c72fULL, 0x2f04467bd4026ULL }
+		},
+		{
+			{ 0x75da38f45d11dULL, 0x5d1d9f4bf60ebULL, 0x4bbb3470e055bULL, 0x4385395ef38ebULL, 0x1884e85a6b63bULL },
+			{ 0x2c8594a62f1a2ULL, 0x18a51509d27a3ULL, 0x0d6ab61bc7a75ULL, 0x4c7f44ce05f17ULL, 0x17df032aab0efULL },
+			{ 0x2b8f0a4ea0c04ULL, 0x3b506cebae774ULL, 0x034dbf49eec4fULL, 0x23273e7ac4046ULL, 0x393fb0dbcf47bULL }
+		},
+		{
+			{ 0x28d40c3e95937ULL, 0x6e22150675a1bULL, 0x0539f1ee393c2ULL, 0x7659579db48f6ULL, 0x00833a35b819cULL },
+			{ 0x5b53cfd3df601ULL, 0x5e6e9dbaadd96ULL, 0x42b3d0c4d76fcULL, 0x0202f03c91961ULL, 0x0aa502fb1b21bULL },
+			{ 0x4fcf486737bcfULL, 0x1df134cfb0754ULL, 0x7acdd3a1eaed0ULL, 0x2ecaf08bdbbf3ULL, 0x0295440304aebULL }
+		},
+		{
+			{ 0x5d0ec9f1aa348ULL, 0x1a95a3b93b030ULL, 0x4dcd43daa2002ULL, 0x1b5c55128dab2ULL, 0x4a6879f90e25cULL },
+			{ 0x592ffe8643318ULL, 0x5829dea51acb1ULL, 0x16060ba65c4d7ULL, 0x481a14f0a8ef0ULL, 0x632d12d3481f8ULL },
+			{ 0x04fa21d529d65ULL, 0x01281ff7ae234ULL, 0x37318793fbc2cULL, 0x5e55c72a91ce6ULL, 0x266a76f836ecaULL }
+		},
+		{
+			{ 0x52577b11efd7bULL, 0x49d548a18bf17ULL, 0x0fe7b7c399f1cULL, 0x43277f6f4cc00ULL, 0x081852f18192dULL },
+			{ 0x7a95b191091a0ULL, 0x7535e44b29053ULL, 0x6dc38b7c00f6cULL, 0x5f82375ec2dcbULL, 0x5f58f219567a0ULL },
+			{ 0x46bb3f5e5dd09ULL, 0x375f966aeb112ULL, 0x54240ad1a5b4fULL, 0x083be86b8d826ULL, 0x678c95cc6a755ULL }
+		},
+	},
+};
+#else
+static const x25519_niels x25519_comb_table[X25519_COMB_COUNT][X25519_COMB_ENTRIES] = {
+	{
+		{
+			{ 32681625, 1646579, 43319641, 30634866, 42078759, 16094094, 42816067, 1627160, 32649163, 10501793 },
+			{ 31062321, 1701796, 29210526, 31428936, 52328908, 4043184, 3070486, 26149584, 63660375, 4618287 },
+			{ 16048188, 23520646, 35857410, 8783126, 50986261, 15430859, 4932839, 10315376, 42742221, 17251088 }
+		},
+		{
+			{ 15141367, 18932613, 41120786, 7580004, 48144770, 11545367, 1157860, 29406944, 50727768, 18248869 },
+			{ 44146306, 31661680, 10426396, 24778513, 24688760, 20695101, 29684931, 22664938, 18583080, 505455 },
+			{ 41313626, 7469686, 60936993, 32391298, 63288722, 4314035, 47159791, 12591530, 28967733, 31787283 }
+		},
+		{
+			{ 66428818, 4981224, 66444970, 8502445, 35793255, 15004233, 6131828, 6746550, 22854139, 26393229 },
+			{ 39128474, 27055708, 23722202, 506370, 36931604, 1351780, 22569249, 5799962, 44236257, 32848429 },
+			{ 62115364, 2823844, 5041969, 12957677, 54697659, 27070854, 63295846, 1063810, 38186131, 30283811 }
+		},
+		{
+			{ 20190353, 21654139, 12825788, 17612010, 62498989, 3581214, 51002468, 33284478, 13900479, 8030025 },
+			{ 25752779, 1140884, 12329967, 20740474, 53504108, 33058462, 16282745, 23252383, 41744680, 10179159 },
+			{ 30327640, 17086336, 14295615, 24043840, 21541912, 8385890, 65071627, 13750694, 58282079, 14562409 }
+		},
+		{
+			{ 9180624, 19710882, 44397994, 27641251, 40196747, 5220944, 4379402, 23924809, 66180994, 8030203 },
+			{ 18666316, 4753835, 6509587, 3415995, 65764742, 25513800, 1157629, 32104572, 63655869, 3954639 },
+			{ 15550818, 25175727, 50891485, 20650090, 33639959, 15661471, 42458379, 21236880, 14905076, 23044198 }
+		},
+		{
+			{ 59321006, 22231801, 10782022, 20736923, 65658855, 21288434, 63662888, 17446038, 60829900, 5602193 },
+			{ 61662886, 4133664, 45019133, 14014387, 29311309, 15946921, 35726386, 2672925, 47352657, 4055319 },
+			{ 42192081, 31320293, 60480538, 6920960, 23196097, 22137165, 20456064, 5605598, 12810946, 251014 }
+		},
+		{
+			{ 64788102, 24105295, 42232708, 18210705, 64899832, 5486321, 1763625, 16751428, 28904702, 27446881 },
+			{ 26877846, 3988133, 18141376, 10386840, 45067366, 33138943, 303016, 4223345, 12219382, 19339090 },
+			{ 27448626, 1521801, 22569787, 4127119, 7137674, 22260970, 36950647, 636874, 15780616, 17429238 }
+		},
+		{
+			{ 33973140, 30252912, 30193639, 14410362, 7412247, 3499345, 52851032, 8780185, 59076422, 11863805 },
+			{ 48872301, 10890487, 2736510, 27719089, 55519290, 32549002, 25201319, 25934060, 45359571, 13736582 },
+			{ 8539983, 7410161, 64848326, 10702118, 51270105, 25664141, 10801022, 31417408, 28317613, 13033391 }
+		},
+		{
+			{ 24870822, 14716155, 5420161, 28846032, 46516379, 23721957, 10755721, 19365202, 4635200, 22357262 },
+			{ 57748998, 21196387, 58976551, 18475170, 32022830, 16834360, 49456535, 25082014, 28131266, 28960346 },
+			{ 48361562, 12523556, 39194786, 12531183, 53371133, 13355297, 16503723, 11807633, 33393696, 14567598 }
+		},
+		{
+			{ 49365382, 11233561, 66159591, 19447584, 1648458, 14072382, 24842571, 17958001, 64036948, 29462749 },
+			{ 7682418, 20249543, 12818144, 23610088, 6583733, 13468677, 24006252, 31779560, 30784753, 30242381 },
+			{ 54139826, 23694159, 18582588, 7534886, 54636272, 30351226, 3777525, 10633239, 47832525, 27758453 }
+		},
+		{
+			{ 16306093, 17615059, 63314865, 24829148, 62037836, 15332569, 36502865, 31083679, 50841633, 1101394 },
+			{ 23924907, 7689457, 33998543, 11827580, 41852389, 31028107, 20529176, 7707417, 1255900, 28636718 },
+			{ 24483521, 23951435, 60031516, 5170802, 42741136, 4037344, 23238717, 31154829, 39360424, 21280475 }
+		},
+		{
+			{ 44705237, 24251604, 14548898, 25114548, 18976028, 727278, 50431314, 24143100, 19652302, 13912887 },
+			{ 63736472, 11137662, 48374032, 25037751, 39907799, 13760293, 35078664, 11731445, 61666770, 28024194 },
+			{ 4168942, 714209, 8316950, 2449924, 48469257, 32293622, 49057387, 13955168, 36361515, 17848023 }
+		},
+		{
+			{ 61843757, 15083578, 10861303, 28587652, 38473010, 16875114, 46497793, 12710820, 47395682, 31381612 },
+			{ 19291160, 17369237, 13438517, 21669359, 49512429, 605972, 36035391, 10393023, 46442233, 1693349 },
+			{ 62595959, 8820672, 6864659, 9655840, 23295645, 6835032, 33538951, 10238474, 63964384, 11029256 }
+		},
+		{
+			{ 13829333, 5259447, 30671834, 31430794, 37543015, 31927266, 29470311, 3101040, 24395629, 15535669 },
+			{ 18154391, 20653867, 35283524, 6955950, 61715092, 8154279, 60863579, 26788811, 3169280, 14577374 },
+			{ 45169817, 26887076, 45439682, 26332844, 3712881, 25286804, 33512241, 23769815, 61995708, 3841943 }
+		},
+		{
+			{ 35392244, 22430851, 12569143, 8690210, 18731359, 16926763, 51939681, 32514733, 6213641, 33357212 },
+			{ 11662943, 13943654, 39985458, 24009896, 31724298, 9138846, 30622960, 22993111, 12781371, 33002831 },
+			{ 2569117, 9097304, 60634189, 8227791, 43732217, 12727855, 2109701, 22875732, 61068976, 28594078 }
+		},
+		{
+			{ 28832977, 3941249, 42608483, 27451990, 35959684, 9434458, 36162404, 23094130, 43620787, 5601852 },
+			{ 30608509, 388780, 37676189, 11286862, 43060143, 23132983, 30905654, 22980262, 50148022, 14824208 },
+			{ 16972459, 17575462, 35951876, 18813728, 42067400, 28630373, 31115357, 24526721, 60578264, 15952316 }
+		},
+	},
+	{
+		{
+			{ 16456427, 32219902, 31510911, 3292478, 57691223, 7857237, 57887075, 6648193, 41693326, 31709422 },
+			{ 59596950, 25607665, 18928230, 4124985, 62282165, 25839591, 24945087, 10874908, 26176256, 8260433 },
+			{ 60794025, 3336798, 13000190, 31561444, 63058555, 25208527, 1481437, 16977648, 33053433, 15391000 }
+		},
+		{
+			{ 11278766, 25743055, 5645007, 9936401, 6386420, 13644389, 50122135, 16221870, 35490404, 16961941 },
+			{ 43605447, 10348564, 6604107, 24187736, 12949553, 20213494, 2442835, 1526905, 25993688, 29776283 },
+			{ 5891563, 9400591, 26586765, 31253893, 19653551, 29299945, 50402103, 13323701, 8786492, 10991423 }
+		},
+		{
+			{ 33529905, 24282815, 47955094, 32676963, 46242229, 7736271, 42036949, 23663897, 34152011, 4012296 },
+			{ 43511858, 24541235, 28928346, 23483351, 56715257, 24083291, 28147615, 13533732, 20102157, 17052740 },
+			{ 57638311, 8495650, 36015506, 28372575, 31313003, 28663238, 15331619, 14823046, 35796892, 11328858 }
+		},
+		{
+			{ 39733869, 27271784, 46205706, 26019027, 37214041, 14381533, 36815402, 14790375, 9006211, 13840983 },
+			{ 29050961, 5745014, 20001664, 29194491, 38891961, 33104847, 24048671, 5710467, 40089415, 21295363 },
+			{ 7878788, 27881079, 63040414, 12928932, 56949103, 23803269, 32934654, 19294941, 34604422, 28825419 }
+		},
+		{
+			{ 41456338, 272355, 35009181, 25455100, 55351484, 17058739, 13073716, 25708774, 6961970, 7419746 },
+			{ 33212397, 20812522, 12461105, 19570224, 49553765, 3978709, 49484110, 32755487, 28797464, 23873884 },
+			{ 30907036, 25790333, 32179843, 15370162, 59845543, 13813303, 37041695, 29744188, 2534526, 1973400 }
+		},
+		{
+			{ 9221628, 25332302, 15766362, 32168092, 60095902, 9180044, 36448714, 13363657, 49096427, 22957230 },
+			{ 10087295, 31375170, 28513501, 27923816, 42029745, 27883067, 39354605, 17593760, 20010006, 13339269 },
+			{ 25076269, 21041091, 42199918, 6511741, 25357719, 32330294, 50736228, 26784194, 55828192, 8993124 }
+		},
+		{
+			{ 1528655, 8095418, 47644131, 13326255, 18198181, 24354200, 31526831, 4235184, 54958829, 25768975 },
+			{ 17677481, 22573667, 55669377, 14226478, 13195442, 8153375, 5523596, 27892545, 33607317, 4833512 },
+			{ 3376616, 4868710, 4561035, 25629260, 44056882, 24978791, 55999543, 7160562, 27407663, 22047531 }
+		},
+		{
+			{ 26321296, 6724701, 23181706, 30223529, 17760920, 3477494, 18798000, 5933202, 1296474, 32963558 },
+			{ 47051441, 13343293, 42813466, 21341146, 44955505, 2421863, 2569465, 16246729, 23509932, 27856165 },
+			{ 10575985, 6674867, 48995758, 21470444, 47605310, 21545298, 41050086, 11717651, 49700069, 14544420 }
+		},
+		{
+			{ 7690162, 13744664, 28039166, 6332306, 46117964, 5650166, 33998135, 27553234, 61494454, 14204278 },
+			{ 21020562, 32309000, 34935478, 15764441, 6307500, 27407031, 23069397, 12582032, 56334317, 18834801 },
+			{ 15378818, 2362527, 40612498, 5269571, 408794, 16285431, 3856699, 13948662, 19079647, 21567355 }
+		},
+		{
+			{ 53275663, 10807680, 32521535, 24798958, 53655005, 23850460, 61015827, 5818646, 54980526, 27310653 },
+			{ 28245752, 21933258, 35630977, 15081252, 32533787, 26102177, 41048484, 23306907, 27472598, 12788803 },
+			{ 27775855, 13067233, 63684888, 3044592, 26047764, 16589800, 50506663, 20314356, 59908803, 593936 }
+		},
+		{
+			{ 1020364, 16027561, 29669508, 29071246, 39969996, 33330394, 43830485, 32969340, 38944747, 23994471 },
+			{ 16751552, 31142893, 56717645, 33314837, 49919371, 13160794, 22402267, 11398700, 52692102, 2032344 },
+			{ 61026516, 14664831, 5422966, 8455734, 20632015, 5487084, 16503461, 5862955, 5498647, 26090733 }
+		},
+		{
+			{ 55609567, 23930694, 11427808, 30901607, 31688807, 8981547, 20354151, 5842661, 39173951, 10928840 },
+			{ 49953831, 30607262, 6883294, 28717483, 117140, 2316642, 25869117, 15593560, 20758512, 11702589 },
+			{ 58597302, 2415856, 47404200, 107634, 43074445, 27575044, 17222031, 5113608, 29980490, 27825173 }
+		},
+		{
+			{ 49917325, 28391786, 6846349, 849776, 33731087, 24918418, 33206880, 26847543, 11111992, 25668519 },
+			{ 4268334, 19753663, 63782939, 6820272, 42319188, 17640947, 49005430, 24845409, 65632122, 20035556 },
+			{ 1312301, 23268777, 58526342, 820370, 52203800, 31377482, 30120988, 18018465, 12129024, 26538391 }
+		},
+		{
+			{ 20925548, 7587931, 42434390, 23904478, 39741310, 20933985, 64287589, 5654064, 28612428, 6171647 },
+			{ 20711438, 14853178, 37780861, 25035285, 22882900, 22240690, 17995917, 2788, 9076449, 19225779 },
+			{ 42361322, 3134302, 14076629, 141713, 49686102, 3981630, 40217436, 16971767, 13938651, 5337909 }
+		},
+		{
+			{ 52612526, 14244770, 42471971, 16539828, 60791121, 629946, 51443587, 32230436, 21087488, 1664669 },
+			{ 55169929, 32534353, 10196938, 6718217, 38397957, 8259851, 4645315, 9691202, 991670, 32325557 },
+			{ 23635834, 12125513, 37707307, 5789014, 8522758, 28405448, 56166832, 21314410, 60392976, 20715582 }
+		},
+		{
+			{ 19488014, 29461086, 7407964, 7584124, 1401775, 32616980, 51522300, 9502165, 55440770, 19629885 },
+			{ 11156424, 3941898, 36777941, 93908, 903194, 9533271, 46619085, 28051714, 53993928, 9328369 },
+			{ 48918894, 23605331, 47159897, 5778610, 57378775, 4866084, 2633536, 32566740, 35570558, 29304159 }
+		},
+	},
+	{
+		{
+			{ 32254463, 30609828, 16754171, 1336445, 58398536, 11277576, 53273349, 31283623, 59159479, 22034587 },
+			{ 7570360, 8934475, 38089209, 19157092, 44114911, 11682017, 27922701, 29631949, 6332467, 11032134 },
+			{ 65015487, 12932616, 63206934, 4236545, 57058110, 12425740, 40934347, 927304, 35019546, 18609419 }
+		},
+		{
+			{ 33066320, 23515670, 32380891, 29507851, 33690918, 7051007, 52695329, 13906357, 43410900, 10971686 },
+			{ 6721121, 4592199, 49403270, 30339601, 60752087, 6906053, 50191850, 16038288, 29041296, 22569624 },
+			{ 66631466, 5497776, 22203820, 2435228, 18290906, 14151577, 11362641, 23032177, 57692540, 17929622 }
+		},
+		{
+			{ 54785163, 22366452, 59638984, 918175, 49192868, 23144309, 53352142, 29722873, 25614631, 32983366 },
+			{ 29637436, 27321651, 37538981, 4675016, 61695000, 7724504, 12798330, 22007273, 60341092, 7944904 },
+			{ 5913324, 16581148, 56555752, 17726511, 56215516, 24099896, 33794286, 12259551, 59317749, 6863087 }
+		},
+		{
+			{ 45474000, 4181885, 46875728, 14226162, 63775688, 21855568, 32283484, 4099969, 13534878, 19141861 },
+			{ 4810861, 3308630, 18808261, 8996203, 12068715, 2543098, 45641657, 15940435, 22996013, 23372876 },
+			{ 59039141, 10698593, 7981315, 7925938, 58947846, 19126960, 18141399, 9670311, 48586459, 30082822 }
+		},
+		{
+			{ 51867907, 5319364, 23831643, 24485515, 24162169, 31315830, 43390073, 16384682, 49083791, 32125173 },
+			{ 62453211, 18126080, 42272715, 26801550, 64107063, 13479529, 34408594, 5190745, 65096726, 29245909 },
+			{ 54426275, 13047193, 33250778, 26932111, 63432479, 27021225, 13224621, 33474749, 38455526, 20284739 }
+		},
+		{
+			{ 34149058, 10954005, 62152506, 26274271, 52481725, 18467874, 17760979, 18795957, 45276571, 28255318 },
+			{ 10816131, 16400367, 57463235, 15834901, 1873751, 1268434, 35602533, 14934148, 64806888, 7957407 },
+			{ 49553486, 20585825, 22229570, 103452, 55194783, 31019905, 17099444, 15116879, 28293079, 2693524 }
+		},
+		{
+			{ 31864549, 4976209, 19073875, 21521910, 58331183, 20392432, 64139331, 26970001, 44228693, 8479047 },
+			{ 15159849, 31118260, 61141542, 14102693, 35006166, 8721831, 30361231, 10138898, 9282268, 17553947 },
+			{ 47094329, 11439954, 8213080, 10605966, 54456968, 4070094, 61293342, 15734708, 23229676, 25704935 }
+		},
+		{
+			{ 40904843, 8732741, 37121151, 27174694, 3418888, 28913560, 3327093, 12270047, 22027928, 25777524 },
+			{ 11473736, 7198051, 10478704, 11797828, 20744714, 31739483, 30563674, 15969033, 20024972, 8815078 },
+			{ 40498057, 14387268, 40500745, 1381393, 66615217, 12143840, 38971104, 926346, 7087261, 3533923 }
+		},
+		{
+			{ 23536948, 4981348, 27343779, 9020697, 34869900, 202258, 14890989, 20094559, 55850994, 12387803 },
+			{ 32479756, 24846520, 17455752, 25360062, 55864474, 25857639, 9647163, 17674964, 2963645, 19687315 },
+			{ 58133353, 22818206, 26725112, 8406077, 57632740, 20307775, 33998426, 32778566, 35772753, 15303263 }
+		},
+		{
+			{ 66212656, 2288111, 49875822, 28505190, 19641157, 31578915, 63463256, 7017336, 7500487, 20693390 },
+			{ 32144337, 31402492, 17604790, 25428165, 763079, 18372424, 51323288, 16410261, 22416992, 18865401 },
+			{ 65673223, 22087700, 35545535, 28229827, 45104037, 26387179, 29889836, 17472865, 30979369, 4318325 }
+		},
+		{
+			{ 52226905, 32598791, 16343424, 3377464, 45412671, 1918687, 28923409, 1641124, 54063270, 6800574 },
+			{ 19061651, 10446770, 10491213, 7586795, 20236508, 27491844, 63289620, 10028515, 28036884, 32817409 },
+			{ 13663494, 13924737, 21914086, 12836418, 33739517, 19996492, 37445410, 10529250, 35590219, 9719760 }
+		},
+		{
+			{ 10930133, 9520662, 14261148, 983249, 8548008, 6748050, 22333093, 18148058, 31731844, 10750972 },
+			{ 21753836, 24942638, 18551163, 15544311, 39557593, 2864660, 19270021, 14543131, 1948848, 2044445 },
+			{ 22195082, 22865331, 1486082, 23289927, 35044755, 2377911, 53222474, 10689568, 20702676, 12223333 }
+		},
+		{
+			{ 30191848, 33308896, 59942830, 17621032, 12001002, 17012030, 10977615, 1620998, 50276723, 19609225 },
+			{ 15995996, 7093227, 70051, 8602253, 33668529, 12415341, 61669264, 28593605, 54937953, 13300112 },
+			{ 3419245, 15347274, 55299978, 10766662, 4360783, 6177846, 17768100, 25162929, 60086758, 10406495 }
+		},
+		{
+			{ 4220448, 31336877, 21698012, 3928972, 964476, 59343, 24988348, 24853884, 17664054, 12568351 },
+			{ 56375923, 20053568, 58021328, 23573056, 47128676, 11168248, 16966281, 5727079, 7651893, 10354526 },
+			{ 40949245, 9910496, 14615985, 21579337, 42561399, 7415063, 19980677, 32845528, 17209850, 22138236 }
+		},
+		{
+			{ 53842897, 30154791, 12918670, 6281418, 65280083, 22511230, 33819861, 2061635, 56960919, 25609040 },
+			{ 8153399, 31593785, 32539297, 24348610, 11865064, 17096439, 40808643, 24522560, 34773528, 10408749 },
+			{ 28772696, 5132855, 31230230, 6917713, 39895497, 32403677, 50730708, 2718505, 26899190, 4737841 }
+		},
+		{
+			{ 21995133, 19177643, 25060578, 11851609, 64631320, 11003108, 37921154, 33305201, 46594754, 23383824 },
+			{ 56883068, 28942463, 46684243, 869136, 34171918, 25634381, 17205952, 1794796, 9001678, 9816499 },
+			{ 65861820, 10445139, 65048206, 25093488, 49581013, 4994433, 48608572, 25251259, 64787946, 12889203 }
+		},
+	},
+	{
+		{
+			{ 46817732, 8384786, 32560092, 10290974, 61923709, 30854933, 50510538, 11541998, 23816083, 5423024 },
+			{ 22379535, 16179504, 35394826, 18508687, 28675782, 9819001, 35879928, 2016430, 51651202, 1213089 },
+			{ 57081009, 30461452, 1113907, 24581601, 15220063, 26281708, 16352455, 12589895, 50986812, 31729189 }
+		},
+		{
+			{ 18259882, 9961602, 38833826, 17175874, 29562483, 3162718, 58573769, 10411567, 35367062, 32863708 },
+			{ 33317296, 14613239, 158190, 12055877, 29106978, 24852121, 60845200, 32780318, 14376209, 7730307 },
+			{ 11349901, 2338102, 56540827, 12473458, 55558887, 8614748, 49470674, 1640939, 21540395, 1412715 }
+		},
+		{
+			{ 32704795, 3012878, 9975818, 2081295, 17026534, 6590975, 29016344, 29881655, 27797657, 13328395 },
+			{ 25085450, 25235885, 1806250, 22094063, 53090824, 1856426, 67057983, 6566913, 9869418, 9834736 },
+			{ 22773212, 18569543, 48241635, 2454941, 9611542, 6162388, 4144094, 15645972, 25153062, 11378212 }
+		},
+		{
+			{ 31586739, 33449357, 741717, 20141773, 49275855, 26705361, 13459689, 30829347, 2071774, 23268086 },
+			{ 1347771, 3437688, 23473100, 18634966, 23837356, 4840168, 55961201, 12342859, 49776842, 18688251 },
+			{ 62841440, 5258766, 31818342, 5641283, 11511104, 13782576, 11078829, 10967716, 27238630, 27208630 }
+		},
+		{
+			{ 8080038, 33526709, 22018465, 8249130, 40989426, 1269856, 31376456, 22839342, 49366681, 8356137 },
+			{ 48250113, 24621912, 2404436, 26653591, 26232543, 7010912, 46648724, 22689329, 5402602, 17446945 },
+			{ 61066980, 442549, 41421125, 15134236, 7714257, 30940460, 56125195, 12332600, 56662146, 5578542 }
+		},
+		{
+			{ 9961612, 24565107, 10371969, 27634698, 66709617, 1254774, 988956, 29742512, 61978605, 28714186 },
+			{ 18345901, 30132486, 58231760, 13062758, 26331409, 19107686, 57697862, 23129305, 16304053, 16823049 },
+			{ 2206263, 30965342, 58183328, 13801666, 11035342, 12837024, 59966780, 697449, 38417516, 26217194 }
+		},
+		{
+			{ 37647303, 7048657, 33195982, 10745879, 9952056, 31608284, 26594795, 27258627, 5484543, 25812923 },
+			{ 46692790, 33276277, 39350651, 12189358, 43336174, 20838854, 20744769, 31690876, 58993746, 8573372 },
+			{ 46246587, 23259174, 52471668, 12712941, 22367004, 11236618, 27354583, 19923959, 41447265, 14417705 }
+		},
+		{
+			{ 66464336, 16872587, 8665046, 887941, 49497850, 10893592, 24604766, 20243952, 32286954, 26473604 },
+			{ 23809212, 27313466, 3124053, 27839552, 22864510, 28511432, 36381617, 20853127, 57915085, 25552554 },
+			{ 32168140, 5168766, 15132416, 24490377, 40918076, 1733042, 47746417, 6500306, 22776825, 32268395 }
+		},
+		{
+			{ 21388528, 25127498, 21862294, 16550392, 54243016, 25965714, 9666751, 2753996, 39213330, 17842615 },
+			{ 20883412, 32155963, 7799562, 17377286, 49258860, 2858841, 23055922, 11949452, 61734689, 3234682 },
+			{ 18235514, 16091314, 63323869, 30442871, 42640615, 18985498, 29689484, 9269267, 41720748, 17289805 }
+		},
+		{
+			{ 55199529, 16244200, 63013437, 15957552, 60681432, 7513219, 21766314, 1708715, 29937121, 4471722 },
+			{ 3643109, 29368072, 59577989, 3476289, 59435889, 28057627, 18903767, 32405075, 21733305, 27724207 },
+			{ 32258358, 3280457, 35843902, 5498931, 64730940, 26496096, 28700657, 864468, 33534181, 639009 }
+		},
+		{
+			{ 11512697, 29951501, 25359087, 20093655, 52243780, 30916294, 14238266, 15608095, 4663433, 30854455 },
+			{ 64392669, 2984242, 5064526, 22143408, 64390862, 10712002, 52318632, 8283460, 52774270, 19044337 },
+			{ 28242199, 18644665, 30933502, 4979389, 53798434, 14967139, 29505492, 7068086, 48996368, 854189 }
+		},
+		{
+			{ 38797358, 12657069, 41448289, 14079737, 7556224, 19030302, 56054621, 6477690, 6911546, 25105071 },
+			{ 20975891, 13161494, 25777275, 18038832, 55651978, 32455601, 4201949, 32828201, 26798112, 10917277 },
+			{ 32970355, 2933313, 7985621, 5190696, 22601429, 13930418, 43370287, 28665463, 62734374, 12325145 }
+		},
+		{
+			{ 54907165, 30894307, 12542187, 24409725, 51250523, 19852497, 32454891, 17700069, 27702843, 6427553 },
+			{ 40038818, 11671122, 10299299, 6460500, 29129333, 3517144, 14704407, 20053267, 44740847, 6257676 },
+			{ 15338500, 11418665, 45803380, 15548851, 10415183, 866045, 61620294, 9215225, 29160571, 15007427 }
+		},
+		{
+			{ 65624375, 10702896, 6773275, 28870740, 48468930, 1370055, 31148278, 31024478, 56328604, 134376 },
+			{ 20837889, 23940927, 61529494, 24754806, 5076732, 17485635, 63510881, 527296, 61977115, 2790411 },
+			{ 41122767, 20921633, 16451412, 7849171, 35565264, 32192334, 12434419, 12266434, 3164907, 677136 }
+		},
+		{
+			{ 52077384, 24394535, 60010544, 6968974, 27926530, 20395279, 19454642, 7172436, 59826780, 19505639 },
+			{ 6566680, 23379962, 38907057, 23111546, 40223959, 5773358, 51023600, 18901075, 20218360, 25998411 },
+			{ 22191461, 1304711, 58384948, 303231, 20954156, 14468638, 44637414, 24729372, 58945226, 10070491 }
+		},
+		{
+			{ 18808187, 21585388, 35176215, 19354914, 3776284, 4169439, 49597440, 17604093, 51910957, 2122059 },
+			{ 17863072, 32134854, 11702355, 30726033, 62918508, 28773933, 32255435, 25037021, 26568608, 24994760 },
+			{ 31841545, 18541821, 45003026, 14515801, 18504527, 22057003, 45668390, 2158497, 13018965, 27144791 }
+		},
+	},
+};
+#endif
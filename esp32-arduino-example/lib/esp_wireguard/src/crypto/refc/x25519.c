@@ -0,0 +1,331 @@
+// X25519 (RFC 7748) without libsodium
+//
+// Two field backends share the code below, picked at build time (see crypto.h):
+//  fe25519-32.h - 10 limbs of 25.5 bits, 32x32=64 bit multiplies (ESP32 and other 32-bit MCUs)
+//  fe25519-64.h - 5 limbs of 51 bits, 64x64=128 bit multiplies (64-bit hosts)
+//
+// x25519() is the usual constant-time Montgomery ladder.
+//
+// x25519_base() is X25519(k, 9), i.e. the Montgomery u coordinate of k*B where B is the Edwards25519 base point. The
+// scalar multiplication is done on the Edwards curve against a precomputed comb table (x25519-table.h, generated by
+// tools/x25519_table.py) and the result converted with u = (1+y)/(1-y).
+// Scalar recoding: k is replaced by m = k + L (L = group order, so m*B = k*B) which is odd, and m is written in signed
+// binary m = sum(s_i * 2^i), s_i in {-1,+1}, using the bits of m' = (m + 2^n - 1)/2. Every comb column is then a
+// non-zero sum of +/-2^j*B, so each column costs exactly one table lookup and one mixed addition - no identity or
+// zero-digit special cases. The lookup scans the whole comb and the sign is applied with a conditional swap/negate,
+// so the sequence of operations and memory accesses does not depend on the private key.
+
+#include "x25519.h"
+
+#include <string.h>
+#include <stdint.h>
+#include "../../crypto.h"
+
+// Up to 57 bits of s starting at bit pos (s is 32 bytes)
+static uint64_t fe25519_load(const uint8_t *s, int pos) {
+	uint64_t v = 0;
+	int i;
+	for (i = 0; (i < 8) && (((pos >> 3) + i) < X25519_KEY_SIZE); i++) {
+		v |= (uint64_t)s[(pos >> 3) + i] << (8 * i);
+	}
+	return v >> (pos & 7);
+}
+
+#if defined(CONFIG_WIREGUARD_X25519_REFC32)
+#include "fe25519-32.h"
+#elif defined(CONFIG_WIREGUARD_X25519_REFC64)
+#include "fe25519-64.h"
+#elif defined(__SIZEOF_INT128__) && defined(__LP64__)
+#include "fe25519-64.h"
+#else
+#include "fe25519-32.h"
+#endif
+
+// Affine point in "Niels" form: (y+x, y-x, 2*d*x*y)
+typedef struct {
+	fe25519 yplusx;
+	fe25519 yminusx;
+	fe25519 xy2d;
+} x25519_niels;
+
+// Extended coordinates: x = X/Z, y = Y/Z, x*y = T/Z
+typedef struct {
+	fe25519 X;
+	fe25519 Y;
+	fe25519 Z;
+	fe25519 T;
+} x25519_ge;
+
+// Completed coordinates: x = X/Z, y = Y/T - output of the add/double formulas
+typedef struct {
+	fe25519 X;
+	fe25519 Y;
+	fe25519 Z;
+	fe25519 T;
+} x25519_ge_completed;
+
+#include "x25519-table.h"
+
+#define X25519_SCALAR_BITS (X25519_COMB_TEETH * X25519_COMB_SPACING * X25519_COMB_COUNT)
+#define X25519_SCALAR_BYTES ((X25519_SCALAR_BITS + 7) / 8)
+
+typedef char x25519_scalar_bits_check[((X25519_SCALAR_BITS >= 256) && (X25519_SCALAR_BYTES >= 33)) ? 1 : -1];
+
+// L = 2^252 + 27742317777372353535851937790883648493, little endian
+static const uint8_t x25519_order[X25519_KEY_SIZE] = {
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+static void x25519_clamp(uint8_t *k, const uint8_t *private_key) {
+	memcpy(k, private_key, X25519_KEY_SIZE);
+	k[0] &= 248;
+	k[31] = (k[31] & 127) | 64;
+}
+
+// -1 if the output is all zero (low order input point), otherwise 0 - checked without branching on the bytes
+static int x25519_check_zero(const uint8_t *out) {
+	uint32_t zero = 0;
+	int i;
+	for (i = 0; i < X25519_KEY_SIZE; i++) {
+		zero |= out[i];
+	}
+	return (int)((zero + 0xFF) >> 8) - 1;
+}
+
+static void x25519_sqn(fe25519 out, const fe25519 f, int n) {
+	fe25519_sq(out, f);
+	while (--n > 0) {
+		fe25519_sq(out, out);
+	}
+}
+
+// out := z^(p-2) = 1/z (0 if z = 0)
+static void x25519_invert(fe25519 out, const fe25519 z) {
+	fe25519 t0, t1, t2, t3;
+
+	fe25519_sq(t0, z);                // z^2
+	x25519_sqn(t1, t0, 2);           // z^8
+	fe25519_mul(t1, z, t1);           // z^9
+	fe25519_mul(t0, t0, t1);          // z^11
+	fe25519_sq(t2, t0);               // z^22
+	fe25519_mul(t1, t1, t2);          // z^(2^5-1)
+	x25519_sqn(t2, t1, 5);
+	fe25519_mul(t1, t2, t1);          // z^(2^10-1)
+	x25519_sqn(t2, t1, 10);
+	fe25519_mul(t2, t2, t1);          // z^(2^20-1)
+	x25519_sqn(t3, t2, 20);
+	fe25519_mul(t2, t3, t2);          // z^(2^40-1)
+	x25519_sqn(t2, t2, 10);
+	fe25519_mul(t1, t2, t1);          // z^(2^50-1)
+	x25519_sqn(t2, t1, 50);
+	fe25519_mul(t2, t2, t1);          // z^(2^100-1)
+	x25519_sqn(t3, t2, 100);
+	fe25519_mul(t2, t3, t2);          // z^(2^200-1)
+	x25519_sqn(t2, t2, 50);
+	fe25519_mul(t1, t2, t1);          // z^(2^250-1)
+	x25519_sqn(t1, t1, 5);
+	fe25519_mul(out, t1, t0);         // z^(2^255-21)
+
+	crypto_zero(t0, sizeof(t0));
+	crypto_zero(t1, sizeof(t1));
+	crypto_zero(t2, sizeof(t2));
+	crypto_zero(t3, sizeof(t3));
+}
+
+static void x25519_ge_identity(x25519_ge *p) {
+	fe25519_0(p->X);
+	fe25519_1(p->Y);
+	fe25519_1(p->Z);
+	fe25519_0(p->T);
+}
+
+static void x25519_ge_from_completed(x25519_ge *r, const x25519_ge_completed *p) {
+	fe25519_mul(r->X, p->X, p->T);
+	fe25519_mul(r->Y, p->Y, p->Z);
+	fe25519_mul(r->Z, p->Z, p->T);
+	fe25519_mul(r->T, p->X, p->Y);
+}
+
+// r := 2*p (the T coordinate of p is not used)
+static void x25519_ge_dbl(x25519_ge_completed *r, const x25519_ge *p) {
+	fe25519 t0;
+
+	fe25519_sq(r->X, p->X);
+	fe25519_sq(r->Z, p->Y);
+	fe25519_sq2(r->T, p->Z);
+	fe25519_add(r->Y, p->X, p->Y);
+	fe25519_sq(t0, r->Y);
+	fe25519_add(r->Y, r->Z, r->X);
+	fe25519_sub(r->Z, r->Z, r->X);
+	fe25519_sub(r->X, t0, r->Y);
+	fe25519_sub(r->T, r->T, r->Z);
+}
+
+// r := p + q for an affine table point q
+static void x25519_ge_madd(x25519_ge_completed *r, const x25519_ge *p, const x25519_niels *q) {
+	fe25519 t0;
+
+	fe25519_add(r->X, p->Y, p->X);
+	fe25519_sub(r->Y, p->Y, p->X);
+	fe25519_mul(r->Z, r->X, q->yplusx);
+	fe25519_mul(r->Y, r->Y, q->yminusx);
+	fe25519_mul(r->T, q->xy2d, p->T);
+	fe25519_add(t0, p->Z, p->Z);
+	fe25519_sub(r->X, r->Z, r->Y);
+	fe25519_add(r->Y, r->Z, r->Y);
+	fe25519_add(r->Z, t0, r->T);
+	fe25519_sub(r->T, t0, r->T);
+}
+
+// Constant time: t := the column value for the signed digits in bits (bit j = tooth j) of the given comb
+static void x25519_comb_select(x25519_niels *t, int comb, uint32_t bits) {
+	uint32_t invert = ((bits >> (X25519_COMB_TEETH - 1)) & 1) ^ 1;
+	uint32_t index = (bits ^ (0 - invert)) & (X25519_COMB_ENTRIES - 1);
+	uint32_t match;
+	fe25519 neg;
+	uint32_t i;
+
+	// Only columns with a +1 top tooth are stored - the others are the negation of the complementary column
+	fe25519_0(t->yplusx);
+	fe25519_0(t->yminusx);
+	fe25519_0(t->xy2d);
+	for (i = 0; i < X25519_COMB_ENTRIES; i++) {
+		match = (((i ^ index) - 1) >> 31) & 1;
+		fe25519_cmov(t->yplusx, x25519_comb_table[comb][i].yplusx, match);
+		fe25519_cmov(t->yminusx, x25519_comb_table[comb][i].yminusx, match);
+		fe25519_cmov(t->xy2d, x25519_comb_table[comb][i].xy2d, match);
+	}
+
+	// -(x,y) = (-x,y): swap y+x and y-x, negate 2dxy
+	fe25519_cswap(t->yplusx, t->yminusx, invert);
+	fe25519_neg(neg, t->xy2d);
+	fe25519_cmov(t->xy2d, neg, invert);
+}
+
+const char *x25519_backend_name(void) {
+	return FE25519_NAME;
+}
+
+int x25519(uint8_t *out, const uint8_t *private_key, const uint8_t *public_key) {
+	uint8_t k[X25519_KEY_SIZE];
+	fe25519 x1, x2, z2, x3, z3, tmp0, tmp1;
+	unsigned int swap = 0;
+	unsigned int bit;
+	int pos;
+
+	x25519_clamp(k, private_key);
+	fe25519_frombytes(x1, public_key);
+	fe25519_1(x2);
+	fe25519_0(z2);
+	memcpy(x3, x1, sizeof(fe25519));
+	fe25519_1(z3);
+
+	for (pos = 254; pos >= 0; pos--) {
+		bit = (k[pos >> 3] >> (pos & 7)) & 1;
+		swap ^= bit;
+		fe25519_cswap(x2, x3, swap);
+		fe25519_cswap(z2, z3, swap);
+		swap = bit;
+
+		// One combined double-and-add step (RFC 7748 section 5, ref10 operation order)
+		fe25519_sub(tmp0, x3, z3);           // D
+		fe25519_sub(tmp1, x2, z2);           // B
+		fe25519_add(x2, x2, z2);             // A
+		fe25519_add(z2, x3, z3);             // C
+		fe25519_mul(z3, tmp0, x2);           // DA
+		fe25519_mul(z2, z2, tmp1);           // CB
+		fe25519_sq(tmp0, tmp1);              // BB
+		fe25519_sq(tmp1, x2);                // AA
+		fe25519_add(x3, z3, z2);             // DA + CB
+		fe25519_sub(z2, z3, z2);             // DA - CB
+		fe25519_mul(x2, tmp1, tmp0);         // x2 = AA * BB
+		fe25519_sub(tmp1, tmp1, tmp0);       // E = AA - BB
+		fe25519_sq(z2, z2);
+		fe25519_mul121666(z3, tmp1);
+		fe25519_sq(x3, x3);                  // x3 = (DA + CB)^2
+		fe25519_add(tmp0, tmp0, z3);         // BB + 121666 * E = AA + 121665 * E
+		fe25519_mul(z3, x1, z2);             // z3 = x1 * (DA - CB)^2
+		fe25519_mul(z2, tmp1, tmp0);         // z2 = E * (AA + a24 * E)
+	}
+	fe25519_cswap(x2, x3, swap);
+	fe25519_cswap(z2, z3, swap);
+
+	x25519_invert(z2, z2);
+	fe25519_mul(x2, x2, z2);
+	fe25519_tobytes(out, x2);
+
+	crypto_zero(k, sizeof(k));
+	crypto_zero(x1, sizeof(x1));
+	crypto_zero(x2, sizeof(x2));
+	crypto_zero(z2, sizeof(z2));
+	crypto_zero(x3, sizeof(x3));
+	crypto_zero(z3, sizeof(z3));
+	crypto_zero(tmp0, sizeof(tmp0));
+	crypto_zero(tmp1, sizeof(tmp1));
+	return x25519_check_zero(out);
+}
+
+int x25519_base(uint8_t *public_key, const uint8_t *private_key) {
+	uint8_t m[X25519_KEY_SIZE];
+	uint8_t r[X25519_SCALAR_BYTES];
+	x25519_ge acc;
+	x25519_ge_completed sum;
+	x25519_niels t;
+	fe25519 num, den;
+	uint32_t bits, carry;
+	int comb, tooth, pos, i, bit;
+
+	// Clamp, then m := k + L (odd, < 2^256)
+	x25519_clamp(m, private_key);
+	carry = 0;
+	for (i = 0; i < X25519_KEY_SIZE; i++) {
+		carry += (uint32_t)m[i] + x25519_order[i];
+		m[i] = (uint8_t)carry;
+		carry >>= 8;
+	}
+
+	// r := (m + 2^n - 1) / 2 = (m >> 1) + 2^(n-1), since m is odd
+	memset(r, 0, sizeof(r));
+	for (i = 0; i < X25519_KEY_SIZE - 1; i++) {
+		r[i] = (uint8_t)((m[i] >> 1) | (m[i + 1] << 7));
+	}
+	r[X25519_KEY_SIZE - 1] = m[X25519_KEY_SIZE - 1] >> 1;
+	r[(X25519_SCALAR_BITS - 1) / 8] |= (uint8_t)(1 << ((X25519_SCALAR_BITS - 1) % 8));
+
+	// Horner over the comb positions, most significant first; bit of tooth t at position p of comb c is
+	// c * TEETH * SPACING + t * SPACING + p
+	x25519_ge_identity(&acc);
+	for (pos = X25519_COMB_SPACING - 1; pos >= 0; pos--) {
+		if (pos != X25519_COMB_SPACING - 1) {
+			x25519_ge_dbl(&sum, &acc);
+			x25519_ge_from_completed(&acc, &sum);
+		}
+		for (comb = 0; comb < X25519_COMB_COUNT; comb++) {
+			bits = 0;
+			for (tooth = 0; tooth < X25519_COMB_TEETH; tooth++) {
+				bit = (comb * X25519_COMB_TEETH + tooth) * X25519_COMB_SPACING + pos;
+				bits |= (uint32_t)((r[bit >> 3] >> (bit & 7)) & 1) << tooth;
+			}
+			x25519_comb_select(&t, comb, bits);
+			x25519_ge_madd(&sum, &acc, &t);
+			x25519_ge_from_completed(&acc, &sum);
+		}
+	}
+
+	// u = (1 + y) / (1 - y) = (Z + Y) / (Z - Y)
+	fe25519_add(num, acc.Z, acc.Y);
+	fe25519_sub(den, acc.Z, acc.Y);
+	x25519_invert(den, den);
+	fe25519_mul(num, num, den);
+	fe25519_tobytes(public_key, num);
+
+	crypto_zero(m, sizeof(m));
+	crypto_zero(r, sizeof(r));
+	crypto_zero(&acc, sizeof(acc));
+	crypto_zero(&sum, sizeof(sum));
+	crypto_zero(&t, sizeof(t));
+	crypto_zero(num, sizeof(num));
+	crypto_zero(den, sizeof(den));
+	return x25519_check_zero(public_key);
+}
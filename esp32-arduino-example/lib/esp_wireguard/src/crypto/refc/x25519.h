@@ -0,0 +1,33 @@
+// X25519 (RFC 7748) - Montgomery ladder for DH, precomputed Edwards25519 comb table for public key generation
+// Built on 32-bit or 64-bit limbs, see x25519.c and crypto.h
+#ifndef _X25519_H_
+#define _X25519_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define X25519_KEY_SIZE 32
+
+// out := X25519(private_key, public_key)
+// The private key is clamped internally and the top bit of public_key is ignored, as crypto_scalarmult_curve25519() does
+// Returns 0 on success, -1 if the result is all zero (low order public_key)
+// Runs in constant time with respect to private_key
+int x25519(uint8_t *out, const uint8_t *private_key, const uint8_t *public_key);
+
+// public_key := X25519(private_key, 9)
+// The private key is clamped internally, as crypto_scalarmult_curve25519() does
+// Returns 0 on success, -1 if the result is all zero (same convention as libsodium)
+// Runs in constant time with respect to private_key
+int x25519_base(uint8_t *public_key, const uint8_t *private_key);
+
+// "refc32" or "refc64" - the field arithmetic this build uses
+const char *x25519_backend_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _X25519_H_ */
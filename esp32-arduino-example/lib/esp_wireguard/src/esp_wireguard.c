@@ -33,6 +33,7 @@
 #include "esp_wireguard.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <string.h>
 #include <inttypes.h>
 #include <time.h>
@@ -42,6 +43,10 @@
 #include "lwip/netdb.h"
 #include "lwip/dns.h"
 #include "lwip/err.h"
+#include "lwip/tcpip.h"
+#if !NO_SYS
+#include "lwip/priv/tcpip_priv.h"
+#endif
 #include "esp_wireguard_err.h"
 #include "esp_wireguard_log.h"
 #include "mbedtls/base64.h"
@@ -50,7 +55,7 @@
 #include "wireguardif.h"
 
 #define TAG "esp_wireguard"
-#define WG_KEY_LEN  (32)
+#define WG_KEY_LEN  ESP_WIREGUARD_KEY_LEN
 #define WG_B64_KEY_LEN (4 * ((WG_KEY_LEN + 2) / 3))
 
 #if defined(CONFIG_LWIP_IPV6)
@@ -59,12 +64,6 @@
 #define WG_ADDRSTRLEN  INET_ADDRSTRLEN
 #endif
 
-static struct netif wg_netif_struct = {0};
-static struct netif *wg_netif = NULL;
-static struct wireguardif_peer peer = {0};
-static uint8_t wireguard_peer_index = WIREGUARDIF_INVALID_INDEX;
-static uint8_t preshared_key_decoded[WG_KEY_LEN];
-
 static void esp_wireguard_dns_query_callback(const char *hostname, const ip_addr_t *ipaddr, wireguard_config_t *config) {
     if(ipaddr) {
         ESP_LOGV(TAG, "dns_query_callback: hostname %s resolved to ip %s", hostname, ipaddr_ntoa(ipaddr));
@@ -75,11 +74,127 @@ static void esp_wireguard_dns_query_callback(const char *hostname, const ip_addr
     }
 }
 
-static esp_err_t esp_wireguard_peer_init(const wireguard_config_t *config, struct wireguardif_peer *peer)
+/* With several tunnels, the default netif saved by one may be another that is gone since */
+static bool esp_wireguard_netif_is_added(const struct netif *netif)
+{
+    struct netif *tmp;
+
+    NETIF_FOREACH(tmp) {
+        if (tmp == netif) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The wireguardif_* calls that change what the lwIP thread works on for every packet are made on that thread */
+struct esp_wireguard_call {
+#if !NO_SYS
+    struct tcpip_api_call_data call; /* tcpip_api_call() hands this back, so it comes first */
+#endif
+    err_t (*fn)(struct esp_wireguard_call *call);
+    wireguard_ctx_t *ctx;
+    struct wireguardif_init_data *init_data;
+    struct netif *netif;
+    struct wireguardif_peer *peer;
+    u8_t peer_index;
+    ip_addr_t ip_addr;
+    ip_addr_t netmask;
+};
+
+#if !NO_SYS
+static err_t esp_wireguard_call_fn(struct tcpip_api_call_data *call)
+{
+    struct esp_wireguard_call *wg_call = (struct esp_wireguard_call *)call;
+    return wg_call->fn(wg_call);
+}
+#endif
+
+/* Runs call->fn on the lwIP thread and waits for it - without an OS there is no other thread, so it just runs */
+static err_t esp_wireguard_call(struct esp_wireguard_call *call)
+{
+#if NO_SYS
+    return call->fn(call);
+#else
+    return tcpip_api_call(esp_wireguard_call_fn, &(call->call));
+#endif
+}
+
+static err_t esp_wireguard_netif_add_fn(struct esp_wireguard_call *call)
+{
+    wireguard_ctx_t *ctx = call->ctx;
+    ip_addr_t gateway = IPADDR4_INIT_BYTES(0, 0, 0, 0);
+    err_t lwip_err = ERR_IF;
+
+    /* Register the new WireGuard network interface with lwIP */
+    ctx->netif = netif_add(
+            &(ctx->netif_struct),
+            ip_2_ip4(&(call->ip_addr)),
+            ip_2_ip4(&(call->netmask)),
+            ip_2_ip4(&gateway),
+            call->init_data, &wireguardif_init,
+            &ip_input);
+    if (ctx->netif != NULL) {
+        /* Mark the interface as administratively up, link up flag is set
+         * automatically when peer connects */
+        netif_set_up(ctx->netif);
+        lwip_err = ERR_OK;
+    }
+    return lwip_err;
+}
+
+static err_t esp_wireguard_add_peer_fn(struct esp_wireguard_call *call)
+{
+    return wireguardif_add_peer(call->netif, call->peer, &(call->peer_index));
+}
+
+static err_t esp_wireguard_connect_fn(struct esp_wireguard_call *call)
+{
+    return wireguardif_connect(call->netif, call->peer_index);
+}
+
+/* Takes the peer and the netif down in one go, so the lwIP thread never sees a half removed device */
+static err_t esp_wireguard_disconnect_fn(struct esp_wireguard_call *call)
+{
+    wireguard_ctx_t *ctx = call->ctx;
+    err_t lwip_err;
+
+    // Clear the IP address to gracefully disconnect any clients while the
+    // peers are still valid
+    netif_set_ipaddr(ctx->netif, IP4_ADDR_ANY4);
+
+    lwip_err = wireguardif_disconnect(ctx->netif, ctx->peer_index);
+    if (lwip_err != ERR_OK) {
+        ESP_LOGW(TAG, "wireguardif_disconnect: peer_index: %" PRIu8 " err: %i", ctx->peer_index, lwip_err);
+    }
+
+    lwip_err = wireguardif_remove_peer(ctx->netif, ctx->peer_index);
+    if (lwip_err != ERR_OK) {
+        ESP_LOGW(TAG, "wireguardif_remove_peer: peer_index: %" PRIu8 " err: %i", ctx->peer_index, lwip_err);
+    }
+
+    ctx->peer_index = WIREGUARDIF_INVALID_INDEX;
+    wireguardif_shutdown(ctx->netif);
+    netif_remove(ctx->netif);
+    wireguardif_fini(ctx->netif);
+    /* netif_remove() has cleared the default if it was this tunnel, other tunnels keep theirs */
+    if (netif_default == NULL && esp_wireguard_netif_is_added(ctx->netif_default)) {
+        netif_set_default(ctx->netif_default);
+    }
+    ctx->netif = NULL;
+    return ERR_OK;
+}
+
+static err_t esp_wireguard_add_allowed_ip_fn(struct esp_wireguard_call *call)
+{
+    return wireguardif_add_allowed_ip(call->netif, call->peer_index, call->ip_addr, call->netmask);
+}
+
+static esp_err_t esp_wireguard_peer_init(const wireguard_config_t *config, struct wireguardif_peer *peer, uint8_t *preshared_key_decoded)
 {
     esp_err_t err;
 
-    if (!config || !peer) {
+    if (!config || !peer || !preshared_key_decoded) {
         err = ESP_ERR_INVALID_ARG;
         goto fail;
     }
@@ -123,6 +238,8 @@ static esp_err_t esp_wireguard_peer_init(const wireguard_config_t *config, struc
 
         // Only the single IP is allowed, thus /32 netmask, leaving to the user
         // the responsibility to set the appropriate list of other allowed IPs.
+        // Incoming packets are checked against their source address, so the
+        // peer's side of the tunnel must be added with esp_wireguard_add_allowed_ip().
         ip_addr_t allowed_mask = IPADDR4_INIT_BYTES(255, 255, 255, 255);
         peer->allowed_mask = allowed_mask;
     }
@@ -135,13 +252,12 @@ fail:
     return err;
 }
 
-static esp_err_t esp_wireguard_netif_create(const wireguard_config_t *config)
+static esp_err_t esp_wireguard_netif_create(wireguard_ctx_t *ctx)
 {
+    const wireguard_config_t *config = ctx ? ctx->config : NULL;
     esp_err_t err;
-    ip_addr_t ip_addr;
-    ip_addr_t netmask;
-    ip_addr_t gateway = IPADDR4_INIT_BYTES(0, 0, 0, 0);
     struct wireguardif_init_data wg = {0};
+    struct esp_wireguard_call call = {0};
 
     if (!config) {
         err = ESP_ERR_INVALID_ARG;
@@ -153,34 +269,25 @@ static esp_err_t esp_wireguard_netif_create(const wireguard_config_t *config)
     wg.listen_port = config->listen_port;
     wg.bind_netif = NULL;
 
-    if (ipaddr_aton(config->address, &ip_addr) != 1) {
+    if (ipaddr_aton(config->address, &(call.ip_addr)) != 1) {
         ESP_LOGE(TAG, "netif_create: invalid address: `%s`", config->address);
         err = ESP_ERR_INVALID_ARG;
         goto fail;
     }
-    if (ipaddr_aton(config->netmask, &netmask) != 1) {
+    if (ipaddr_aton(config->netmask, &(call.netmask)) != 1) {
         ESP_LOGE(TAG, "netif_create: invalid netmask: `%s`", config->netmask);
         err = ESP_ERR_INVALID_ARG;
         goto fail;
     }
 
-    /* Register the new WireGuard network interface with lwIP */
-    wg_netif = netif_add(
-            &wg_netif_struct,
-            ip_2_ip4(&ip_addr),
-            ip_2_ip4(&netmask),
-            ip_2_ip4(&gateway),
-            &wg, &wireguardif_init,
-            &ip_input);
-    if (wg_netif == NULL) {
+    call.fn = esp_wireguard_netif_add_fn;
+    call.ctx = ctx;
+    call.init_data = &wg;
+    if (esp_wireguard_call(&call) != ERR_OK) {
         ESP_LOGE(TAG, "netif_add: failed");
         err = ESP_FAIL;
         goto fail;
     }
-
-    /* Mark the interface as administratively up, link up flag is set
-     * automatically when peer connects */
-    netif_set_up(wg_netif);
     err = ESP_OK;
 fail:
     return err;
@@ -218,6 +325,7 @@ esp_err_t esp_wireguard_init(wireguard_config_t *config, wireguard_ctx_t *ctx)
     ctx->config = config;
     ctx->netif = NULL;
     ctx->netif_default = netif_default;
+    ctx->peer_index = WIREGUARDIF_INVALID_INDEX;
 
     err = ESP_OK;
 fail:
@@ -228,6 +336,7 @@ esp_err_t esp_wireguard_connect(wireguard_ctx_t *ctx)
 {
     esp_err_t err = ESP_FAIL;
     err_t lwip_err = -1;
+    struct esp_wireguard_call call = {0};
 
     if (!ctx) {
         err = ESP_ERR_INVALID_ARG;
@@ -235,7 +344,7 @@ esp_err_t esp_wireguard_connect(wireguard_ctx_t *ctx)
     }
 
     if (ctx->netif == NULL) {
-        err = esp_wireguard_netif_create(ctx->config);
+        err = esp_wireguard_netif_create(ctx);
         if (err != ESP_OK) {
 #if !defined(LIBRETINY)
             ESP_LOGE(TAG, "netif_create: %s", esp_err_to_name(err));
@@ -244,7 +353,6 @@ esp_err_t esp_wireguard_connect(wireguard_ctx_t *ctx)
 #endif // !defined(LIBRETINY)
             goto fail;
         }
-        ctx->netif = wg_netif;
         ctx->netif_default = netif_default;
     }
 
@@ -277,7 +385,7 @@ esp_err_t esp_wireguard_connect(wireguard_ctx_t *ctx)
     }
 
         /* Initialize the first WireGuard peer structure */
-        err = esp_wireguard_peer_init(ctx->config, &peer);
+        err = esp_wireguard_peer_init(ctx->config, &(ctx->peer), ctx->preshared_key);
         if (err != ESP_OK) {
 #if !defined(LIBRETINY)
             ESP_LOGE(TAG, "peer_init: %s", esp_err_to_name(err));
@@ -288,19 +396,26 @@ esp_err_t esp_wireguard_connect(wireguard_ctx_t *ctx)
         }
 
         /* Register the new WireGuard peer with the network interface */
-        lwip_err = wireguardif_add_peer(ctx->netif, &peer, &wireguard_peer_index);
-        if (lwip_err != ERR_OK || wireguard_peer_index == WIREGUARDIF_INVALID_INDEX) {
+        call.fn = esp_wireguard_add_peer_fn;
+        call.netif = ctx->netif;
+        call.peer = &(ctx->peer);
+        call.peer_index = WIREGUARDIF_INVALID_INDEX;
+        lwip_err = esp_wireguard_call(&call);
+        ctx->peer_index = call.peer_index;
+        if (lwip_err != ERR_OK || ctx->peer_index == WIREGUARDIF_INVALID_INDEX) {
             ESP_LOGE(TAG, "wireguardif_add_peer: %i", lwip_err);
             err = ESP_FAIL;
             goto fail;
         }
-        if (ip_addr_isany(&peer.endpoint_ip)) {
+        if (ip_addr_isany(&(ctx->peer.endpoint_ip))) {
             err = ESP_FAIL;
             goto fail;
         }
 
-    ESP_LOGI(TAG, "connecting to %s (%s), port %i", ctx->config->endpoint, ipaddr_ntoa(&(peer.endpoint_ip)), peer.endport_port);
-    lwip_err = wireguardif_connect(ctx->netif, wireguard_peer_index);
+    ESP_LOGI(TAG, "connecting to %s (%s), port %i", ctx->config->endpoint, ipaddr_ntoa(&(ctx->peer.endpoint_ip)), ctx->peer.endport_port);
+    call.fn = esp_wireguard_connect_fn;
+    call.peer_index = ctx->peer_index;
+    lwip_err = esp_wireguard_call(&call);
     if (lwip_err != ERR_OK) {
         ESP_LOGE(TAG, "wireguardif_connect: %i", lwip_err);
         err = ESP_FAIL;
@@ -335,7 +450,7 @@ esp_err_t esp_wireguard_restore_default(const wireguard_ctx_t *ctx)
         err = ESP_ERR_INVALID_ARG;
         goto fail;
     }
-    if(!ctx->netif_default) {
+    if(!ctx->netif_default || !esp_wireguard_netif_is_added(ctx->netif_default)) {
         err = ESP_ERR_INVALID_STATE;
         goto fail;
     }
@@ -348,33 +463,16 @@ fail:
 esp_err_t esp_wireguard_disconnect(wireguard_ctx_t *ctx)
 {
     esp_err_t err;
-    err_t lwip_err;
+    struct esp_wireguard_call call = {0};
 
     if (!ctx) {
         err = ESP_ERR_INVALID_ARG;
         goto fail;
     }
 
-    // Clear the IP address to gracefully disconnect any clients while the
-    // peers are still valid
-    netif_set_ipaddr(ctx->netif, IP4_ADDR_ANY4);
-
-    lwip_err = wireguardif_disconnect(ctx->netif, wireguard_peer_index);
-    if (lwip_err != ERR_OK) {
-        ESP_LOGW(TAG, "wireguardif_disconnect: peer_index: %" PRIu8 " err: %i", wireguard_peer_index, lwip_err);
-    }
-
-    lwip_err = wireguardif_remove_peer(ctx->netif, wireguard_peer_index);
-    if (lwip_err != ERR_OK) {
-        ESP_LOGW(TAG, "wireguardif_remove_peer: peer_index: %" PRIu8 " err: %i", wireguard_peer_index, lwip_err);
-    }
-
-    wireguard_peer_index = WIREGUARDIF_INVALID_INDEX;
-    wireguardif_shutdown(ctx->netif);
-    netif_remove(ctx->netif);
-    wireguardif_fini(ctx->netif);
-    netif_set_default(ctx->netif_default);
-    ctx->netif = NULL;
+    call.fn = esp_wireguard_disconnect_fn;
+    call.ctx = ctx;
+    esp_wireguard_call(&call);
 
     err = ESP_OK;
 fail:
@@ -385,6 +483,8 @@ esp_err_t esp_wireguard_peer_is_up(const wireguard_ctx_t *ctx)
 {
     esp_err_t err;
     err_t lwip_err;
+    ip_addr_t ip_addr;
+    u16_t port;
 
     if (!ctx) {
         err = ESP_ERR_INVALID_ARG;
@@ -393,9 +493,9 @@ esp_err_t esp_wireguard_peer_is_up(const wireguard_ctx_t *ctx)
 
     lwip_err = wireguardif_peer_is_up(
             ctx->netif,
-            wireguard_peer_index,
-            &peer.endpoint_ip,
-            &peer.endport_port);
+            ctx->peer_index,
+            &ip_addr,
+            &port);
 
     if (lwip_err != ERR_OK) {
         err = ESP_FAIL;
@@ -420,7 +520,7 @@ esp_err_t esp_wireguard_latest_handshake(const wireguard_ctx_t *ctx, time_t *res
         goto fail;
     }
 
-    *result = wireguardif_latest_handshake(ctx->netif, wireguard_peer_index);
+    *result = wireguardif_latest_handshake(ctx->netif, ctx->peer_index);
     err = (*result > 0) ? ESP_OK : ESP_FAIL;
 
 fail:
@@ -431,9 +531,7 @@ esp_err_t esp_wireguard_add_allowed_ip(const wireguard_ctx_t *ctx, const char *a
 {
     esp_err_t err;
     err_t lwip_err;
-
-    ip_addr_t ip_addr;
-    ip_addr_t netmask;
+    struct esp_wireguard_call call = {0};
 
     if (!ctx || !allowed_ip || !allowed_ip_mask) {
         err = ESP_ERR_INVALID_ARG;
@@ -445,20 +543,23 @@ esp_err_t esp_wireguard_add_allowed_ip(const wireguard_ctx_t *ctx, const char *a
         goto fail;
     }
 
-    if (ipaddr_aton(allowed_ip, &ip_addr) != 1) {
+    if (ipaddr_aton(allowed_ip, &(call.ip_addr)) != 1) {
         ESP_LOGE(TAG, "add_allowed_ip: invalid allowed_ip: `%s`", allowed_ip);
         err = ESP_ERR_INVALID_ARG;
         goto fail;
     }
 
-    if (ipaddr_aton(allowed_ip_mask, &netmask) != 1) {
+    if (ipaddr_aton(allowed_ip_mask, &(call.netmask)) != 1) {
         ESP_LOGE(TAG, "add_allowed_ip: invalid allowed_ip_mask: `%s`", allowed_ip_mask);
         err = ESP_ERR_INVALID_ARG;
         goto fail;
     }
 
     ESP_LOGI(TAG, "add allowed_ip: %s/%s", allowed_ip, allowed_ip_mask);
-    lwip_err = wireguardif_add_allowed_ip(ctx->netif, wireguard_peer_index, ip_addr, netmask);
+    call.fn = esp_wireguard_add_allowed_ip_fn;
+    call.netif = ctx->netif;
+    call.peer_index = ctx->peer_index;
+    lwip_err = esp_wireguard_call(&call);
     err = (lwip_err == ERR_OK ? ESP_OK : ESP_FAIL);
 
 fail:
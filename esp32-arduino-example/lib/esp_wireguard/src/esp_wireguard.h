@@ -40,6 +40,9 @@ extern "C" {
 #include <time.h>
 #include <lwip/netif.h>
 #include "esp_wireguard_err.h"
+#include "wireguardif.h"
+
+#define ESP_WIREGUARD_KEY_LEN (32)
 
 #define ESP_WIREGUARD_CONFIG_DEFAULT() { \
     .private_key = NULL, \
@@ -59,12 +62,13 @@ extern "C" {
     .config = NULL, \
     .netif = NULL, \
     .netif_default = NULL, \
+    .peer_index = WIREGUARDIF_INVALID_INDEX, \
 }
 
 typedef struct {
     /* interface config */
     const char* private_key;            /**< a base64 private key generated by wg genkey. Required. */
-    uint16_t    listen_port;            /**< a 16-bit port for listening */
+    uint16_t    listen_port;            /**< a 16-bit port for listening. Each tunnel needs its own, zero picks a free one. */
     uint32_t    fw_mark;                /**< a 32-bit fwmark for outgoing packets */
     /* peer config */
     const char* public_key;             /**< a base64 public key calculated by wg pubkey from a private key. Required. */
@@ -84,6 +88,11 @@ typedef struct {
     wireguard_config_t* config;        /**< a pointer to wireguard config */
     struct netif*       netif;         /**< a pointer to configured netif */
     struct netif*       netif_default; /**< a pointer to the default netif. */
+    /* tunnel state (internal use) */
+    struct netif        netif_struct;  /**< the WireGuard netif, `netif` points here once connected */
+    struct wireguardif_peer peer;      /**< the remote peer */
+    uint8_t             peer_index;    /**< index of the peer in the WireGuard device */
+    uint8_t             preshared_key[ESP_WIREGUARD_KEY_LEN]; /**< decoded preshared key of the peer */
 } wireguard_ctx_t;
 
 /**
@@ -91,7 +100,9 @@ typedef struct {
  *
  * Call this function to initialize the context of WireGuard.
  *
- * Do not call this function multiple times.
+ * Do not call this function multiple times on the same context. Every
+ * tunnel has a context of its own, several of them can be up at the same
+ * time as long as their `listen_port`s differ.
  *
  * To connect to other peer, use `esp_wireguard_disconnect()`, and
  * `esp_wireguard_init()` with a new configuration. To reconnect to
@@ -0,0 +1,294 @@
+// vim: noexpandtab
+// Cryptokey routing trie - see wireguard-allowedips.h
+
+#include "wireguard-allowedips.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "lwip/mem.h"
+
+// Addresses are handled as arrays of 32-bit words in network order, as lwIP stores them. Bit 0 is the MSB of
+// the first byte; whole words are compared without byte swapping
+
+struct wireguard_allowedips_node {
+	struct wireguard_peer *peer; // NULL for nodes that only join two subtrees
+	struct wireguard_allowedips_node *parent;
+	// Children continue the prefix with a 0 or 1 at bit 'cidr'
+	struct wireguard_allowedips_node *child[2];
+	uint32_t last_mask; // Prefix bits of the last partial word, in memory order
+	uint8_t cidr;
+	uint32_t bits[]; // The prefix, zero past cidr - 1 or 4 words
+};
+
+static uint8_t allowedips_bit(const uint32_t *key, uint8_t bit) {
+	return (((const uint8_t *)key)[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+// Number of leading bits a and b have in common, at most max_bits
+static uint8_t allowedips_common_bits(const uint32_t *a, const uint32_t *b, uint8_t max_bits) {
+	const uint8_t *a8 = (const uint8_t *)a;
+	const uint8_t *b8 = (const uint8_t *)b;
+	uint8_t result = 0;
+	uint8_t diff;
+	while ((result < max_bits) && (a8[result >> 3] == b8[result >> 3])) {
+		result += 8;
+	}
+	if (result < max_bits) {
+		diff = a8[result >> 3] ^ b8[result >> 3];
+		while (!(diff & 0x80)) {
+			diff <<= 1;
+			result++;
+		}
+	}
+	return (result < max_bits) ? result : max_bits;
+}
+
+static bool allowedips_prefix_matches(const struct wireguard_allowedips_node *node, const uint32_t *key) {
+	uint8_t full = node->cidr >> 5;
+	uint8_t x;
+	bool result = true;
+	for (x=0; result && (x < full); x++) {
+		result = (node->bits[x] == key[x]);
+	}
+	if (result && (node->cidr & 31)) {
+		result = (((node->bits[full] ^ key[full]) & node->last_mask) == 0);
+	}
+	return result;
+}
+
+static struct wireguard_allowedips_node *allowedips_node_new(const uint32_t *key, size_t words, uint8_t cidr, struct wireguard_peer *peer) {
+	struct wireguard_allowedips_node *result = (struct wireguard_allowedips_node *)mem_malloc(sizeof(struct wireguard_allowedips_node) + (words * sizeof(uint32_t)));
+	uint8_t *bits;
+	uint8_t *mask;
+	size_t x;
+	if (result) {
+		result->peer = peer;
+		result->parent = NULL;
+		result->child[0] = NULL;
+		result->child[1] = NULL;
+		result->cidr = cidr;
+		// Keep only the prefix bits so that nodes compare equal whatever host bits the caller passed
+		memcpy(result->bits, key, words * sizeof(uint32_t));
+		bits = (uint8_t *)result->bits;
+		for (x=0; x < words * sizeof(uint32_t); x++) {
+			if ((x * 8) >= cidr) {
+				bits[x] = 0;
+			} else if ((x * 8) + 8 > cidr) {
+				bits[x] &= (uint8_t)(0xFF << (8 - (cidr - (x * 8))));
+			}
+		}
+		result->last_mask = 0;
+		mask = (uint8_t *)&result->last_mask;
+		for (x=0; x < sizeof(uint32_t); x++) {
+			if ((x * 8) + 8 <= (cidr & 31)) {
+				mask[x] = 0xFF;
+			} else if ((x * 8) < (cidr & 31)) {
+				mask[x] = (uint8_t)(0xFF << (8 - ((cidr & 31) - (x * 8))));
+			}
+		}
+	}
+	return result;
+}
+
+static bool allowedips_insert(struct wireguard_allowedips_node **root, const uint32_t *key, size_t words, uint8_t cidr, struct wireguard_peer *peer) {
+	bool result = false;
+	struct wireguard_allowedips_node **link = root;
+	struct wireguard_allowedips_node *parent = NULL;
+	struct wireguard_allowedips_node *node = *root;
+	struct wireguard_allowedips_node *leaf;
+	struct wireguard_allowedips_node *join;
+	uint8_t common;
+
+	// Walk down while the node's prefix contains key/cidr
+	while (node && (node->cidr <= cidr) && allowedips_prefix_matches(node, key)) {
+		if (node->cidr == cidr) {
+			break;
+		}
+		parent = node;
+		link = &node->child[allowedips_bit(key, node->cidr)];
+		node = *link;
+	}
+
+	if (node && (node->cidr == cidr) && allowedips_prefix_matches(node, key)) {
+		// Exact prefix already present (possibly as a join node)
+		node->peer = peer;
+		result = true;
+	} else {
+		leaf = allowedips_node_new(key, words, cidr, peer);
+		if (leaf) {
+			// Each new node is fully linked below before it is published through *link
+			if (!node) {
+				leaf->parent = parent;
+				*link = leaf;
+				result = true;
+			} else {
+				common = allowedips_common_bits(node->bits, leaf->bits, (node->cidr < cidr) ? node->cidr : cidr);
+				if (common == cidr) {
+					// The new prefix contains node
+					leaf->child[allowedips_bit(node->bits, cidr)] = node;
+					leaf->parent = parent;
+					node->parent = leaf;
+					*link = leaf;
+					result = true;
+				} else {
+					// They diverge at bit 'common' - join them under a node without a peer
+					join = allowedips_node_new(key, words, common, NULL);
+					if (join) {
+						join->child[allowedips_bit(node->bits, common)] = node;
+						join->child[allowedips_bit(leaf->bits, common)] = leaf;
+						join->parent = parent;
+						leaf->parent = join;
+						node->parent = join;
+						*link = join;
+						result = true;
+					} else {
+						mem_free(leaf);
+					}
+				}
+			}
+		}
+	}
+	return result;
+}
+
+static struct wireguard_peer *allowedips_lookup(const struct wireguard_allowedips_node *node, const uint32_t *key, uint8_t max_bits) {
+	struct wireguard_peer *result = NULL;
+	while (node) {
+		// Join nodes are not checked: their prefix is part of every prefix below them, so a mismatch there
+		// fails at the next node holding a peer
+		if (node->peer) {
+			if (!allowedips_prefix_matches(node, key)) {
+				break;
+			}
+			result = node->peer;
+		}
+		if (node->cidr == max_bits) {
+			break;
+		}
+		node = node->child[allowedips_bit(key, node->cidr)];
+	}
+	return result;
+}
+
+// Clears the prefixes of peer (all of them if peer is NULL) and frees the nodes no longer needed.
+// Iterative post-order walk using the parent links, so the stack use does not depend on the trie depth
+static void allowedips_remove(struct wireguard_allowedips_node **root, const struct wireguard_peer *peer) {
+	struct wireguard_allowedips_node *node = *root;
+	struct wireguard_allowedips_node *parent;
+	struct wireguard_allowedips_node *child;
+	struct wireguard_allowedips_node **link;
+	int from = 0; // 0: arrived from the parent, 1: back from child[0], 2: back from child[1]
+
+	while (node) {
+		if ((from == 0) && node->child[0]) {
+			node = node->child[0];
+		} else if ((from < 2) && node->child[1]) {
+			node = node->child[1];
+			from = 0;
+		} else {
+			// Both subtrees done
+			parent = node->parent;
+			from = (parent && (parent->child[1] == node)) ? 2 : 1;
+			if (!peer || (node->peer == peer)) {
+				node->peer = NULL;
+			}
+			// A node without a peer is only worth keeping while it joins two subtrees
+			if (!node->peer && !(node->child[0] && node->child[1])) {
+				child = node->child[0] ? node->child[0] : node->child[1];
+				link = parent ? &parent->child[from - 1] : root;
+				if (child) {
+					child->parent = parent;
+				}
+				*link = child;
+				mem_free(node);
+			}
+			node = parent;
+		}
+	}
+}
+
+// Prefix length of a contiguous mask, -1 if it is not one
+static int allowedips_mask_cidr(const uint8_t *mask, size_t len) {
+	int result = 0;
+	size_t x;
+	uint8_t byte;
+	for (x=0; x < len; x++) {
+		byte = mask[x];
+		if ((result != (int)(x * 8)) && byte) {
+			// Set bits after a gap
+			result = -1;
+			break;
+		}
+		while (byte & 0x80) {
+			byte <<= 1;
+			result++;
+		}
+		if (byte) {
+			result = -1;
+			break;
+		}
+	}
+	return result;
+}
+
+bool wireguard_allowedips_insert(struct wireguard_allowedips *table, const ip_addr_t *ip, const ip_addr_t *mask, struct wireguard_peer *peer) {
+	bool result = false;
+	int cidr;
+	if (table && ip && mask && peer && (IP_GET_TYPE(ip) == IP_GET_TYPE(mask))) {
+#if LWIP_IPV4
+		if (IP_IS_V4(ip)) {
+			cidr = allowedips_mask_cidr((const uint8_t *)&ip_2_ip4(mask)->addr, 4);
+			if (cidr >= 0) {
+				result = allowedips_insert(&table->root4, &ip_2_ip4(ip)->addr, 1, (uint8_t)cidr, peer);
+			}
+		}
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+		if (IP_IS_V6(ip)) {
+			cidr = allowedips_mask_cidr((const uint8_t *)ip_2_ip6(mask)->addr, 16);
+			if (cidr >= 0) {
+				result = allowedips_insert(&table->root6, ip_2_ip6(ip)->addr, 4, (uint8_t)cidr, peer);
+			}
+		}
+#endif /* LWIP_IPV6 */
+	}
+	return result;
+}
+
+struct wireguard_peer *wireguard_allowedips_lookup(const struct wireguard_allowedips *table, const ip_addr_t *ip) {
+	struct wireguard_peer *result = NULL;
+#if LWIP_IPV4
+	if (IP_IS_V4(ip)) {
+		result = allowedips_lookup(table->root4, &ip_2_ip4(ip)->addr, 32);
+	}
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+	if (IP_IS_V6(ip)) {
+		result = allowedips_lookup(table->root6, ip_2_ip6(ip)->addr, 128);
+	}
+#endif /* LWIP_IPV6 */
+	return result;
+}
+
+void wireguard_allowedips_remove_by_peer(struct wireguard_allowedips *table, const struct wireguard_peer *peer) {
+	if (peer) {
+#if LWIP_IPV4
+		allowedips_remove(&table->root4, peer);
+#endif
+#if LWIP_IPV6
+		allowedips_remove(&table->root6, peer);
+#endif
+	}
+}
+
+void wireguard_allowedips_clear(struct wireguard_allowedips *table) {
+#if LWIP_IPV4
+	allowedips_remove(&table->root4, NULL);
+#endif
+#if LWIP_IPV6
+	allowedips_remove(&table->root6, NULL);
+#endif
+}
@@ -0,0 +1,48 @@
+// vim: noexpandtab
+// Cryptokey routing table (WireGuard paper 2.1) - maps IPv4/IPv6 prefixes to peers with longest prefix match.
+// One compressed binary radix trie per address family: a lookup walks at most one node per distinct prefix
+// length on the path to the address (33 for IPv4, 129 for IPv6), however many prefixes are stored.
+// Nodes come from mem_malloc(); a peer can own any number of prefixes.
+#ifndef _WIREGUARD_ALLOWEDIPS_H_
+#define _WIREGUARD_ALLOWEDIPS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lwip/ip_addr.h"
+
+struct wireguard_peer;
+struct wireguard_allowedips_node;
+
+struct wireguard_allowedips {
+#if LWIP_IPV4
+	struct wireguard_allowedips_node *root4;
+#endif
+#if LWIP_IPV6
+	struct wireguard_allowedips_node *root6;
+#endif
+};
+
+// Routes ip/mask to peer. As with wg(8), a prefix already routed to another peer moves to this one.
+// ip and mask must be the same family and mask must be contiguous (a.b.c.d/n style). Returns false on bad
+// arguments or when out of memory, in which case the table is unchanged
+bool wireguard_allowedips_insert(struct wireguard_allowedips *table, const ip_addr_t *ip, const ip_addr_t *mask, struct wireguard_peer *peer);
+
+// The peer owning the longest prefix containing ip, NULL if none
+struct wireguard_peer *wireguard_allowedips_lookup(const struct wireguard_allowedips *table, const ip_addr_t *ip);
+
+// Drops every prefix routed to peer
+void wireguard_allowedips_remove_by_peer(struct wireguard_allowedips *table, const struct wireguard_peer *peer);
+
+// Drops every prefix and frees all nodes
+void wireguard_allowedips_clear(struct wireguard_allowedips *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIREGUARD_ALLOWEDIPS_H_ */
@@ -68,6 +68,9 @@ static mbedtls_ctr_drbg_context random_context;
 static mbedtls_entropy_context entropy_context;
 #endif
 
+// Set once the DRBG is seeded - it is shared by every tunnel and must not be reset under one that is running
+static bool random_ready = false;
+
 static int entropy_hw_random_source( void *data, unsigned char *output, size_t len, size_t *olen ) {
 	esp_fill_random(output, len);
 	*olen = len;
@@ -78,6 +81,10 @@ esp_err_t wireguard_platform_init() {
 	int mbedtls_err;
 	esp_err_t err;
 
+	if (random_ready) {
+		err = ESP_OK;
+		goto fail;
+	}
 	mbedtls_entropy_init(&entropy_context);
 	mbedtls_ctr_drbg_init(&random_context);
 	mbedtls_err = mbedtls_entropy_add_source(
@@ -102,6 +109,7 @@ esp_err_t wireguard_platform_init() {
 		err = ESP_ERR_INVALID_CRC;
 		goto fail;
 	}
+	random_ready = true;
 	err = ESP_OK;
 fail:
 	return err;
@@ -129,8 +137,4 @@ void wireguard_tai64n_now(uint8_t *output) {
 	U64TO8_BIG(output + 0, seconds);
 	U32TO8_BIG(output + 8, nanos);
 }
-
-bool wireguard_is_under_load() {
-	return false;
-}
 // vim: noexpandtab
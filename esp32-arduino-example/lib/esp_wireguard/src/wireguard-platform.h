@@ -44,17 +44,15 @@ extern "C" {
 
 #include "esp_wireguard_err.h"
 
-// Peers are allocated statically inside the device structure to avoid malloc
+// Upper limit on peers per device - they are allocated on demand (see peer_alloc), so unused ones cost nothing
 #ifdef CONFIG_WIREGUARD_MAX_PEERS
 	#define WIREGUARD_MAX_PEERS (CONFIG_WIREGUARD_MAX_PEERS)
 #else
-	#define WIREGUARD_MAX_PEERS (1)
+	#define WIREGUARD_MAX_PEERS (64)
 #endif
-
-#ifdef CONFIG_WIREGUARD_MAX_SRC_IPS
-	#define WIREGUARD_MAX_SRC_IPS (CONFIG_WIREGUARD_MAX_SRC_IPS)
-#else
-	#define WIREGUARD_MAX_SRC_IPS (1)
+// Peer indices are 8-bit and 0xFF means none
+#if (WIREGUARD_MAX_PEERS < 1) || (WIREGUARD_MAX_PEERS > 255)
+	#error "WIREGUARD_MAX_PEERS must be between 1 and 255"
 #endif
 
 // Per device limit on accepting (valid) initiation requests - per peer
@@ -64,6 +62,105 @@ extern "C" {
 	#define MAX_INITIATIONS_PER_SECOND (2)
 #endif
 
+// Number of handshake initiations kept pre-built per peer by the idle timer (0 disables pre-generation)
+#ifdef CONFIG_WIREGUARD_PREGEN_INITIATIONS
+	#define WIREGUARD_PREGEN_INITIATIONS (CONFIG_WIREGUARD_PREGEN_INITIATIONS)
+#else
+	#define WIREGUARD_PREGEN_INITIATIONS (1)
+#endif
+
+// Anti-replay window for data packets, in packets: how far out of order one may arrive and still be accepted.
+// A power of two from 128 to 8192 - every keypair carries WIREGUARD_REPLAY_WINDOW / 8 bytes of bitmap
+#ifdef CONFIG_WIREGUARD_REPLAY_WINDOW
+	#define WIREGUARD_REPLAY_WINDOW (CONFIG_WIREGUARD_REPLAY_WINDOW)
+#else
+	#define WIREGUARD_REPLAY_WINDOW (1024)
+#endif
+#if (WIREGUARD_REPLAY_WINDOW < 128) || (WIREGUARD_REPLAY_WINDOW > 8192) || ((WIREGUARD_REPLAY_WINDOW & (WIREGUARD_REPLAY_WINDOW - 1)) != 0)
+	#error "WIREGUARD_REPLAY_WINDOW must be a power of two between 128 and 8192"
+#endif
+
+// Outgoing packets held per peer while it has no session, instead of failing them - they are sent as soon as a
+// handshake completes, and the oldest is dropped when more arrive. 0 disables the queue
+#ifdef CONFIG_WIREGUARD_STAGED_PACKETS
+	#define WIREGUARD_STAGED_PACKETS (CONFIG_WIREGUARD_STAGED_PACKETS)
+#else
+	#define WIREGUARD_STAGED_PACKETS (8)
+#endif
+#if (WIREGUARD_STAGED_PACKETS < 0) || (WIREGUARD_STAGED_PACKETS > 255)
+	#error "WIREGUARD_STAGED_PACKETS must be between 0 and 255"
+#endif
+
+// MTU-sized buffers each WireGuard interface keeps for the packets it sends, so that encrypting does not go to the
+// heap for every packet - when they are all in flight the heap is used after all. 0 disables the pool
+#ifdef CONFIG_WIREGUARD_TX_POOL_SIZE
+	#define WIREGUARD_TX_POOL_SIZE (CONFIG_WIREGUARD_TX_POOL_SIZE)
+#else
+	#define WIREGUARD_TX_POOL_SIZE (4)
+#endif
+#if (WIREGUARD_TX_POOL_SIZE < 0) || (WIREGUARD_TX_POOL_SIZE > 64)
+	#error "WIREGUARD_TX_POOL_SIZE must be between 0 and 64"
+#endif
+
+// Outgoing packets queued per peer while the lwIP thread finishes what it is doing, then encrypted and sent as one
+// batch - the peer's keys are checked once and short packets share the ChaCha20 kernels. A full queue is sent
+// straight away. 0 sends each packet as it comes
+#ifdef CONFIG_WIREGUARD_TX_BATCH
+	#define WIREGUARD_TX_BATCH (CONFIG_WIREGUARD_TX_BATCH)
+#else
+	#define WIREGUARD_TX_BATCH (8)
+#endif
+#if (WIREGUARD_TX_BATCH < 0) || (WIREGUARD_TX_BATCH > 64)
+	#error "WIREGUARD_TX_BATCH must be between 0 and 64"
+#endif
+
+// Received handshakes waiting for the handshake worker, which does their X25519 work off the lwIP thread - more
+// are dropped until it catches up. 0 does without the worker and processes them on the lwIP thread
+#ifdef CONFIG_WIREGUARD_HANDSHAKE_QUEUE_LEN
+	#define WIREGUARD_HANDSHAKE_QUEUE_LEN (CONFIG_WIREGUARD_HANDSHAKE_QUEUE_LEN)
+#else
+	#define WIREGUARD_HANDSHAKE_QUEUE_LEN (4)
+#endif
+#ifdef CONFIG_WIREGUARD_HANDSHAKE_STACK_SIZE
+	#define WIREGUARD_HANDSHAKE_STACK_SIZE (CONFIG_WIREGUARD_HANDSHAKE_STACK_SIZE)
+#else
+	#define WIREGUARD_HANDSHAKE_STACK_SIZE (4096)
+#endif
+// Below the lwIP thread, so the stack keeps moving packets while a handshake is calculated
+#ifdef CONFIG_WIREGUARD_HANDSHAKE_PRIORITY
+	#define WIREGUARD_HANDSHAKE_PRIORITY (CONFIG_WIREGUARD_HANDSHAKE_PRIORITY)
+#else
+	#define WIREGUARD_HANDSHAKE_PRIORITY (5)
+#endif
+
+// CPU time received handshakes may take per second before their senders are asked for cookies (5.3), in ms
+#ifdef CONFIG_WIREGUARD_HANDSHAKE_BUDGET_MSECS
+	#define WIREGUARD_HANDSHAKE_BUDGET_MSECS (CONFIG_WIREGUARD_HANDSHAKE_BUDGET_MSECS)
+#else
+	#define WIREGUARD_HANDSHAKE_BUDGET_MSECS (250)
+#endif
+
+// Handshakes each source address may cause while under load, and how many it may send at once. Sources beyond
+// WIREGUARD_RATELIMIT_SOURCES sending at the same time are turned away
+#ifdef CONFIG_WIREGUARD_RATELIMIT_PER_SECOND
+	#define WIREGUARD_RATELIMIT_PER_SECOND (CONFIG_WIREGUARD_RATELIMIT_PER_SECOND)
+#else
+	#define WIREGUARD_RATELIMIT_PER_SECOND (20)
+#endif
+#ifdef CONFIG_WIREGUARD_RATELIMIT_BURST
+	#define WIREGUARD_RATELIMIT_BURST (CONFIG_WIREGUARD_RATELIMIT_BURST)
+#else
+	#define WIREGUARD_RATELIMIT_BURST (5)
+#endif
+#ifdef CONFIG_WIREGUARD_RATELIMIT_SOURCES
+	#define WIREGUARD_RATELIMIT_SOURCES (CONFIG_WIREGUARD_RATELIMIT_SOURCES)
+#else
+	#define WIREGUARD_RATELIMIT_SOURCES (64)
+#endif
+#if (WIREGUARD_RATELIMIT_PER_SECOND < 1) || (WIREGUARD_RATELIMIT_PER_SECOND > 1000) || (WIREGUARD_RATELIMIT_BURST < 1) || (WIREGUARD_RATELIMIT_SOURCES < 1)
+	#error "WIREGUARD_RATELIMIT_PER_SECOND must be between 1 and 1000, the burst and sources at least 1"
+#endif
+
 // Initialize crypto backend (return ESP_OK on success)
 esp_err_t wireguard_platform_init();
 
@@ -79,9 +176,6 @@ void wireguard_random_bytes(void *bytes, size_t size);
 // The remote end of the Wireguard tunnel will use this value in handshake replay detection
 void wireguard_tai64n_now(uint8_t *output);
 
-// Is the system under load - i.e. should we generate cookie reply message in response to initiation messages
-bool wireguard_is_under_load();
-
 #ifdef __cplusplus
 }
 #endif
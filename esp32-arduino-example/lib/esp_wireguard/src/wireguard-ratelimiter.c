@@ -0,0 +1,127 @@
+// vim: noexpandtab
+// Handshake admission control - see wireguard-ratelimiter.h
+
+#include "wireguard-ratelimiter.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wireguard-platform.h"
+
+#define WIREGUARD_LOAD_WINDOW_MSECS		(1000)
+// How long the load estimator stays under load once the cause is gone
+#define WIREGUARD_LOAD_HOLD_MSECS		(1000)
+// Queued handshakes that make for load - half the queue, so cookies are asked for before any is dropped
+#define WIREGUARD_LOAD_QUEUED			((WIREGUARD_HANDSHAKE_QUEUE_LEN > 1) ? (WIREGUARD_HANDSHAKE_QUEUE_LEN / 2) : 1)
+
+#define WIREGUARD_RATELIMIT_COST		(1000 / WIREGUARD_RATELIMIT_PER_SECOND)
+#define WIREGUARD_RATELIMIT_MAX_TOKENS	(WIREGUARD_RATELIMIT_COST * WIREGUARD_RATELIMIT_BURST)
+// Entries a source may hash to
+#define WIREGUARD_RATELIMIT_PROBES		((WIREGUARD_RATELIMIT_SOURCES < 8) ? WIREGUARD_RATELIMIT_SOURCES : 8)
+
+// Moves the windows along to the one holding now
+static void wireguard_load_roll(struct wireguard_load *load, uint32_t now) {
+	uint32_t elapsed = now - load->window_start;
+	if (elapsed >= (2 * WIREGUARD_LOAD_WINDOW_MSECS)) {
+		load->busy_prev = 0;
+		load->busy = 0;
+		load->window_start = now;
+	} else if (elapsed >= WIREGUARD_LOAD_WINDOW_MSECS) {
+		load->busy_prev = load->busy;
+		load->busy = 0;
+		load->window_start += WIREGUARD_LOAD_WINDOW_MSECS;
+	}
+}
+
+void wireguard_load_queued(struct wireguard_load *load, uint32_t queued) {
+	load->queued = queued;
+}
+
+void wireguard_load_busy(struct wireguard_load *load, uint32_t now, uint32_t millis) {
+	wireguard_load_roll(load, now);
+	load->busy += millis;
+}
+
+bool wireguard_load_check(struct wireguard_load *load, uint32_t now) {
+	uint32_t busy;
+	bool result;
+
+	wireguard_load_roll(load, now);
+	// The last second, taking the previous window as evenly spread over it
+	busy = load->busy + ((load->busy_prev * (WIREGUARD_LOAD_WINDOW_MSECS - (now - load->window_start))) / WIREGUARD_LOAD_WINDOW_MSECS);
+
+	result = (load->queued >= WIREGUARD_LOAD_QUEUED) || (busy > WIREGUARD_HANDSHAKE_BUDGET_MSECS);
+	if (result) {
+		load->under_load = true;
+		load->last_under_load = now;
+	} else if (load->under_load) {
+		if ((now - load->last_under_load) < WIREGUARD_LOAD_HOLD_MSECS) {
+			result = true;
+		} else {
+			load->under_load = false;
+		}
+	}
+	return result;
+}
+
+void wireguard_ratelimiter_init(struct wireguard_ratelimiter *limiter) {
+	memset(limiter, 0, sizeof(struct wireguard_ratelimiter));
+	wireguard_random_bytes(limiter->hash_key, sizeof(limiter->hash_key));
+}
+
+static uint32_t wireguard_ratelimit_hash(const struct wireguard_ratelimiter *limiter, const uint8_t *source, size_t len) {
+	// Keyed like the public key index - a seeded FNV-1a still lets a sender find colliding sources
+	return (uint32_t)wireguard_siphash(limiter->hash_key, source, len);
+}
+
+bool wireguard_ratelimiter_allow(struct wireguard_ratelimiter *limiter, const uint8_t *source_addr_port, size_t source_length, uint32_t now) {
+	struct wireguard_ratelimit_entry *entry = NULL;
+	struct wireguard_ratelimit_entry *free_entry = NULL;
+	struct wireguard_ratelimit_entry *tmp;
+	uint32_t start;
+	uint32_t elapsed;
+	uint32_t x;
+	size_t len;
+	bool result = false;
+
+	// 16 address bytes and a port for IPv6, 4 and a port for IPv4
+	len = (source_length > 6) ? WIREGUARD_RATELIMIT_SOURCE_LEN : ((source_length > 4) ? 4 : source_length);
+	start = wireguard_ratelimit_hash(limiter, source_addr_port, len) % WIREGUARD_RATELIMIT_SOURCES;
+
+	for (x=0; x < WIREGUARD_RATELIMIT_PROBES; x++) {
+		tmp = &limiter->entries[(start + x) % WIREGUARD_RATELIMIT_SOURCES];
+		if ((tmp->source_len == len) && (memcmp(tmp->source, source_addr_port, len) == 0)) {
+			entry = tmp;
+			break;
+		}
+		// An entry whose bucket has had time to fill up again is as good as a free one
+		if (!free_entry && ((tmp->source_len == 0) || ((now - tmp->last_millis) >= WIREGUARD_RATELIMIT_MAX_TOKENS))) {
+			free_entry = tmp;
+		}
+	}
+
+	if (entry) {
+		elapsed = now - entry->last_millis;
+		if (elapsed >= WIREGUARD_RATELIMIT_MAX_TOKENS) {
+			entry->tokens = WIREGUARD_RATELIMIT_MAX_TOKENS;
+		} else {
+			entry->tokens += elapsed;
+			if (entry->tokens > WIREGUARD_RATELIMIT_MAX_TOKENS) {
+				entry->tokens = WIREGUARD_RATELIMIT_MAX_TOKENS;
+			}
+		}
+		entry->last_millis = now;
+		if (entry->tokens >= WIREGUARD_RATELIMIT_COST) {
+			entry->tokens -= WIREGUARD_RATELIMIT_COST;
+			result = true;
+		}
+	} else if (free_entry) {
+		memcpy(free_entry->source, source_addr_port, len);
+		free_entry->source_len = (uint8_t)len;
+		free_entry->last_millis = now;
+		free_entry->tokens = WIREGUARD_RATELIMIT_MAX_TOKENS - WIREGUARD_RATELIMIT_COST;
+		result = true;
+	}
+	return result;
+}
@@ -0,0 +1,62 @@
+// vim: noexpandtab
+// Handshake admission control (5.3 Denial of Service Mitigation & Cookies). The load estimator decides when a
+// valid mac1 is no longer enough and senders have to prove their address with a cookie; once they have, the rate
+// limiter caps the handshake work each source address can cause, so one peer or scanner cannot take the CPU.
+// Times are wireguard_sys_now() milliseconds, passed in so that a flood can be simulated. A zeroed estimator is
+// ready to use, a rate limiter needs wireguard_ratelimiter_init().
+#ifndef _WIREGUARD_RATELIMITER_H_
+#define _WIREGUARD_RATELIMITER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wireguard-platform.h"
+#include "crypto.h"
+
+// IPv4 sources are limited per address, IPv6 ones per /64
+#define WIREGUARD_RATELIMIT_SOURCE_LEN		(8)
+
+struct wireguard_load {
+	uint32_t queued; // Handshakes waiting to be processed
+	uint32_t window_start;
+	uint32_t busy; // Milliseconds spent on handshakes since window_start
+	uint32_t busy_prev; // ...and in the second before it
+	uint32_t last_under_load;
+	bool under_load;
+};
+
+struct wireguard_ratelimit_entry {
+	uint8_t source[WIREGUARD_RATELIMIT_SOURCE_LEN];
+	uint8_t source_len; // 0 for a free entry
+	uint32_t last_millis;
+	uint32_t tokens; // Milliseconds of credit, each handshake costs 1000 / WIREGUARD_RATELIMIT_PER_SECOND
+};
+
+struct wireguard_ratelimiter {
+	uint8_t hash_key[SIPHASH_KEY_SIZE]; // Random, so the slots a source lands in cannot be chosen from outside
+	struct wireguard_ratelimit_entry entries[WIREGUARD_RATELIMIT_SOURCES];
+};
+
+void wireguard_load_queued(struct wireguard_load *load, uint32_t queued);
+// Accounts millis of CPU time spent processing a handshake
+void wireguard_load_busy(struct wireguard_load *load, uint32_t now, uint32_t millis);
+// Under load while handshakes queue up or have used more than WIREGUARD_HANDSHAKE_BUDGET_MSECS in the last
+// second - and for a second after either, so that cookies are not asked for and forgotten on every other packet
+bool wireguard_load_check(struct wireguard_load *load, uint32_t now);
+
+void wireguard_ratelimiter_init(struct wireguard_ratelimiter *limiter);
+// Takes a token for another handshake from source_addr_port (as passed to wireguard_check_mac2: the address
+// followed by the port). False if that source has used up its rate, or if all the entries it may use are held by
+// other sources that are still sending
+bool wireguard_ratelimiter_allow(struct wireguard_ratelimiter *limiter, const uint8_t *source_addr_port, size_t source_length, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIREGUARD_RATELIMITER_H_ */
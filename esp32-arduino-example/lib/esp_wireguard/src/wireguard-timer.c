@@ -0,0 +1,127 @@
+// vim: noexpandtab
+// Hashed timer wheel - see wireguard-timer.h
+
+#include "wireguard-timer.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wireguard-platform.h"
+
+#define WIREGUARD_TIMER_SLOT_MASK (WIREGUARD_TIMER_WHEEL_SLOTS - 1)
+
+// The slot index is taken from the absolute time: a turn of the wheel divides 2^32, so it is unaffected by wrapping
+static uint32_t wireguard_timer_slot(uint32_t time) {
+	return (time >> WIREGUARD_TIMER_SLOT_SHIFT) & WIREGUARD_TIMER_SLOT_MASK;
+}
+
+static uint32_t wireguard_timer_slot_start(uint32_t time) {
+	return time & ~(uint32_t)(WIREGUARD_TIMER_SLOT_MSECS - 1);
+}
+
+void wireguard_timer_disarm(struct wireguard_timer_wheel *wheel, struct wireguard_timer *timer) {
+	if (timer->pprev) {
+		*timer->pprev = timer->next;
+		if (timer->next) {
+			timer->next->pprev = timer->pprev;
+		}
+		timer->next = NULL;
+		timer->pprev = NULL;
+		wheel->count--;
+	}
+}
+
+void wireguard_timer_arm(struct wireguard_timer_wheel *wheel, struct wireguard_timer *timer, uint32_t expires) {
+	struct wireguard_timer **slot;
+	wireguard_timer_disarm(wheel, timer);
+	if (wheel->count == 0) {
+		// The clock of an empty wheel may be arbitrarily old - restart it from now
+		wheel->now = wireguard_timer_slot_start(wireguard_sys_now());
+	}
+	// A timer already due goes in the slot the next run starts with, rather than one it has passed
+	slot = &wheel->slots[wireguard_timer_slot(((int32_t)(expires - wheel->now) < 0) ? wheel->now : expires)];
+	timer->expires = expires;
+	timer->next = *slot;
+	if (timer->next) {
+		timer->next->pprev = &timer->next;
+	}
+	timer->pprev = slot;
+	*slot = timer;
+	wheel->count++;
+}
+
+bool wireguard_timer_armed(const struct wireguard_timer *timer) {
+	return (timer->pprev != NULL);
+}
+
+struct wireguard_timer *wireguard_timer_expire(struct wireguard_timer_wheel *wheel, uint32_t now) {
+	struct wireguard_timer *result = NULL;
+	struct wireguard_timer *timer;
+	uint32_t slots;
+
+	if (wheel->count > 0) {
+		if ((int32_t)(now - wheel->now) < 0) {
+			slots = 0;
+		} else {
+			slots = (now - wheel->now) >> WIREGUARD_TIMER_SLOT_SHIFT;
+			if (slots >= WIREGUARD_TIMER_WHEEL_SLOTS) {
+				// Asleep for more than a turn - every slot has to be looked at, but only once
+				slots = WIREGUARD_TIMER_WHEEL_SLOTS - 1;
+				wheel->now = wireguard_timer_slot_start(now) - (slots << WIREGUARD_TIMER_SLOT_SHIFT);
+			}
+		}
+		// Walk the slots up to the one holding now, stopping at the first timer due
+		while (!result) {
+			for (timer = wheel->slots[wireguard_timer_slot(wheel->now)]; timer; timer = timer->next) {
+				if ((int32_t)(timer->expires - now) <= 0) {
+					result = timer;
+					break;
+				}
+			}
+			if (slots == 0) {
+				break;
+			}
+			if (!result) {
+				wheel->now += WIREGUARD_TIMER_SLOT_MSECS;
+				slots--;
+			}
+		}
+		if (result) {
+			wireguard_timer_disarm(wheel, result);
+		}
+	}
+	return result;
+}
+
+bool wireguard_timer_next(const struct wireguard_timer_wheel *wheel, uint32_t *expires) {
+	const struct wireguard_timer *timer;
+	uint32_t slot_end = wheel->now + WIREGUARD_TIMER_SLOT_MSECS;
+	uint32_t x;
+	bool found = false;
+
+	if (wheel->count > 0) {
+		// Usually the first slot holding a timer for the current turn has the answer
+		for (x=0; !found && (x < WIREGUARD_TIMER_WHEEL_SLOTS); x++) {
+			for (timer = wheel->slots[wireguard_timer_slot(wheel->now + (x << WIREGUARD_TIMER_SLOT_SHIFT))]; timer; timer = timer->next) {
+				if (((int32_t)(timer->expires - slot_end) < 0) && (!found || ((int32_t)(timer->expires - *expires) < 0))) {
+					*expires = timer->expires;
+					found = true;
+				}
+			}
+			slot_end += WIREGUARD_TIMER_SLOT_MSECS;
+		}
+		if (!found) {
+			// Every timer is at least a turn away - take the earliest of them all
+			for (x=0; x < WIREGUARD_TIMER_WHEEL_SLOTS; x++) {
+				for (timer = wheel->slots[x]; timer; timer = timer->next) {
+					if (!found || ((int32_t)(timer->expires - *expires) < 0)) {
+						*expires = timer->expires;
+						found = true;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
@@ -0,0 +1,55 @@
+// vim: noexpandtab
+// Hashed timer wheel (Varghese & Lauck, scheme 6) for the per-peer deadlines. A timer hashes into one of
+// WIREGUARD_TIMER_WHEEL_SLOTS slots by its expiry time, so arming and disarming are O(1) however many timers
+// are armed, and running the wheel only visits the slots between the previous run and now.
+// Times are wireguard_sys_now() milliseconds and may wrap. The wheel does not tick by itself: the owner sleeps
+// until wireguard_timer_next() and then pops what is due with wireguard_timer_expire(), so nothing runs while
+// no timer is armed. A zeroed wheel or timer is ready to use.
+#ifndef _WIREGUARD_TIMER_H_
+#define _WIREGUARD_TIMER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 64 slots of 128ms - one turn of the wheel is ~8s. Timers further out wait in their slot for later turns
+#define WIREGUARD_TIMER_WHEEL_SLOTS		(64)
+#define WIREGUARD_TIMER_SLOT_SHIFT		(7)
+#define WIREGUARD_TIMER_SLOT_MSECS		(1UL << WIREGUARD_TIMER_SLOT_SHIFT)
+
+struct wireguard_timer {
+	struct wireguard_timer *next;
+	struct wireguard_timer **pprev; // NULL while the timer is not armed
+	uint32_t expires;
+	void *arg; // For the owner - the wheel does not use it
+};
+
+struct wireguard_timer_wheel {
+	struct wireguard_timer *slots[WIREGUARD_TIMER_WHEEL_SLOTS];
+	uint32_t now; // Start of the slot the previous run stopped at
+	uint32_t count;
+};
+
+// (Re)arms timer to expire at expires, which may already be past
+void wireguard_timer_arm(struct wireguard_timer_wheel *wheel, struct wireguard_timer *timer, uint32_t expires);
+
+// Does nothing if the timer is not armed
+void wireguard_timer_disarm(struct wireguard_timer_wheel *wheel, struct wireguard_timer *timer);
+
+bool wireguard_timer_armed(const struct wireguard_timer *timer);
+
+// Disarms and returns one timer due at now, NULL once there are none left. The caller may re-arm timers between
+// calls; one re-armed for a time not after now is returned again
+struct wireguard_timer *wireguard_timer_expire(struct wireguard_timer_wheel *wheel, uint32_t now);
+
+// The earliest expiry time of the armed timers, false if none is armed
+bool wireguard_timer_next(const struct wireguard_timer_wheel *wheel, uint32_t *expires);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIREGUARD_TIMER_H_ */
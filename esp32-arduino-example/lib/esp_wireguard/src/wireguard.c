@@ -38,6 +38,8 @@
 #include <string.h>
 #include <limits.h>
 
+#include "lwip/mem.h"
+
 #include "esp_wireguard_log.h"
 #include "crypto.h"
 
@@ -65,6 +67,12 @@ static uint8_t identifier_hash[WIREGUARD_HASH_LEN];
 
 void wireguard_init() {
 	wireguard_blake2s_ctx ctx;
+#if defined(CONFIG_WIREGUARD_CRYPTO_CALIBRATE)
+	// Pick the fastest crypto providers for this CPU - only the first call does any work
+	if (!wireguard_crypto_calibrate()) {
+		ESP_LOGE(TAG, "crypto self-test failed");
+	}
+#endif
 	// Pre-calculate chaining key hash
 	wireguard_blake2s_init(&ctx, WIREGUARD_HASH_LEN, NULL, 0);
 	wireguard_blake2s_update(&ctx, CONSTRUCTION, sizeof(CONSTRUCTION));
@@ -76,41 +84,108 @@ void wireguard_init() {
 	wireguard_blake2s_final(&ctx, identifier_hash);
 }
 
-struct wireguard_peer *peer_alloc(struct wireguard_device *device) {
-	struct wireguard_peer *result = NULL;
-	struct wireguard_peer *tmp;
-	int x;
-	for (x=0; x < WIREGUARD_MAX_PEERS; x++) {
-		tmp = &device->peers[x];
-		if (!tmp->valid) {
-			result = tmp;
+// Public key index - see struct wireguard_pubkey_entry
+
+static uint32_t wireguard_pubkey_hash(struct wireguard_device *device, const uint8_t *public_key) {
+	return (uint32_t)wireguard_siphash(device->pubkey_hash_key, public_key, WIREGUARD_PUBLIC_KEY_LEN);
+}
+
+static size_t wireguard_pubkey_slot(struct wireguard_device *device, uint32_t hash) {
+	return hash & (device->pubkey_table_size - 1);
+}
+
+// Slot holding peer (or a peer with this public key if peer is NULL), NULL if none
+static struct wireguard_pubkey_entry *wireguard_pubkey_find(struct wireguard_device *device, const uint8_t *public_key, const struct wireguard_peer *peer) {
+	struct wireguard_pubkey_entry *result = NULL;
+	struct wireguard_pubkey_entry *entry;
+	uint32_t hash;
+	size_t slot;
+	uint32_t x;
+	if (device->pubkey_table) {
+		hash = wireguard_pubkey_hash(device, public_key);
+		slot = wireguard_pubkey_slot(device, hash);
+	}
+	for (x=0; device->pubkey_table && (x < device->pubkey_table_size); x++) {
+		entry = &device->pubkey_table[slot];
+		if (!entry->peer) {
 			break;
 		}
+		if (peer ? (entry->peer == peer) : ((entry->hash == hash) && (memcmp(entry->peer->public_key, public_key, WIREGUARD_PUBLIC_KEY_LEN) == 0))) {
+			result = entry;
+			break;
+		}
+		slot = wireguard_pubkey_slot(device, slot + 1);
 	}
 	return result;
 }
 
-struct wireguard_peer *peer_lookup_by_pubkey(struct wireguard_device *device, uint8_t *public_key) {
-	struct wireguard_peer *result = NULL;
-	struct wireguard_peer *tmp;
-	int x;
-	for (x=0; x < WIREGUARD_MAX_PEERS; x++) {
-		tmp = &device->peers[x];
-		if (tmp->valid) {
-			if (memcmp(tmp->public_key, public_key, WIREGUARD_PUBLIC_KEY_LEN) == 0) {
-				result = tmp;
+static bool wireguard_pubkey_insert_hash(struct wireguard_device *device, struct wireguard_peer *peer, uint32_t hash) {
+	bool result = false;
+	struct wireguard_pubkey_entry *entry;
+	size_t slot = wireguard_pubkey_slot(device, hash);
+	uint32_t x;
+	for (x=0; x < device->pubkey_table_size; x++) {
+		entry = &device->pubkey_table[slot];
+		if (!entry->peer) {
+			entry->peer = peer;
+			entry->hash = hash;
+			result = true;
+			break;
+		}
+		slot = wireguard_pubkey_slot(device, slot + 1);
+	}
+	return result;
+}
+
+static bool wireguard_pubkey_insert(struct wireguard_device *device, struct wireguard_peer *peer) {
+	return wireguard_pubkey_insert_hash(device, peer, wireguard_pubkey_hash(device, peer->public_key));
+}
+
+static void wireguard_pubkey_remove(struct wireguard_device *device, struct wireguard_peer *peer) {
+	// Backward shift deletion as in wireguard_index_remove, using the cached hash for the home slot
+	struct wireguard_pubkey_entry *entry = wireguard_pubkey_find(device, peer->public_key, peer);
+	size_t hole;
+	size_t slot;
+	size_t home;
+	bool move;
+	uint32_t x;
+	if (entry) {
+		hole = entry - device->pubkey_table;
+		slot = hole;
+		for (x=1; x < device->pubkey_table_size; x++) {
+			slot = wireguard_pubkey_slot(device, slot + 1);
+			if (!device->pubkey_table[slot].peer) {
 				break;
 			}
+			home = wireguard_pubkey_slot(device, device->pubkey_table[slot].hash);
+			if (hole <= slot) {
+				move = (home <= hole) || (home > slot);
+			} else {
+				move = (home <= hole) && (home > slot);
+			}
+			if (move) {
+				device->pubkey_table[hole] = device->pubkey_table[slot];
+				hole = slot;
+			}
 		}
+		memset(&device->pubkey_table[hole], 0, sizeof(struct wireguard_pubkey_entry));
+	}
+}
+
+struct wireguard_peer *peer_lookup_by_pubkey(struct wireguard_device *device, uint8_t *public_key) {
+	struct wireguard_peer *result = NULL;
+	struct wireguard_pubkey_entry *entry = wireguard_pubkey_find(device, public_key, NULL);
+	if (entry && entry->peer->valid) {
+		result = entry->peer;
 	}
 	return result;
 }
 
 uint8_t wireguard_peer_index(struct wireguard_device *device, struct wireguard_peer *peer) {
 	uint8_t result = 0xFF;
-	uint8_t x;
-	for (x=0; x < WIREGUARD_MAX_PEERS; x++) {
-		if (peer == &device->peers[x]) {
+	uint16_t x;
+	for (x=0; peer && (x < device->peer_capacity); x++) {
+		if (peer == device->peers[x]) {
 			result = x;
 			break;
 		}
@@ -120,26 +195,180 @@ uint8_t wireguard_peer_index(struct wireguard_device *device, struct wireguard_p
 
 struct wireguard_peer *peer_lookup_by_peer_index(struct wireguard_device *device, uint8_t peer_index) {
 	struct wireguard_peer *result = NULL;
-	if (peer_index < WIREGUARD_MAX_PEERS) {
-		if (device->peers[peer_index].valid) {
-			result = &device->peers[peer_index];
+	if (peer_index < device->peer_capacity) {
+		if (device->peers[peer_index] && device->peers[peer_index]->valid) {
+			result = device->peers[peer_index];
 		}
 	}
 	return result;
 }
 
-struct wireguard_peer *peer_lookup_by_receiver(struct wireguard_device *device, uint32_t receiver) {
+// Receiver index table - see struct wireguard_index_entry
+
+static size_t wireguard_index_slot(struct wireguard_device *device, uint32_t index) {
+	return index & (device->index_table_size - 1);
+}
+
+static struct wireguard_index_entry *wireguard_index_find(struct wireguard_device *device, uint32_t index) {
+	struct wireguard_index_entry *result = NULL;
+	struct wireguard_index_entry *entry;
+	size_t slot = wireguard_index_slot(device, index);
+	uint32_t x;
+	if ((index != 0) && device->index_table) {
+		for (x=0; x < device->index_table_size; x++) {
+			entry = &device->index_table[slot];
+			if (entry->index == index) {
+				result = entry;
+				break;
+			} else if (entry->index == 0) {
+				break;
+			}
+			slot = wireguard_index_slot(device, slot + 1);
+		}
+	}
+	return result;
+}
+
+static bool wireguard_index_insert(struct wireguard_device *device, uint32_t index, struct wireguard_peer *peer, struct wireguard_keypair *keypair) {
+	bool result = false;
+	struct wireguard_index_entry *entry;
+	size_t slot = wireguard_index_slot(device, index);
+	uint32_t x;
+	for (x=0; x < device->index_table_size; x++) {
+		entry = &device->index_table[slot];
+		if (entry->index == 0) {
+			entry->index = index;
+			entry->peer = peer;
+			entry->keypair = keypair;
+			result = true;
+			break;
+		}
+		slot = wireguard_index_slot(device, slot + 1);
+	}
+	return result;
+}
+
+static void wireguard_index_remove(struct wireguard_device *device, struct wireguard_index_entry *entry) {
+	// Backward shift deletion: pull later entries of the probe run into the hole so lookups never stop early
+	size_t hole = entry - device->index_table;
+	size_t slot = hole;
+	size_t home;
+	bool move;
+	uint32_t x;
+	for (x=1; x < device->index_table_size; x++) {
+		slot = wireguard_index_slot(device, slot + 1);
+		if (device->index_table[slot].index == 0) {
+			break;
+		}
+		home = wireguard_index_slot(device, device->index_table[slot].index);
+		// Move it unless its home slot lies cyclically in (hole, slot]
+		if (hole <= slot) {
+			move = (home <= hole) || (home > slot);
+		} else {
+			move = (home <= hole) && (home > slot);
+		}
+		if (move) {
+			device->index_table[hole] = device->index_table[slot];
+			hole = slot;
+		}
+	}
+	memset(&device->index_table[hole], 0, sizeof(struct wireguard_index_entry));
+}
+
+// Peer pool - see struct wireguard_device
+
+static uint32_t wireguard_pow2_ceil(uint32_t value) {
+	uint32_t result = 1;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+// Frees the slot array and both tables (the peers must already be gone)
+static void wireguard_pool_release(struct wireguard_device *device) {
+	mem_free(device->peers);
+	mem_free(device->index_table);
+	mem_free(device->pubkey_table);
+	device->peers = NULL;
+	device->index_table = NULL;
+	device->pubkey_table = NULL;
+	device->peer_capacity = 0;
+	device->index_table_size = 0;
+	device->pubkey_table_size = 0;
+}
+
+// Doubles the number of peer slots (up to WIREGUARD_MAX_PEERS) and rebuilds the index and public key tables for it.
+// Leaves everything as it was if memory runs out
+static bool wireguard_pool_grow(struct wireguard_device *device) {
+	bool result = false;
+	uint16_t capacity = device->peer_capacity ? (device->peer_capacity * 2) : 1;
+	struct wireguard_peer **peers = NULL;
+	struct wireguard_index_entry *index_table = NULL;
+	struct wireguard_pubkey_entry *pubkey_table = NULL;
+	struct wireguard_index_entry *old_index_table = device->index_table;
+	struct wireguard_pubkey_entry *old_pubkey_table = device->pubkey_table;
+	uint32_t old_index_table_size = device->index_table_size;
+	uint32_t old_pubkey_table_size = device->pubkey_table_size;
+	uint32_t index_table_size;
+	uint32_t pubkey_table_size;
+	uint32_t x;
+
+	if (capacity > WIREGUARD_MAX_PEERS) {
+		capacity = WIREGUARD_MAX_PEERS;
+	}
+	if (capacity > device->peer_capacity) {
+		index_table_size = wireguard_pow2_ceil(capacity) * WIREGUARD_INDEX_SLOTS_PER_PEER;
+		pubkey_table_size = wireguard_pow2_ceil(capacity) * WIREGUARD_PUBKEY_SLOTS_PER_PEER;
+		peers = (struct wireguard_peer **)mem_calloc(capacity, sizeof(struct wireguard_peer *));
+		index_table = (struct wireguard_index_entry *)mem_calloc(index_table_size, sizeof(struct wireguard_index_entry));
+		pubkey_table = (struct wireguard_pubkey_entry *)mem_calloc(pubkey_table_size, sizeof(struct wireguard_pubkey_entry));
+		if (peers && index_table && pubkey_table) {
+			if (device->peers) {
+				memcpy(peers, device->peers, device->peer_capacity * sizeof(struct wireguard_peer *));
+				mem_free(device->peers);
+			}
+			device->peers = peers;
+			device->peer_capacity = capacity;
+
+			// Rehash into the bigger tables
+			device->index_table = index_table;
+			device->index_table_size = index_table_size;
+			for (x=0; x < old_index_table_size; x++) {
+				if (old_index_table[x].index != 0) {
+					wireguard_index_insert(device, old_index_table[x].index, old_index_table[x].peer, old_index_table[x].keypair);
+				}
+			}
+			device->pubkey_table = pubkey_table;
+			device->pubkey_table_size = pubkey_table_size;
+			for (x=0; x < old_pubkey_table_size; x++) {
+				if (old_pubkey_table[x].peer) {
+					wireguard_pubkey_insert_hash(device, old_pubkey_table[x].peer, old_pubkey_table[x].hash);
+				}
+			}
+			mem_free(old_index_table);
+			mem_free(old_pubkey_table);
+			result = true;
+		} else {
+			mem_free(peers);
+			mem_free(index_table);
+			mem_free(pubkey_table);
+		}
+	}
+	return result;
+}
+
+struct wireguard_peer *peer_alloc(struct wireguard_device *device) {
 	struct wireguard_peer *result = NULL;
-	struct wireguard_peer *tmp;
-	int x;
-	for (x=0; x < WIREGUARD_MAX_PEERS; x++) {
-		tmp = &device->peers[x];
-		if (tmp->valid) {
-			if ((tmp->curr_keypair.valid && (tmp->curr_keypair.local_index == receiver)) ||
-				(tmp->next_keypair.valid && (tmp->next_keypair.local_index == receiver)) ||
-				(tmp->prev_keypair.valid && (tmp->prev_keypair.local_index == receiver))
-				) {
-				result = tmp;
+	uint16_t x;
+	if ((device->peer_count < device->peer_capacity) || wireguard_pool_grow(device)) {
+		for (x=0; x < device->peer_capacity; x++) {
+			if (!device->peers[x]) {
+				result = (struct wireguard_peer *)mem_calloc(1, sizeof(struct wireguard_peer));
+				if (result) {
+					device->peers[x] = result;
+					device->peer_count++;
+				}
 				break;
 			}
 		}
@@ -147,17 +376,32 @@ struct wireguard_peer *peer_lookup_by_receiver(struct wireguard_device *device,
 	return result;
 }
 
+struct wireguard_keypair *keypair_lookup_by_receiver(struct wireguard_device *device, uint32_t receiver, struct wireguard_peer **peer) {
+	struct wireguard_keypair *result = NULL;
+	struct wireguard_index_entry *entry = wireguard_index_find(device, receiver);
+	if (entry && entry->keypair && entry->peer->valid && entry->keypair->valid && (entry->keypair->local_index == receiver)) {
+		result = entry->keypair;
+		if (peer) {
+			*peer = entry->peer;
+		}
+	}
+	return result;
+}
+
+struct wireguard_peer *peer_lookup_by_receiver(struct wireguard_device *device, uint32_t receiver) {
+	struct wireguard_peer *result = NULL;
+	keypair_lookup_by_receiver(device, receiver, &result);
+	return result;
+}
+
 struct wireguard_peer *peer_lookup_by_handshake(struct wireguard_device *device, uint32_t receiver) {
 	struct wireguard_peer *result = NULL;
 	struct wireguard_peer *tmp;
-	int x;
-	for (x=0; x < WIREGUARD_MAX_PEERS; x++) {
-		tmp = &device->peers[x];
-		if (tmp->valid) {
-			if (tmp->handshake.valid && tmp->handshake.initiator && (tmp->handshake.local_index == receiver)) {
-				result = tmp;
-				break;
-			}
+	struct wireguard_index_entry *entry = wireguard_index_find(device, receiver);
+	if (entry && !entry->keypair) {
+		tmp = entry->peer;
+		if (tmp->valid && tmp->handshake && tmp->handshake->valid && tmp->handshake->initiator && (tmp->handshake->local_index == receiver)) {
+			result = tmp;
 		}
 	}
 	return result;
@@ -212,12 +456,15 @@ static void wireguard_mix_hash(uint8_t *hash, const uint8_t *src, size_t src_len
 	wireguard_blake2s_final(&ctx, hash);
 }
 
-static void wireguard_hmac(uint8_t *digest, const uint8_t *key, size_t key_len, const uint8_t *text, size_t text_len) {
-	// Adapted from appendix example in RFC2104 to use BLAKE2S instead of MD5 - https://tools.ietf.org/html/rfc2104
-	wireguard_blake2s_ctx ctx;
-	uint8_t k_ipad[WIREGUARD_BLAKE2S_BLOCK_SIZE]; // inner padding - key XORd with ipad
-	uint8_t k_opad[WIREGUARD_BLAKE2S_BLOCK_SIZE]; // outer padding - key XORd with opad
+// HMAC key schedule - the inner and outer pads are compressed once per key and the resulting
+// BLAKE2s states are reused for every message authenticated under that key
+struct wireguard_hmac_ctx {
+	wireguard_blake2s_ctx inner; // state after K XOR ipad
+	wireguard_blake2s_ctx outer; // state after K XOR opad
+};
 
+static void wireguard_hmac_pads(uint8_t *k_ipad, uint8_t *k_opad, const uint8_t *key, size_t key_len) {
+	// Adapted from appendix example in RFC2104 to use BLAKE2S instead of MD5 - https://tools.ietf.org/html/rfc2104
 	uint8_t tk[WIREGUARD_HASH_LEN];
 	int i;
 	// if key is longer than BLAKE2S_BLOCK_SIZE bytes reset it to key=BLAKE2S(key)
@@ -236,8 +483,8 @@ static void wireguard_hmac(uint8_t *digest, const uint8_t *key, size_t key_len,
 	// ipad is the byte 0x36 repeated BLAKE2S_BLOCK_SIZE times
 	// opad is the byte 0x5c repeated BLAKE2S_BLOCK_SIZE times
 	// and text is the data being protected
-	memset(k_ipad, 0, sizeof(k_ipad));
-	memset(k_opad, 0, sizeof(k_opad));
+	memset(k_ipad, 0, WIREGUARD_BLAKE2S_BLOCK_SIZE);
+	memset(k_opad, 0, WIREGUARD_BLAKE2S_BLOCK_SIZE);
 	memcpy(k_ipad, key, key_len);
 	memcpy(k_opad, key, key_len);
 
@@ -246,125 +493,157 @@ static void wireguard_hmac(uint8_t *digest, const uint8_t *key, size_t key_len,
 		k_ipad[i] ^= 0x36;
 		k_opad[i] ^= 0x5c;
 	}
+	crypto_zero(tk, sizeof(tk));
+}
+
+static void wireguard_hmac_init(struct wireguard_hmac_ctx *ctx, const uint8_t *key, size_t key_len) {
+	uint8_t k_ipad[WIREGUARD_BLAKE2S_BLOCK_SIZE]; // inner padding - key XORd with ipad
+	uint8_t k_opad[WIREGUARD_BLAKE2S_BLOCK_SIZE]; // outer padding - key XORd with opad
+
+	wireguard_hmac_pads(k_ipad, k_opad, key, key_len);
+
+	wireguard_blake2s_init(&ctx->inner, WIREGUARD_HASH_LEN, NULL, 0);
+	wireguard_blake2s_update_block(&ctx->inner, k_ipad);
+	wireguard_blake2s_init(&ctx->outer, WIREGUARD_HASH_LEN, NULL, 0);
+	wireguard_blake2s_update_block(&ctx->outer, k_opad);
+
+	crypto_zero(k_ipad, sizeof(k_ipad));
+	crypto_zero(k_opad, sizeof(k_opad));
+}
+
+// Note: text must not be empty - the pad block in the midstate has already been compressed as a non-final block
+static void wireguard_hmac_digest(const struct wireguard_hmac_ctx *ctx, uint8_t *digest, const uint8_t *text, size_t text_len) {
+	wireguard_blake2s_ctx hctx;
+
 	// perform inner HASH
-	wireguard_blake2s_init(&ctx, WIREGUARD_HASH_LEN, NULL, 0); // init context for 1st pass
-	wireguard_blake2s_update(&ctx, k_ipad, WIREGUARD_BLAKE2S_BLOCK_SIZE); // start with inner pad
-	wireguard_blake2s_update(&ctx, text, text_len); // then text of datagram
-	wireguard_blake2s_final(&ctx, digest); // finish up 1st pass
+	hctx = ctx->inner;
+	wireguard_blake2s_update(&hctx, text, text_len); // text of datagram
+	wireguard_blake2s_final(&hctx, digest); // finish up 1st pass
 
 	// perform outer HASH
-	wireguard_blake2s_init(&ctx, WIREGUARD_HASH_LEN, NULL, 0); // init context for 2nd pass
-	wireguard_blake2s_update(&ctx, k_opad, WIREGUARD_BLAKE2S_BLOCK_SIZE); // start with outer pad
-	wireguard_blake2s_update(&ctx, digest, WIREGUARD_HASH_LEN); // then results of 1st hash
-	wireguard_blake2s_final(&ctx, digest); // finish up 2nd pass
+	hctx = ctx->outer;
+	wireguard_blake2s_update(&hctx, digest, WIREGUARD_HASH_LEN); // results of 1st hash
+	wireguard_blake2s_final(&hctx, digest); // finish up 2nd pass
+
+	crypto_zero(&hctx, sizeof(hctx));
 }
 
+// All of the kdf outputs are keyed by tau0 so its HMAC pads are only compressed once
 static void wireguard_kdf1(uint8_t *tau1, const uint8_t *chaining_key, const uint8_t *data, size_t data_len) {
+	struct wireguard_hmac_ctx hmac;
 	uint8_t tau0[WIREGUARD_HASH_LEN];
 	uint8_t output[WIREGUARD_HASH_LEN + 1];
 
 	// tau0 = Hmac(key, input)
 	wireguard_hmac(tau0, chaining_key, WIREGUARD_HASH_LEN, data, data_len);
+	wireguard_hmac_init(&hmac, tau0, WIREGUARD_HASH_LEN);
 	// tau1 := Hmac(tau0, 0x1)
 	output[0] = 1;
-	wireguard_hmac(output, tau0, WIREGUARD_HASH_LEN, output, 1);
+	wireguard_hmac_digest(&hmac, output, output, 1);
 	memcpy(tau1, output, WIREGUARD_HASH_LEN);
 
 	// Wipe intermediates
+	crypto_zero(&hmac, sizeof(hmac));
 	crypto_zero(tau0, sizeof(tau0));
 	crypto_zero(output, sizeof(output));
 }
 
 static void wireguard_kdf2(uint8_t *tau1, uint8_t *tau2, const uint8_t *chaining_key, const uint8_t *data, size_t data_len) {
+	struct wireguard_hmac_ctx hmac;
 	uint8_t tau0[WIREGUARD_HASH_LEN];
 	uint8_t output[WIREGUARD_HASH_LEN + 1];
 
 	// tau0 = Hmac(key, input)
 	wireguard_hmac(tau0, chaining_key, WIREGUARD_HASH_LEN, data, data_len);
+	wireguard_hmac_init(&hmac, tau0, WIREGUARD_HASH_LEN);
 	// tau1 := Hmac(tau0, 0x1)
 	output[0] = 1;
-	wireguard_hmac(output, tau0, WIREGUARD_HASH_LEN, output, 1);
+	wireguard_hmac_digest(&hmac, output, output, 1);
 	memcpy(tau1, output, WIREGUARD_HASH_LEN);
 
 	// tau2 := Hmac(tau0,tau1 || 0x2)
 	output[WIREGUARD_HASH_LEN] = 2;
-	wireguard_hmac(output, tau0, WIREGUARD_HASH_LEN, output, WIREGUARD_HASH_LEN + 1);
+	wireguard_hmac_digest(&hmac, output, output, WIREGUARD_HASH_LEN + 1);
 	memcpy(tau2, output, WIREGUARD_HASH_LEN);
 
 	// Wipe intermediates
+	crypto_zero(&hmac, sizeof(hmac));
 	crypto_zero(tau0, sizeof(tau0));
 	crypto_zero(output, sizeof(output));
 }
 
 static void wireguard_kdf3(uint8_t *tau1, uint8_t *tau2, uint8_t *tau3, const uint8_t *chaining_key, const uint8_t *data, size_t data_len) {
+	struct wireguard_hmac_ctx hmac;
 	uint8_t tau0[WIREGUARD_HASH_LEN];
 	uint8_t output[WIREGUARD_HASH_LEN + 1];
 
 	// tau0 = Hmac(key, input)
 	wireguard_hmac(tau0, chaining_key, WIREGUARD_HASH_LEN, data, data_len);
+	wireguard_hmac_init(&hmac, tau0, WIREGUARD_HASH_LEN);
 	// tau1 := Hmac(tau0, 0x1)
 	output[0] = 1;
-	wireguard_hmac(output, tau0, WIREGUARD_HASH_LEN, output, 1);
+	wireguard_hmac_digest(&hmac, output, output, 1);
 	memcpy(tau1, output, WIREGUARD_HASH_LEN);
 
 	// tau2 := Hmac(tau0,tau1 || 0x2)
 	output[WIREGUARD_HASH_LEN] = 2;
-	wireguard_hmac(output, tau0, WIREGUARD_HASH_LEN, output, WIREGUARD_HASH_LEN + 1);
+	wireguard_hmac_digest(&hmac, output, output, WIREGUARD_HASH_LEN + 1);
 	memcpy(tau2, output, WIREGUARD_HASH_LEN);
 
 	// tau3 := Hmac(tau0,tau1,tau2 || 0x3)
 	output[WIREGUARD_HASH_LEN] = 3;
-	wireguard_hmac(output, tau0, WIREGUARD_HASH_LEN, output, WIREGUARD_HASH_LEN + 1);
+	wireguard_hmac_digest(&hmac, output, output, WIREGUARD_HASH_LEN + 1);
 	memcpy(tau3, output, WIREGUARD_HASH_LEN);
 
 	// Wipe intermediates
+	crypto_zero(&hmac, sizeof(hmac));
 	crypto_zero(tau0, sizeof(tau0));
 	crypto_zero(output, sizeof(output));
 }
 
 bool wireguard_check_replay(struct wireguard_keypair *keypair, uint64_t seq) {
-	// Implementation of packet replay window - as per RFC2401
-	// Adapted from code in Appendix C at https://tools.ietf.org/html/rfc2401
-	uint32_t diff;
+	// Implementation of packet replay window - as per RFC6479: the bitmap is a ring of words indexed by the
+	// counter itself, so moving the window forward clears whole words rather than shifting every bit.
+	// Both the check and the update touch one word, plus at most WIREGUARD_REPLAY_WORDS cleared on a jump
+	uint64_t index;
+	uint64_t index_current;
+	uint64_t top;
+	uint64_t x;
+	uint32_t bit;
 	bool result = false;
-	size_t ReplayWindowSize = sizeof(keypair->replay_bitmap) * CHAR_BIT; // 32 bits
 
 	// WireGuard data packet counter starts from 0 but algorithm expects packet numbers to start from 1
 	seq++;
 
 	if (seq != 0) {
-		if (seq > keypair->replay_counter) {
-			// new larger sequence number
-			diff = seq - keypair->replay_counter;
-			if (diff < ReplayWindowSize) {
-				// In window
-				keypair->replay_bitmap <<= diff;
-				// set bit for this packet
-				keypair->replay_bitmap |= 1;
-			} else {
-				// This packet has a "way larger"
-				keypair->replay_bitmap = 1;
-			}
-			keypair->replay_counter = seq;
-			// larger is good
-			result = true;
-		} else {
-			diff = keypair->replay_counter - seq;
-			if (diff < ReplayWindowSize) {
-				if (keypair->replay_bitmap & ((uint32_t)1 << diff)) {
-					// already seen
-				} else {
-					// mark as seen
-					keypair->replay_bitmap |= ((uint32_t)1 << diff);
-					// out of order but good
-					result = true;
+		if (seq + WIREGUARD_REPLAY_WINDOW_SIZE >= keypair->replay_counter) {
+			index = seq / WIREGUARD_REPLAY_WORD_BITS;
+			if (seq > keypair->replay_counter) {
+				// new larger sequence number - clear the words it moves the window across
+				index_current = keypair->replay_counter / WIREGUARD_REPLAY_WORD_BITS;
+				top = index - index_current;
+				if (top > WIREGUARD_REPLAY_WORDS) {
+					top = WIREGUARD_REPLAY_WORDS;
 				}
+				for (x=1; x <= top; x++) {
+					keypair->replay_bitmap[(index_current + x) & (WIREGUARD_REPLAY_WORDS - 1)] = 0;
+				}
+				keypair->replay_counter = seq;
+			}
+			index &= (WIREGUARD_REPLAY_WORDS - 1);
+			bit = (uint32_t)1 << (seq & (WIREGUARD_REPLAY_WORD_BITS - 1));
+			if (keypair->replay_bitmap[index] & bit) {
+				// already seen
 			} else {
-				// too old or wrapped
+				// mark as seen - newest or out of order, but good
+				keypair->replay_bitmap[index] |= bit;
+				result = true;
 			}
+		} else {
+			// too old
 		}
 	} else {
-		// first == 0 or wrapped
+		// wrapped
 	}
 	return result;
 }
@@ -380,30 +659,29 @@ struct wireguard_keypair *get_peer_keypair_for_idx(struct wireguard_peer *peer,
 	return NULL;
 }
 
-static uint32_t wireguard_generate_unique_index(struct wireguard_device *device) {
+// A fresh random index for the peer's handshake, replacing the one it had
+static uint32_t wireguard_generate_unique_index(struct wireguard_device *device, struct wireguard_peer *peer) {
 	// We need a random 32-bit number but make sure it's not already been used in the context of this device
 	uint32_t result;
 	uint8_t buf[4];
-	int x;
-	struct wireguard_peer *peer;
-	bool existing;
+	struct wireguard_index_entry *entry;
+
+	// The previous handshake index is still ours unless wireguard_start_session handed it to a keypair
+	entry = wireguard_index_find(device, peer->handshake->local_index);
+	if (entry && !entry->keypair) {
+		wireguard_index_remove(device, entry);
+	}
+	peer->handshake->local_index = 0;
+
 	do {
 		do {
 			wireguard_random_bytes(buf, 4);
 			result = U8TO32_LITTLE(buf);
 		} while ((result == 0) || (result == 0xFFFFFFFF)); // Don't allow 0 or 0xFFFFFFFF as valid values
+	} while (wireguard_index_find(device, result));
 
-		existing = false;
-		for (x=0; x < WIREGUARD_MAX_PEERS; x++) {
-			peer = &device->peers[x];
-			existing = (result == peer->curr_keypair.local_index) ||
-					(result == peer->prev_keypair.local_index) ||
-					(result == peer->next_keypair.local_index) ||
-					(result == peer->handshake.local_index);
-
-		}
-	} while (existing);
-
+	// Cannot fail - the table has room for every index the peers can hold
+	wireguard_index_insert(device, result, peer, NULL);
 	return result;
 }
 
@@ -418,14 +696,22 @@ static void wireguard_generate_private_key(uint8_t *key) {
 }
 
 static bool wireguard_generate_public_key(uint8_t *public_key, const uint8_t *private_key) {
-	static const uint8_t basepoint[WIREGUARD_PUBLIC_KEY_LEN] = { 9 };
 	bool result = false;
 	if (memcmp(private_key, zero_key, WIREGUARD_PUBLIC_KEY_LEN) != 0) {
-		result = (wireguard_x25519(public_key, private_key, basepoint) == 0);
+		result = (wireguard_x25519_base(public_key, private_key) == 0);
 	}
 	return result;
 }
 
+// DH(private_key, public_key), unless the handshake worker already calculated it
+static void wireguard_dh(uint8_t *dst, const uint8_t *private_key, const uint8_t *public_key, const uint8_t *precalculated) {
+	if (precalculated) {
+		memcpy(dst, precalculated, WIREGUARD_PUBLIC_KEY_LEN);
+	} else {
+		wireguard_x25519(dst, private_key, public_key);
+	}
+}
+
 bool wireguard_check_mac1(struct wireguard_device *device, const uint8_t *data, size_t len, const uint8_t *mac1) {
 	bool result = false;
 	uint8_t calculated[WIREGUARD_COOKIE_LEN];
@@ -450,39 +736,132 @@ bool wireguard_check_mac2(struct wireguard_device *device, const uint8_t *data,
 	return result;
 }
 
-void keypair_destroy(struct wireguard_keypair *keypair) {
+uint8_t wireguard_check_handshake_macs(struct wireguard_device *device, const uint8_t *data, size_t len, bool under_load, uint8_t *source_addr_port, size_t source_length) {
+	uint8_t result = WIREGUARD_MACS_INVALID;
+	const uint8_t *mac1 = data + len - (2 * WIREGUARD_COOKIE_LEN);
+	const uint8_t *mac2 = data + len - WIREGUARD_COOKIE_LEN;
+
+	if (wireguard_check_mac1(device, data, len - (2 * WIREGUARD_COOKIE_LEN), mac1)) {
+		if (!under_load) {
+			// If we aren't under load we only need mac1 to be correct
+			result = WIREGUARD_MACS_VALID;
+		} else if (wireguard_check_mac2(device, data, len - WIREGUARD_COOKIE_LEN, source_addr_port, source_length, mac2)) {
+			result = WIREGUARD_MACS_VALID;
+		} else {
+			// If the responder receives a message with a valid msg.mac1 yet with an invalid msg.mac2, and is under load, it may respond with a cookie reply message
+			result = WIREGUARD_MACS_NEED_COOKIE;
+		}
+	}
+	return result;
+}
+
+void keypair_destroy(struct wireguard_device *device, struct wireguard_keypair *keypair) {
+	// Only free the index if this copy is the one the table points at - see keypair_move
+	struct wireguard_index_entry *entry = wireguard_index_find(device, keypair->local_index);
+	if (entry && (entry->keypair == keypair)) {
+		wireguard_index_remove(device, entry);
+	}
 	crypto_zero(keypair, sizeof(struct wireguard_keypair));
 	keypair->valid = false;
 }
 
-void keypair_update(struct wireguard_peer *peer, struct wireguard_keypair *received_keypair) {
+// The peer's handshake, allocated if it has none yet. NULL when out of memory
+static struct wireguard_handshake *handshake_get(struct wireguard_peer *peer) {
+	if (!peer->handshake) {
+		peer->handshake = (struct wireguard_handshake *)mem_calloc(1, sizeof(struct wireguard_handshake));
+	}
+	return peer->handshake;
+}
+
+void handshake_destroy(struct wireguard_device *device, struct wireguard_peer *peer) {
+	struct wireguard_handshake *handshake = peer->handshake;
+	struct wireguard_index_entry *entry;
+	if (handshake) {
+		entry = wireguard_index_find(device, handshake->local_index);
+		if (entry && !entry->keypair) {
+			wireguard_index_remove(device, entry);
+		}
+		crypto_zero(handshake, sizeof(struct wireguard_handshake));
+		mem_free(handshake);
+		peer->handshake = NULL;
+	}
+}
+
+static void peer_clear(struct wireguard_device *device, struct wireguard_peer *peer) {
+	wireguard_timer_disarm(&device->timers, &peer->timer);
+	if (peer->valid) {
+		// Free its receiver indices, public key slot and allowed IPs before the peer goes
+		keypair_destroy(device, &peer->next_keypair);
+		keypair_destroy(device, &peer->curr_keypair);
+		keypair_destroy(device, &peer->prev_keypair);
+		handshake_destroy(device, peer);
+		wireguard_pubkey_remove(device, peer);
+		wireguard_allowedips_remove_by_peer(&device->allowedips, peer);
+	}
+	crypto_zero(peer, sizeof(struct wireguard_peer));
+	peer->valid = false;
+}
+
+void peer_free(struct wireguard_device *device, struct wireguard_peer *peer) {
+	uint8_t x = wireguard_peer_index(device, peer);
+	if (x != 0xFF) {
+		peer_clear(device, peer);
+		device->peers[x] = NULL;
+		device->peer_count--;
+		mem_free(peer);
+		if (device->peer_count == 0) {
+			// Nothing left to index - hand the tables back too
+			wireguard_pool_release(device);
+		}
+	}
+}
+
+// Copies a keypair over another slot of the peer (destroying what was there) and points its index at the new copy
+static void keypair_move(struct wireguard_device *device, struct wireguard_keypair *dst, const struct wireguard_keypair *src) {
+	struct wireguard_index_entry *entry;
+	keypair_destroy(device, dst);
+	*dst = *src;
+	if (dst->valid) {
+		entry = wireguard_index_find(device, dst->local_index);
+		if (entry) {
+			entry->keypair = dst;
+		}
+	}
+}
+
+struct wireguard_keypair *keypair_update(struct wireguard_device *device, struct wireguard_peer *peer, struct wireguard_keypair *received_keypair) {
+	struct wireguard_keypair *result = received_keypair;
 	bool key_is_next = (received_keypair == &peer->next_keypair);
 	if (key_is_next) {
-		peer->prev_keypair = peer->curr_keypair;
-		peer->curr_keypair = peer->next_keypair;
-		keypair_destroy(&peer->next_keypair);
+		keypair_move(device, &peer->prev_keypair, &peer->curr_keypair);
+		keypair_move(device, &peer->curr_keypair, &peer->next_keypair);
+		keypair_destroy(device, &peer->next_keypair);
+		result = &peer->curr_keypair;
 	}
+	return result;
 }
 
-static void add_new_keypair(struct wireguard_peer *peer, struct wireguard_keypair new_keypair) {
-	if (new_keypair.initiator) {
+static void add_new_keypair(struct wireguard_device *device, struct wireguard_peer *peer, const struct wireguard_keypair *new_keypair) {
+	if (new_keypair->initiator) {
 		if (peer->next_keypair.valid) {
-			peer->prev_keypair = peer->next_keypair;
-			keypair_destroy(&peer->next_keypair);
+			keypair_move(device, &peer->prev_keypair, &peer->next_keypair);
+			keypair_destroy(device, &peer->next_keypair);
 		} else  {
-			peer->prev_keypair = peer->curr_keypair;
+			keypair_move(device, &peer->prev_keypair, &peer->curr_keypair);
 		}
-		peer->curr_keypair = new_keypair;
+		keypair_move(device, &peer->curr_keypair, new_keypair);
 	} else {
-		peer->next_keypair =  new_keypair;
-		keypair_destroy(&peer->prev_keypair);
+		keypair_move(device, &peer->next_keypair, new_keypair);
+		keypair_destroy(device, &peer->prev_keypair);
 	}
-	peer->latest_handshake_millis = new_keypair.keypair_millis;
+	peer->latest_handshake_millis = new_keypair->keypair_millis;
 }
 
-void wireguard_start_session(struct wireguard_peer *peer, bool initiator) {
-	struct wireguard_handshake *handshake = &peer->handshake;
+void wireguard_start_session(struct wireguard_device *device, struct wireguard_peer *peer, bool initiator) {
+	struct wireguard_handshake *handshake = peer->handshake;
 	struct wireguard_keypair new_keypair;
+	uint8_t sending_key[WIREGUARD_SESSION_KEY_LEN];
+	uint8_t receiving_key[WIREGUARD_SESSION_KEY_LEN];
 
 	crypto_zero(&new_keypair, sizeof(struct wireguard_keypair));
 	new_keypair.initiator = initiator;
@@ -496,12 +875,17 @@ void wireguard_start_session(struct wireguard_peer *peer, bool initiator) {
 	// 5.4.5 Transport Data Key Derivation
 	// (Tsendi = Trecvr, Trecvi = Tsendr) := Kdf2(Ci = Cr,E)
 	if (new_keypair.initiator) {
-		wireguard_kdf2(new_keypair.sending_key, new_keypair.receiving_key, handshake->chaining_key, NULL, 0);
+		wireguard_kdf2(sending_key, receiving_key, handshake->chaining_key, NULL, 0);
 	} else {
-		wireguard_kdf2(new_keypair.receiving_key, new_keypair.sending_key, handshake->chaining_key, NULL, 0);
+		wireguard_kdf2(receiving_key, sending_key, handshake->chaining_key, NULL, 0);
 	}
+	// Expand the key schedule once here rather than for every packet
+	wireguard_aead_key_init(&new_keypair.sending_key, sending_key);
+	wireguard_aead_key_init(&new_keypair.receiving_key, receiving_key);
+	crypto_zero(sending_key, sizeof(sending_key));
+	crypto_zero(receiving_key, sizeof(receiving_key));
 
-	new_keypair.replay_bitmap = 0;
+	memset(new_keypair.replay_bitmap, 0, sizeof(new_keypair.replay_bitmap));
 	new_keypair.replay_counter = 0;
 
 	new_keypair.last_tx = 0;
@@ -510,15 +894,11 @@ void wireguard_start_session(struct wireguard_peer *peer, bool initiator) {
 	new_keypair.valid = true;
 
 	// Eprivi = Epubi = Eprivr = Epubr = Ci = Cr := E
-	crypto_zero(handshake->ephemeral_private, WIREGUARD_PUBLIC_KEY_LEN);
-	crypto_zero(handshake->remote_ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
-	crypto_zero(handshake->hash, WIREGUARD_HASH_LEN);
-	crypto_zero(handshake->chaining_key, WIREGUARD_HASH_LEN);
-	handshake->remote_index = 0;
-	handshake->local_index = 0;
-	handshake->valid = false;
+	handshake->local_index = 0; // Its table entry now belongs to the keypair, see keypair_move
+	handshake_destroy(device, peer);
 
-	add_new_keypair(peer, new_keypair);
+	add_new_keypair(device, peer, &new_keypair);
+	crypto_zero(&new_keypair, sizeof(new_keypair));
 }
 
 uint8_t wireguard_get_message_type(const uint8_t *data, size_t len) {
@@ -554,10 +934,59 @@ uint8_t wireguard_get_message_type(const uint8_t *data, size_t len) {
 	return result;
 }
 
-struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_device *device, struct message_handshake_initiation *msg) {
+void wireguard_handshake_dh_prepare(struct wireguard_handshake_dh *dh, const uint8_t *ephemeral_private) {
+	crypto_zero(dh, sizeof(struct wireguard_handshake_dh));
+	if (ephemeral_private) {
+		memcpy(dh->ephemeral_private, ephemeral_private, WIREGUARD_PRIVATE_KEY_LEN);
+	} else {
+		wireguard_generate_private_key(dh->ephemeral_private);
+	}
+}
+
+bool wireguard_handshake_dh_initiation(const uint8_t *private_key, const uint8_t *initiation_hash, const struct message_handshake_initiation *msg, struct wireguard_handshake_dh *dh) {
+	uint8_t key[WIREGUARD_SESSION_KEY_LEN];
+	uint8_t chaining_key[WIREGUARD_HASH_LEN];
+	uint8_t hash[WIREGUARD_HASH_LEN];
+	uint8_t s[WIREGUARD_PUBLIC_KEY_LEN];
+	bool result = false;
+
+	// The same steps as wireguard_process_initiation_message up to decrypting Spubi, which the response needs
+	memcpy(chaining_key, construction_hash, WIREGUARD_HASH_LEN);
+	memcpy(hash, initiation_hash, WIREGUARD_HASH_LEN);
+	wireguard_kdf1(chaining_key, chaining_key, msg->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
+	wireguard_mix_hash(hash, msg->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
+
+	// DH(Eprivi,Spubr)
+	wireguard_x25519(dh->static_ephemeral, private_key, msg->ephemeral);
+	if (!crypto_equal(dh->static_ephemeral, zero_key, WIREGUARD_PUBLIC_KEY_LEN)) {
+		wireguard_kdf2(chaining_key, key, chaining_key, dh->static_ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
+		if (wireguard_aead_decrypt(s, msg->enc_static, sizeof(msg->enc_static), hash, WIREGUARD_HASH_LEN, 0, key)) {
+			// Then what wireguard_create_handshake_response needs: Epubr, DH(Eprivr, Epubi) and DH(Eprivr, Spubi)
+			if (wireguard_generate_public_key(dh->ephemeral_public, dh->ephemeral_private)) {
+				wireguard_x25519(dh->ephemeral_ephemeral, dh->ephemeral_private, msg->ephemeral);
+				wireguard_x25519(dh->ephemeral_static, dh->ephemeral_private, s);
+				result = true;
+			}
+		}
+	}
+
+	crypto_zero(key, sizeof(key));
+	crypto_zero(hash, sizeof(hash));
+	crypto_zero(chaining_key, sizeof(chaining_key));
+	return result;
+}
+
+bool wireguard_handshake_dh_response(const uint8_t *private_key, const struct message_handshake_response *msg, struct wireguard_handshake_dh *dh) {
+	// DH(Eprivi, Epubr) and DH(Sprivi, Epubr)
+	wireguard_x25519(dh->ephemeral_ephemeral, dh->ephemeral_private, msg->ephemeral);
+	wireguard_x25519(dh->static_ephemeral, private_key, msg->ephemeral);
+	return !crypto_equal(dh->ephemeral_ephemeral, zero_key, WIREGUARD_PUBLIC_KEY_LEN) && !crypto_equal(dh->static_ephemeral, zero_key, WIREGUARD_PUBLIC_KEY_LEN);
+}
+
+struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_device *device, struct message_handshake_initiation *msg, const struct wireguard_handshake_dh *dh) {
 	struct wireguard_peer *ret_peer = NULL;
 	struct wireguard_peer *peer = NULL;
-	struct wireguard_handshake *handshake;
+	struct wireguard_handshake *handshake = NULL;
 	uint8_t key[WIREGUARD_SESSION_KEY_LEN];
 	uint8_t chaining_key[WIREGUARD_HASH_LEN];
 	uint8_t hash[WIREGUARD_HASH_LEN];
@@ -575,10 +1004,9 @@ struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_dev
 	memcpy(chaining_key, construction_hash, WIREGUARD_HASH_LEN);
 
 	// Hi := Hash(Ci || Identifier
-	memcpy(hash, identifier_hash, WIREGUARD_HASH_LEN);
-
 	// Hi := Hash(Hi || Spubr)
-	wireguard_mix_hash(hash, device->public_key, WIREGUARD_PUBLIC_KEY_LEN);
+	// (precalculated in wireguard_device_init)
+	memcpy(hash, device->initiation_hash, WIREGUARD_HASH_LEN);
 
 	 // Ci := Kdf1(Ci, Epubi)
 	wireguard_kdf1(chaining_key, chaining_key, msg->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
@@ -590,7 +1018,7 @@ struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_dev
 	wireguard_mix_hash(hash, msg->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
 
 	// Calculate DH(Eprivi,Spubr)
-	wireguard_x25519(dh_calculation, device->private_key, e);
+	wireguard_dh(dh_calculation, device->private_key, e, dh ? dh->static_ephemeral : NULL);
 	if (!crypto_equal(dh_calculation, zero_key, WIREGUARD_PUBLIC_KEY_LEN)) {
 
 		// (Ci,k) := Kdf2(Ci,DH(Eprivi,Spubr))
@@ -603,8 +1031,6 @@ struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_dev
 
 			peer = peer_lookup_by_pubkey(device, s);
 			if (peer) {
-				handshake = &peer->handshake;
-
 				// (Ci,k) := Kdf2(Ci,DH(Sprivi,Spubr))
 				wireguard_kdf2(chaining_key, key, chaining_key, peer->public_key_dh, WIREGUARD_PUBLIC_KEY_LEN);
 
@@ -620,6 +1046,10 @@ struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_dev
 					rate_limit = (peer->last_initiation_rx - now) < (1000 / MAX_INITIATIONS_PER_SECOND);
 
 					if (!replay && !rate_limit) {
+						handshake = handshake_get(peer);
+					}
+
+					if (handshake) {
 						// Success! Copy everything to peer
 						peer->last_initiation_rx = now;
 						if (memcmp(t, peer->greatest_timestamp, WIREGUARD_TAI64N_LEN) > 0) {
@@ -658,8 +1088,8 @@ struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_dev
 	return ret_peer;
 }
 
-bool wireguard_process_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *src) {
-	struct wireguard_handshake *handshake = &peer->handshake;
+bool wireguard_process_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *src, const struct wireguard_handshake_dh *dh) {
+	struct wireguard_handshake *handshake = peer->handshake;
 
 	bool result = false;
 	uint8_t key[WIREGUARD_SESSION_KEY_LEN];
@@ -672,7 +1102,8 @@ bool wireguard_process_handshake_response(struct wireguard_device *device, struc
 	uint8_t dh_calculation[WIREGUARD_PUBLIC_KEY_LEN];
 	uint8_t tau[WIREGUARD_PUBLIC_KEY_LEN];
 
-	if (handshake->valid && handshake->initiator) {
+	// A dh calculated for an initiation we have since replaced is of no use
+	if (handshake && handshake->valid && handshake->initiator && (!dh || crypto_equal(dh->ephemeral_private, handshake->ephemeral_private, WIREGUARD_PRIVATE_KEY_LEN))) {
 
 		memcpy(hash, handshake->hash, WIREGUARD_HASH_LEN);
 		memcpy(chaining_key, handshake->chaining_key, WIREGUARD_HASH_LEN);
@@ -693,13 +1124,13 @@ bool wireguard_process_handshake_response(struct wireguard_device *device, struc
 
 		// Cr := Kdf1(Cr, DH(Eprivr, Epubi))
 		// Calculate DH(Eprivr, Epubi)
-		wireguard_x25519(dh_calculation, ephemeral_private, e);
+		wireguard_dh(dh_calculation, ephemeral_private, e, dh ? dh->ephemeral_ephemeral : NULL);
 		if (!crypto_equal(dh_calculation, zero_key, WIREGUARD_PUBLIC_KEY_LEN)) {
 			wireguard_kdf1(chaining_key, chaining_key, dh_calculation, WIREGUARD_PUBLIC_KEY_LEN);
 
 			// Cr := Kdf1(Cr, DH(Eprivr, Spubi))
 			// CalculateDH(Eprivr, Spubi)
-			wireguard_x25519(dh_calculation, device->private_key, e);
+			wireguard_dh(dh_calculation, device->private_key, e, dh ? dh->static_ephemeral : NULL);
 			if (!crypto_equal(dh_calculation, zero_key, WIREGUARD_PUBLIC_KEY_LEN)) {
 				wireguard_kdf1(chaining_key, chaining_key, dh_calculation, WIREGUARD_PUBLIC_KEY_LEN);
 
@@ -749,16 +1180,16 @@ bool wireguard_process_cookie_message(struct wireguard_device *device, struct wi
 	uint8_t cookie[WIREGUARD_COOKIE_LEN];
 	bool result = false;
 
-	if (peer->handshake_mac1_valid) {
+	if (peer->handshake && peer->handshake->mac1_valid) {
 
-		result = wireguard_xaead_decrypt(cookie, src->enc_cookie, sizeof(src->enc_cookie), peer->handshake_mac1, WIREGUARD_COOKIE_LEN, src->nonce, peer->label_cookie_key);
+		result = wireguard_xaead_decrypt(cookie, src->enc_cookie, sizeof(src->enc_cookie), peer->handshake->mac1, WIREGUARD_COOKIE_LEN, src->nonce, peer->label_cookie_key);
 
 		if (result) {
 			// 5.4.7 Under Load: Cookie Reply Message
 			// Upon receiving this message, if it is valid, the only thing the recipient of this message should do is store the cookie along with the time at which it was received
 			memcpy(peer->cookie, cookie, WIREGUARD_COOKIE_LEN);
 			peer->cookie_millis = wireguard_sys_now();
-			peer->handshake_mac1_valid = false;
+			peer->handshake->mac1_valid = false;
 		}
 	} else {
 		// We didn't send any initiation packet so we shouldn't be getting a cookie reply!
@@ -766,72 +1197,174 @@ bool wireguard_process_cookie_message(struct wireguard_device *device, struct wi
 	return result;
 }
 
-bool wireguard_create_handshake_initiation(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_initiation *dst) {
-	uint8_t timestamp[WIREGUARD_TAI64N_LEN];
-	uint8_t key[WIREGUARD_SESSION_KEY_LEN];
-	uint8_t dh_calculation[WIREGUARD_PUBLIC_KEY_LEN];
+bool wireguard_handshake_dh_pregen(const uint8_t *public_key, struct wireguard_handshake_dh *dh) {
 	bool result = false;
+	// (Eprivi, Epubi) := DH-Generate() - Eprivi was drawn by wireguard_handshake_dh_prepare on the lwIP thread
+	if (wireguard_generate_public_key(dh->ephemeral_public, dh->ephemeral_private)) {
+		// DH(Eprivi,Spubr)
+		wireguard_x25519(dh->ephemeral_static, dh->ephemeral_private, public_key);
+		result = !crypto_equal(dh->ephemeral_static, zero_key, WIREGUARD_PUBLIC_KEY_LEN);
+	}
+	return result;
+}
 
-	struct wireguard_handshake *handshake = &peer->handshake;
-
-	memset(dst, 0, sizeof(struct message_handshake_initiation));
+// Everything in an initiation up to (but not including) the timestamp - none of it depends on when the message is sent
+static bool wireguard_build_initiation_prefix(struct wireguard_device *device, struct wireguard_peer *peer, struct wireguard_pregen_initiation *dst, const struct wireguard_handshake_dh *dh) {
+	struct wireguard_handshake_dh local_dh;
+	bool result = false;
 
-	// Ci := Hash(Construction) (precalculated hash)
-	memcpy(handshake->chaining_key, construction_hash, WIREGUARD_HASH_LEN);
+	if (!dh) {
+		wireguard_handshake_dh_prepare(&local_dh, NULL);
+		if (wireguard_handshake_dh_pregen(peer->public_key, &local_dh)) {
+			dh = &local_dh;
+		}
+	}
 
-	// Hi := Hash(Ci || Identifier)
-	memcpy(handshake->hash, identifier_hash, WIREGUARD_HASH_LEN);
+	if (dh) {
+		// Ci := Hash(Construction) (precalculated hash)
+		memcpy(dst->chaining_key, construction_hash, WIREGUARD_HASH_LEN);
 
-	// Hi := Hash(Hi || Spubr)
-	wireguard_mix_hash(handshake->hash, peer->public_key, WIREGUARD_PUBLIC_KEY_LEN);
+		// Hi := Hash(Ci || Identifier)
+		// Hi := Hash(Hi || Spubr)
+		// (precalculated in wireguard_peer_init)
+		memcpy(dst->hash, peer->initiation_hash, WIREGUARD_HASH_LEN);
 
-	// (Eprivi, Epubi) := DH-Generate()
-	wireguard_generate_private_key(handshake->ephemeral_private);
-	if (wireguard_generate_public_key(dst->ephemeral, handshake->ephemeral_private)) {
+		// (Eprivi, Epubi) := DH-Generate()
+		memcpy(dst->ephemeral_private, dh->ephemeral_private, WIREGUARD_PRIVATE_KEY_LEN);
+		memcpy(dst->ephemeral, dh->ephemeral_public, WIREGUARD_PUBLIC_KEY_LEN);
 
 		// Ci := Kdf1(Ci, Epubi)
-		wireguard_kdf1(handshake->chaining_key, handshake->chaining_key, dst->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
+		wireguard_kdf1(dst->chaining_key, dst->chaining_key, dst->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
 
 		// msg.ephemeral := Epubi
-		// Done above - public keys is calculated into dst->ephemeral
-
 		// Hi := Hash(Hi || msg.ephemeral)
-		wireguard_mix_hash(handshake->hash, dst->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
+		wireguard_mix_hash(dst->hash, dst->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
 
-		// Calculate DH(Eprivi,Spubr)
-		wireguard_x25519(dh_calculation, handshake->ephemeral_private, peer->public_key);
-		if (!crypto_equal(dh_calculation, zero_key, WIREGUARD_PUBLIC_KEY_LEN)) {
+		// (Ci,k) := Kdf2(Ci,DH(Eprivi,Spubr))
+		wireguard_kdf2(dst->chaining_key, dst->key, dst->chaining_key, dh->ephemeral_static, WIREGUARD_PUBLIC_KEY_LEN);
 
-			// (Ci,k) := Kdf2(Ci,DH(Eprivi,Spubr))
-			wireguard_kdf2(handshake->chaining_key, key, handshake->chaining_key, dh_calculation, WIREGUARD_PUBLIC_KEY_LEN);
+		// msg.static := AEAD(k,0,Spubi, Hi)
+		wireguard_aead_encrypt(dst->enc_static, device->public_key, WIREGUARD_PUBLIC_KEY_LEN, dst->hash, WIREGUARD_HASH_LEN, 0, dst->key);
 
-			// msg.static := AEAD(k,0,Spubi, Hi)
-			wireguard_aead_encrypt(dst->enc_static, device->public_key, WIREGUARD_PUBLIC_KEY_LEN, handshake->hash, WIREGUARD_HASH_LEN, 0, key);
+		// Hi := Hash(Hi || msg.static)
+		wireguard_mix_hash(dst->hash, dst->enc_static, sizeof(dst->enc_static));
 
-			// Hi := Hash(Hi || msg.static)
-			wireguard_mix_hash(handshake->hash, dst->enc_static, sizeof(dst->enc_static));
+		// (Ci,k) := Kdf2(Ci,DH(Sprivi,Spubr))
+		// note DH(Sprivi,Spubr) is precomputed per peer
+		wireguard_kdf2(dst->chaining_key, dst->key, dst->chaining_key, peer->public_key_dh, WIREGUARD_PUBLIC_KEY_LEN);
 
-			// (Ci,k) := Kdf2(Ci,DH(Sprivi,Spubr))
-			// note DH(Sprivi,Spubr) is precomputed per peer
-			wireguard_kdf2(handshake->chaining_key, key, handshake->chaining_key, peer->public_key_dh, WIREGUARD_PUBLIC_KEY_LEN);
+		dst->created_millis = wireguard_sys_now();
+		dst->valid = true;
+		result = true;
+	}
 
-			// msg.timestamp := AEAD(k, 0, Timestamp(), Hi)
-			wireguard_tai64n_now(timestamp);
-			wireguard_aead_encrypt(dst->enc_timestamp, timestamp, WIREGUARD_TAI64N_LEN, handshake->hash, WIREGUARD_HASH_LEN, 0, key);
+	crypto_zero(&local_dh, sizeof(local_dh));
+	return result;
+}
 
-			// Hi := Hash(Hi || msg.timestamp)
-			wireguard_mix_hash(handshake->hash, dst->enc_timestamp, sizeof(dst->enc_timestamp));
+// Fill one empty or stale pre-generated initiation slot for this peer
+// Returns true if a slot was (re)built, false if they were all still usable (or pre-generation is disabled)
+bool wireguard_pregenerate_initiation(struct wireguard_device *device, struct wireguard_peer *peer, const struct wireguard_handshake_dh *dh) {
+	bool result = false;
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+	struct wireguard_pregen_initiation *slot;
+	int x;
 
-			dst->type = MESSAGE_HANDSHAKE_INITIATION;
-			dst->sender = wireguard_generate_unique_index(device);
+	for (x = 0; x < WIREGUARD_PREGEN_INITIATIONS; x++) {
+		slot = &peer->pregen[x];
+		if (!slot->valid || wireguard_expired(slot->created_millis, PREGEN_INITIATION_MAX_AGE)) {
+			crypto_zero(slot, sizeof(struct wireguard_pregen_initiation));
+			if (!wireguard_build_initiation_prefix(device, peer, slot, dh)) {
+				crypto_zero(slot, sizeof(struct wireguard_pregen_initiation));
+			}
+			result = slot->valid;
+			break;
+		}
+	}
+#endif
+	return result;
+}
 
-			handshake->valid = true;
-			handshake->initiator = true;
-			handshake->local_index = dst->sender;
+bool wireguard_pregen_initiation_due(struct wireguard_peer *peer, uint32_t *due_millis) {
+	bool result = false;
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+	uint32_t now = wireguard_sys_now();
+	uint32_t due;
+	int x;
 
+	for (x = 0; x < WIREGUARD_PREGEN_INITIATIONS; x++) {
+		due = peer->pregen[x].valid ? (peer->pregen[x].created_millis + (PREGEN_INITIATION_MAX_AGE * 1000)) : now;
+		if (!result || ((int32_t)(due - *due_millis) < 0)) {
+			*due_millis = due;
 			result = true;
 		}
 	}
+#endif
+	return result;
+}
+
+static struct wireguard_pregen_initiation *wireguard_take_pregen_initiation(struct wireguard_peer *peer) {
+	struct wireguard_pregen_initiation *result = NULL;
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+	struct wireguard_pregen_initiation *slot;
+	int x;
+
+	for (x = 0; x < WIREGUARD_PREGEN_INITIATIONS; x++) {
+		slot = &peer->pregen[x];
+		if (slot->valid && !wireguard_expired(slot->created_millis, PREGEN_INITIATION_MAX_AGE)) {
+			result = slot;
+			break;
+		}
+	}
+#endif
+	return result;
+}
+
+bool wireguard_create_handshake_initiation(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_initiation *dst) {
+	uint8_t timestamp[WIREGUARD_TAI64N_LEN];
+	struct wireguard_pregen_initiation built;
+	struct wireguard_pregen_initiation *prefix = NULL;
+	bool result = false;
+
+	struct wireguard_handshake *handshake = handshake_get(peer);
+
+	memset(dst, 0, sizeof(struct message_handshake_initiation));
+	crypto_zero(&built, sizeof(built));
+
+	if (handshake) {
+		// Use an initiation prepared by the idle timer if there is one, otherwise do the whole thing now
+		prefix = wireguard_take_pregen_initiation(peer);
+		if (!prefix && wireguard_build_initiation_prefix(device, peer, &built, NULL)) {
+			prefix = &built;
+		}
+	}
+
+	if (prefix) {
+		memcpy(handshake->ephemeral_private, prefix->ephemeral_private, WIREGUARD_PRIVATE_KEY_LEN);
+		memcpy(handshake->chaining_key, prefix->chaining_key, WIREGUARD_HASH_LEN);
+		memcpy(handshake->hash, prefix->hash, WIREGUARD_HASH_LEN);
+		memcpy(dst->ephemeral, prefix->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
+		memcpy(dst->enc_static, prefix->enc_static, sizeof(dst->enc_static));
+
+		// msg.timestamp := AEAD(k, 0, Timestamp(), Hi)
+		wireguard_tai64n_now(timestamp);
+		wireguard_aead_encrypt(dst->enc_timestamp, timestamp, WIREGUARD_TAI64N_LEN, handshake->hash, WIREGUARD_HASH_LEN, 0, prefix->key);
+
+		// Hi := Hash(Hi || msg.timestamp)
+		wireguard_mix_hash(handshake->hash, dst->enc_timestamp, sizeof(dst->enc_timestamp));
+
+		dst->type = MESSAGE_HANDSHAKE_INITIATION;
+		dst->sender = wireguard_generate_unique_index(device, peer);
+
+		handshake->valid = true;
+		handshake->initiator = true;
+		handshake->local_index = dst->sender;
+
+		// An ephemeral key must never be used for more than one initiation
+		crypto_zero(prefix, sizeof(struct wireguard_pregen_initiation));
+
+		result = true;
+	}
 
 	if (result) {
 		// 5.4.4 Cookie MACs
@@ -850,13 +1383,12 @@ bool wireguard_create_handshake_initiation(struct wireguard_device *device, stru
 		}
 	}
 
-	crypto_zero(key, sizeof(key));
-	crypto_zero(dh_calculation, sizeof(dh_calculation));
+	crypto_zero(&built, sizeof(built));
 	return result;
 }
 
-bool wireguard_create_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *dst) {
-	struct wireguard_handshake *handshake = &peer->handshake;
+bool wireguard_create_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *dst, const struct wireguard_handshake_dh *dh) {
+	struct wireguard_handshake *handshake = peer->handshake;
 	uint8_t key[WIREGUARD_SESSION_KEY_LEN];
 	uint8_t dh_calculation[WIREGUARD_PUBLIC_KEY_LEN];
 	uint8_t tau[WIREGUARD_HASH_LEN];
@@ -864,11 +1396,16 @@ bool wireguard_create_handshake_response(struct wireguard_device *device, struct
 
 	memset(dst, 0, sizeof(struct message_handshake_response));
 
-	if (handshake->valid && !handshake->initiator) {
+	if (handshake && handshake->valid && !handshake->initiator) {
 
 		// (Eprivr, Epubr) := DH-Generate()
-		wireguard_generate_private_key(handshake->ephemeral_private);
-		if (wireguard_generate_public_key(dst->ephemeral, handshake->ephemeral_private)) {
+		if (dh) {
+			memcpy(handshake->ephemeral_private, dh->ephemeral_private, WIREGUARD_PRIVATE_KEY_LEN);
+			memcpy(dst->ephemeral, dh->ephemeral_public, WIREGUARD_PUBLIC_KEY_LEN);
+		} else {
+			wireguard_generate_private_key(handshake->ephemeral_private);
+		}
+		if (dh || wireguard_generate_public_key(dst->ephemeral, handshake->ephemeral_private)) {
 
 			// Cr := Kdf1(Cr,Epubr)
 			wireguard_kdf1(handshake->chaining_key, handshake->chaining_key, dst->ephemeral, WIREGUARD_PUBLIC_KEY_LEN);
@@ -881,13 +1418,13 @@ bool wireguard_create_handshake_response(struct wireguard_device *device, struct
 
 			// Cr := Kdf1(Cr, DH(Eprivr, Epubi))
 			// Calculate DH(Eprivi,Spubr)
-			wireguard_x25519(dh_calculation, handshake->ephemeral_private, handshake->remote_ephemeral);
+			wireguard_dh(dh_calculation, handshake->ephemeral_private, handshake->remote_ephemeral, dh ? dh->ephemeral_ephemeral : NULL);
 			if (!crypto_equal(dh_calculation, zero_key, WIREGUARD_PUBLIC_KEY_LEN)) {
 				wireguard_kdf1(handshake->chaining_key, handshake->chaining_key, dh_calculation, WIREGUARD_PUBLIC_KEY_LEN);
 
 				// Cr := Kdf1(Cr, DH(Eprivr, Spubi))
 				// Calculate DH(Eprivi,Spubr)
-				wireguard_x25519(dh_calculation, handshake->ephemeral_private, peer->public_key);
+				wireguard_dh(dh_calculation, handshake->ephemeral_private, peer->public_key, dh ? dh->ephemeral_static : NULL);
 				if (!crypto_equal(dh_calculation, zero_key, WIREGUARD_PUBLIC_KEY_LEN)) {
 					wireguard_kdf1(handshake->chaining_key, handshake->chaining_key, dh_calculation, WIREGUARD_PUBLIC_KEY_LEN);
 
@@ -905,7 +1442,7 @@ bool wireguard_create_handshake_response(struct wireguard_device *device, struct
 
 					dst->type = MESSAGE_HANDSHAKE_RESPONSE;
 					dst->receiver = handshake->remote_index;
-					dst->sender = wireguard_generate_unique_index(device);
+					dst->sender = wireguard_generate_unique_index(device, peer);
 					// Update handshake object too
 					handshake->local_index = dst->sender;
 
@@ -955,8 +1492,8 @@ void wireguard_create_cookie_reply(struct wireguard_device *device, struct messa
 }
 
 bool wireguard_peer_init(struct wireguard_device *device, struct wireguard_peer *peer, const uint8_t *public_key, const uint8_t *preshared_key) {
-	// Clear out structure
-	memset(peer, 0, sizeof(struct wireguard_peer));
+	// Clear out structure (and anything the device still indexes it under)
+	peer_clear(device, peer);
 
 	if (device->valid) {
 		// Copy across the public key into our peer structure
@@ -968,10 +1505,6 @@ bool wireguard_peer_init(struct wireguard_device *device, struct wireguard_peer
 		}
 
 		if (wireguard_x25519(peer->public_key_dh, device->private_key, peer->public_key) == 0) {
-			// Zero out handshake
-			memset(&peer->handshake, 0, sizeof(struct wireguard_handshake));
-			peer->handshake.valid = false;
-
 			// Zero out any cookie info - we haven't received one yet
 			peer->cookie_millis = 0;
 			memset(&peer->cookie, 0, WIREGUARD_COOKIE_LEN);
@@ -980,7 +1513,11 @@ bool wireguard_peer_init(struct wireguard_device *device, struct wireguard_peer
 			wireguard_mac_key(peer->label_mac1_key, peer->public_key, LABEL_MAC1, sizeof(LABEL_MAC1));
 			wireguard_mac_key(peer->label_cookie_key, peer->public_key, LABEL_COOKIE, sizeof(LABEL_COOKIE));
 
-			peer->valid = true;
+			// Precompute the part of the initiation hash that only depends on the peer's static key
+			memcpy(peer->initiation_hash, identifier_hash, WIREGUARD_HASH_LEN);
+			wireguard_mix_hash(peer->initiation_hash, peer->public_key, WIREGUARD_PUBLIC_KEY_LEN);
+
+			peer->valid = wireguard_pubkey_insert(device, peer);
 		} else {
 			crypto_zero(peer->public_key_dh, WIREGUARD_PUBLIC_KEY_LEN);
 		}
@@ -991,6 +1528,17 @@ bool wireguard_peer_init(struct wireguard_device *device, struct wireguard_peer
 bool wireguard_device_init(struct wireguard_device *device, const uint8_t *private_key) {
 	// Set the private key and calculate public key from it
 	memcpy(device->private_key, private_key, WIREGUARD_PRIVATE_KEY_LEN);
+	// No peers yet - peer_alloc allocates the pool on first use
+	device->peers = NULL;
+	device->peer_capacity = 0;
+	device->peer_count = 0;
+	device->index_table = NULL;
+	device->index_table_size = 0;
+	device->pubkey_table = NULL;
+	device->pubkey_table_size = 0;
+	memset(&device->timers, 0, sizeof(device->timers));
+	device->timer_scheduled = false;
+	wireguard_random_bytes(device->pubkey_hash_key, sizeof(device->pubkey_hash_key));
 	// Ensure private key is correctly "clamped"
 	wireguard_clamp_private_key(device->private_key);
 	device->valid = wireguard_generate_public_key(device->public_key, private_key);
@@ -1000,6 +1548,9 @@ bool wireguard_device_init(struct wireguard_device *device, const uint8_t *priva
 		wireguard_mac_key(device->label_mac1_key, device->public_key, LABEL_MAC1, sizeof(LABEL_MAC1));
 		// 5.4.7 Under Load: Cookie Reply Message - The value Hash(Label-Cookie || Spubm) above can be pre-computed.
 		wireguard_mac_key(device->label_cookie_key, device->public_key, LABEL_COOKIE, sizeof(LABEL_COOKIE));
+		// 5.4.2 As responder Hr := Hash(Hash(Cr || Identifier) || Spubr) only depends on our own static key
+		memcpy(device->initiation_hash, identifier_hash, WIREGUARD_HASH_LEN);
+		wireguard_mix_hash(device->initiation_hash, device->public_key, WIREGUARD_PUBLIC_KEY_LEN);
 
 	} else {
 		crypto_zero(device->private_key, WIREGUARD_PRIVATE_KEY_LEN);
@@ -1007,13 +1558,36 @@ bool wireguard_device_init(struct wireguard_device *device, const uint8_t *priva
 	return device->valid;
 }
 
+void wireguard_device_fini(struct wireguard_device *device) {
+	uint16_t x;
+	for (x=0; x < device->peer_capacity; x++) {
+		if (device->peers[x]) {
+			peer_free(device, device->peers[x]);
+		}
+	}
+	wireguard_allowedips_clear(&device->allowedips);
+	wireguard_pool_release(device);
+}
+
 void wireguard_encrypt_packet(uint8_t *dst, const uint8_t *src, size_t src_len, struct wireguard_keypair *keypair) {
-	wireguard_aead_encrypt(dst, src, src_len, NULL, 0, keypair->sending_counter, keypair->sending_key);
+	wireguard_aead_encrypt_key(dst, src, src_len, NULL, 0, keypair->sending_counter, &keypair->sending_key);
 	keypair->sending_counter++;
 }
 
 bool wireguard_decrypt_packet(uint8_t *dst, const uint8_t *src, size_t src_len, uint64_t counter, struct wireguard_keypair *keypair) {
-	return wireguard_aead_decrypt(dst, src, src_len, NULL, 0, counter, keypair->receiving_key);
+	return wireguard_aead_decrypt_key(dst, src, src_len, NULL, 0, counter, &keypair->receiving_key);
+}
+
+void wireguard_encrypt_packet_start(struct wireguard_aead_stream *stream, uint64_t counter, struct wireguard_keypair *keypair) {
+	wireguard_aead_stream_init(stream, NULL, 0, counter, &keypair->sending_key);
+}
+
+void wireguard_encrypt_packets(struct wireguard_aead_message *packets, size_t count, struct wireguard_keypair *keypair) {
+	wireguard_aead_encrypt_batch(packets, count, &keypair->sending_key);
+}
+
+void wireguard_decrypt_packet_start(struct wireguard_aead_stream *stream, uint64_t counter, struct wireguard_keypair *keypair) {
+	wireguard_aead_stream_init(stream, NULL, 0, counter, &keypair->receiving_key);
 }
 
 bool wireguard_base64_decode(const char *str, uint8_t *out, size_t *outlen) {
@@ -51,6 +51,15 @@ extern "C" {
 // Platform-specific functions that need to be implemented per-platform
 #include "wireguard-platform.h"
 
+// Crypto primitives - needed for the cached session key contexts held in each keypair
+#include "crypto.h"
+
+// Cryptokey routing - allowed IPs of every peer
+#include "wireguard-allowedips.h"
+
+// Per-peer deadlines
+#include "wireguard-timer.h"
+
 // tai64n contains 64-bit seconds and 32-bit nano offset (12 bytes)
 #define WIREGUARD_TAI64N_LEN		(12)
 // Auth algorithm is chacha20pol1305 which is 128bit (16 byte) authenticator
@@ -74,29 +83,40 @@ extern "C" {
 #define REKEY_AFTER_TIME			(120)
 #define REJECT_AFTER_TIME			(180)
 #define REKEY_TIMEOUT				(5)
+#define PREGEN_INITIATION_MAX_AGE	(REKEY_AFTER_TIME)
+
+// RFC 6479 anti-replay ring - see wireguard_check_replay(). The word holding the newest counter is only partly
+// filled, so a packet is accepted up to WIREGUARD_REPLAY_WINDOW_SIZE counters behind it
+#define WIREGUARD_REPLAY_WORD_BITS		(32)
+#define WIREGUARD_REPLAY_WORDS			(WIREGUARD_REPLAY_WINDOW / WIREGUARD_REPLAY_WORD_BITS)
+#define WIREGUARD_REPLAY_WINDOW_SIZE	(WIREGUARD_REPLAY_WINDOW - WIREGUARD_REPLAY_WORD_BITS)
 
 struct wireguard_keypair {
 	bool valid;
 	bool initiator; // Did we initiate this session (send the initiation packet rather than sending the response packet)
 	uint32_t keypair_millis;
 
-	uint8_t sending_key[WIREGUARD_SESSION_KEY_LEN];
+	struct wireguard_aead_key sending_key; // Expanded once when the session starts
 	bool sending_valid;
 	uint64_t sending_counter;
 
-	uint8_t receiving_key[WIREGUARD_SESSION_KEY_LEN];
+	struct wireguard_aead_key receiving_key;
 	bool receiving_valid;
 
 	uint32_t last_tx;
 	uint32_t last_rx;
 
-	uint32_t replay_bitmap;
-	uint64_t replay_counter;
+	uint64_t replay_counter; // Highest counter received + 1, 0 before the first packet
 
 	uint32_t local_index; // This is the index we generated for our end
 	uint32_t remote_index; // This is the index on the other end
+
+	// Counters seen, bit (counter + 1) % WIREGUARD_REPLAY_WINDOW - last as only one word of it is read per packet
+	uint32_t replay_bitmap[WIREGUARD_REPLAY_WORDS];
 };
 
+// Only exists while a handshake is in flight - allocated when we send or accept an initiation and freed once the
+// session starts (or the peer is reset), so an idle peer carries none of it
 struct wireguard_handshake {
 	bool valid;
 	bool initiator;
@@ -106,28 +126,91 @@ struct wireguard_handshake {
 	uint8_t remote_ephemeral[WIREGUARD_PUBLIC_KEY_LEN];
 	uint8_t hash[WIREGUARD_HASH_LEN];
 	uint8_t chaining_key[WIREGUARD_HASH_LEN];
+
+	// The latest mac1 we sent with an initiation - a cookie reply is only accepted for that
+	bool mac1_valid;
+	uint8_t mac1[WIREGUARD_COOKIE_LEN];
 };
 
-struct wireguard_allowed_ip {
+// The part of an initiation that does not depend on the send time: the ephemeral keypair, the encrypted static
+// and the hash chain up to the timestamp - built ahead of time so only the timestamp AEAD and MACs are left to do
+struct wireguard_pregen_initiation {
 	bool valid;
-	ip_addr_t ip;
-	ip_addr_t mask;
+	uint32_t created_millis;
+	uint8_t ephemeral_private[WIREGUARD_PRIVATE_KEY_LEN];
+	uint8_t ephemeral[WIREGUARD_PUBLIC_KEY_LEN];
+	uint8_t enc_static[WIREGUARD_PUBLIC_KEY_LEN + WIREGUARD_AUTHTAG_LEN];
+	uint8_t hash[WIREGUARD_HASH_LEN];
+	uint8_t chaining_key[WIREGUARD_HASH_LEN];
+	uint8_t key[WIREGUARD_SESSION_KEY_LEN]; // Timestamp key from Kdf2(Ci,DH(Sprivi,Spubr))
 };
 
+// The X25519 results for one received handshake message, or for an initiation being pre-generated. Processing the
+// message needs them alongside state only the lwIP thread may touch, but they depend on nothing besides the message,
+// the static keys and the ephemeral private key - so the handshake worker calculates them elsewhere and the lwIP
+// thread is left with hashing and AEAD
+struct wireguard_handshake_dh {
+	uint8_t ephemeral_private[WIREGUARD_PRIVATE_KEY_LEN]; // Ours: the response's Eprivr, or the initiation's Eprivi
+	uint8_t ephemeral_public[WIREGUARD_PUBLIC_KEY_LEN]; // Epubr for an initiation, Epubi for a pre-generated one
+	uint8_t static_ephemeral[WIREGUARD_PUBLIC_KEY_LEN]; // DH(Spriv, remote Epub)
+	uint8_t ephemeral_ephemeral[WIREGUARD_PUBLIC_KEY_LEN]; // DH(Epriv, remote Epub)
+	uint8_t ephemeral_static[WIREGUARD_PUBLIC_KEY_LEN]; // DH(Eprivr, Spubi) for an initiation, DH(Eprivi, Spubr) for a pre-generated one
+};
+
+// Fields are ordered by how often they are touched. The data path (sending, receiving and the periodic timer)
+// only reads the first block, so for an established session it stays within the first few cache lines;
+// configuration, handshake and cookie material comes after it, and the handshake itself is out of line
 struct wireguard_peer {
 	bool valid; // Is this peer initialised?
 	bool active; // Should we be actively trying to connect?
+	// We set this flag on RX/TX of packets if we think that we should initiate a new handshake
+	bool send_handshake;
+	// keep-alive interval in seconds, 0 is disable
+	uint16_t keepalive_interval;
 
-	// This is the configured IP of the peer (endpoint)
-	ip_addr_t connect_ip;
-	u16_t connect_port;
 	// This is the latest received IP/port
 	ip_addr_t ip;
 	u16_t port;
-	// keep-alive interval in seconds, 0 is disable
-	uint16_t keepalive_interval;
 
-	struct wireguard_allowed_ip allowed_source_ips[WIREGUARD_MAX_SRC_IPS];
+	// last_tx and last_rx of data packets
+	uint32_t last_tx;
+	uint32_t last_rx;
+
+	// Session keypairs - curr_keypair carries the traffic, the other two only matter around a rekey
+	struct wireguard_keypair curr_keypair;
+	struct wireguard_keypair prev_keypair;
+	struct wireguard_keypair next_keypair;
+
+	// The time of the latest completed handshake
+	uint32_t latest_handshake_millis;
+	// The last time we received a valid initiation message
+	uint32_t last_initiation_rx;
+	// The last time we sent an initiation message to this peer
+	uint32_t last_initiation_tx;
+
+	// Due when the next keepalive, handshake, key expiry or pre-generation is - see wireguardif_timer_update()
+	struct wireguard_timer timer;
+
+	// The active handshake that is happening, NULL when there is none
+	struct wireguard_handshake *handshake;
+
+#if WIREGUARD_STAGED_PACKETS > 0
+	// Packets sent while there was no session to send them with, oldest first - owned by wireguardif, which sends
+	// them once a session starts and frees them before the peer is cleared
+	struct pbuf *staged[WIREGUARD_STAGED_PACKETS];
+	uint8_t staged_head;
+	uint8_t staged_count;
+#endif
+
+#if WIREGUARD_TX_BATCH > 0
+	// Packets waiting for the next batch to go out, in order - owned by wireguardif like staged
+	struct pbuf *tx_batch[WIREGUARD_TX_BATCH];
+	uint8_t tx_batch_count;
+#endif
+
+	// This is the configured IP of the peer (endpoint)
+	ip_addr_t connect_ip;
+	u16_t connect_port;
 
 	uint8_t public_key[WIREGUARD_PUBLIC_KEY_LEN];
 	uint8_t preshared_key[WIREGUARD_SESSION_KEY_LEN];
@@ -135,43 +218,44 @@ struct wireguard_peer {
 	// Precomputed DH(Sprivi,Spubr) with device private key, and peer public key
 	uint8_t public_key_dh[WIREGUARD_PUBLIC_KEY_LEN];
 
-	// Session keypairs
-	struct wireguard_keypair curr_keypair;
-	struct wireguard_keypair prev_keypair;
-	struct wireguard_keypair next_keypair;
+	// Precomputed Hi := Hash(Hash(Ci || Identifier) || Spubr) - the starting hash of every initiation we send to this peer
+	uint8_t initiation_hash[WIREGUARD_HASH_LEN];
 
 	// 5.1 Silence is a Virtue: The responder keeps track of the greatest timestamp received per peer
 	uint8_t greatest_timestamp[WIREGUARD_TAI64N_LEN];
 
-	// The active handshake that is happening
-	struct wireguard_handshake handshake;
-
-	// The time of the latest completed handshake
-	uint32_t latest_handshake_millis;
-
 	// Decrypted cookie from the responder
 	uint32_t cookie_millis;
 	uint8_t cookie[WIREGUARD_COOKIE_LEN];
 
-	// The latest mac1 we sent with initiation
-	bool handshake_mac1_valid;
-	uint8_t handshake_mac1[WIREGUARD_COOKIE_LEN];
-
 	// Precomputed keys for use in mac validation
 	uint8_t label_cookie_key[WIREGUARD_SESSION_KEY_LEN];
 	uint8_t label_mac1_key[WIREGUARD_SESSION_KEY_LEN];
 
-	// The last time we received a valid initiation message
-	uint32_t last_initiation_rx;
-	// The last time we sent an initiation message to this peer
-	uint32_t last_initiation_tx;
+#if WIREGUARD_PREGEN_INITIATIONS > 0
+	// Initiations prepared ahead of time by wireguard_pregenerate_initiation()
+	struct wireguard_pregen_initiation pregen[WIREGUARD_PREGEN_INITIATIONS];
+#endif
+	bool pregen_pending; // The handshake worker is calculating an initiation for pregen
+};
 
-	// last_tx and last_rx of data packets
-	uint32_t last_tx;
-	uint32_t last_rx;
+// Every local index in use on a device - one per handshake in progress and one per keypair - hashed on the index
+// itself (it is random) with linear probing. Room for all of them at half load; grows with the peer pool
+#define WIREGUARD_INDEX_SLOTS_PER_PEER (8)
 
-	// We set this flag on RX/TX of packets if we think that we should initiate a new handshake
-	bool send_handshake;
+struct wireguard_index_entry {
+	uint32_t index; // 0 marks a free slot (never generated)
+	struct wireguard_peer *peer;
+	struct wireguard_keypair *keypair; // NULL while the index belongs to the peer's handshake
+};
+
+// Static public key -> peer for initiation processing and peer registration. Public keys are chosen by whoever
+// sends the initiation, so the slot comes from SipHash keyed with a per-device random secret. Linear probing
+#define WIREGUARD_PUBKEY_SLOTS_PER_PEER (2)
+
+struct wireguard_pubkey_entry {
+	struct wireguard_peer *peer; // NULL marks a free slot
+	uint32_t hash; // Low bits of the SipHash - compared before the key itself
 };
 
 struct wireguard_device {
@@ -190,9 +274,37 @@ struct wireguard_device {
 	// Precalculated
  	uint8_t label_cookie_key[WIREGUARD_SESSION_KEY_LEN];
 	uint8_t label_mac1_key[WIREGUARD_SESSION_KEY_LEN];
-
-	// List of peers associated with this device
- 	struct wireguard_peer peers[WIREGUARD_MAX_PEERS];
+	// Hr := Hash(Hash(Cr || Identifier) || Spubr) - the starting hash of every initiation we receive
+	uint8_t initiation_hash[WIREGUARD_HASH_LEN];
+
+	// Peers associated with this device, allocated on demand (see peer_alloc) - NULL for a free slot
+	// The slot number is the peer index. Capacity doubles as needed up to WIREGUARD_MAX_PEERS
+	struct wireguard_peer **peers;
+	uint16_t peer_capacity;
+	uint16_t peer_count;
+
+	// Allowed IPs of all peers - used to pick the peer for outgoing packets and to check incoming ones
+	struct wireguard_allowedips allowedips;
+
+	// Receiver index -> (peer, keypair) for demultiplexing incoming messages
+	// Both tables are sized from the peer capacity (rounded up to a power of two) and rebuilt when it grows
+	struct wireguard_index_entry *index_table;
+	uint32_t index_table_size;
+
+	// Public key -> peer, see struct wireguard_pubkey_entry
+	struct wireguard_pubkey_entry *pubkey_table;
+	uint32_t pubkey_table_size;
+	uint8_t pubkey_hash_key[SIPHASH_KEY_SIZE];
+
+	// Buffers for outgoing messages, see wireguardif_tx_alloc - NULL when there is no pool
+	struct wireguardif_tx_pool *tx_pool;
+	// Sends the queued batches from the lwIP thread, see wireguardif_tx_queue - NULL when packets are sent as they come
+	struct wireguardif_tx_drain *tx_drain;
+
+	// The timers of all peers, and when the lwIP timeout that runs them is due (if one is scheduled)
+	struct wireguard_timer_wheel timers;
+	uint32_t timer_expires;
+	bool timer_scheduled;
 
 	bool valid;
 };
@@ -250,41 +362,88 @@ struct message_transport_data {
 // Initialise the WireGuard system - need to call this before anything else
 void wireguard_init();
 bool wireguard_device_init(struct wireguard_device *device, const uint8_t *private_key);
+// Frees every peer and the memory the device allocated for them - the device structure itself is the caller's
+void wireguard_device_fini(struct wireguard_device *device);
 bool wireguard_peer_init(struct wireguard_device *device, struct wireguard_peer *peer, const uint8_t *public_key, const uint8_t *preshared_key);
 
+// A zeroed peer in a free slot of the device, growing the pool if needed. NULL when WIREGUARD_MAX_PEERS are in
+// use or out of memory. Initialise it with wireguard_peer_init, or hand it back with peer_free. Growing replaces the
+// tables packets are looked up in, so like peer_free it may only be called where packets are processed (the lwIP thread)
 struct wireguard_peer *peer_alloc(struct wireguard_device *device);
 uint8_t wireguard_peer_index(struct wireguard_device *device, struct wireguard_peer *peer);
 struct wireguard_peer *peer_lookup_by_pubkey(struct wireguard_device *device, uint8_t *public_key);
 struct wireguard_peer *peer_lookup_by_peer_index(struct wireguard_device *device, uint8_t peer_index);
 struct wireguard_peer *peer_lookup_by_receiver(struct wireguard_device *device, uint32_t receiver);
+// The keypair a transport data message addressed to receiver belongs to (and its peer), NULL if none
+struct wireguard_keypair *keypair_lookup_by_receiver(struct wireguard_device *device, uint32_t receiver, struct wireguard_peer **peer);
 struct wireguard_peer *peer_lookup_by_handshake(struct wireguard_device *device, uint32_t receiver);
 
-void wireguard_start_session(struct wireguard_peer *peer, bool initiator);
+void wireguard_start_session(struct wireguard_device *device, struct wireguard_peer *peer, bool initiator);
 
-void keypair_update(struct wireguard_peer *peer, struct wireguard_keypair *received_keypair);
-void keypair_destroy(struct wireguard_keypair *keypair);
+// Promotes next to current once the peer has used it - returns where received_keypair lives afterwards
+struct wireguard_keypair *keypair_update(struct wireguard_device *device, struct wireguard_peer *peer, struct wireguard_keypair *received_keypair);
+void keypair_destroy(struct wireguard_device *device, struct wireguard_keypair *keypair);
+// Abandons the handshake in progress, if any, and frees its index
+void handshake_destroy(struct wireguard_device *device, struct wireguard_peer *peer);
+// Destroys the peer's session state, drops it from the device's indices and returns its memory - peer is invalid afterwards
+void peer_free(struct wireguard_device *device, struct wireguard_peer *peer);
 
 struct wireguard_keypair *get_peer_keypair_for_idx(struct wireguard_peer *peer, uint32_t idx);
 bool wireguard_check_replay(struct wireguard_keypair *keypair, uint64_t seq);
 
 uint8_t wireguard_get_message_type(const uint8_t *data, size_t len);
 
-struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_device *device, struct message_handshake_initiation *msg);
-bool wireguard_process_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *src);
+// Handshake messages are processed in two steps when the X25519 work should not run on the lwIP thread: prepare the
+// DH values there - ephemeral_private is the Eprivi of our initiation for a response, or NULL to generate the Eprivr
+// for answering an initiation (the random generator is not thread safe) - then calculate them on any thread from
+// copies of the device's private key and initiation hash. False if the message is bad
+void wireguard_handshake_dh_prepare(struct wireguard_handshake_dh *dh, const uint8_t *ephemeral_private);
+bool wireguard_handshake_dh_initiation(const uint8_t *private_key, const uint8_t *initiation_hash, const struct message_handshake_initiation *msg, struct wireguard_handshake_dh *dh);
+bool wireguard_handshake_dh_response(const uint8_t *private_key, const struct message_handshake_response *msg, struct wireguard_handshake_dh *dh);
+// Epubi and DH(Eprivi, Spubr) for an initiation to the peer with this public key
+bool wireguard_handshake_dh_pregen(const uint8_t *public_key, struct wireguard_handshake_dh *dh);
+
+// dh is the result of the matching wireguard_handshake_dh_* call, or NULL to do the X25519 work here
+struct wireguard_peer *wireguard_process_initiation_message(struct wireguard_device *device, struct message_handshake_initiation *msg, const struct wireguard_handshake_dh *dh);
+bool wireguard_process_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *src, const struct wireguard_handshake_dh *dh);
 bool wireguard_process_cookie_message(struct wireguard_device *device, struct wireguard_peer *peer, struct message_cookie_reply *src);
 
+// dh is the result of wireguard_handshake_dh_pregen(), or NULL to do the X25519 work here
+bool wireguard_pregenerate_initiation(struct wireguard_device *device, struct wireguard_peer *peer, const struct wireguard_handshake_dh *dh);
+// When wireguard_pregenerate_initiation() next has a slot to fill - false if pre-generation is disabled
+bool wireguard_pregen_initiation_due(struct wireguard_peer *peer, uint32_t *due_millis);
 bool wireguard_create_handshake_initiation(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_initiation *dst);
-bool wireguard_create_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *dst);
+// dh is the one the initiation was processed with, or NULL
+bool wireguard_create_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *dst, const struct wireguard_handshake_dh *dh);
 void wireguard_create_cookie_reply(struct wireguard_device *device, struct message_cookie_reply *dst, const uint8_t *mac1, uint32_t index, uint8_t *source_addr_port, size_t source_length);
 
 
 bool wireguard_check_mac1(struct wireguard_device *device, const uint8_t *data, size_t len, const uint8_t *mac1);
 bool wireguard_check_mac2(struct wireguard_device *device, const uint8_t *data, size_t len, uint8_t *source_addr_port, size_t source_length, const uint8_t *mac2);
+// 5.3 Denial of Service Mitigation & Cookies - what the MACs of a received initiation or response (len bytes
+// from data, ending with mac1 and mac2) allow. Under load a valid mac1 is not enough: the sender also has to
+// prove its source address with a cookie, and is sent one first if its mac2 does not match
+#define WIREGUARD_MACS_INVALID		(0)
+#define WIREGUARD_MACS_VALID		(1)
+#define WIREGUARD_MACS_NEED_COOKIE	(2)
+uint8_t wireguard_check_handshake_macs(struct wireguard_device *device, const uint8_t *data, size_t len, bool under_load, uint8_t *source_addr_port, size_t source_length);
 
 bool wireguard_expired(uint32_t created_millis, uint32_t valid_seconds);
 
 void wireguard_encrypt_packet(uint8_t *dst, const uint8_t *src, size_t src_len, struct wireguard_keypair *keypair);
 bool wireguard_decrypt_packet(uint8_t *dst, const uint8_t *src, size_t src_len, uint64_t counter, struct wireguard_keypair *keypair);
+// As above for a packet that is not in one piece: start, then every segment in order (in place if need be), then
+// finish to append the auth tag or verify to check the received one. Unlike wireguard_encrypt_packet, starting to
+// encrypt leaves keypair->sending_counter to the caller, which has taken counter from it
+void wireguard_encrypt_packet_start(struct wireguard_aead_stream *stream, uint64_t counter, struct wireguard_keypair *keypair);
+void wireguard_decrypt_packet_start(struct wireguard_aead_stream *stream, uint64_t counter, struct wireguard_keypair *keypair);
+#define wireguard_encrypt_packet_segment(stream,dst,src,len) wireguard_aead_stream_encrypt(stream,dst,src,len)
+#define wireguard_decrypt_packet_segment(stream,dst,src,len) wireguard_aead_stream_decrypt(stream,dst,src,len)
+#define wireguard_encrypt_packet_finish(stream,tag) wireguard_aead_stream_finish(stream,tag)
+#define wireguard_decrypt_packet_verify(stream,tag) wireguard_aead_stream_verify(stream,tag)
+// Encrypts count packets from their src into their dst, each zero padded to len and followed by room for its tag,
+// on the sending counter in its nonce member - which the caller has taken from keypair->sending_counter
+void wireguard_encrypt_packets(struct wireguard_aead_message *packets, size_t count, struct wireguard_keypair *keypair);
 
 bool wireguard_base64_decode(const char *str, uint8_t *out, size_t *outlen);
 bool wireguard_base64_encode(const uint8_t *in, size_t inlen, char *out, size_t *outlen);
@@ -45,6 +45,7 @@
 #include "lwip/mem.h"
 #include "lwip/sys.h"
 #include "lwip/timeouts.h"
+#include "lwip/tcpip.h"
 
 #include "esp_wireguard_log.h"
 #include "esp_wireguard_err.h"
@@ -55,36 +56,41 @@
 #endif  // (!defined(ESP8266) || defined(IDF_VER)) && !defined(LIBRETINY)
 
 #include "wireguard.h"
+#include "wireguard-ratelimiter.h"
 #include "crypto.h"
 
-#define WIREGUARDIF_TIMER_MSECS 400
+// Something due that could not be done when its timer fired (no buffer, no usable key, another x25519 already
+// ran in the same pass) is tried again after this long
+#define WIREGUARDIF_TIMER_RETRY_MSECS 400
+// Random delay added to every peer deadline so that peers configured alike do not all fire at once
+#define WIREGUARDIF_TIMER_JITTER_MSECS 333
+
+// The handshake worker needs an OS - without one, handshakes are processed on the lwIP thread
+#if (WIREGUARD_HANDSHAKE_QUEUE_LEN > 0) && !NO_SYS
+#define WIREGUARDIF_HANDSHAKE_WORKER 1
+#else
+#define WIREGUARDIF_HANDSHAKE_WORKER 0
+#endif
+
+// Batches are sent from an lwIP callback
+#if (WIREGUARD_TX_BATCH > 0) && !NO_SYS
+#define WIREGUARDIF_TX_BATCH 1
+#else
+#define WIREGUARDIF_TX_BATCH 0
+#endif
 
 #define TAG "wireguardif"
 
+static void wireguardif_tmr(void *arg);
+static void wireguardif_peer_timer_update(struct wireguard_device *device, struct wireguard_peer *peer);
+static void wireguardif_update_link(struct wireguard_device *device);
+static err_t wireguard_start_handshake(struct netif *netif, struct wireguard_peer *peer);
+
 static void update_peer_addr(struct wireguard_peer *peer, const ip_addr_t *addr, u16_t port) {
 	peer->ip = *addr;
 	peer->port = port;
 }
 
-static struct wireguard_peer *peer_lookup_by_allowed_ip(struct wireguard_device *device, const ip_addr_t *ipaddr) {
-	struct wireguard_peer *result = NULL;
-	struct wireguard_peer *tmp;
-	int x;
-	int y;
-	for (x=0; (!result) && (x < WIREGUARD_MAX_PEERS); x++) {
-		tmp = &device->peers[x];
-		if (tmp->valid) {
-			for (y=0; y < WIREGUARD_MAX_SRC_IPS; y++) {
-				if ((tmp->allowed_source_ips[y].valid) && ip_addr_netcmp(ipaddr, &tmp->allowed_source_ips[y].ip, ip_2_ip4(&tmp->allowed_source_ips[y].mask))) {
-					result = tmp;
-					break;
-				}
-			}
-		}
-	}
-	return result;
-}
-
 static bool wireguardif_can_send_initiation(struct wireguard_peer *peer) {
 	return ((peer->last_initiation_tx == 0) || (wireguard_expired(peer->last_initiation_tx, REKEY_TIMEOUT)));
 }
@@ -100,8 +106,307 @@ static err_t wireguardif_device_output(struct wireguard_device *device, struct p
 	return udp_sendto_if(device->udp_pcb, q, ipaddr, port, device->underlying_netif);
 }
 
+// Largest message we send: a transport data message carrying a full MTU of padded data
+#define WIREGUARDIF_TX_MESSAGE_LEN (sizeof(struct message_transport_data) + ((WIREGUARDIF_MTU + 15) & ~15) + WIREGUARD_AUTHTAG_LEN)
+
+#if (WIREGUARD_TX_POOL_SIZE > 0) && LWIP_SUPPORT_CUSTOM_PBUF
+#define WIREGUARDIF_TX_POOL
+#endif
+
+#if defined(WIREGUARDIF_TX_POOL)
+// Room for the headers lwIP adds below PBUF_TRANSPORT, as pbuf_alloced_custom() lays them out, and the message
+#define WIREGUARDIF_TX_BUFFER_LEN (LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT) + LWIP_MEM_ALIGN_SIZE(WIREGUARDIF_TX_MESSAGE_LEN))
+
+struct wireguardif_tx_buffer {
+	struct pbuf_custom p; // First, so that the pbuf handed back to wireguardif_tx_free is the buffer
+	struct wireguardif_tx_pool *pool;
+	struct wireguardif_tx_buffer *next;
+	u8_t mem[WIREGUARDIF_TX_BUFFER_LEN];
+};
+
+struct wireguardif_tx_pool {
+	struct wireguardif_tx_buffer *free;
+	u16_t in_use;
+	u16_t high_water;
+	u32_t exhausted;
+	// The device is gone but buffers are still queued somewhere below us - the last one to come back frees the pool
+	bool orphaned;
+	struct wireguardif_tx_buffer buffers[WIREGUARD_TX_POOL_SIZE];
+};
+
+// Runs wherever the pbuf is let go of, which can be a driver task once the frame is on the air - hence the lock
+static void wireguardif_tx_free(struct pbuf *p) {
+	struct wireguardif_tx_buffer *buffer = (struct wireguardif_tx_buffer *)p;
+	struct wireguardif_tx_pool *pool = buffer->pool;
+	bool release;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	SYS_ARCH_PROTECT(lev);
+	buffer->next = pool->free;
+	pool->free = buffer;
+	pool->in_use--;
+	release = pool->orphaned && (pool->in_use == 0);
+	SYS_ARCH_UNPROTECT(lev);
+	if (release) {
+		mem_free(pool);
+	}
+}
+
+static struct wireguardif_tx_pool *wireguardif_tx_pool_new() {
+	struct wireguardif_tx_pool *pool;
+	int x;
+
+	pool = (struct wireguardif_tx_pool *)mem_calloc(1, sizeof(struct wireguardif_tx_pool));
+	if (pool) {
+		for (x=0; x < WIREGUARD_TX_POOL_SIZE; x++) {
+			pool->buffers[x].pool = pool;
+			pool->buffers[x].next = pool->free;
+			pool->free = &pool->buffers[x];
+		}
+	}
+	return pool;
+}
+
+static void wireguardif_tx_pool_release(struct wireguardif_tx_pool *pool) {
+	bool release;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	if (pool) {
+		SYS_ARCH_PROTECT(lev);
+		pool->orphaned = true;
+		release = (pool->in_use == 0);
+		SYS_ARCH_UNPROTECT(lev);
+		if (release) {
+			mem_free(pool);
+		}
+	}
+}
+
+// A pbuf for a message of length bytes, in one piece with room for the UDP/IP headers in front. From the device's
+// pool, which only the tcpip thread takes from, or else the heap. Nothing is zeroed, callers only clear the bytes
+// they do not write
+static struct pbuf *wireguardif_tx_alloc(struct wireguard_device *device, u16_t length) {
+	struct wireguardif_tx_pool *pool = device->tx_pool;
+	struct wireguardif_tx_buffer *buffer = NULL;
+	struct pbuf *result;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	if (pool && (length <= WIREGUARDIF_TX_MESSAGE_LEN)) {
+		SYS_ARCH_PROTECT(lev);
+		buffer = pool->free;
+		if (buffer) {
+			pool->free = buffer->next;
+			pool->in_use++;
+			if (pool->in_use > pool->high_water) {
+				pool->high_water = pool->in_use;
+			}
+		} else {
+			pool->exhausted++;
+		}
+		SYS_ARCH_UNPROTECT(lev);
+	}
+	if (buffer) {
+		buffer->p.custom_free_function = wireguardif_tx_free;
+		result = pbuf_alloced_custom(PBUF_TRANSPORT, length, PBUF_RAM, &buffer->p, buffer->mem, sizeof(buffer->mem));
+	} else {
+		result = pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM);
+	}
+	return result;
+}
+
+err_t wireguardif_tx_pool_usage(struct netif *netif, u16_t *in_use, u16_t *high_water, u32_t *exhausted) {
+	struct wireguard_device *device;
+	struct wireguardif_tx_pool *pool;
+	err_t result = ERR_ARG;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	if (netif && netif->state) {
+		device = (struct wireguard_device *)netif->state;
+		pool = device->tx_pool;
+		SYS_ARCH_PROTECT(lev);
+		*in_use = pool ? pool->in_use : 0;
+		*high_water = pool ? pool->high_water : 0;
+		*exhausted = pool ? pool->exhausted : 0;
+		SYS_ARCH_UNPROTECT(lev);
+		result = ERR_OK;
+	}
+	return result;
+}
+#else
+static struct wireguardif_tx_pool *wireguardif_tx_pool_new() {
+	return NULL;
+}
+
+static void wireguardif_tx_pool_release(struct wireguardif_tx_pool *pool) {
+}
+
+static struct pbuf *wireguardif_tx_alloc(struct wireguard_device *device, u16_t length) {
+	return pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM);
+}
+
+err_t wireguardif_tx_pool_usage(struct netif *netif, u16_t *in_use, u16_t *high_water, u32_t *exhausted) {
+	err_t result = ERR_ARG;
+	if (netif && netif->state) {
+		*in_use = 0;
+		*high_water = 0;
+		*exhausted = 0;
+		result = ERR_OK;
+	}
+	return result;
+}
+#endif /* WIREGUARDIF_TX_POOL */
+
+#if WIREGUARD_STAGED_PACKETS > 0
+// A reference to q for sending later. As etharp_query does: only a packet whose data may change after we return
+// has to be copied
+static struct pbuf *wireguardif_keep_packet(struct pbuf *q) {
+	struct pbuf *p;
+	if (PBUF_NEEDS_COPY(q)) {
+		p = pbuf_clone(PBUF_RAW, PBUF_RAM, q);
+	} else {
+		p = q;
+		pbuf_ref(p);
+	}
+	return p;
+}
+#endif
+
+#if WIREGUARD_STAGED_PACKETS > 0
+// Holds on to a packet the peer has no session for, and gets a handshake going rather than wait for the timer to.
+// When the queue is full the oldest packet makes room
+static err_t wireguardif_stage_packet(struct wireguard_device *device, struct wireguard_peer *peer, struct pbuf *q) {
+	struct pbuf *p = wireguardif_keep_packet(q);
+	err_t result = ERR_MEM;
+
+	if (p) {
+		if (peer->staged_count == WIREGUARD_STAGED_PACKETS) {
+			pbuf_free(peer->staged[peer->staged_head]);
+			peer->staged_head = (peer->staged_head + 1) % WIREGUARD_STAGED_PACKETS;
+			peer->staged_count--;
+		}
+		peer->staged[(peer->staged_head + peer->staged_count) % WIREGUARD_STAGED_PACKETS] = p;
+		peer->staged_count++;
+
+		// Not while a session we responded to waits for its first packet, nor while an initiation is in flight
+		if (!peer->next_keypair.valid && wireguardif_can_send_initiation(peer)) {
+			peer->send_handshake = true;
+			wireguard_start_handshake(device->netif, peer);
+			wireguardif_peer_timer_update(device, peer);
+		}
+		result = ERR_OK;
+	}
+	return result;
+}
+
+// Frees what was staged, for a peer whose session is gone for good
+static void wireguardif_purge_staged(struct wireguard_peer *peer) {
+	while (peer->staged_count > 0) {
+		pbuf_free(peer->staged[peer->staged_head]);
+		peer->staged[peer->staged_head] = NULL;
+		peer->staged_head = (peer->staged_head + 1) % WIREGUARD_STAGED_PACKETS;
+		peer->staged_count--;
+	}
+	peer->staged_head = 0;
+}
+#else
+static err_t wireguardif_stage_packet(struct wireguard_device *device, struct wireguard_peer *peer, struct pbuf *q) {
+	return ERR_CONN;
+}
+
+static void wireguardif_purge_staged(struct wireguard_peer *peer) {
+}
+#endif /* WIREGUARD_STAGED_PACKETS > 0 */
+
+// Encrypts the plaintext in q, which may be a chain, on counter straight into dst: padded with zeros to padded_len and
+// followed by the auth tag. q is NULL for a keep-alive
+static void wireguardif_encrypt_pbuf(uint8_t *dst, struct pbuf *q, size_t padded_len, uint64_t counter, struct wireguard_keypair *keypair) {
+	struct wireguard_aead_stream stream;
+	size_t len = 0;
+
+	wireguard_encrypt_packet_start(&stream, counter, keypair);
+	for (; q; q = q->next) {
+		wireguard_encrypt_packet_segment(&stream, dst + len, (const uint8_t *)q->payload, q->len);
+		len += q->len;
+	}
+	// The padding is encrypted where it is to go
+	memset(dst + len, 0, padded_len - len);
+	wireguard_encrypt_packet_segment(&stream, dst + len, dst + len, padded_len - len);
+	wireguard_encrypt_packet_finish(&stream, dst + padded_len);
+}
+
+// Decrypts the src_len bytes of ciphertext and auth tag at offset in p, which may be a chain, where they are -
+// true if they authenticated
+static bool wireguardif_decrypt_pbuf(struct pbuf *p, u16_t offset, size_t src_len, uint64_t counter, struct wireguard_keypair *keypair) {
+	struct wireguard_aead_stream stream;
+	uint8_t tag[WIREGUARD_AUTHTAG_LEN];
+	size_t data_len = src_len - WIREGUARD_AUTHTAG_LEN;
+	size_t remaining = data_len;
+	size_t skip = offset;
+	size_t len;
+	uint8_t *data;
+	struct pbuf *q;
+	bool result = false;
+
+	// The tag may well straddle two pbufs
+	if (pbuf_copy_partial(p, tag, WIREGUARD_AUTHTAG_LEN, (u16_t)(offset + data_len)) == WIREGUARD_AUTHTAG_LEN) {
+		wireguard_decrypt_packet_start(&stream, counter, keypair);
+		for (q = p; q && remaining; q = q->next) {
+			if (skip >= q->len) {
+				skip -= q->len;
+			} else {
+				data = (uint8_t *)q->payload + skip;
+				len = q->len - skip;
+				if (len > remaining) {
+					len = remaining;
+				}
+				wireguard_decrypt_packet_segment(&stream, data, data, len);
+				remaining -= len;
+				skip = 0;
+			}
+		}
+		result = wireguard_decrypt_packet_verify(&stream, tag);
+	}
+	return result;
+}
+
+// The keypair to send to the peer with, NULL if it has none that may be used - one that has expired is destroyed
+static struct wireguard_keypair *wireguardif_send_keypair(struct wireguard_device *device, struct wireguard_peer *peer) {
+	struct wireguard_keypair *keypair = &peer->curr_keypair;
+	struct wireguard_keypair *result = NULL;
+
+	// Note: We may not be able to use the current keypair if we haven't received data, may need to resort to using previous keypair
+	if (keypair->valid && (!keypair->initiator) && (keypair->last_rx == 0)) {
+		keypair = &peer->prev_keypair;
+	}
+
+	if (keypair->valid && (keypair->initiator || keypair->last_rx != 0)) {
+		if (
+				!wireguard_expired(keypair->keypair_millis, REJECT_AFTER_TIME) &&
+				(keypair->sending_counter < REJECT_AFTER_MESSAGES)
+		) {
+			result = keypair;
+		} else {
+			// key has expired...
+			keypair_destroy(device, keypair);
+		}
+	}
+	return result;
+}
+
+// Check to see if we should rekey, having sent with keypair
+static void wireguardif_check_rekey(struct wireguard_device *device, struct wireguard_peer *peer, struct wireguard_keypair *keypair) {
+	if (!peer->send_handshake && (
+			(keypair->sending_counter >= REKEY_AFTER_MESSAGES) ||
+			(keypair->initiator && wireguard_expired(keypair->keypair_millis, REKEY_AFTER_TIME)))
+		) {
+		peer->send_handshake = true;
+		wireguardif_peer_timer_update(device, peer);
+	}
+}
+
 static err_t wireguardif_output_to_peer(struct netif *netif, struct pbuf *q, const ip_addr_t *ipaddr, struct wireguard_peer *peer) {
 	// The LWIP IP layer wants to send an IP packet out over the interface - we need to encrypt and send it to the peer
+	struct wireguard_device *device = (struct wireguard_device *)netif->state;
 	struct message_transport_data *hdr;
 	struct pbuf *pbuf;
 	err_t result;
@@ -110,101 +415,338 @@ static err_t wireguardif_output_to_peer(struct netif *netif, struct pbuf *q, con
 	size_t header_len = 16;
 	uint8_t *dst;
 	uint32_t now;
-	struct wireguard_keypair *keypair = &peer->curr_keypair;
+	struct wireguard_keypair *keypair = wireguardif_send_keypair(device, peer);
 
-	// Note: We may not be able to use the current keypair if we haven't received data, may need to resort to using previous keypair
-	if (keypair->valid && (!keypair->initiator) && (keypair->last_rx == 0)) {
-		keypair = &peer->prev_keypair;
+	if (keypair) {
+		// Calculate the outgoing packet size - round up to next 16 bytes, add 16 bytes for header
+		if (q) {
+			// This is actual transport data
+			unpadded_len = q->tot_len;
+		} else {
+			// This is a keep-alive
+			unpadded_len = 0;
+		}
+		padded_len = (unpadded_len + 15) & 0xFFFFFFF0; // Round up to next 16 byte boundary
+
+		// The buffer needs room in front for LwIP generated IP headers
+		// The IP packet consists of 16 byte header (struct message_transport_data), data padded upto 16 byte boundary + encrypted auth tag (16 bytes)
+		pbuf = wireguardif_tx_alloc(device, header_len + padded_len + WIREGUARD_AUTHTAG_LEN);
+		if (pbuf) {
+			// Note: wireguardif_tx_alloc guarantees that the pbuf is in one section and not chained
+			// - i.e payload points to the contiguous memory region
+			hdr = (struct message_transport_data *)pbuf->payload;
+
+			hdr->type = MESSAGE_TRANSPORT_DATA;
+			memset(hdr->reserved, 0, sizeof(hdr->reserved));
+			hdr->receiver = keypair->remote_index;
+			// Alignment required... pbuf_alloc has probably aligned data, but want to be sure
+			U64TO8_LITTLE(hdr->counter, keypair->sending_counter);
+
+			// Encrypt the (padded) data straight from q into the output packet - handles case where q is chained
+			// Note: the IP header checksum (and other checksums in the IP packet - e.g. ICMP) need to be calculated by LWIP before calling
+			// The Wireguard interface always needs checksums to be generated in software but the base netif may have some checksums generated by hardware
+			dst = &hdr->enc_packet[0];
+			wireguardif_encrypt_pbuf(dst, q, padded_len, keypair->sending_counter, keypair);
+			keypair->sending_counter++;
+
+			result = wireguardif_peer_output(netif, pbuf, peer);
+
+			if (result == ERR_OK) {
+				now = wireguard_sys_now();
+				peer->last_tx = now;
+				keypair->last_tx = now;
+			}
+
+			pbuf_free(pbuf);
+
+			wireguardif_check_rekey(device, peer, keypair);
+		} else {
+			// Failed to allocate memory
+			result = ERR_MEM;
+		}
+	} else {
+		// No valid keys!
+		result = ERR_CONN;
 	}
+	if ((result == ERR_CONN) && q) {
+		// Sent once a handshake has given us keys
+		result = wireguardif_stage_packet(device, peer, q);
+	}
+	return result;
+}
 
-	if (keypair->valid && (keypair->initiator || keypair->last_rx != 0)) {
+#if WIREGUARD_STAGED_PACKETS > 0
+// Sends what was staged now that the peer has a session to send it with - false if there was nothing
+static bool wireguardif_send_staged(struct wireguard_device *device, struct wireguard_peer *peer) {
+	struct pbuf *p;
+	uint8_t count = peer->staged_count;
+	bool result = (count > 0);
+
+	// Only those staged so far - one the keys still turn out unusable for is staged again
+	while ((count > 0) && (peer->staged_count > 0)) {
+		p = peer->staged[peer->staged_head];
+		peer->staged[peer->staged_head] = NULL;
+		peer->staged_head = (peer->staged_head + 1) % WIREGUARD_STAGED_PACKETS;
+		peer->staged_count--;
+		count--;
+		wireguardif_output_to_peer(device->netif, p, NULL, peer);
+		pbuf_free(p);
+	}
+	return result;
+}
+#else
+static bool wireguardif_send_staged(struct wireguard_device *device, struct wireguard_peer *peer) {
+	return false;
+}
+#endif /* WIREGUARD_STAGED_PACKETS > 0 */
+
+#if WIREGUARDIF_TX_BATCH
+// Packets of a batch that are encrypted together. Each holds a transmit buffer until the group is sent, so there are
+// no more than the pool has (when there is one), and no more than 8 so that a group takes little of the lwIP
+// thread's stack
+#if defined(WIREGUARDIF_TX_POOL) && (WIREGUARD_TX_POOL_SIZE < 8)
+#define WIREGUARDIF_TX_GROUP_MAX WIREGUARD_TX_POOL_SIZE
+#else
+#define WIREGUARDIF_TX_GROUP_MAX 8
+#endif
+#define WIREGUARDIF_TX_GROUP ((WIREGUARD_TX_BATCH < WIREGUARDIF_TX_GROUP_MAX) ? WIREGUARD_TX_BATCH : WIREGUARDIF_TX_GROUP_MAX)
+
+// The lwIP callback that sends the queued batches. It is kept apart from the device so that one still on its way
+// when the device shuts down has something to find
+struct wireguardif_tx_drain {
+	struct tcpip_callback_msg *msg;
+	struct wireguard_device *device; // NULL once the device has shut down
+	bool scheduled;
+	u32_t dropped; // Queued packets that found no buffer or that the underlying netif would not take
+};
+
+// Encrypts and sends up to WIREGUARDIF_TX_GROUP packets from the front of the peer's queue: the keypair is picked and
+// checked once and the packets take one range of counters, in the order they were queued. Each is encrypted straight
+// from the queued pbuf into its buffer behind the header - through the ChaCha20 kernels together with the others when
+// the pbuf is in one piece, on its own as wireguardif_output_to_peer() does when it is a chain
+static void wireguardif_send_group(struct wireguard_device *device, struct wireguard_peer *peer) {
+	struct pbuf *queue[WIREGUARDIF_TX_GROUP];
+	struct pbuf *out[WIREGUARDIF_TX_GROUP];
+	uint8_t out_queue[WIREGUARDIF_TX_GROUP]; // The queue[] each of out[] carries
+	struct wireguard_aead_message packets[WIREGUARDIF_TX_GROUP];
+	struct message_transport_data *hdr;
+	struct wireguard_keypair *keypair;
+	struct pbuf *q;
+	uint64_t counter;
+	size_t padded_len;
+	uint8_t count = (peer->tx_batch_count < WIREGUARDIF_TX_GROUP) ? peer->tx_batch_count : WIREGUARDIF_TX_GROUP;
+	uint8_t sent = 0;
+	uint8_t batched = 0;
+	uint8_t taken = 0;
+	uint8_t n = 0;
+	uint8_t x;
+	uint32_t now;
 
-		if (
-				!wireguard_expired(keypair->keypair_millis, REJECT_AFTER_TIME) &&
-				(keypair->sending_counter < REJECT_AFTER_MESSAGES)
-		) {
+	memcpy(queue, peer->tx_batch, count * sizeof(struct pbuf *));
+	peer->tx_batch_count -= count;
+	memmove(peer->tx_batch, &peer->tx_batch[count], peer->tx_batch_count * sizeof(struct pbuf *));
 
-			// Calculate the outgoing packet size - round up to next 16 bytes, add 16 bytes for header
-			if (q) {
-				// This is actual transport data
-				unpadded_len = q->tot_len;
+	keypair = wireguardif_send_keypair(device, peer);
+	if (keypair) {
+		// A buffer for each packet, as far as the keypair has counters left - the rest wait for the new keys
+		// wireguardif_check_rekey() asks for below
+		for (x=0; (x < count) && ((keypair->sending_counter + n) < REJECT_AFTER_MESSAGES); x++) {
+			padded_len = (queue[x]->tot_len + 15) & 0xFFFFFFF0;
+			out[n] = wireguardif_tx_alloc(device, sizeof(struct message_transport_data) + padded_len + WIREGUARD_AUTHTAG_LEN);
+			if (out[n]) {
+				out_queue[n] = x;
+				n++;
 			} else {
-				// This is a keep-alive
-				unpadded_len = 0;
+				// As wireguardif_output_to_peer() would have failed it with ERR_MEM
+				device->tx_drain->dropped++;
 			}
-			padded_len = (unpadded_len + 15) & 0xFFFFFFF0; // Round up to next 16 byte boundary
-
-			// The buffer needs to be allocated from "transport" pool to leave room for LwIP generated IP headers
-			// The IP packet consists of 16 byte header (struct message_transport_data), data padded upto 16 byte boundary + encrypted auth tag (16 bytes)
-			pbuf = pbuf_alloc(PBUF_TRANSPORT, header_len + padded_len + WIREGUARD_AUTHTAG_LEN, PBUF_RAM);
-			if (pbuf) {
-				// Note: allocating pbuf from RAM above guarantees that the pbuf is in one section and not chained
-				// - i.e payload points to the contiguous memory region
-				memset(pbuf->payload, 0, pbuf->tot_len);
-
-				hdr = (struct message_transport_data *)pbuf->payload;
-
-				hdr->type = MESSAGE_TRANSPORT_DATA;
-				hdr->receiver = keypair->remote_index;
-				// Alignment required... pbuf_alloc has probably aligned data, but want to be sure
-				U64TO8_LITTLE(hdr->counter, keypair->sending_counter);
-
-				// Copy the encrypted (padded) data to the output packet - chacha20poly1305_encrypt() can encrypt data in-place which avoids call to mem_malloc
-				dst = &hdr->enc_packet[0];
-				if ((padded_len > 0) && q) {
-					// Note: before copying make sure we have inserted the IP header checksum
-					// The IP header checksum (and other checksums in the IP packet - e.g. ICMP) need to be calculated by LWIP before calling
-					// The Wireguard interface always needs checksums to be generated in software but the base netif may have some checksums generated by hardware
-
-					// Copy pbuf to memory - handles case where pbuf is chained
-					pbuf_copy_partial(q, dst, unpadded_len, 0);
-				}
+		}
+		taken = x;
+
+		// Then the counters for all of them at once
+		counter = keypair->sending_counter;
+		keypair->sending_counter += n;
+		for (x=0; x < n; x++) {
+			q = queue[out_queue[x]];
+			padded_len = (q->tot_len + 15) & 0xFFFFFFF0;
+			hdr = (struct message_transport_data *)out[x]->payload;
+			hdr->type = MESSAGE_TRANSPORT_DATA;
+			memset(hdr->reserved, 0, sizeof(hdr->reserved));
+			hdr->receiver = keypair->remote_index;
+			U64TO8_LITTLE(hdr->counter, counter + x);
+			if (q->len == q->tot_len) {
+				packets[batched].dst = hdr->enc_packet;
+				packets[batched].src = (const uint8_t *)q->payload;
+				packets[batched].src_len = q->tot_len;
+				packets[batched].len = padded_len;
+				packets[batched].nonce = counter + x;
+				batched++;
+			} else {
+				wireguardif_encrypt_pbuf(hdr->enc_packet, q, padded_len, counter + x, keypair);
+			}
+		}
+		wireguard_encrypt_packets(packets, batched, keypair);
 
-				// Then encrypt
-				wireguard_encrypt_packet(dst, dst, padded_len, keypair);
+		for (x=0; x < n; x++) {
+			if (wireguardif_peer_output(device->netif, out[x], peer) == ERR_OK) {
+				sent++;
+			} else {
+				device->tx_drain->dropped++;
+			}
+			pbuf_free(out[x]);
+		}
 
-				result = wireguardif_peer_output(netif, pbuf, peer);
+		if (sent > 0) {
+			now = wireguard_sys_now();
+			peer->last_tx = now;
+			keypair->last_tx = now;
+		}
+		wireguardif_check_rekey(device, peer, keypair);
+	}
 
-				if (result == ERR_OK) {
-					now = wireguard_sys_now();
-					peer->last_tx = now;
-					keypair->last_tx = now;
-				}
+	// Without keys, or once the keypair ran out of counters, they are sent when a handshake has given us new ones
+	for (x=taken; x < count; x++) {
+		wireguardif_stage_packet(device, peer, queue[x]);
+	}
 
-				pbuf_free(pbuf);
+	for (x=0; x < count; x++) {
+		pbuf_free(queue[x]);
+	}
+}
 
-				// Check to see if we should rekey
-				if (keypair->sending_counter >= REKEY_AFTER_MESSAGES) {
-					peer->send_handshake = true;
-				} else if (keypair->initiator && wireguard_expired(keypair->keypair_millis, REKEY_AFTER_TIME)) {
-					peer->send_handshake = true;
-				}
+static void wireguardif_send_batch(struct wireguard_device *device, struct wireguard_peer *peer) {
+	while (peer->tx_batch_count > 0) {
+		wireguardif_send_group(device, peer);
+	}
+}
 
-			} else {
-				// Failed to allocate memory
-				result = ERR_MEM;
+static void wireguardif_tx_drain(void *arg) {
+	struct wireguardif_tx_drain *drain = (struct wireguardif_tx_drain *)arg;
+	struct wireguard_device *device = drain->device;
+	int x;
+
+	drain->scheduled = false;
+	if (device) {
+		for (x=0; x < device->peer_capacity; x++) {
+			if (device->peers[x] && (device->peers[x]->tx_batch_count > 0)) {
+				wireguardif_send_batch(device, device->peers[x]);
 			}
+		}
+	} else {
+		// The device shut down while this was on its way
+		tcpip_callbackmsg_delete(drain->msg);
+		mem_free(drain);
+	}
+}
+
+static struct wireguardif_tx_drain *wireguardif_tx_drain_new(struct wireguard_device *device) {
+	struct wireguardif_tx_drain *drain = (struct wireguardif_tx_drain *)mem_calloc(1, sizeof(struct wireguardif_tx_drain));
+	if (drain) {
+		drain->device = device;
+		drain->msg = tcpip_callbackmsg_new(wireguardif_tx_drain, drain);
+		if (!drain->msg) {
+			mem_free(drain);
+			drain = NULL;
+		}
+	}
+	return drain;
+}
+
+// One still on its way is left to free itself when it runs
+static void wireguardif_tx_drain_release(struct wireguardif_tx_drain *drain) {
+	if (drain) {
+		if (drain->scheduled) {
+			drain->device = NULL;
 		} else {
-			// key has expired...
-			keypair_destroy(keypair);
-			result = ERR_CONN;
+			tcpip_callbackmsg_delete(drain->msg);
+			mem_free(drain);
 		}
+	}
+}
+
+// Queues q for the peer's next batch. Batches go out from an lwIP callback, i.e. once the lwIP thread has handled
+// what was already waiting for it - so all the segments a TCP ACK releases, say, are sent together. A packet whose
+// data may change after we return is sent right away, with the result of sending it; a full queue, and one the
+// callback cannot be posted for, are sent right away too
+static err_t wireguardif_tx_queue(struct wireguard_device *device, struct wireguard_peer *peer, struct pbuf *q) {
+	struct wireguardif_tx_drain *drain = device->tx_drain;
+	err_t result;
+
+	if (PBUF_NEEDS_COPY(q)) {
+		// Encrypting copies it anyway, where queueing it would have to copy it first. Whatever was queued before
+		// goes first
+		wireguardif_send_batch(device, peer);
+		result = wireguardif_output_to_peer(device->netif, q, NULL, peer);
 	} else {
-		// No valid keys!
-		result = ERR_CONN;
+		if (peer->tx_batch_count == WIREGUARD_TX_BATCH) {
+			wireguardif_send_batch(device, peer);
+		}
+		pbuf_ref(q);
+		peer->tx_batch[peer->tx_batch_count++] = q;
+		if (!drain->scheduled) {
+			if (tcpip_callbackmsg_trycallback(drain->msg) == ERR_OK) {
+				drain->scheduled = true;
+			} else {
+				wireguardif_send_batch(device, peer);
+			}
+		}
+		result = ERR_OK;
 	}
 	return result;
 }
 
-// This is used as the output function for the Wireguard netif
+err_t wireguardif_tx_dropped(struct netif *netif, u32_t *dropped) {
+	struct wireguard_device *device;
+	err_t result = ERR_ARG;
+
+	if (netif && netif->state) {
+		device = (struct wireguard_device *)netif->state;
+		*dropped = device->tx_drain ? device->tx_drain->dropped : 0;
+		result = ERR_OK;
+	}
+	return result;
+}
+#else
+static struct wireguardif_tx_drain *wireguardif_tx_drain_new(struct wireguard_device *device) {
+	return NULL;
+}
+
+static void wireguardif_tx_drain_release(struct wireguardif_tx_drain *drain) {
+}
+
+static err_t wireguardif_tx_queue(struct wireguard_device *device, struct wireguard_peer *peer, struct pbuf *q) {
+	return wireguardif_output_to_peer(device->netif, q, NULL, peer);
+}
+
+err_t wireguardif_tx_dropped(struct netif *netif, u32_t *dropped) {
+	err_t result = ERR_ARG;
+	if (netif && netif->state) {
+		*dropped = 0;
+		result = ERR_OK;
+	}
+	return result;
+}
+#endif /* WIREGUARDIF_TX_BATCH */
+
+// Frees what is held for the peer - staged and batched - for a peer whose session is gone for good
+static void wireguardif_purge_queued(struct wireguard_peer *peer) {
+	wireguardif_purge_staged(peer);
+#if WIREGUARD_TX_BATCH > 0
+	while (peer->tx_batch_count > 0) {
+		peer->tx_batch_count--;
+		pbuf_free(peer->tx_batch[peer->tx_batch_count]);
+		peer->tx_batch[peer->tx_batch_count] = NULL;
+	}
+#endif
+}
+
 // The ipaddr here is the one inside the VPN which we use to lookup the correct peer/endpoint
-static err_t wireguardif_output(struct netif *netif, struct pbuf *q, const ip4_addr_t *ip4addr) {
+static err_t wireguardif_output_ip(struct netif *netif, struct pbuf *q, const ip_addr_t *ipaddr) {
 	if (netif->state == NULL) {
 		// maybe the underlying interface has already been deactivated?
 		return ERR_IF;
 	}
 	struct wireguard_device *device = (struct wireguard_device *)netif->state;
-	ip_addr_t ipaddr;
 
 	if (!device) {
 		ESP_LOGE(TAG, "wireguardif_output NULL device");
@@ -212,28 +754,52 @@ static err_t wireguardif_output(struct netif *netif, struct pbuf *q, const ip4_a
 	}
 
 	// Send to peer that matches dest IP
-	ip_addr_copy_from_ip4(ipaddr, *ip4addr);
-	struct wireguard_peer *peer = peer_lookup_by_allowed_ip(device, &ipaddr);
+	struct wireguard_peer *peer = wireguard_allowedips_lookup(&device->allowedips, ipaddr);
 	if (peer) {
-		return wireguardif_output_to_peer(netif, q, &ipaddr, peer);
+		if (device->tx_drain) {
+			return wireguardif_tx_queue(device, peer, q);
+		}
+		return wireguardif_output_to_peer(netif, q, ipaddr, peer);
 	} else {
 		return ERR_RTE;
 	}
 }
 
+#if LWIP_IPV4
+// This is used as the output function for the Wireguard netif
+static err_t wireguardif_output(struct netif *netif, struct pbuf *q, const ip4_addr_t *ip4addr) {
+	ip_addr_t ipaddr;
+	ip_addr_copy_from_ip4(ipaddr, *ip4addr);
+	return wireguardif_output_ip(netif, q, &ipaddr);
+}
+#endif /* LWIP_IPV4 */
+
+#if LWIP_IPV6
+// IPv6 output function for the Wireguard netif
+static err_t wireguardif_output_ip6(struct netif *netif, struct pbuf *q, const ip6_addr_t *ip6addr) {
+	ip_addr_t ipaddr;
+	ip_addr_copy_from_ip6(ipaddr, *ip6addr);
+	return wireguardif_output_ip(netif, q, &ipaddr);
+}
+#endif /* LWIP_IPV6 */
+
 static void wireguardif_send_keepalive(struct wireguard_device *device, struct wireguard_peer *peer) {
 	// Send a NULL packet as a keep-alive
 	wireguardif_output_to_peer(device->netif, NULL, NULL, peer);
 }
 
-static void wireguardif_process_response_message(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *response, const ip_addr_t *addr, u16_t port) {
-	if (wireguard_process_handshake_response(device, peer, response)) {
+static void wireguardif_process_response_message(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_response *response, const struct wireguard_handshake_dh *dh, const ip_addr_t *addr, u16_t port) {
+	if (wireguard_process_handshake_response(device, peer, response, dh)) {
 		// Packet is good
 		// Update the peer location
 		update_peer_addr(peer, addr, port);
 
-		wireguard_start_session(peer, true);
-		wireguardif_send_keepalive(device, peer);
+		wireguard_start_session(device, peer, true);
+		// Either confirms the session for the responder
+		if (!wireguardif_send_staged(device, peer)) {
+			wireguardif_send_keepalive(device, peer);
+		}
+		wireguardif_peer_timer_update(device, peer);
 
 		// Set the IF-UP flag on netif
 		netif_set_link_up(device->netif);
@@ -242,49 +808,46 @@ static void wireguardif_process_response_message(struct wireguard_device *device
 	}
 }
 
-static bool peer_add_ip(struct wireguard_peer *peer, ip_addr_t ip, ip_addr_t mask) {
-	bool result = false;
-	struct wireguard_allowed_ip *allowed;
-	int x;
-	// Look for existing match first
-	for (x=0; x < WIREGUARD_MAX_SRC_IPS; x++) {
-		allowed = &peer->allowed_source_ips[x];
-		if ((allowed->valid) && ip_addr_cmp(&allowed->ip, &ip) && ip_addr_cmp(&allowed->mask, &mask)) {
-			result = true;
-			break;
-		}
+// Brings the first hlen bytes of the received packet p into its first pbuf. Decrypting a chain in place leaves it
+// with an empty first pbuf when that held just the WireGuard header, which is dropped; a header still split across
+// pbufs after that is rare enough to copy the packet into one piece for. Returns NULL if that copy fails
+static struct pbuf *wireguardif_inner_packet(struct pbuf *p, u16_t hlen) {
+	struct pbuf *q;
+
+	while ((p->len == 0) && p->next) {
+		q = p->next;
+		pbuf_ref(q);
+		pbuf_free(p);
+		p = q;
 	}
-	if (!result) {
-		// Look for a free slot
-		for (x=0; x < WIREGUARD_MAX_SRC_IPS; x++) {
-			allowed = &peer->allowed_source_ips[x];
-			if (!allowed->valid) {
-				allowed->valid = true;
-				allowed->ip = ip;
-				allowed->mask = mask;
-				result = true;
-				break;
-			}
-		}
+	if (p->len < hlen) {
+		q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+		pbuf_free(p);
+		p = q;
 	}
-	return result;
+	return p;
 }
 
-static void wireguardif_process_data_message(struct wireguard_device *device, struct wireguard_peer *peer, struct message_transport_data *data_hdr, size_t data_len, const ip_addr_t *addr, u16_t port) {
-	struct wireguard_keypair *keypair;
+// keypair is the one found by keypair_lookup_by_receiver() for data_hdr->receiver
+// Takes the received pbuf over: the packet is decrypted where it is, across the chain if it is one, and the pbuf
+// stripped of the WireGuard header and auth tag is what goes to ip_input
+static void wireguardif_process_data_message(struct wireguard_device *device, struct wireguard_peer *peer, struct wireguard_keypair *keypair, struct pbuf *pbuf, const ip_addr_t *addr, u16_t port) {
+	struct message_transport_data *data_hdr = (struct message_transport_data *)pbuf->payload;
 	uint64_t nonce;
-	uint8_t *src;
 	size_t src_len;
-	struct pbuf *pbuf;
-	struct ip_hdr *iphdr;
-	ip_addr_t dest;
-	bool dest_ok = false;
-	int x;
+	// The inner IP header - a copy, as a chain may have split it across its pbufs
+	union {
+		struct ip_hdr ip4;
+#if LWIP_IPV6
+		struct ip6_hdr ip6;
+#endif
+	} iphdr;
+	u16_t iphdr_len;
+	ip_addr_t source;
+	bool source_ok = false;
 	uint32_t now;
 	uint16_t header_len = 0xFFFF;
-	uint32_t idx = data_hdr->receiver;
-
-	keypair = get_peer_keypair_for_idx(peer, idx);
+	uint16_t hlen = 0xFFFF;
 
 	if (keypair) {
 		if (
@@ -295,86 +858,87 @@ static void wireguardif_process_data_message(struct wireguard_device *device, st
 		) {
 
 			nonce = U8TO64_LITTLE(data_hdr->counter);
-			src = &data_hdr->enc_packet[0];
-			src_len = data_len;
-
-			// We don't know the unpadded size until we have decrypted the packet and validated/inspected the IP header
-			pbuf = pbuf_alloc(PBUF_TRANSPORT, src_len - WIREGUARD_AUTHTAG_LEN, PBUF_RAM);
-			if (pbuf) {
-				// Decrypt the packet
-				memset(pbuf->payload, 0, pbuf->tot_len);
-				if (wireguard_decrypt_packet(pbuf->payload, src, src_len, nonce, keypair)) {
-
-					// 3. Since the packet has authenticated correctly, the source IP of the outer UDP/IP packet is used to update the endpoint for peer TrMv...WXX0.
-					// Update the peer location
-					update_peer_addr(peer, addr, port);
-
-					now = wireguard_sys_now();
-					keypair->last_rx = now;
-					peer->last_rx = now;
-
-					// Might need to shuffle next key --> current keypair
-					keypair_update(peer, keypair);
+			src_len = pbuf->tot_len - sizeof(struct message_transport_data);
+
+			// Decrypt the packet in place
+			if (wireguardif_decrypt_pbuf(pbuf, sizeof(struct message_transport_data), src_len, nonce, keypair)) {
+
+				// We don't know the unpadded size until we have validated/inspected the IP header - ip_input
+				// trims the padding off, all that goes here is the header in front and the auth tag behind
+				pbuf_remove_header(pbuf, sizeof(struct message_transport_data));
+				pbuf_realloc(pbuf, src_len - WIREGUARD_AUTHTAG_LEN);
+
+				// 3. Since the packet has authenticated correctly, the source IP of the outer UDP/IP packet is used to update the endpoint for peer TrMv...WXX0.
+				// Update the peer location
+				update_peer_addr(peer, addr, port);
+
+				now = wireguard_sys_now();
+				keypair->last_rx = now;
+				peer->last_rx = now;
+
+				// Might need to shuffle next key --> current keypair
+				if (keypair == &peer->next_keypair) {
+					keypair = keypair_update(device, peer, keypair);
+					// The session deadlines now follow the new current keypair
+					wireguardif_peer_timer_update(device, peer);
+					// The session we responded to is confirmed, so it can carry what was staged meanwhile
+					wireguardif_send_staged(device, peer);
+				}
 
-					// Check to see if we should rekey
-					if (keypair->initiator && wireguard_expired(keypair->keypair_millis, REJECT_AFTER_TIME - peer->keepalive_interval - REKEY_TIMEOUT)) {
-						peer->send_handshake = true;
-					}
+				// Check to see if we should rekey
+				if (!peer->send_handshake && keypair->initiator && wireguard_expired(keypair->keypair_millis, REJECT_AFTER_TIME - peer->keepalive_interval - REKEY_TIMEOUT)) {
+					peer->send_handshake = true;
+					wireguardif_peer_timer_update(device, peer);
+				}
 
-					// Make sure that link is reported as up
-					netif_set_link_up(device->netif);
+				// Make sure that link is reported as up
+				netif_set_link_up(device->netif);
 
-					if (pbuf->tot_len > 0) {
-						//4a. Once the packet payload is decrypted, the interface has a plaintext packet. If this is not an IP packet, it is dropped.
-						iphdr = (struct ip_hdr *)pbuf->payload;
-						// Check for packet replay / dupes
-						if (wireguard_check_replay(keypair, nonce)) {
+				if (pbuf->tot_len > 0) {
+					//4a. Once the packet payload is decrypted, the interface has a plaintext packet. If this is not an IP packet, it is dropped.
+					iphdr_len = pbuf_copy_partial(pbuf, &iphdr, sizeof(iphdr), 0);
+					// Check for packet replay / dupes
+					if (wireguard_check_replay(keypair, nonce)) {
 
-							// 4b. Otherwise, WireGuard checks to see if the source IP address of the plaintext inner-packet routes correspondingly in the cryptokey routing table
-							// Also check packet length!
+						// 4b. Otherwise, WireGuard checks to see if the source IP address of the plaintext inner-packet routes correspondingly in the cryptokey routing table
+						// Also check packet length!
 #if LWIP_IPV4
-							if (IPH_V(iphdr) == 4) {
-								ip_addr_copy_from_ip4(dest, iphdr->dest);
-								for (x=0; x < WIREGUARD_MAX_SRC_IPS; x++) {
-									if (peer->allowed_source_ips[x].valid) {
-										if (ip_addr_netcmp(&dest, &peer->allowed_source_ips[x].ip, ip_2_ip4(&peer->allowed_source_ips[x].mask))) {
-											dest_ok = true;
-											header_len = PP_NTOHS(IPH_LEN(iphdr));
-											break;
-										}
-									}
-								}
-							}
+						if ((iphdr_len >= IP_HLEN) && (IPH_V(&iphdr.ip4) == 4)) {
+							ip_addr_copy_from_ip4(source, iphdr.ip4.src);
+							source_ok = (wireguard_allowedips_lookup(&device->allowedips, &source) == peer);
+							header_len = PP_NTOHS(IPH_LEN(&iphdr.ip4));
+							hlen = IPH_HL(&iphdr.ip4) * 4;
+						}
 #endif /* LWIP_IPV4 */
 #if LWIP_IPV6
-							if (IPH_V(iphdr) == 6) {
-								// TODO: IPV6 support for route filtering
-								header_len = PP_NTOHS(IPH_LEN(iphdr));
-								dest_ok = true;
-							}
+						if ((iphdr_len >= IP6_HLEN) && (IPH_V(&iphdr.ip4) == 6)) {
+							ip_addr_copy_from_ip6_packed(source, iphdr.ip6.src);
+							source_ok = (wireguard_allowedips_lookup(&device->allowedips, &source) == peer);
+							header_len = IP6H_PLEN(&iphdr.ip6) + IP6_HLEN;
+							hlen = IP6_HLEN;
+						}
 #endif /* LWIP_IPV6 */
-							if (header_len <= pbuf->tot_len) {
-
-								// 5. If the plaintext packet has not been dropped, it is inserted into the receive queue of the wg0 interface.
-								if (dest_ok) {
-									// Send packet to be process by LWIP
-									ip_input(pbuf, device->netif);
-									// pbuf is owned by IP layer now
-									pbuf = NULL;
-								}
-							} else {
-								// IP header is corrupt or lied about packet size
+						if (header_len <= pbuf->tot_len) {
+
+							// 5. If the plaintext packet has not been dropped, it is inserted into the receive queue of the wg0 interface.
+							if (source_ok) {
+								// ip_input wants the IP header in the first pbuf
+								pbuf = wireguardif_inner_packet(pbuf, hlen);
+							}
+							if (pbuf && source_ok) {
+								// Send packet to be process by LWIP
+								ip_input(pbuf, device->netif);
+								// pbuf is owned by IP layer now
+								pbuf = NULL;
 							}
 						} else {
-							// This is a duplicate packet / replayed / too far out of order
+							// IP header is corrupt or lied about packet size
 						}
 					} else {
-						// This was a keep-alive packet
+						// This is a duplicate packet / replayed / too far out of order
 					}
-				}
-
-				if (pbuf) {
-					pbuf_free(pbuf);
+				} else {
+					// This was a keep-alive packet
 				}
 			}
 
@@ -383,33 +947,33 @@ static void wireguardif_process_data_message(struct wireguard_device *device, st
 			//After Reject-After-Messages transport data messages or after the current secure session is Reject- After-Time seconds old,
 			// whichever comes first, WireGuard will refuse to send or receive any more transport data messages using the current secure session,
 			// until a new secure session is created through the 1-RTT handshake
-			keypair_destroy(keypair);
+			keypair_destroy(device, keypair);
 		}
 
 	} else {
 		// Could not locate valid keypair for remote index
 	}
+	if (pbuf) {
+		pbuf_free(pbuf);
+	}
 }
 
-static struct pbuf *wireguardif_initiate_handshake(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_initiation *msg, err_t *error) {
-	struct pbuf *pbuf = NULL;
+// The message is built in the pbuf it is sent in
+static struct pbuf *wireguardif_initiate_handshake(struct wireguard_device *device, struct wireguard_peer *peer, err_t *error) {
+	struct pbuf *pbuf;
 	err_t err = ERR_OK;
-	if (wireguard_create_handshake_initiation(device, peer, msg)) {
-		ESP_LOGD(TAG, "sending initiation packet");
-		pbuf = pbuf_alloc(PBUF_TRANSPORT, sizeof(struct message_handshake_initiation), PBUF_RAM);
-		if (pbuf) {
-			err = pbuf_take(pbuf, msg, sizeof(struct message_handshake_initiation));
-			if (err == ERR_OK) {
-				// OK!
-			} else {
-				pbuf_free(pbuf);
-				pbuf = NULL;
-			}
+
+	pbuf = wireguardif_tx_alloc(device, sizeof(struct message_handshake_initiation));
+	if (pbuf) {
+		if (wireguard_create_handshake_initiation(device, peer, (struct message_handshake_initiation *)pbuf->payload)) {
+			ESP_LOGD(TAG, "sending initiation packet");
 		} else {
-			err = ERR_MEM;
+			pbuf_free(pbuf);
+			pbuf = NULL;
+			err = ERR_ARG;
 		}
 	} else {
-		err = ERR_ARG;
+		err = ERR_MEM;
 	}
 	if (error) {
 		*error = err;
@@ -417,25 +981,20 @@ static struct pbuf *wireguardif_initiate_handshake(struct wireguard_device *devi
 	return pbuf;
 }
 
-static void wireguardif_send_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer) {
-	struct message_handshake_response packet;
-	struct pbuf *pbuf = NULL;
-	err_t err = ERR_OK;
+static void wireguardif_send_handshake_response(struct wireguard_device *device, struct wireguard_peer *peer, const struct wireguard_handshake_dh *dh) {
+	struct pbuf *pbuf;
 
-	if (wireguard_create_handshake_response(device, peer, &packet)) {
+	pbuf = wireguardif_tx_alloc(device, sizeof(struct message_handshake_response));
+	if (pbuf) {
+		if (wireguard_create_handshake_response(device, peer, (struct message_handshake_response *)pbuf->payload, dh)) {
 
-		wireguard_start_session(peer, false);
+			wireguard_start_session(device, peer, false);
+			wireguardif_peer_timer_update(device, peer);
 
-		ESP_LOGD(TAG, "sending handshake response packet");
-		pbuf = pbuf_alloc(PBUF_TRANSPORT, sizeof(struct message_handshake_response), PBUF_RAM);
-		if (pbuf) {
-			err = pbuf_take(pbuf, &packet, sizeof(struct message_handshake_response));
-			if (err == ERR_OK) {
-				// OK!
-				wireguardif_peer_output(device->netif, pbuf, peer);
-			}
-			pbuf_free(pbuf);
+			ESP_LOGD(TAG, "sending handshake response packet");
+			wireguardif_peer_output(device->netif, pbuf, peer);
 		}
+		pbuf_free(pbuf);
 	}
 }
 
@@ -469,89 +1028,285 @@ static size_t get_source_addr_port(const ip_addr_t *addr, u16_t port, uint8_t *b
 }
 
 static void wireguardif_send_handshake_cookie(struct wireguard_device *device, const uint8_t *mac1, uint32_t index, const ip_addr_t *addr, u16_t port) {
-	struct message_cookie_reply packet;
-	struct pbuf *pbuf = NULL;
-	err_t err = ERR_OK;
+	struct pbuf *pbuf;
 	uint8_t source_buf[18];
 	size_t source_len = get_source_addr_port(addr, port, source_buf, sizeof(source_buf));
 
-	wireguard_create_cookie_reply(device, &packet, mac1, index, source_buf, source_len);
-
-	// Send this packet out!
-	pbuf = pbuf_alloc(PBUF_TRANSPORT, sizeof(struct message_cookie_reply), PBUF_RAM);
+	pbuf = wireguardif_tx_alloc(device, sizeof(struct message_cookie_reply));
 	if (pbuf) {
-		err = pbuf_take(pbuf, &packet, sizeof(struct message_cookie_reply));
-		if (err == ERR_OK) {
-			wireguardif_device_output(device, pbuf, addr, port);
-		}
+		wireguard_create_cookie_reply(device, (struct message_cookie_reply *)pbuf->payload, mac1, index, source_buf, source_len);
+		// Send this packet out!
+		wireguardif_device_output(device, pbuf, addr, port);
 		pbuf_free(pbuf);
 	}
 }
 
-static bool wireguardif_check_initiation_message(struct wireguard_device *device, struct message_handshake_initiation *msg, const ip_addr_t *addr, u16_t port) {
+// Handshake admission is shared by all devices, like the handshake worker
+static struct wireguard_load wireguardif_load;
+static struct wireguard_ratelimiter wireguardif_ratelimiter;
+static bool wireguardif_ratelimiter_ready = false;
+
+// Checks a received initiation or response before any X25519 work is spent on it - under load this may send the
+// sender a cookie reply instead
+static bool wireguardif_check_handshake_message(struct wireguard_device *device, uint8_t *data, size_t len, uint32_t sender, const ip_addr_t *addr, u16_t port) {
 	bool result = false;
-	uint8_t *data = (uint8_t *)msg;
 	uint8_t source_buf[18];
-	size_t source_len;
-	// We received an initiation packet check it is valid
+	size_t source_len = get_source_addr_port(addr, port, source_buf, sizeof(source_buf));
+	uint32_t now = wireguard_sys_now();
+	bool under_load = wireguard_load_check(&wireguardif_load, now);
 
-	if (wireguard_check_mac1(device, data, sizeof(struct message_handshake_initiation) - (2 * WIREGUARD_COOKIE_LEN), msg->mac1)) {
-		// mac1 is valid!
-		if (!wireguard_is_under_load()) {
-			// If we aren't under load we only need mac1 to be correct
-			result = true;
+	switch (wireguard_check_handshake_macs(device, data, len, under_load, source_buf, source_len)) {
+		case WIREGUARD_MACS_VALID:
+			// Under load the sender has proven its address with a cookie, so it can be held to its share
+			result = !under_load || wireguard_ratelimiter_allow(&wireguardif_ratelimiter, source_buf, source_len, now);
+			break;
+		case WIREGUARD_MACS_NEED_COOKIE:
+			// mac2 is invalid (cookie may have expired) or not present
+			wireguardif_send_handshake_cookie(device, data + len - (2 * WIREGUARD_COOKIE_LEN), sender, addr, port);
+			break;
+		default:
+			// mac1 is invalid
+			break;
+	}
+	return result;
+}
+
+// Accounts the CPU time of a handshake processed since start, plus extra spent on it elsewhere
+static void wireguardif_handshake_busy(uint32_t start, uint32_t extra) {
+	uint32_t now = wireguard_sys_now();
+	wireguard_load_busy(&wireguardif_load, now, (now - start) + extra);
+}
+
+static void wireguardif_process_initiation_message(struct wireguard_device *device, struct message_handshake_initiation *msg, const struct wireguard_handshake_dh *dh, const ip_addr_t *addr, u16_t port) {
+	struct wireguard_peer *peer = wireguard_process_initiation_message(device, msg, dh);
+	if (peer) {
+		// Update the peer location
+		update_peer_addr(peer, addr, port);
+
+		// Send back a handshake response
+		wireguardif_send_handshake_response(device, peer, dh);
+	}
+}
+
+#if WIREGUARDIF_HANDSHAKE_WORKER
+// Job type of an initiation being pre-generated - the others carry the type of the received message
+#define WIREGUARDIF_HANDSHAKE_PREGEN	(MESSAGE_INVALID)
+
+// A received handshake message, or an initiation being pre-generated, on its way through the handshake worker.
+// The worker only reads what is copied in here, so the device and its peers are never touched off the lwIP thread
+struct wireguardif_handshake_job {
+	struct wireguardif_handshake_job *next;
+	struct wireguard_device *device; // NULL once the device has shut down
+	ip_addr_t addr;
+	u16_t port;
+	uint8_t type;
+	bool dh_valid;
+	uint32_t busy_millis; // Spent by the worker
+	uint8_t private_key[WIREGUARD_PRIVATE_KEY_LEN];
+	uint8_t initiation_hash[WIREGUARD_HASH_LEN];
+	uint8_t public_key[WIREGUARD_PUBLIC_KEY_LEN]; // The peer's, for a pre-generated initiation
+	union {
+		struct message_handshake_initiation initiation;
+		struct message_handshake_response response;
+	} msg;
+	struct wireguard_handshake_dh dh;
+};
+
+// One worker serves every device - it is started with the first one and then stays, like the lwIP thread.
+// Jobs are only allocated, listed and freed on the lwIP thread; the worker hands each one back through tcpip_callback
+static sys_mbox_t wireguardif_handshake_mbox;
+static bool wireguardif_handshake_started = false;
+static struct wireguardif_handshake_job *wireguardif_handshake_jobs = NULL;
+static int wireguardif_handshake_jobs_pending = 0;
+
+static void wireguardif_handshake_done(void *arg) {
+	struct wireguardif_handshake_job *job = (struct wireguardif_handshake_job *)arg;
+	struct wireguardif_handshake_job **link;
+	struct wireguard_peer *peer;
+	uint32_t start = wireguard_sys_now();
+
+	for (link = &wireguardif_handshake_jobs; *link; link = &(*link)->next) {
+		if (*link == job) {
+			*link = job->next;
+			break;
+		}
+	}
+	wireguardif_handshake_jobs_pending--;
+	wireguard_load_queued(&wireguardif_load, wireguardif_handshake_jobs_pending);
+
+	if (job->type == WIREGUARDIF_HANDSHAKE_PREGEN) {
+		// The peer may have been removed meanwhile - a re-added one with the same key can still use the result
+		peer = job->device ? peer_lookup_by_pubkey(job->device, job->public_key) : NULL;
+		if (peer) {
+			peer->pregen_pending = false;
+			if (job->dh_valid) {
+				wireguard_pregenerate_initiation(job->device, peer, &job->dh);
+			}
+			wireguardif_peer_timer_update(job->device, peer);
+		}
+	} else if (job->device && job->dh_valid) {
+		if (job->type == MESSAGE_HANDSHAKE_INITIATION) {
+			wireguardif_process_initiation_message(job->device, &job->msg.initiation, &job->dh, &job->addr, job->port);
 		} else {
-			// If we are under load then check mac2
-			source_len = get_source_addr_port(addr, port, source_buf, sizeof(source_buf));
+			// The handshake may have moved on while the worker was busy - the dh is checked against it
+			peer = peer_lookup_by_handshake(job->device, job->msg.response.receiver);
+			if (peer) {
+				wireguardif_process_response_message(job->device, peer, &job->msg.response, &job->dh, &job->addr, job->port);
+			}
+		}
+	}
+	if (job->type != WIREGUARDIF_HANDSHAKE_PREGEN) {
+		// Pre-generation is our own work, not something a sender should be asked for a cookie over
+		wireguardif_handshake_busy(start, job->busy_millis);
+	}
+	crypto_zero(job, sizeof(struct wireguardif_handshake_job));
+	mem_free(job);
+}
 
-			result = wireguard_check_mac2(device, data, sizeof(struct message_handshake_initiation) - (WIREGUARD_COOKIE_LEN), source_buf, source_len, msg->mac2);
+static void wireguardif_handshake_worker(void *arg) {
+	struct wireguardif_handshake_job *job;
+	void *msg;
+	uint32_t start;
+	LWIP_UNUSED_ARG(arg);
+
+	for (;;) {
+		if (sys_arch_mbox_fetch(&wireguardif_handshake_mbox, &msg, 0) != SYS_ARCH_TIMEOUT) {
+			job = (struct wireguardif_handshake_job *)msg;
+			start = wireguard_sys_now();
+			if (job->type == WIREGUARDIF_HANDSHAKE_PREGEN) {
+				job->dh_valid = wireguard_handshake_dh_pregen(job->public_key, &job->dh);
+			} else if (job->type == MESSAGE_HANDSHAKE_INITIATION) {
+				job->dh_valid = wireguard_handshake_dh_initiation(job->private_key, job->initiation_hash, &job->msg.initiation, &job->dh);
+			} else {
+				job->dh_valid = wireguard_handshake_dh_response(job->private_key, &job->msg.response, &job->dh);
+			}
+			crypto_zero(job->private_key, sizeof(job->private_key));
+			job->busy_millis = wireguard_sys_now() - start;
+			// Only fails while lwIP is out of message buffers
+			while (tcpip_callback(wireguardif_handshake_done, job) != ERR_OK) {
+				sys_msleep(10);
+			}
+		}
+	}
+}
 
-			if (!result) {
-				// mac2 is invalid (cookie may have expired) or not present
-				// 5.3 Denial of Service Mitigation & Cookies
-				// If the responder receives a message with a valid msg.mac1 yet with an invalid msg.mac2, and is under load, it may respond with a cookie reply message
-				wireguardif_send_handshake_cookie(device, msg->mac1, msg->sender, addr, port);
+static void wireguardif_handshake_start() {
+	if (!wireguardif_handshake_started) {
+		if (sys_mbox_new(&wireguardif_handshake_mbox, WIREGUARD_HANDSHAKE_QUEUE_LEN) == ERR_OK) {
+			if (sys_thread_new("wg_handshake", wireguardif_handshake_worker, NULL, WIREGUARD_HANDSHAKE_STACK_SIZE, WIREGUARD_HANDSHAKE_PRIORITY) != NULL) {
+				wireguardif_handshake_started = true;
+			} else {
+				sys_mbox_free(&wireguardif_handshake_mbox);
 			}
 		}
+		if (!wireguardif_handshake_started) {
+			ESP_LOGW(TAG, "no handshake worker, handshakes are processed inline");
+		}
+	}
+}
 
+// Jobs already queued for the device are finished by the worker but then dropped
+static void wireguardif_handshake_cancel(struct wireguard_device *device) {
+	struct wireguardif_handshake_job *job;
+	for (job = wireguardif_handshake_jobs; job; job = job->next) {
+		if (job->device == device) {
+			job->device = NULL;
+		}
+	}
+}
+
+// A job for the device, or NULL if the worker's queue is full
+static struct wireguardif_handshake_job *wireguardif_handshake_job_new(struct wireguard_device *device, uint8_t type) {
+	struct wireguardif_handshake_job *job = NULL;
+	if (wireguardif_handshake_jobs_pending < WIREGUARD_HANDSHAKE_QUEUE_LEN) {
+		job = (struct wireguardif_handshake_job *)mem_calloc(1, sizeof(struct wireguardif_handshake_job));
+		if (job) {
+			job->device = device;
+			job->type = type;
+		}
+	}
+	return job;
+}
+
+// Lists the job and passes it to the worker - false, and the job freed, if that fails
+static bool wireguardif_handshake_post(struct wireguardif_handshake_job *job) {
+	bool result = false;
+	if (sys_mbox_trypost(&wireguardif_handshake_mbox, job) == ERR_OK) {
+		job->next = wireguardif_handshake_jobs;
+		wireguardif_handshake_jobs = job;
+		wireguardif_handshake_jobs_pending++;
+		wireguard_load_queued(&wireguardif_load, wireguardif_handshake_jobs_pending);
+		result = true;
 	} else {
-		// mac1 is invalid
+		crypto_zero(job, sizeof(struct wireguardif_handshake_job));
+		mem_free(job);
 	}
 	return result;
 }
 
-static bool wireguardif_check_response_message(struct wireguard_device *device, struct message_handshake_response *msg, const ip_addr_t *addr, u16_t port) {
+// Hands a handshake message that passed the mac checks to the worker. ephemeral_private is that of our initiation
+// for a response, NULL for an initiation. False if there is no worker and the caller has to process it; when the
+// queue is full the message is dropped (and true returned) - the sender retries its handshake
+static bool wireguardif_handshake_queue(struct wireguard_device *device, uint8_t type, const void *msg, size_t len, const uint8_t *ephemeral_private, const ip_addr_t *addr, u16_t port) {
+	struct wireguardif_handshake_job *job;
 	bool result = false;
-	uint8_t *data = (uint8_t *)msg;
-	uint8_t source_buf[18];
-	size_t source_len;
-	// We received an initiation packet check it is valid
 
-	if (wireguard_check_mac1(device, data, sizeof(struct message_handshake_response) - (2 * WIREGUARD_COOKIE_LEN), msg->mac1)) {
-		// mac1 is valid!
-		if (!wireguard_is_under_load()) {
-			// If we aren't under load we only need mac1 to be correct
-			result = true;
-		} else {
-			// If we are under load then check mac2
-			source_len = get_source_addr_port(addr, port, source_buf, sizeof(source_buf));
-
-			result = wireguard_check_mac2(device, data, sizeof(struct message_handshake_response) - (WIREGUARD_COOKIE_LEN), source_buf, source_len, msg->mac2);
-
-			if (!result) {
-				// mac2 is invalid (cookie may have expired) or not present
-				// 5.3 Denial of Service Mitigation & Cookies
-				// If the responder receives a message with a valid msg.mac1 yet with an invalid msg.mac2, and is under load, it may respond with a cookie reply message
-				wireguardif_send_handshake_cookie(device, msg->mac1, msg->sender, addr, port);
+	if (wireguardif_handshake_started) {
+		result = true;
+		job = wireguardif_handshake_job_new(device, type);
+		if (job) {
+			ip_addr_copy(job->addr, *addr);
+			job->port = port;
+			memcpy(job->private_key, device->private_key, WIREGUARD_PRIVATE_KEY_LEN);
+			memcpy(job->initiation_hash, device->initiation_hash, WIREGUARD_HASH_LEN);
+			memcpy(&job->msg, msg, len);
+			wireguard_handshake_dh_prepare(&job->dh, ephemeral_private);
+			if (!wireguardif_handshake_post(job)) {
+				job = NULL;
 			}
 		}
+		if (!job) {
+			ESP_LOGD(TAG, "handshake queue full, dropping handshake");
+		}
+	}
+	return result;
+}
 
-	} else {
-		// mac1 is invalid
+// Hands pre-generating an initiation for the peer to the worker. The ephemeral key is drawn here - the random
+// generator is not thread safe. False if there is no worker and the caller has to do it; while the worker is busy
+// nothing is done (and true returned), so received handshakes keep the queue - it is still due on the next pass
+static bool wireguardif_pregen_queue(struct wireguard_device *device, struct wireguard_peer *peer) {
+	struct wireguardif_handshake_job *job = NULL;
+	bool result = false;
+
+	if (wireguardif_handshake_started) {
+		result = true;
+		if (wireguardif_handshake_jobs_pending == 0) {
+			job = wireguardif_handshake_job_new(device, WIREGUARDIF_HANDSHAKE_PREGEN);
+		}
+		if (job) {
+			memcpy(job->public_key, peer->public_key, WIREGUARD_PUBLIC_KEY_LEN);
+			wireguard_handshake_dh_prepare(&job->dh, NULL);
+			peer->pregen_pending = wireguardif_handshake_post(job);
+		}
 	}
 	return result;
 }
+#else
+static void wireguardif_handshake_start() {
+}
+
+static void wireguardif_handshake_cancel(struct wireguard_device *device) {
+}
+
+static bool wireguardif_handshake_queue(struct wireguard_device *device, uint8_t type, const void *msg, size_t len, const uint8_t *ephemeral_private, const ip_addr_t *addr, u16_t port) {
+	return false;
+}
 
+static bool wireguardif_pregen_queue(struct wireguard_device *device, struct wireguard_peer *peer) {
+	return false;
+}
+#endif /* WIREGUARDIF_HANDSHAKE_WORKER */
 
 void wireguardif_network_rx(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
 	LWIP_ASSERT("wireguardif_network_rx: invalid arg", arg != NULL);
@@ -559,30 +1314,38 @@ void wireguardif_network_rx(void *arg, struct udp_pcb *pcb, struct pbuf *p, cons
 	// We have received a packet from the base_netif to our UDP port - process this as a possible Wireguard packet
 	struct wireguard_device *device = (struct wireguard_device *)arg;
 	struct wireguard_peer *peer;
+	struct wireguard_keypair *keypair;
 	uint8_t *data = p->payload;
-	size_t len = p->len; // This buf, not chained ones
+	size_t len = p->tot_len;
 
 	struct message_handshake_initiation *msg_initiation;
 	struct message_handshake_response *msg_response;
 	struct message_cookie_reply *msg_cookie;
 	struct message_transport_data *msg_data;
+	uint32_t start;
 
-	uint8_t type = wireguard_get_message_type(data, len);
+	uint8_t type = MESSAGE_INVALID;
+
+	// Transport data is taken from a chain as it is, anything else has to be in the first pbuf - and so does the
+	// header of a transport data message
+	if ((p->len == p->tot_len) || (p->len >= sizeof(struct message_transport_data))) {
+		type = wireguard_get_message_type(data, len);
+		if ((type != MESSAGE_TRANSPORT_DATA) && (p->len != p->tot_len)) {
+			type = MESSAGE_INVALID;
+		}
+	}
 
 	switch (type) {
 		case MESSAGE_HANDSHAKE_INITIATION:
 			msg_initiation = (struct message_handshake_initiation *)data;
 
 			// Check mac1 (and optionally mac2) are correct - note it may internally generate a cookie reply packet
-			if (wireguardif_check_initiation_message(device, msg_initiation, addr, port)) {
-
-				peer = wireguard_process_initiation_message(device, msg_initiation);
-				if (peer) {
-					// Update the peer location
-					update_peer_addr(peer, addr, port);
-
-					// Send back a handshake response
-					wireguardif_send_handshake_response(device, peer);
+			if (wireguardif_check_handshake_message(device, data, len, msg_initiation->sender, addr, port)) {
+				// The X25519 work is left to the handshake worker, so other traffic is not held up meanwhile
+				if (!wireguardif_handshake_queue(device, type, msg_initiation, len, NULL, addr, port)) {
+					start = wireguard_sys_now();
+					wireguardif_process_initiation_message(device, msg_initiation, NULL, addr, port);
+					wireguardif_handshake_busy(start, 0);
 				}
 			}
 			break;
@@ -591,12 +1354,14 @@ void wireguardif_network_rx(void *arg, struct udp_pcb *pcb, struct pbuf *p, cons
 			msg_response = (struct message_handshake_response *)data;
 
 			// Check mac1 (and optionally mac2) are correct - note it may internally generate a cookie reply packet
-			if (wireguardif_check_response_message(device, msg_response, addr, port)) {
+			if (wireguardif_check_handshake_message(device, data, len, msg_response->sender, addr, port)) {
 
 				peer = peer_lookup_by_handshake(device, msg_response->receiver);
-				if (peer) {
+				if (peer && !wireguardif_handshake_queue(device, type, msg_response, len, peer->handshake->ephemeral_private, addr, port)) {
 					// Process the handshake response
-					wireguardif_process_response_message(device, peer, msg_response, addr, port);
+					start = wireguard_sys_now();
+					wireguardif_process_response_message(device, peer, msg_response, NULL, addr, port);
+					wireguardif_handshake_busy(start, 0);
 				}
 			}
 			break;
@@ -616,10 +1381,11 @@ void wireguardif_network_rx(void *arg, struct udp_pcb *pcb, struct pbuf *p, cons
 
 		case MESSAGE_TRANSPORT_DATA:
 			msg_data = (struct message_transport_data *)data;
-			peer = peer_lookup_by_receiver(device, msg_data->receiver);
-			if (peer) {
-				// header is 16 bytes long so take that off the length
-				wireguardif_process_data_message(device, peer, msg_data, len - 16, addr, port);
+			keypair = keypair_lookup_by_receiver(device, msg_data->receiver, &peer);
+			if (keypair) {
+				wireguardif_process_data_message(device, peer, keypair, p, addr, port);
+				// p is decrypted in place and handed on from there
+				p = NULL;
 			}
 			break;
 
@@ -628,18 +1394,23 @@ void wireguardif_network_rx(void *arg, struct udp_pcb *pcb, struct pbuf *p, cons
 			break;
 	}
 	// Release data!
-	pbuf_free(p);
+	if (p) {
+		pbuf_free(p);
+	}
 }
 
 static err_t wireguard_start_handshake(struct netif *netif, struct wireguard_peer *peer) {
 	struct wireguard_device *device = (struct wireguard_device *)netif->state;
 	err_t result;
 	struct pbuf *pbuf;
-	struct message_handshake_initiation msg;
+	struct message_handshake_initiation *msg;
 
 	ESP_LOGD(TAG, "starting handshake");
-	pbuf = wireguardif_initiate_handshake(device, peer, &msg, &result);
+	pbuf = wireguardif_initiate_handshake(device, peer, &result);
 	if (pbuf) {
+		msg = (struct message_handshake_initiation *)pbuf->payload;
+		memcpy(peer->handshake->mac1, msg->mac1, WIREGUARD_COOKIE_LEN);
+		peer->handshake->mac1_valid = true;
 		result = wireguardif_peer_output(netif, pbuf, peer);
 		if (result != ERR_OK) {
 #ifdef CONFIG_LWIP_DEBUG
@@ -651,8 +1422,6 @@ static err_t wireguard_start_handshake(struct netif *netif, struct wireguard_pee
 		pbuf_free(pbuf);
 		peer->send_handshake = false;
 		peer->last_initiation_tx = wireguard_sys_now();
-		memcpy(peer->handshake_mac1, msg.mac1, WIREGUARD_COOKIE_LEN);
-		peer->handshake_mac1_valid = true;
 	}
 	return result;
 }
@@ -681,6 +1450,7 @@ static err_t wireguardif_lookup_peer(struct netif *netif, u8_t peer_index, struc
 }
 
 err_t wireguardif_connect(struct netif *netif, u8_t peer_index) {
+	LWIP_ASSERT_CORE_LOCKED();
 	struct wireguard_peer *peer;
 	err_t result = wireguardif_lookup_peer(netif, peer_index, &peer);
 	if (result == ERR_OK) {
@@ -690,6 +1460,7 @@ err_t wireguardif_connect(struct netif *netif, u8_t peer_index) {
 			peer->active = true;
 			peer->ip = peer->connect_ip;
 			peer->port = peer->connect_port;
+			wireguardif_peer_timer_update((struct wireguard_device *)netif->state, peer);
 			result = ERR_OK;
 		} else {
 			result = ERR_ARG;
@@ -699,15 +1470,22 @@ err_t wireguardif_connect(struct netif *netif, u8_t peer_index) {
 }
 
 err_t wireguardif_disconnect(struct netif *netif, u8_t peer_index) {
+	LWIP_ASSERT_CORE_LOCKED();
+	struct wireguard_device *device;
 	struct wireguard_peer *peer;
 	err_t result = wireguardif_lookup_peer(netif, peer_index, &peer);
 	if (result == ERR_OK) {
+		device = (struct wireguard_device *)netif->state;
 		// Set the flag that we want to try connecting
 		peer->active = false;
 		// Wipe out current keys
-		keypair_destroy(&peer->next_keypair);
-		keypair_destroy(&peer->curr_keypair);
-		keypair_destroy(&peer->prev_keypair);
+		keypair_destroy(device, &peer->next_keypair);
+		keypair_destroy(device, &peer->curr_keypair);
+		keypair_destroy(device, &peer->prev_keypair);
+		handshake_destroy(device, peer);
+		wireguardif_purge_queued(peer);
+		wireguardif_peer_timer_update(device, peer);
+		wireguardif_update_link(device);
 		result = ERR_OK;
 	}
 	return result;
@@ -756,10 +1534,13 @@ time_t wireguardif_latest_handshake(struct netif *netif, u8_t peer_index) {
 }
 
 err_t wireguardif_add_allowed_ip(struct netif *netif, u8_t peer_index, ip_addr_t ip, ip_addr_t mask) {
+	LWIP_ASSERT_CORE_LOCKED();
+	struct wireguard_device *device;
 	struct wireguard_peer *peer;
 	err_t result = wireguardif_lookup_peer(netif, peer_index, &peer);
 	if (result == ERR_OK) {
-		if(peer_add_ip(peer, ip, mask)) {
+		device = (struct wireguard_device *)netif->state;
+		if (wireguard_allowedips_insert(&device->allowedips, &ip, &mask, peer)) {
 			result = ERR_OK;
 		} else {
 			result = ERR_MEM;
@@ -769,11 +1550,15 @@ err_t wireguardif_add_allowed_ip(struct netif *netif, u8_t peer_index, ip_addr_t
 }
 
 err_t wireguardif_remove_peer(struct netif *netif, u8_t peer_index) {
+	LWIP_ASSERT_CORE_LOCKED();
+	struct wireguard_device *device;
 	struct wireguard_peer *peer;
 	err_t result = wireguardif_lookup_peer(netif, peer_index, &peer);
 	if (result == ERR_OK) {
-		crypto_zero(peer, sizeof(struct wireguard_peer));
-		peer->valid = false;
+		device = (struct wireguard_device *)netif->state;
+		wireguardif_purge_queued(peer);
+		peer_free(device, peer);
+		wireguardif_update_link(device);
 		result = ERR_OK;
 	}
 	return result;
@@ -795,6 +1580,7 @@ err_t wireguardif_add_peer(struct netif *netif, struct wireguardif_peer *p, u8_t
 	LWIP_ASSERT("netif != NULL", (netif != NULL));
 	LWIP_ASSERT("state != NULL", (netif->state != NULL));
 	LWIP_ASSERT("p != NULL", (p != NULL));
+	LWIP_ASSERT_CORE_LOCKED();
 	struct wireguard_device *device = (struct wireguard_device *)netif->state;
 	err_t result;
 	uint8_t public_key[WIREGUARD_PUBLIC_KEY_LEN];
@@ -820,11 +1606,14 @@ err_t wireguardif_add_peer(struct netif *netif, struct wireguardif_peer *p, u8_t
 					peer->ip = peer->connect_ip;
 					peer->port = peer->connect_port;
 					peer->keepalive_interval = p->keep_alive;
-					peer_add_ip(peer, p->allowed_ip, p->allowed_mask);
+					wireguard_allowedips_insert(&device->allowedips, &p->allowed_ip, &p->allowed_mask, peer);
 					memcpy(peer->greatest_timestamp, p->greatest_timestamp, sizeof(peer->greatest_timestamp));
 
 					result = ERR_OK;
 				} else {
+					// Give the slot and its memory back
+					peer_free(device, peer);
+					peer = NULL;
 					result = ERR_ARG;
 				}
 			} else {
@@ -895,51 +1684,184 @@ static bool should_reset_peer(struct wireguard_peer *peer) {
 	return result;
 }
 
-static void wireguardif_tmr(void *arg) {
-	struct wireguard_device *device = (struct wireguard_device *)arg;
+// When the idle-time pre-generation of an initiation is next due. Only for peers about to initiate: active ones
+// without a session, and ones with a session from half a slot's lifetime before the earliest rekey, so the slot is
+// fresh when it is needed. A slot that goes stale unused is then not rebuilt every PREGEN_INITIATION_MAX_AGE - an
+// idle peer gets one per session at most, and none once the session has gone
+static bool wireguardif_pregen_due(struct wireguard_peer *peer, uint32_t *due) {
+	struct wireguard_keypair *keypair = &peer->curr_keypair;
+	uint32_t rekey;
+	bool result = false;
+	if (!peer->pregen_pending) {
+		if (keypair->valid) {
+			result = wireguard_pregen_initiation_due(peer, due);
+			rekey = keypair->keypair_millis + (REKEY_AFTER_TIME * 1000) - (PREGEN_INITIATION_MAX_AGE * 500);
+			if (result && ((int32_t)(*due - rekey) < 0)) {
+				*due = rekey;
+			}
+		} else if (peer->active) {
+			result = wireguard_pregen_initiation_due(peer, due);
+		}
+	}
+	return result;
+}
+
+static bool should_pregenerate_initiation(struct wireguard_peer *peer) {
+	bool result = false;
+	uint32_t due;
+	if (wireguardif_pregen_due(peer, &due)) {
+		result = ((int32_t)(due - wireguard_sys_now()) <= 0);
+	}
+	return result;
+}
+
+// NETIF_FLAG_LINK_UP is cleared once no peer has a session left
+static void wireguardif_update_link(struct wireguard_device *device) {
 	struct wireguard_peer *peer;
+	bool link_up = false;
 	int x;
-	// Reschedule this timer
-	sys_timeout(WIREGUARDIF_TIMER_MSECS, wireguardif_tmr, device);
+	for (x=0; !link_up && (x < device->peer_capacity); x++) {
+		peer = device->peers[x];
+		if (peer && peer->valid && (peer->curr_keypair.valid || peer->prev_keypair.valid)) {
+			link_up = true;
+		}
+	}
+	if (!link_up) {
+		// Clear the IF-UP flag on netif
+		netif_set_link_down(device->netif);
+	}
+}
 
-	// Check periodic things
-	bool link_up = false;
-	for (x=0; x < WIREGUARD_MAX_PEERS; x++) {
-		peer = &device->peers[x];
-		if (peer->valid) {
-			// Do we need to rekey / send a handshake?
-			if (should_reset_peer(peer)) {
-				// Nothing back for too long - we should wipe out all crypto state
-				keypair_destroy(&peer->next_keypair);
-				keypair_destroy(&peer->curr_keypair);
-				keypair_destroy(&peer->prev_keypair);
-				// TODO: Also destroy handshake?
-
-				// Revert back to default IP/port if these were altered
-				peer->ip = peer->connect_ip;
-				peer->port = peer->connect_port;
-			}
-			if (should_destroy_current_keypair(peer)) {
-				// Destroy current keypair
-				keypair_destroy(&peer->curr_keypair);
-			}
-			if (should_send_keepalive(peer)) {
-				wireguardif_send_keepalive(device, peer);
-			}
-			if (should_send_initiation(peer)) {
-				wireguard_start_handshake(device->netif, peer);
-			}
+static void wireguardif_deadline(uint32_t *earliest, bool *pending, uint32_t deadline) {
+	if (!*pending || ((int32_t)(deadline - *earliest) < 0)) {
+		*earliest = deadline;
+		*pending = true;
+	}
+}
 
-			if ((peer->curr_keypair.valid) || (peer->prev_keypair.valid)) {
-				link_up = true;
+// Arms the peer's timer for the earliest moment one of the should_*() checks can turn true. Apart from time
+// passing they only turn true on the events that call wireguardif_peer_timer_update(), so nothing has to poll.
+// A deadline that moves later (last_tx after a send) is picked up when the timer fires. Deadlines before
+// not_before are moved there, and the timer is disarmed when nothing is pending
+static void wireguardif_arm_peer_timer(struct wireguard_device *device, struct wireguard_peer *peer, uint32_t not_before) {
+	struct wireguard_keypair *keypair = &peer->curr_keypair;
+	uint32_t earliest = 0;
+	uint32_t initiation;
+	uint32_t rekey;
+	uint32_t pregen;
+	uint16_t jitter;
+	bool pending = false;
+
+	if (peer->valid) {
+		if (keypair->valid) {
+			// should_destroy_current_keypair - should_reset_peer is later and only applies while the keypair is kept
+			wireguardif_deadline(&earliest, &pending, (keypair->sending_counter >= REJECT_AFTER_MESSAGES) ? not_before : (keypair->keypair_millis + (REJECT_AFTER_TIME * 1000)));
+		}
+		if ((peer->keepalive_interval > 0) && (keypair->valid || peer->prev_keypair.valid)) {
+			wireguardif_deadline(&earliest, &pending, peer->last_tx + (peer->keepalive_interval * 1000));
+		}
+		// should_send_initiation, never before wireguardif_can_send_initiation
+		initiation = (peer->last_initiation_tx == 0) ? not_before : (peer->last_initiation_tx + (REKEY_TIMEOUT * 1000));
+		if (peer->send_handshake || (!keypair->valid && peer->active)) {
+			wireguardif_deadline(&earliest, &pending, initiation);
+		} else if (keypair->valid && !keypair->initiator && (peer->keepalive_interval < REJECT_AFTER_TIME)) {
+			rekey = keypair->keypair_millis + ((REJECT_AFTER_TIME - peer->keepalive_interval) * 1000);
+			wireguardif_deadline(&earliest, &pending, ((int32_t)(rekey - initiation) > 0) ? rekey : initiation);
+		}
+		if (wireguardif_pregen_due(peer, &pregen)) {
+			wireguardif_deadline(&earliest, &pending, pregen);
+		}
+	}
+
+	if (pending) {
+		if ((int32_t)(earliest - not_before) < 0) {
+			earliest = not_before;
+		}
+		wireguard_random_bytes(&jitter, sizeof(jitter));
+		peer->timer.arg = peer;
+		wireguard_timer_arm(&device->timers, &peer->timer, earliest + (jitter % WIREGUARDIF_TIMER_JITTER_MSECS));
+	} else {
+		wireguard_timer_disarm(&device->timers, &peer->timer);
+	}
+}
+
+// Keeps one lwIP timeout for the earliest peer timer, and none at all while no timer is armed
+static void wireguardif_timer_schedule(struct wireguard_device *device) {
+	uint32_t expires;
+	uint32_t now;
+	if (wireguard_timer_next(&device->timers, &expires)) {
+		// Firing early is harmless (the run just reschedules) so the timeout is only ever brought forward
+		if (!device->timer_scheduled || ((int32_t)(expires - device->timer_expires) < 0)) {
+			if (device->timer_scheduled) {
+				sys_untimeout(wireguardif_tmr, device);
 			}
+			now = wireguard_sys_now();
+			device->timer_expires = expires;
+			device->timer_scheduled = true;
+			sys_timeout(((int32_t)(expires - now) > 0) ? (expires - now) : 0, wireguardif_tmr, device);
 		}
+	} else if (device->timer_scheduled) {
+		sys_untimeout(wireguardif_tmr, device);
+		device->timer_scheduled = false;
 	}
+}
 
-	if (!link_up) {
-		// Clear the IF-UP flag on netif
-		netif_set_link_down(device->netif);
+// After an event that can bring one of the peer's deadlines forward
+static void wireguardif_peer_timer_update(struct wireguard_device *device, struct wireguard_peer *peer) {
+	wireguardif_arm_peer_timer(device, peer, wireguard_sys_now());
+	wireguardif_timer_schedule(device);
+}
+
+// Does what is due for one peer and re-arms its timer. *busy is set once an x25519 computation ran in this pass -
+// pre-generation then waits, so a pass never holds the lwIP thread for long
+static void wireguardif_peer_timer(struct wireguard_device *device, struct wireguard_peer *peer, bool *busy) {
+	if (peer->valid) {
+		// Do we need to rekey / send a handshake?
+		if (should_reset_peer(peer)) {
+			// Nothing back for too long - we should wipe out all crypto state
+			keypair_destroy(device, &peer->next_keypair);
+			keypair_destroy(device, &peer->curr_keypair);
+			keypair_destroy(device, &peer->prev_keypair);
+			handshake_destroy(device, peer);
+			wireguardif_purge_queued(peer);
+
+			// Revert back to default IP/port if these were altered
+			peer->ip = peer->connect_ip;
+			peer->port = peer->connect_port;
+		}
+		if (should_destroy_current_keypair(peer)) {
+			// Destroy current keypair
+			keypair_destroy(device, &peer->curr_keypair);
+		}
+		if (should_send_keepalive(peer)) {
+			wireguardif_send_keepalive(device, peer);
+		}
+		if (should_send_initiation(peer)) {
+			wireguard_start_handshake(device->netif, peer);
+			*busy = true;
+		}
+		// Idle time: prepare the expensive part of the next initiation now so sending it later is cheap
+		// The handshake worker does the x25519 work if there is one
+		if (!*busy && should_pregenerate_initiation(peer) && !wireguardif_pregen_queue(device, peer)) {
+			wireguard_pregenerate_initiation(device, peer, NULL);
+			*busy = true;
+		}
+	}
+	wireguardif_arm_peer_timer(device, peer, wireguard_sys_now() + WIREGUARDIF_TIMER_RETRY_MSECS);
+}
+
+static void wireguardif_tmr(void *arg) {
+	struct wireguard_device *device = (struct wireguard_device *)arg;
+	struct wireguard_timer *timer;
+	uint32_t now = wireguard_sys_now();
+	bool busy = false;
+
+	device->timer_scheduled = false;
+	while ((timer = wireguard_timer_expire(&device->timers, now)) != NULL) {
+		wireguardif_peer_timer(device, (struct wireguard_peer *)timer->arg, &busy);
 	}
+	wireguardif_update_link(device);
+	wireguardif_timer_schedule(device);
 }
 
 
@@ -1035,7 +1957,12 @@ err_t wireguardif_init(struct netif *netif) {
 							netif->state = device;
 							netif->name[0] = 'w';
 							netif->name[1] = 'g';
+#if LWIP_IPV4
 							netif->output = wireguardif_output;
+#endif
+#if LWIP_IPV6
+							netif->output_ip6 = wireguardif_output_ip6;
+#endif
 							netif->linkoutput = NULL;
 							netif->hwaddr_len = 0;
 							netif->mtu = WIREGUARDIF_MTU;
@@ -1043,10 +1970,22 @@ err_t wireguardif_init(struct netif *netif) {
 							// NETIF_FLAG_LINK_UP is automatically set/cleared when at least one peer is connected
 							netif->flags = 0;
 
+							if (!wireguardif_ratelimiter_ready) {
+								wireguard_ratelimiter_init(&wireguardif_ratelimiter);
+								wireguardif_ratelimiter_ready = true;
+							}
+							device->tx_pool = wireguardif_tx_pool_new();
+							if (!device->tx_pool && (WIREGUARD_TX_POOL_SIZE > 0)) {
+								ESP_LOGW(TAG, "no memory for the transmit buffer pool, sending from the heap");
+							}
+							device->tx_drain = wireguardif_tx_drain_new(device);
+							if (!device->tx_drain && WIREGUARDIF_TX_BATCH) {
+								ESP_LOGW(TAG, "no memory for batching, sending packets as they come");
+							}
 							udp_recv(udp, wireguardif_network_rx, device);
+							wireguardif_handshake_start();
 
-							// Start a periodic timer for this wireguard device
-							sys_timeout(WIREGUARDIF_TIMER_MSECS, wireguardif_tmr, device);
+							// No timer yet - wireguardif_tmr is scheduled as peer deadlines are armed
 
 							result = ERR_OK;
 						} else {
@@ -1093,10 +2032,15 @@ void wireguardif_peer_init(struct wireguardif_peer *peer) {
 void wireguardif_shutdown(struct netif *netif) {
 	LWIP_ASSERT("netif != NULL", (netif != NULL));
 	LWIP_ASSERT("state != NULL", (netif->state != NULL));
+	LWIP_ASSERT_CORE_LOCKED();
 
 	struct wireguard_device *device = (struct wireguard_device *)netif->state;
 	// Disable timer.
 	sys_untimeout(wireguardif_tmr, device);
+	device->timer_scheduled = false;
+	wireguardif_handshake_cancel(device);
+	wireguardif_tx_drain_release(device->tx_drain);
+	device->tx_drain = NULL;
 	// remove UDP context.
 	if (device->udp_pcb) {
 		udp_disconnect(device->udp_pcb);
@@ -1110,8 +2054,17 @@ void wireguardif_fini(struct netif *netif) {
 	LWIP_ASSERT("state != NULL", (netif->state != NULL));
 
 	struct wireguard_device *device = (struct wireguard_device *)netif->state;
+	int x;
 
 	// remove device context.
+	for (x=0; x < device->peer_capacity; x++) {
+		if (device->peers[x]) {
+			wireguardif_purge_queued(device->peers[x]);
+		}
+	}
+	wireguardif_tx_pool_release(device->tx_pool);
+	device->tx_pool = NULL;
+	wireguard_device_fini(device);
 	free(device);
 	netif->state = NULL;
 }
@@ -77,7 +77,9 @@ struct wireguardif_peer {
 
 #define WIREGUARDIF_INVALID_INDEX (0xFF)
 
-/* static struct netif wg_netif_struct = {0};
+/* Like netif_add() itself, these calls belong on the lwIP thread (tcpip_api_call) or under LOCK_TCPIP_CORE()
+ *
+ * static struct netif wg_netif_struct = {0};
  * struct wireguard_interface wg;
  * wg.private_key = "abcdefxxx..xxxxx=";
  * wg.listen_port = 51820;
@@ -116,26 +118,36 @@ void wireguardif_peer_init(struct wireguardif_peer *peer);
 
 // Add a new peer to the specified interface - see wireguard.h for maximum number of peers allowed
 // On success the peer_index can be used to reference this peer in future function calls
+// The peer tables it may grow are read by the lwIP thread for every packet - call it there or with the core lock held
 err_t wireguardif_add_peer(struct netif *netif, struct wireguardif_peer *peer, u8_t *peer_index);
 
 // Remove the given peer from the network interface
+// Frees its allowed ips, which the lwIP thread looks up for every packet - call it there or with the core lock held
 err_t wireguardif_remove_peer(struct netif *netif, u8_t peer_index);
 
 // Update the "connect" IP of the given peer
 err_t wireguardif_update_endpoint(struct netif *netif, u8_t peer_index, const ip_addr_t *ip, u16_t port);
 
-// Try and connect to the given peer
+// Try and connect to the given peer - arms the peer's timer, so call it on the lwIP thread or with the core lock held
 err_t wireguardif_connect(struct netif *netif, u8_t peer_index);
 
-// Stop trying to connect to the given peer
+// Stop trying to connect to the given peer - on the lwIP thread or with the core lock held, like wireguardif_connect
 err_t wireguardif_disconnect(struct netif *netif, u8_t peer_index);
 
-// Shutdown the WireGuard interface
+// Shutdown the WireGuard interface - on the lwIP thread or with the core lock held, before netif_remove()
 void wireguardif_shutdown(struct netif *netif);
 
 // Finalize the WireGuard interface after the netif is removed
 void wireguardif_fini(struct netif *netif);
 
+// Usage of the interface's pool of transmit buffers: how many are in use now, the most that ever were at once, and
+// how many packets found them all in use and were allocated from the heap instead
+err_t wireguardif_tx_pool_usage(struct netif *netif, u16_t *in_use, u16_t *high_water, u32_t *exhausted);
+
+// Number of batched packets that were dropped because no transmit buffer could be had for them or sending them
+// failed - without batching, such failures are returned to lwIP instead
+err_t wireguardif_tx_dropped(struct netif *netif, u32_t *dropped);
+
 // Is the given peer "up"? A peer is up if it has a valid session key it can communicate with
 err_t wireguardif_peer_is_up(struct netif *netif, u8_t peer_index, ip_addr_t *current_ip, u16_t *current_port);
 
@@ -143,7 +155,8 @@ err_t wireguardif_peer_is_up(struct netif *netif, u8_t peer_index, ip_addr_t *cu
 // Return 0 if no handshake already done or in case of errors
 time_t wireguardif_latest_handshake(struct netif *netif, u8_t peer_index);
 
-// Add ip/mask to the list of allowed ips of the given peer
+// Add ip/mask (IPv4 or IPv6) to the allowed ips of the given peer - longest prefix match picks the peer, an ip/mask
+// already allowed for another peer moves to this one. Call on the lwIP thread or with the core lock held
 err_t wireguardif_add_allowed_ip(struct netif *netif, u8_t peer_index, ip_addr_t ip, ip_addr_t mask);
 
 #ifdef __cplusplus
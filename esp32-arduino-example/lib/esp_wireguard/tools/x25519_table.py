@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Generates src/crypto/refc/x25519-table.h - the precomputed comb table used by x25519_base()
+#
+#   python3 tools/x25519_table.py > src/crypto/refc/x25519-table.h
+#
+# The scalar is recoded into signed binary digits (+1/-1, see x25519.c) and split into COMBS combs of TEETH teeth
+# spaced SPACING bits apart. Entry [c][i] of the table is
+#   2^(c*TEETH*SPACING) * (2^((TEETH-1)*SPACING)*B + sum over t < TEETH-1 of (+1 if bit t of i else -1) * 2^(t*SPACING)*B)
+# i.e. every column value whose top tooth is +1; the other half are their negations and are not stored.
+# Points are stored as affine Edwards25519 (y+x, y-x, 2*d*x*y), once for each field backend: 10 limbs of 25.5 bits
+# (fe25519-32.h) and 5 limbs of 51 bits (fe25519-64.h).
+
+import sys
+
+TEETH = 5
+SPACING = 13
+COMBS = 4
+
+P = 2**255 - 19
+D = (-121665 * pow(121666, P - 2, P)) % P
+BY = (4 * pow(5, P - 2, P)) % P
+BX = 15112221349535400772501151409588531511454012693041857206046113283949847762202
+
+
+def add(p, q):
+	(x1, y1), (x2, y2) = p, q
+	t = (D * x1 * x2 * y1 * y2) % P
+	x3 = ((x1 * y2 + y1 * x2) * pow(1 + t, P - 2, P)) % P
+	y3 = ((y1 * y2 + x1 * x2) * pow(1 - t, P - 2, P)) % P
+	return (x3, y3)
+
+
+def neg(p):
+	return ((-p[0]) % P, p[1])
+
+
+def mul(k, p):
+	r = (0, 1)
+	while k:
+		if k & 1:
+			r = add(r, p)
+		p = add(p, p)
+		k >>= 1
+	return r
+
+
+def limbs(v, radix51):
+	out = []
+	for i in range(5 if radix51 else 10):
+		bits = 51 if radix51 else (26 if (i % 2) == 0 else 25)
+		out.append(v & ((1 << bits) - 1))
+		v >>= bits
+	return out
+
+
+def fe(v, radix51):
+	fmt = "0x%013xULL" if radix51 else "%d"
+	return "{ " + ", ".join(fmt % l for l in limbs(v % P, radix51)) + " }"
+
+
+def table(out, points, radix51):
+	out.write("static const x25519_niels x25519_comb_table[X25519_COMB_COUNT][X25519_COMB_ENTRIES] = {\n")
+	for comb in points:
+		out.write("\t{\n")
+		for (x, y) in comb:
+			out.write("\t\t{\n")
+			out.write("\t\t\t%s,\n" % fe(y + x, radix51))
+			out.write("\t\t\t%s,\n" % fe(y - x, radix51))
+			out.write("\t\t\t%s\n" % fe(2 * D * x * y, radix51))
+			out.write("\t\t},\n")
+		out.write("\t},\n")
+	out.write("};\n")
+
+
+def main():
+	assert (BX * BX * (P - 1) + BY * BY) % P == (1 + D * BX * BX * BY * BY) % P, "base point not on curve"
+
+	bits = TEETH * SPACING * COMBS
+	assert bits >= 256
+
+	# 2^(j*SPACING)*B for every tooth position of every comb
+	tooth = [mul(1 << (j * SPACING), (BX, BY)) for j in range(TEETH * COMBS)]
+
+	points = []
+	for c in range(COMBS):
+		comb = []
+		for i in range(1 << (TEETH - 1)):
+			pt = tooth[c * TEETH + TEETH - 1]
+			for t in range(TEETH - 1):
+				q = tooth[c * TEETH + t]
+				pt = add(pt, q if (i >> t) & 1 else neg(q))
+			comb.append(pt)
+		points.append(comb)
+
+	out = sys.stdout
+	out.write("// Precomputed comb table for x25519_base() - generated by tools/x25519_table.py, do not edit\n")
+	out.write("// %d combs x %d entries, %d teeth spaced %d bits apart (%d scalar bits)\n\n" % (COMBS, 1 << (TEETH - 1), TEETH, SPACING, bits))
+	out.write("#define X25519_COMB_TEETH %d\n" % TEETH)
+	out.write("#define X25519_COMB_SPACING %d\n" % SPACING)
+	out.write("#define X25519_COMB_COUNT %d\n" % COMBS)
+	out.write("#define X25519_COMB_ENTRIES %d\n\n" % (1 << (TEETH - 1)))
+	out.write("#if FE25519_LIMBS == 5\n")
+	table(out, points, True)
+	out.write("#else\n")
+	table(out, points, False)
+	out.write("#endif\n")
+
+
+if __name__ == "__main__":
+	main()